@@ -65,12 +65,37 @@
  * // Somewhere else:
  * mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, my_alarm_ev_handler, NULL);
  * ```
+ *
+ * The event data is taken from a fixed pool of payloads and recycled once
+ * the handlers return, handlers must copy anything they need to keep and
+ * must not free it.
+ *
+ * With mgos_alarm_set_batch_events(true) the per-alarm SET/RESET events are
+ * replaced by a single MGOS_ALARM_EV_BATCH per main alarm service timer pass,
+ * its event data is a struct alarm_batch. Transitions made by debounce timers
+ * between passes join the next pass's batch, MGOS_ALARM_EVAL_IMMEDIATE 
+ * notifications deliver their own batch. The same copy/no free rules apply.
+ *
+ * With mgos_alarm_set_dispatch_mode(MGOS_ALARM_DISPATCH_ASYNC, ...) the same
+ * events are raised later from a drain callback on the mgos task, a batch
+ * then holds the transitions of one drain callback.
+ *
+ * An alarm whose chatter detection latches (see mgos_alarm_set_chatter_h)
+ * raises MGOS_ALARM_EV_CHATTER, its event data a struct alarm_info like
+ * SET/RESET, in place of the transition that latched it and raises no
+ * further SET/RESET until it unlatches. Transitions refused by the event
+ * rate limiter (see mgos_alarm_set_rate_limit) are replaced by a periodic
+ * MGOS_ALARM_EV_SUMMARY, its event data a struct alarm_summary. A summary
+ * is never batched.
  */
 #define MGOS_EVENT_GRP_ALARM MGOS_EVENT_BASE('A', 'L', 'M')
 
 enum mgos_alarm_event{
   MGOS_ALARM_EV_RESET = MGOS_EVENT_GRP_ALARM,
-  MGOS_ALARM_EV_SET
+  MGOS_ALARM_EV_SET,
+  MGOS_ALARM_EV_BATCH,
+  MGOS_ALARM_EV_CHATTER,
+  MGOS_ALARM_EV_SUMMARY
 };
 
 /*
@@ -101,6 +126,18 @@ enum mgos_a_alarm_state{
   HH
 };
 
+/*
+ * Statistic a windowed analog alarm classifies, see mgos_add_window_alarm_h
+ * MGOS_ALARM_WINDOW_MIN - the lowest sample in the window
+ * MGOS_ALARM_WINDOW_MAX - the highest sample in the window
+ * MGOS_ALARM_WINDOW_MEAN - the mean of the samples in the window
+ */
+enum mgos_alarm_window_stat{
+  MGOS_ALARM_WINDOW_MIN,
+  MGOS_ALARM_WINDOW_MAX,
+  MGOS_ALARM_WINDOW_MEAN
+};
+
 /*
  * Alarm types
  * 
@@ -145,6 +182,81 @@ struct alarm_list{
   size_t length;
 };
 
+/*
+ * Opaque alarm handle returned by mgos_add_a_alarm_h, mgos_add_d_alarm_h
+ * and mgos_alarm_find. 
+ * 
+ * A handle is a generation checked index into the alarm table, operations
+ * on a handle skip the name lookup entirely. Once the alarm is removed its
+ * handles are stale and every handle operation on them returns false.
+ */
+typedef uint32_t mgos_alarm_handle_t;
+
+#define MGOS_ALARM_INVALID_HANDLE ((mgos_alarm_handle_t) 0)
+
+/*
+ * Alarm transition delivered as part of MGOS_ALARM_EV_BATCH.
+ * 
+ * ev - MGOS_ALARM_EV_SET, MGOS_ALARM_EV_RESET or MGOS_ALARM_EV_CHATTER, the
+ *   event the transition would have raised on its own
+ * handle - the handle of the alarm
+ * info - the alarm after the transition, info.state is the new state
+ * old_state - the state before the transition, d_state or a_state as info.type
+ * time_ms - uptime in milliseconds at which the alarm transitioned
+ */
+struct alarm_transition{
+  int ev;
+  mgos_alarm_handle_t handle;
+  struct alarm_info info;
+  union{
+    bool d_state;
+    enum mgos_a_alarm_state a_state;
+  } old_state;
+  int64_t time_ms;
+};
+
+/*
+ * Event data of MGOS_ALARM_EV_BATCH, the transitions are in the order 
+ * they happened.
+ */
+struct alarm_batch{
+  const struct alarm_transition *transitions;
+  size_t length;
+};
+
+/*
+ * Event data of MGOS_ALARM_EV_SUMMARY, the transitions the event rate
+ * limiter refused since the previous summary. The alarms' states are
+ * up to date in mgos_list_alarms whether or not their events were raised.
+ *
+ * suppressed - number of transitions refused
+ * from_ms, to_ms - uptime in milliseconds of the first and last of them
+ * since - pass to mgos_list_alarm_changes to list every alarm they changed
+ */
+struct alarm_summary{
+  uint32_t suppressed;
+  int64_t from_ms, to_ms;
+  uint32_t since;
+};
+
+/*
+ * The last cascade of the suppression graph, see mgos_alarm_set_parent_h.
+ * A cascade starts when an alarm becomes active and masks descendants.
+ *
+ * first_out - the alarm of the cascade that became active first, the
+ *   parent or one of the alarms it masked that was already active
+ * parent - the alarm whose activation started the cascade
+ * time_ms - uptime in milliseconds the cascade started at
+ * masked - number of alarms the cascade masked when it started
+ * active - the parent is still active, the cascade has not ended
+ */
+struct alarm_first_out{
+  mgos_alarm_handle_t first_out, parent;
+  int64_t time_ms;
+  uint32_t masked;
+  bool active;
+};
+
 /*
  * Add an analog alarm to the alarm list.
  * 
@@ -210,13 +322,663 @@ bool mgos_disable_alarm(char *name);
  */
 bool mgos_reset_alarm(char *name);
 
+/*
+ * Handle returning variants of mgos_add_a_alarm and mgos_add_d_alarm,
+ * the arguments are identical.
+ * returns the handle of the added alarm
+ * returns MGOS_ALARM_INVALID_HANDLE otherwise
+ */
+mgos_alarm_handle_t mgos_add_a_alarm_h(bool enabled, float *pv, float ll_sv, float l_sv,
+                                       float h_sv, float hh_sv, int set_interval, 
+                                       char *name);
+mgos_alarm_handle_t mgos_add_d_alarm_h(bool enabled, bool *input, enum mgos_d_alarm_mode mode,
+                                       int set_interval, int reset_interval, char *name);
+
+/*
+ * Add an analog alarm on a raw ADC count, such as the value of 
+ * mgos_adc_read, without converting the count to a float. The setpoints
+ * are given in engineering units, value = raw * scale + offset, and are
+ * converted to counts once here so that every evaluation is an integer 
+ * compare. The engineering value is only computed when it is reported by
+ * mgos_alarm_get_value_h. The alarm is an ANALOG alarm in every other way.
+ *
+ * raw - pointer to the count
+ * scale - engineering units per count, must be greater than 0
+ * offset - engineering value of a count of 0
+ * the other arguments are those of mgos_add_a_alarm
+ * returns the handle of the added alarm
+ * returns MGOS_ALARM_INVALID_HANDLE otherwise
+ */
+mgos_alarm_handle_t mgos_add_raw_alarm_h(bool enabled, const int32_t *raw, float scale, float offset,
+                                         float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                         int set_interval, char *name);
+mgos_alarm_handle_t mgos_add_raw16_alarm_h(bool enabled, const int16_t *raw, float scale, float offset,
+                                           float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                           int set_interval, char *name);
+
+/*
+ * Add an analog alarm on the rate of change of a float PV, in PV units per
+ * period ms, for example a level rising faster than a limit per minute
+ * with a period of 60000 and the limit as h_sv. The rate is an exponential
+ * moving average of the change between samples, updated from each sample
+ * in constant time. The PV is sampled every pass in every evaluation mode
+ * as the rate also changes while the PV does not, it needs two samples
+ * before it is classified. The alarm is an ANALOG alarm in every other way.
+ *
+ * period - ms the rate is expressed over, must be greater than 0
+ * filter - time constant of the average in ms, 0 for the rate between
+ *   the last two samples
+ * the other arguments are those of mgos_add_a_alarm with the setpoints
+ *   applying to the rate
+ * returns the handle of the added alarm
+ * returns MGOS_ALARM_INVALID_HANDLE otherwise
+ */
+mgos_alarm_handle_t mgos_add_rate_alarm_h(bool enabled, float *pv, int period, int filter,
+                                          float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                          int set_interval, char *name);
+
+/*
+ * Add an analog alarm on the deviation *pv - *sp of a float PV from a
+ * moving setpoint, for example l_sv -y and h_sv y for a PV more than y
+ * from its setpoint. The deviation is averaged as the rate of 
+ * mgos_add_rate_alarm_h is and is sampled every pass in the same way.
+ *
+ * sp - pointer to the setpoint, read each time the PV is sampled
+ * filter - time constant of the average in ms, 0 for no filtering
+ * the other arguments are those of mgos_add_a_alarm with the setpoints
+ *   applying to the deviation
+ * returns the handle of the added alarm
+ * returns MGOS_ALARM_INVALID_HANDLE otherwise
+ */
+mgos_alarm_handle_t mgos_add_deviation_alarm_h(bool enabled, float *pv, const float *sp, int filter,
+                                               float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                               int set_interval, char *name);
+
+/*
+ * Add an analog alarm on the minimum, maximum or mean of a float PV over a
+ * sliding window of its last samples, so that a noisy PV does not chatter
+ * across a setpoint. The PV is sampled every pass in every evaluation mode
+ * into a ring of samples allocated here, each sample costs O(1) amortized
+ * whatever the window length. A NAN PV empties the window.
+ *
+ * stat - the statistic classified against the setpoints
+ * samples - most samples in the window, must be greater than 0. For a
+ *   window of window_ms this should be at least window_ms / poll_interval
+ *   or the oldest samples are dropped early
+ * window_ms - samples older than this leave the window, 0 to keep the last
+ *   samples samples whatever their age
+ * the other arguments are those of mgos_add_a_alarm with the setpoints
+ *   applying to the statistic
+ * returns the handle of the added alarm
+ * returns MGOS_ALARM_INVALID_HANDLE otherwise
+ */
+mgos_alarm_handle_t mgos_add_window_alarm_h(bool enabled, float *pv, enum mgos_alarm_window_stat stat,
+                                            int samples, int window_ms, float ll_sv, float l_sv,
+                                            float h_sv, float hh_sv, int set_interval, char *name);
+
+/*
+ * Add a digital alarm whose input is a boolean expression over the states
+ * and inputs of other alarms, such as "pump & level.LL" or
+ * "2 of (pt1.HH, pt2.HH, pt3.HH)". The expression is compiled here into
+ * bytecode with its alarm names bound to handles, so it can only refer to
+ * alarms that already exist, and cannot form a cycle. It is evaluated after
+ * the scan, in the order the expressions were added, and only when an
+ * alarm it refers to changed, or every pass in MGOS_ALARM_EVAL_POLL if it
+ * reads an input. The alarm then debounces the result like any digital
+ * alarm's input, a set_interval of 5000 makes "for 5s".
+ *
+ * An operand is true, false, a reference or a parenthesised expression,
+ * the operators from the lowest precedence are | (or ||), ^, & (or &&)
+ * and !. K of (e1, e2, ...) is true while at least K of its expressions
+ * are. A reference is an alarm name, in double quotes unless it is made of
+ * letters, digits, _ and - and starts with a letter or _, followed by
+ * nothing or .active - the alarm is active, an analog alarm is not NOM
+ * .in - a digital alarm's input is in its active state, before debouncing
+ * .NOM, .LL, .L, .H or .HH - an analog alarm is in that state
+ * A reference to an alarm that has since been removed is false.
+ *
+ * expr - the expression, at most 32 references and 32 nested operands
+ * the other arguments are those of mgos_add_d_alarm
+ * returns the handle of the added alarm
+ * returns MGOS_ALARM_INVALID_HANDLE if the expression does not compile or
+ *   the alarm could not be added
+ */
+mgos_alarm_handle_t mgos_add_expr_alarm_h(bool enabled, const char *expr, int set_interval,
+                                          int reset_interval, char *name);
+
+/*
+ * Look up the handle of the alarm with the passed name
+ * returns MGOS_ALARM_INVALID_HANDLE if the alarm does not exist
+ */
+mgos_alarm_handle_t mgos_alarm_find(const char *name);
+
+/*
+ * Handle based alarm operations, equivalent to the name based 
+ * mgos_remove_alarm, mgos_disable_alarm and mgos_reset_alarm.
+ * mgos_alarm_enable_h re-enables a disabled alarm.
+ * returns true if the operation is applied
+ * returns false if the handle is invalid or stale
+ */
+bool mgos_alarm_remove_h(mgos_alarm_handle_t handle);
+bool mgos_alarm_enable_h(mgos_alarm_handle_t handle);
+bool mgos_alarm_disable_h(mgos_alarm_handle_t handle);
+bool mgos_alarm_reset_h(mgos_alarm_handle_t handle);
+
+/*
+ * Inputs and process values the alarms of mgos_alarm_load_config are bound 
+ * to, a configuration refers to them by index
+ *
+ * inputs, num_inputs - the digital alarm inputs
+ * pvs, num_pvs - the analog alarm process values
+ */
+struct mgos_alarm_config_io{
+  bool *inputs;
+  uint32_t num_inputs;
+  float *pvs;
+  uint32_t num_pvs;
+};
+
+/*
+ * Add every alarm of a configuration file, either JSON or the compact 
+ * binary form compiled from it by tools/mgos_alarm_config.py
+ *
+ * {"alarms": [
+ *   {"name": "pump1", "type": "digital", "input": 0, "mode": "ACTIVE_HIGH",
+ *    "set_interval": 1000, "reset_interval": 1000},
+ *   {"name": "sump1", "type": "analog", "pv": 0, "ll_sv": null, "l_sv": 0.2,
+ *    "h_sv": 0.8, "hh_sv": 0.9, "set_interval": 5000, "enabled": false}
+ * ]}
+ *
+ * Every alarm is validated as mgos_add_d_alarm and mgos_add_a_alarm do 
+ * before any is added, intervals must be whole, non-negative 
+ * milliseconds. Then the tables, the alarm table and the name index grow 
+ * once for the whole configuration and the names are copied into one 
+ * allocation, freed when the last of its alarms is removed. Either every 
+ * alarm is added or none is.
+ *
+ * path - the configuration file
+ * data, len - the configuration in memory
+ * io - what the input and pv indexes refer to
+ * returns false if the configuration is invalid, a name is not unique or
+ *   memory could not be allocated
+ */
+bool mgos_alarm_load_config(const char *path, const struct mgos_alarm_config_io *io);
+bool mgos_alarm_load_config_buf(const char *data, size_t len, const struct mgos_alarm_config_io *io);
+
+/*
+ * Copy the name, enabled flag, type and state of the alarm with the
+ * passed handle into info
+ * returns false if the handle is invalid or stale
+ */
+bool mgos_alarm_get_state_h(mgos_alarm_handle_t handle, struct alarm_info *info);
+
+/*
+ * Copy the value the analog alarm with the passed handle was last 
+ * evaluated on into value, in engineering units, NAN if it has not been
+ * evaluated yet. The value of a rate or deviation alarm is its filtered
+ * rate or deviation, of a windowed alarm its window statistic.
+ * returns false if the handle is invalid, stale or not an analog alarm
+ */
+bool mgos_alarm_get_value_h(mgos_alarm_handle_t handle, float *value);
+
+/*
+ * Set the reset deadband of an analog alarm, in the units of its value.
+ * Once the alarm is in a band the value must move deadband back past that
+ * band's setpoint before the alarm can leave it, so a PV hovering around
+ * a setpoint no longer toggles the alarm. Moving further out, H to HH or
+ * L to LL, is not delayed. An alarm leaving HH (LL) within deadband of 
+ * h_sv (l_sv) moves to H (L).
+ *
+ * deadband - 0 (default) to leave the bands as soon as the value does
+ * returns false if the handle is invalid, stale or not an analog alarm, or
+ *   deadband is negative or NAN
+ */
+bool mgos_alarm_set_deadband_h(mgos_alarm_handle_t handle, float deadband);
+
+/*
+ * Latch an alarm that chatters, transitions more than limit times in 
+ * window_ms. The transition that crosses the limit is raised as 
+ * MGOS_ALARM_EV_CHATTER and the alarm's later transitions raise nothing,
+ * they are counted in chatter_suppressed. Its state is still tracked and
+ * listed. Once it has made no transition for window_ms it unlatches, and
+ * if its state differs from the one last raised a SET/RESET for the 
+ * current state is raised. Resetting or disabling the alarm unlatches it.
+ *
+ * The transitions are counted over a sliding window estimated from fixed
+ * windows of window_ms, the count of the current one plus the previous 
+ * one's weighted by how much of it the sliding window still overlaps.
+ *
+ * limit - transitions allowed per window, 0 to stop detecting chatter
+ * window_ms - the window, must be greater than 0 unless limit is 0
+ * returns false if the handle is invalid or stale, window_ms is invalid or
+ *   memory could not be allocated
+ */
+bool mgos_alarm_set_chatter_h(mgos_alarm_handle_t handle, uint32_t limit, int window_ms);
+
+/*
+ * Make an alarm the child of another in the suppression graph, each alarm
+ * has at most one parent. While a parent is active, or masked itself, its
+ * children are masked. A masked alarm is left out of the scan with its
+ * pending transition cancelled, so it holds its state, arms no timer and
+ * raises no event. Parents are evaluated first in a pass, so children
+ * tripping in the same pass as their parent are masked before they
+ * transition. Once unmasked an alarm is evaluated on the next pass at
+ * the latest, and raises the transitions its input or PV still calls
+ * for. Masking spreads down the graph only as far as alarms change
+ * whether they mask, so a parent's transition costs the alarms it
+ * affects, not a scan of them all.
+ * The start of each cascade is recorded, see mgos_alarm_get_first_out.
+ * Removing an alarm detaches its children.
+ *
+ * child - the alarm to move in the graph
+ * parent - its new parent, MGOS_ALARM_INVALID_HANDLE to detach it
+ * returns false if a handle is invalid or stale, or parent is child or one
+ *   of its descendants
+ */
+bool mgos_alarm_set_parent_h(mgos_alarm_handle_t child, mgos_alarm_handle_t parent);
+
+/*
+ * Copy the record of the last cascade of the suppression graph into first_out
+ * returns false if the library is not initialised or no cascade has started
+ */
+bool mgos_alarm_get_first_out(struct alarm_first_out *first_out);
+
 /*
  * Returns an array of alarm_info structs based on alarms in the alarm list
  * returns null if no alarms are returned
- * caller must free returned struct
+ * caller must free both the returned struct and its info array
+ *
+ * mgos_list_alarms, mgos_list_alarms_buf and mgos_alarm_get_state_h copy a
+ * consistent snapshot of the alarms without taking the alarm lock, they may
+ * be called from any task and never hold up the alarm scan.
  */
  struct alarm_list * mgos_list_alarms(void);
 
+/*
+ * Fill the caller provided info array with up to capacity alarms, in the
+ * same order as mgos_list_alarms. Nothing is allocated.
+ * returns the total number of alarms, if this is more than capacity the
+ *   list was truncated
+ */
+size_t mgos_list_alarms_buf(struct alarm_info *info, size_t capacity);
+
+/*
+ * Alarm changes returned by mgos_list_alarm_changes.
+ * Every add, transition, enable, disable and reset of an alarm takes the 
+ * next value of a library wide change sequence.
+ * 
+ * info - caller provided array the changed alarms are written to, oldest
+ *   change first
+ * capacity - number of entries in info
+ * length - number of entries written
+ * seq - the sequence number to pass as since on the next call, if the 
+ *   changes did not fit in info the next call continues where this one stopped
+ * removed - an alarm has been removed after since, removed alarms are not 
+ *   listed so the caller should refresh its full list
+ */
+struct alarm_changes{
+  struct alarm_info *info;
+  size_t capacity;
+  size_t length;
+  uint32_t seq;
+  bool removed;
+};
+
+/*
+ * List the alarms that changed after sequence number since, pass 0 to list
+ * every alarm. Costs O(changes) as the alarms are kept in change order.
+ * returns false if changes is NULL or the library is not initialised
+ */
+bool mgos_list_alarm_changes(uint32_t since, struct alarm_changes *changes);
+
+/*
+ * Debounce mode, how pending set/reset transitions are timed
+ * MGOS_ALARM_DEBOUNCE_TIMER - an mgos timer is armed for every pending 
+ *   transition and the alarm transitions when it fires (default)
+ * MGOS_ALARM_DEBOUNCE_TIMESTAMP - each alarm records when its pending 
+ *   transition started and the main alarm service timer compares it against
+ *   the uptime, transitions fire inline during the scan and no timers are 
+ *   armed. Set/reset intervals are rounded up to the next poll_interval.
+ * MGOS_ALARM_DEBOUNCE_WHEEL - as MGOS_ALARM_DEBOUNCE_TIMER but the deadlines 
+ *   are held in a timing wheel owned by the library and advanced by the main
+ *   alarm service timer. Arming and cancelling a deadline is O(1), expiries 
+ *   are processed in one batch per poll_interval and no SDK timers are used. 
+ *   Set/reset intervals are rounded up to whole poll_intervals.
+ */
+enum mgos_alarm_debounce_mode{
+  MGOS_ALARM_DEBOUNCE_TIMER,
+  MGOS_ALARM_DEBOUNCE_TIMESTAMP,
+  MGOS_ALARM_DEBOUNCE_WHEEL
+};
+
+/*
+ * Select the debounce mode, any transition pending under the previous 
+ * mode is cancelled.
+ * returns false if the library is not initialised or the mode is unknown
+ */
+bool mgos_alarm_set_debounce_mode(enum mgos_alarm_debounce_mode mode);
+
+/*
+ * Evaluation mode, which alarms the main alarm service timer evaluates
+ * MGOS_ALARM_EVAL_POLL - every enabled alarm is evaluated every poll_interval
+ *   (default)
+ * MGOS_ALARM_EVAL_CHANGED - only alarms marked dirty by mgos_alarm_input_changed
+ *   or mgos_alarm_pv_update since the last pass, alarms waiting on a 
+ *   MGOS_ALARM_DEBOUNCE_TIMESTAMP interval, and rate, deviation and windowed
+ *   alarms, are evaluated. The scan cost follows
+ *   the rate of change rather than the number of alarms but every change to an
+ *   input or PV must be notified.
+ * MGOS_ALARM_EVAL_IMMEDIATE - as MGOS_ALARM_EVAL_CHANGED but a notified alarm
+ *   is evaluated inside the notification call rather than on the next pass,
+ *   its events are triggered before the call returns
+ */
+enum mgos_alarm_eval_mode{
+  MGOS_ALARM_EVAL_POLL,
+  MGOS_ALARM_EVAL_CHANGED,
+  MGOS_ALARM_EVAL_IMMEDIATE
+};
+
+/*
+ * Select the evaluation mode, every alarm is marked dirty so nothing is
+ * missed by the switch.
+ * returns false if the library is not initialised or the mode is unknown
+ */
+bool mgos_alarm_set_eval_mode(enum mgos_alarm_eval_mode mode);
+
+/*
+ * Schedule mode, when the main alarm service timer runs
+ * MGOS_ALARM_SCHEDULE_POLL - every poll_interval (default)
+ * MGOS_ALARM_SCHEDULE_ADAPTIVE - a one shot timer is re-armed after each pass
+ *   for the earliest pending set/reset deadline, and the engine sleeps while
+ *   nothing is pending. A notified input change, edge, added, enabled or
+ *   reset alarm wakes it early. With MGOS_ALARM_EVAL_POLL the inputs are not
+ *   notified, so a pass is still never more than poll_interval away. Use
+ *   MGOS_ALARM_EVAL_CHANGED or MGOS_ALARM_EVAL_IMMEDIATE, or edge capture,
+ *   to let the engine sleep. MGOS_ALARM_DEBOUNCE_TIMESTAMP and 
+ *   MGOS_ALARM_DEBOUNCE_WHEEL deadlines are met by the wake up, 
+ *   MGOS_ALARM_DEBOUNCE_TIMER debounce timers fire on their own.
+ */
+enum mgos_alarm_schedule_mode{
+  MGOS_ALARM_SCHEDULE_POLL,
+  MGOS_ALARM_SCHEDULE_ADAPTIVE
+};
+
+/*
+ * Select the schedule mode, the first pass under the new mode runs straight
+ * away. Compare wakeups_per_hour and scan_avg_us in mgos_alarm_stats between
+ * the modes.
+ * returns false if the library is not initialised or the mode is unknown
+ */
+bool mgos_alarm_set_schedule_mode(enum mgos_alarm_schedule_mode mode);
+
+/*
+ * Deliver the transitions of each pass as one MGOS_ALARM_EV_BATCH instead
+ * of a MGOS_ALARM_EV_SET/RESET per alarm (default false)
+ * returns false if the library is not initialised
+ */
+bool mgos_alarm_set_batch_events(bool batch);
+
+/*
+ * Limit the SET/RESET/CHATTER events raised to max_events per period_ms,
+ * a token bucket that allows bursts of up to max_events. Transitions over
+ * the limit raise no event, they are counted in rate_limited and once 
+ * per period_ms (from the first of them) replaced by a single 
+ * MGOS_ALARM_EV_SUMMARY raised after the pass.
+ *
+ * max_events - events allowed per period, 0 (default) for no limit
+ * period_ms - the period, must be greater than 0 unless max_events is 0
+ * returns false if the library is not initialised or period_ms is invalid
+ */
+bool mgos_alarm_set_rate_limit(uint32_t max_events, int period_ms);
+
+/*
+ * Dispatch mode, where the alarm event handlers run
+ * MGOS_ALARM_DISPATCH_SYNC - at the end of the pass, debounce timer or 
+ *   notification that made the transitions (default)
+ * MGOS_ALARM_DISPATCH_ASYNC - the transitions are pushed into a bounded 
+ *   lock-free queue of MGOS_ALARM_DISPATCH_QUEUE_SIZE entries which is drained
+ *   to the handlers by a separate callback on the mgos task, at most 
+ *   MGOS_ALARM_DISPATCH_BUDGET transitions per callback. A slow handler no 
+ *   longer delays the scan or the debounce expiries.
+ */
+enum mgos_alarm_dispatch_mode{
+  MGOS_ALARM_DISPATCH_SYNC,
+  MGOS_ALARM_DISPATCH_ASYNC
+};
+
+/*
+ * What MGOS_ALARM_DISPATCH_ASYNC does with a transition when the queue is full
+ * MGOS_ALARM_OVERFLOW_DROP_OLDEST - the oldest queued transition is dropped
+ * MGOS_ALARM_OVERFLOW_DROP_NEWEST - the new transition is dropped
+ * MGOS_ALARM_OVERFLOW_COALESCE - while a transition is queued for an alarm
+ *   any further transition of that alarm updates it to the new state, keeping 
+ *   its old state and its place in the queue, so the queue holds at most one 
+ *   transition per alarm and handlers see the alarm's net change. A net change
+ *   of nothing is not delivered. When the queue is still full the oldest is
+ *   dropped.
+ */
+enum mgos_alarm_overflow_policy{
+  MGOS_ALARM_OVERFLOW_DROP_OLDEST,
+  MGOS_ALARM_OVERFLOW_DROP_NEWEST,
+  MGOS_ALARM_OVERFLOW_COALESCE
+};
+
+/*
+ * Select the dispatch mode and the queue overflow policy, switching back to
+ * MGOS_ALARM_DISPATCH_SYNC leaves any queued transitions to be drained.
+ * returns false if the library is not initialised or the mode or policy is unknown
+ */
+bool mgos_alarm_set_dispatch_mode(enum mgos_alarm_dispatch_mode mode,
+                                  enum mgos_alarm_overflow_policy policy);
+
+/*
+ * Shard function handed to a shard runner, evaluates shard number index
+ */
+typedef void (*mgos_alarm_shard_fn)(uint32_t index, void *ctx);
+
+/*
+ * Shard runner, must call fn(index, ctx) once for every index below shards,
+ * on whatever cores or threads it has, and return once every call has
+ * returned. arg is the argument passed to mgos_alarm_set_shards. The calls
+ * must not use the alarm API.
+ */
+typedef void (*mgos_alarm_shard_runner)(uint32_t shards, mgos_alarm_shard_fn fn,
+                                        void *ctx, void *arg);
+
+/*
+ * Split each pass of the main alarm service timer into shards, up to
+ * MGOS_ALARM_MAX_SHARDS (default 16). The alarm tables are split evenly by
+ * rows and every shard evaluates and debounces its own rows, so the shards
+ * can run in parallel on other cores. Their transitions are then made in 
+ * row order, the same event order as an unsharded pass.
+ *
+ * Sharding is only used with MGOS_ALARM_DEBOUNCE_TIMESTAMP, under the other
+ * debounce modes the pass stays on the mgos task as arming a timer is not 
+ * local to a shard.
+ *
+ * shards - number of shards, 1 turns sharding off
+ * runner - the shard runner, NULL runs the shards one after another
+ * arg - passed to the runner
+ * returns false if the library is not initialised, shards is out of range
+ *   or memory could not be allocated
+ */
+bool mgos_alarm_set_shards(uint32_t shards, mgos_alarm_shard_runner runner, void *arg);
+
+/*
+ * Notify the library that the input or PV of the alarm with the passed 
+ * handle has changed. Alarms sharing an input must each be notified.
+ * returns false if the handle is invalid or stale
+ */
+bool mgos_alarm_input_changed(mgos_alarm_handle_t handle);
+
+/*
+ * Write value to the PV of the analog alarm with the passed handle and
+ * notify the change as mgos_alarm_input_changed does
+ * returns false if the handle is invalid, stale or not an analog alarm 
+ *   with a float PV
+ */
+bool mgos_alarm_pv_update(mgos_alarm_handle_t handle, float value);
+
+/*
+ * Switch the digital alarm with the passed handle to edge capture, or back
+ * to reading its input. An edge captured alarm no longer reads *input, its
+ * input is at the level of the last edge pushed by mgos_alarm_edge_push,
+ * starting from *input (false if input is NULL) when capture is switched on.
+ * The set and reset intervals are timed from the edge timestamps whatever the
+ * debounce mode, so a pulse that lasted the set interval sets the alarm even
+ * if it ended between two passes, and one that did not never does. The 
+ * transition event carries the time the interval ran out.
+ *
+ * Edges are consumed at the start of each pass of the main alarm service
+ * timer, in MGOS_ALARM_EVAL_IMMEDIATE mode by a callback the push invokes.
+ * Any transition pending when capture is switched is cancelled.
+ * returns false if the library is not initialised or the handle is invalid,
+ *   stale, not a digital alarm or an expression alarm
+ */
+bool mgos_alarm_set_edge_capture(mgos_alarm_handle_t handle, bool capture);
+
+/*
+ * Push an input edge of an edge captured digital alarm into a lock-free ring
+ * of MGOS_ALARM_EDGE_RING_SIZE edges. It neither locks nor allocates and may
+ * be called from an interrupt handler, but all edges must be pushed from one
+ * context at a time, such as the GPIO interrupt handlers or a single thread.
+ *
+ * Example:
+ * ```c
+ * static IRAM void input_isr(int pin, void *arg) {
+ *   mgos_alarm_edge_push((mgos_alarm_handle_t) (uintptr_t) arg, mgos_gpio_read(pin),
+ *                        mgos_uptime_micros());
+ * }
+ *
+ * // Somewhere else:
+ * mgos_alarm_set_edge_capture(handle, true);
+ * mgos_gpio_set_int_handler_isr(pin, MGOS_GPIO_INT_EDGE_ANY, input_isr, (void *) (uintptr_t) handle);
+ * mgos_gpio_enable_int(pin);
+ * ```
+ *
+ * handle - the alarm the input belongs to
+ * level - the input level after the edge
+ * time_us - uptime of the edge in microseconds, see mgos_uptime_micros
+ * returns false if the ring is full, the edge is dropped and counted
+ */
+bool mgos_alarm_edge_push(mgos_alarm_handle_t handle, bool level, int64_t time_us);
+
+/*
+ * Per-operation timing returned as part of mgos_alarm_stats.
+ *
+ * count - number of times the operation has been called
+ * total_us - total time spent in the operation in microseconds
+ * max_us - longest single call in microseconds
+ */
+struct mgos_alarm_op_stats{
+  uint32_t count;
+  uint64_t total_us;
+  uint32_t max_us;
+};
+
+/*
+ * Alarm engine statistics returned by mgos_alarm_get_stats.
+ *
+ * d_alarms, a_alarms - number of digital and analog alarms currently in the lists
+ * ticks - number of main alarm service timer passes
+ * alarms_scanned - total number of enabled alarms evaluated across all ticks,
+ *   including MGOS_ALARM_EVAL_IMMEDIATE evaluations
+ * notifications - calls to mgos_alarm_input_changed and mgos_alarm_pv_update
+ * scan - timing of the main alarm service timer passes
+ * scan_ns_per_alarm - average scan cost per evaluated alarm in nanoseconds
+ * scan_avg_us - average cost of one pass in microseconds
+ * wakeups_per_hour - passes per hour since init or the last reset of the 
+ *   statistics, see mgos_alarm_set_schedule_mode
+ * classify - timing of the batch analog band classification run by each scan
+ * classify_kernel - the classification kernel in use ("avx", "sse2", "neon"
+ *   or "scalar")
+ * allocs - heap allocations made by the library
+ * hot_allocs - heap allocations made on the scan and transition path, 
+ *   this includes every SDK timer armed as mgos_set_timer allocates
+ * timer_sets, timer_clears - calls made to mgos_set_timer and mgos_clear_timer
+ * dispatch - timing of alarm events passed to mgos_event_trigger
+ * add, remove, lookup - timing of mgos_add_*_alarm, mgos_remove_alarm and 
+ *   the name based operations (mgos_disable_alarm, mgos_reset_alarm)
+ * load - timing of mgos_alarm_load_config and mgos_alarm_load_config_buf
+ * wheel_pending - deadlines currently armed in the timing wheel
+ * wheel_expired - timing wheel deadlines that have expired
+ * event_pool_size - number of event payloads in the pool (MGOS_ALARM_EVENT_POOL_SIZE)
+ * event_pool_high_water - most event payloads in use at once
+ * event_pool_exhausted - events dispatched while the pool was empty, these 
+ *   use a stack payload instead
+ * queue_size - number of entries in the MGOS_ALARM_DISPATCH_ASYNC queue
+ * queue_depth - transitions currently queued
+ * queue_high_water - most transitions queued at once
+ * queue_dropped - transitions dropped by the overflow policy
+ * queue_coalesced - transitions merged into a queued one by MGOS_ALARM_OVERFLOW_COALESCE
+ * queue_latency - time from a transition being queued to its handlers starting
+ * view_retries - copies of alarm state by mgos_list_alarms, mgos_list_alarms_buf
+ *   and mgos_alarm_get_state_h that overlapped a change and were retried
+ * view_locked_reads - such copies that kept overlapping changes and were
+ *   made under the alarm lock instead
+ * shards - number of shards the scan is split into, see mgos_alarm_set_shards
+ * merge - timing of sharded passes making the transitions their shards found
+ * edges - edges consumed from the edge ring, see mgos_alarm_edge_push
+ * edges_dropped - edges pushed while the edge ring was full
+ * edge_ring_size - number of entries in the edge ring (MGOS_ALARM_EDGE_RING_SIZE)
+ * edge_ring_high_water - most edges queued at once
+ * arena_size, arena_used - bytes reserved and carved by mgos_alarm_init_ex,
+ *   0 if the tables are allocated as alarms are added
+ * bytes_per_alarm - arena bytes per reserved alarm, the extension records
+ *   and other heap allocations listed at mgos_alarm_init_ex come on top
+ * alarms_high_water - most alarms in the lists at once
+ * chatter_latched - times an alarm's chatter detection latched
+ * chatter_suppressed - transitions of latched alarms that raised no event
+ * rate_limited - transitions refused by the event rate limiter
+ * summaries - MGOS_ALARM_EV_SUMMARY events raised
+ * expr_evals - evaluations of expression alarms, see mgos_add_expr_alarm_h
+ * masked - times an alarm was masked by its parent, see mgos_alarm_set_parent_h
+ * cascades - cascades started in the suppression graph
+ */
+struct mgos_alarm_stats{
+  uint32_t d_alarms, a_alarms;
+  uint32_t ticks;
+  uint64_t alarms_scanned;
+  uint32_t notifications;
+  struct mgos_alarm_op_stats scan;
+  uint32_t scan_ns_per_alarm;
+  uint32_t scan_avg_us, wakeups_per_hour;
+  struct mgos_alarm_op_stats classify;
+  const char *classify_kernel;
+  uint32_t allocs, hot_allocs;
+  uint32_t timer_sets, timer_clears;
+  struct mgos_alarm_op_stats dispatch;
+  struct mgos_alarm_op_stats add, remove, lookup, load;
+  uint32_t wheel_pending, wheel_expired;
+  uint32_t event_pool_size, event_pool_high_water, event_pool_exhausted;
+  uint32_t queue_size, queue_depth, queue_high_water;
+  uint32_t queue_dropped, queue_coalesced;
+  struct mgos_alarm_op_stats queue_latency;
+  uint32_t view_retries, view_locked_reads;
+  uint32_t shards;
+  struct mgos_alarm_op_stats merge;
+  uint32_t edges, edges_dropped;
+  uint32_t edge_ring_size, edge_ring_high_water;
+  uint32_t arena_size, arena_used, bytes_per_alarm;
+  uint32_t alarms_high_water;
+  uint32_t chatter_latched, chatter_suppressed;
+  uint32_t rate_limited, summaries;
+  uint32_t expr_evals;
+  uint32_t masked, cascades;
+};
+
+/*
+ * Copy the alarm engine statistics into the passed struct.
+ * Divide the counters by stats->ticks to get per tick figures.
+ * returns false if stats is NULL or the library is not initialised
+ */
+bool mgos_alarm_get_stats(struct mgos_alarm_stats *stats);
+
+/*
+ * Zero the alarm engine statistics counters
+ */
+void mgos_alarm_reset_stats(void);
+
 /*
  * Initilise alarm list, rlock and main timer routine.
  * Must be called before any other mgos_alarm functions, typically in mgos_app_init().
@@ -229,4 +991,121 @@ bool mgos_reset_alarm(char *name);
  */
 bool mgos_alarm_init(int poll_interval);
 
+/*
+ * Capacity reserved by mgos_alarm_init_ex
+ *
+ * d_alarms, a_alarms - number of digital and analog alarms
+ * name_len - longest alarm name, names are copied into the reservation so 
+ *   they need not outlive the add call. 0 keeps the caller's name pointers.
+ */
+struct mgos_alarm_capacity{
+  uint32_t d_alarms, a_alarms;
+  uint32_t name_len;
+};
+
+/*
+ * Initilise as mgos_alarm_init, carving the alarm tables, name index, names,
+ * event buffer and event payloads out of one block reserved for capacity.
+ * No table is allocated or freed as alarms are added and removed, adding
+ * an alarm beyond the reserved capacity fails. The room of a removed alarm
+ * is reused once its waiting events, which point to its name, have been
+ * dispatched, so an event handler that removes an alarm cannot add another
+ * in its place while the table is full. The arena only covers the
+ * core tables, these are still taken from the heap as they are used:
+ * - the per-alarm extension records of raw alarms (mgos_add_raw_alarm_h),
+ *   rate and deviation alarms, window alarms, chatter detection and
+ *   expression dependencies
+ * - the sample rings of window alarms
+ * - expression alarms, their compiled code and the evaluation order
+ * - the shard array and shard row arrays of mgos_alarm_set_shards
+ * - the SDK timers of MGOS_ALARM_DEBOUNCE_TIMER
+ * - the list copies returned by mgos_list_alarms
+ * Returns true if successfully intitilise
+ *
+ * poll_interval - see mgos_alarm_init
+ * capacity - the alarms to reserve room for
+ */
+bool mgos_alarm_init_ex(int poll_interval, const struct mgos_alarm_capacity *capacity);
+
+/*
+ * Returns the bytes mgos_alarm_init_ex reserves for capacity, allowing a 
+ * memory budget to be checked before the reservation is made
+ */
+size_t mgos_alarm_arena_size(const struct mgos_alarm_capacity *capacity);
+
+/*
+ * Const descriptor of an alarm in a static alarm table, placed in flash by
+ * tools/mgos_alarm_gen.py with MGOS_ALARM_D_DEF and MGOS_ALARM_A_DEF
+ *
+ * type - digital or analog
+ * name - unique name of the alarm
+ * hash - FNV-1a hash of the name
+ * enabled - the alarm starts enabled
+ * input, mode, reset_interval - digital alarm parameters, see mgos_add_d_alarm
+ * pv, ll_sv, l_sv, h_sv, hh_sv - analog alarm parameters, see mgos_add_a_alarm
+ * set_interval - the set interval of either type
+ */
+struct mgos_alarm_def{
+  enum mgos_alarm_type type;
+  const char *name;
+  uint32_t hash;
+  bool enabled;
+  bool *input;
+  enum mgos_d_alarm_mode mode;
+  int reset_interval;
+  float *pv;
+  float ll_sv, l_sv, h_sv, hh_sv;
+  int set_interval;
+};
+
+#define MGOS_ALARM_D_DEF(name, hash, enabled, input, mode, set_interval, reset_interval) \
+  {DIGITAL, (name), (hash), (enabled), (input), (mode), (reset_interval), NULL, \
+   NAN, NAN, NAN, NAN, (set_interval)}
+
+#define MGOS_ALARM_A_DEF(name, hash, enabled, pv, ll_sv, l_sv, h_sv, hh_sv, set_interval) \
+  {ANALOG, (name), (hash), (enabled), NULL, ACTIVE_HIGH, 0, (pv), \
+   (ll_sv), (l_sv), (h_sv), (hh_sv), (set_interval)}
+
+/*
+ * Static alarm table generated by tools/mgos_alarm_gen.py
+ *
+ * defs - the alarm descriptors, ordered by the perfect hash of their names
+ * count - number of descriptors
+ * d_alarms, a_alarms - number of digital and analog descriptors
+ * seeds - perfect hash seeds, a name hashing to h is descriptor
+ *   mix(h, seeds[h % seed_count]) % count
+ * seed_count - number of seeds
+ */
+struct mgos_alarm_static_table{
+  const struct mgos_alarm_def *defs;
+  uint32_t count, d_alarms, a_alarms;
+  const uint16_t *seeds;
+  uint32_t seed_count;
+};
+
+/*
+ * Initilise as mgos_alarm_init_ex with the alarms of a static table already
+ * added. By default the tables are reserved in one heap block sized for the
+ * table, setting the cdefs MGOS_ALARM_STATIC_D_ALARMS and 
+ * MGOS_ALARM_STATIC_A_ALARMS in the app's mos.yml instead places them in a
+ * RAM array sized at build time. Nothing is logged or checked for 
+ * uniqueness per alarm, and names are looked up by the table's perfect 
+ * hash. Alarms can still be added up to the reserved capacity and the 
+ * static alarms removed.
+ * Returns true if successfully intitilise, false if the table is empty,
+ * its counts do not match its alarms or an alarm has no input, the tables
+ * cannot be reserved or the table does not fit the cdefs
+ *
+ * poll_interval - see mgos_alarm_init
+ * table - the generated table
+ */
+bool mgos_alarm_init_static(int poll_interval, const struct mgos_alarm_static_table *table);
+
+/*
+ * Returns the handle of the alarm of the static table with the passed index,
+ * the enum generated with the table.
+ * returns MGOS_ALARM_INVALID_HANDLE if the alarm has been removed
+ */
+mgos_alarm_handle_t mgos_alarm_static_handle(uint32_t index);
+
 #endif /* CS_FW_INCLUDE_MGOS_ALARM_H_ */
\ No newline at end of file
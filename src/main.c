@@ -22,6 +22,7 @@
 #include "mgos_timers.h"
 #include "mgos_alarm.h"
 #include "mgos_adc.h"
+#include "main_alarms.h"
 
 bool input_1 = false;
 bool input_2 = false;
@@ -35,10 +36,20 @@ float input_5 = 0;
 int input_4_pin = 26;
 int input_5_pin = 34;
 
+//the digital inputs are edge captured, each edge is pushed with its
+//timestamp so pulses shorter than the poll interval are still debounced
+static IRAM void input_edge_isr(int pin, void *arg){
+  mgos_alarm_edge_push((mgos_alarm_handle_t) (uintptr_t) arg, mgos_gpio_read(pin),
+                       mgos_uptime_micros());
+}
+
+static void input_edge_capture(int pin, mgos_alarm_handle_t handle){
+  if(handle == MGOS_ALARM_INVALID_HANDLE || !mgos_alarm_set_edge_capture(handle, true)) return;
+  mgos_gpio_set_int_handler_isr(pin, MGOS_GPIO_INT_EDGE_ANY, input_edge_isr, (void *) (uintptr_t) handle);
+  mgos_gpio_enable_int(pin);
+}
+
 static void input_checker_cb(void *arg){
-  input_1 = mgos_gpio_read(input_1_pin);
-  input_2 = mgos_gpio_read(input_2_pin);
-  input_3 = mgos_gpio_read(input_3_pin);
   input_4 = mgos_gpio_read(input_4_pin);
   input_5 = mgos_gpio_read(input_5_pin);
   LOG(LL_INFO, ("name: %i", mgos_adc_read(input_5_pin)));
@@ -46,7 +57,9 @@ static void input_checker_cb(void *arg){
 
 enum mgos_app_init_result mgos_app_init(void){
 
-  if(!mgos_alarm_init(500)) return false;
+  //the alarms are defined in main_alarms.json, regenerate main_alarms.c with
+  //tools/mgos_alarm_gen.py src/main_alarms.json src
+  if(!mgos_alarm_init_static(500, &main_alarms)) return false;
 
   mgos_gpio_setup_input(input_1_pin, MGOS_GPIO_PULL_DOWN);
   mgos_gpio_setup_input(input_2_pin, MGOS_GPIO_PULL_DOWN);
@@ -59,18 +72,21 @@ enum mgos_app_init_result mgos_app_init(void){
 
  // mgos_set_timer(5000, MGOS_TIMER_REPEAT, status_timer, NULL);
 
-  mgos_add_d_alarm(true, &input_1, ACTIVE_HIGH, 1000, 1000, "alarm1");
-  mgos_add_d_alarm(true, &input_2, ACTIVE_HIGH, 2000, 2000, "alarm2");
-  mgos_add_d_alarm(true, &input_3, ACTIVE_LOW, 3000, 3000, "alarm3");
-
-  mgos_add_a_alarm(true, &input_4, 0.2, 0.3, 0.4, 0.5, 1000, "alarm4");
-  mgos_add_a_alarm(true, &input_5, 0.2, 0.3, 0.4, 0.5, 1000, "alarm5");
+  input_1 = mgos_gpio_read(input_1_pin);
+  input_2 = mgos_gpio_read(input_2_pin);
+  input_3 = mgos_gpio_read(input_3_pin);
+  input_edge_capture(input_1_pin, mgos_alarm_static_handle(MAIN_ALARMS_ALARM1));
+  input_edge_capture(input_2_pin, mgos_alarm_static_handle(MAIN_ALARMS_ALARM2));
+  input_edge_capture(input_3_pin, mgos_alarm_static_handle(MAIN_ALARMS_ALARM3));
 
   struct alarm_list *list =  mgos_list_alarms();
-  for(size_t i = 0; i < list->length; i++){
-    LOG(LL_INFO, ("name: %*s", strlen(list->info[i].name), list->info[i].name));
+  if(list != NULL){
+    for(size_t i = 0; i < list->length; i++){
+      LOG(LL_INFO, ("name: %*s", strlen(list->info[i].name), list->info[i].name));
+    }
+    free(list->info);
+    free(list);
   }
-  free(list);
 
   // mgos_remove_alarm("alarm5");
   // mgos_remove_alarm("alm5");
@@ -93,6 +109,7 @@ enum mgos_app_init_result mgos_app_init(void){
   //     LOG(LL_INFO, ("ANALOG State: %i", list2->info[i].state.a_state));
   //   }
   // }
+  //free(list2->info);
   //free(list2);
 
   return MGOS_APP_INIT_SUCCESS;
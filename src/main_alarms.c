@@ -0,0 +1,26 @@
+/*
+ * Generated by tools/mgos_alarm_gen.py from main_alarms.json, do not edit
+ */
+
+#include "main_alarms.h"
+
+extern bool input_1;
+extern bool input_2;
+extern bool input_3;
+extern float input_4;
+extern float input_5;
+
+static const struct mgos_alarm_def s_defs[] = {
+  MGOS_ALARM_A_DEF("alarm5", 0xbd65fc3du, true, &input_5, 0.2f, 0.3f, 0.4f, 0.5f, 1000),
+  MGOS_ALARM_D_DEF("alarm1", 0xb965f5f1u, true, &input_1, ACTIVE_HIGH, 1000, 1000),
+  MGOS_ALARM_D_DEF("alarm3", 0xb765f2cbu, true, &input_3, ACTIVE_LOW, 3000, 3000),
+  MGOS_ALARM_A_DEF("alarm4", 0xbc65faaau, true, &input_4, 0.2f, 0.3f, 0.4f, 0.5f, 1000),
+  MGOS_ALARM_D_DEF("alarm2", 0xb665f138u, true, &input_2, ACTIVE_HIGH, 2000, 2000),
+};
+
+static const uint16_t s_seeds[] = {6, 1, 0};
+
+const struct mgos_alarm_static_table main_alarms = {
+  s_defs, 5, 3, 2,
+  s_seeds, 3
+};
@@ -0,0 +1,27 @@
+/*
+ * Generated by tools/mgos_alarm_gen.py from main_alarms.json, do not edit
+ *
+ * Reserved on the heap unless the app sets the cdefs
+ *   MGOS_ALARM_STATIC_D_ALARMS: 3
+ *   MGOS_ALARM_STATIC_A_ALARMS: 2
+ */
+
+#ifndef CS_FW_SRC_MAIN_ALARMS_H_
+#define CS_FW_SRC_MAIN_ALARMS_H_
+
+#include "mgos_alarm.h"
+
+extern const struct mgos_alarm_static_table main_alarms;
+
+/*
+ * index of each alarm, see mgos_alarm_static_handle
+ */
+enum main_alarms_index{
+  MAIN_ALARMS_ALARM5 = 0,
+  MAIN_ALARMS_ALARM1 = 1,
+  MAIN_ALARMS_ALARM3 = 2,
+  MAIN_ALARMS_ALARM4 = 3,
+  MAIN_ALARMS_ALARM2 = 4,
+};
+
+#endif /* CS_FW_SRC_MAIN_ALARMS_H_ */
@@ -15,518 +15,4780 @@
  * limitations under the License.
  */
 
+#include <limits.h>
+
 #include "mgos_alarm.h"
+#include "mgos_alarm_wheel.h"
+#include "mgos_alarm_classify.h"
+#include "mgos_alarm_queue.h"
+#include "mgos_alarm_edge.h"
+#include "mgos_alarm_arena.h"
+#include "mgos_alarm_pool.h"
+#include "mgos_alarm_window.h"
+#include "mgos_alarm_expr.h"
+#include "mgos_alarm_config.h"
+#include "mgos_alarm_chatter.h"
+#include "mgos_alarm_rate.h"
+#include "common/cs_file.h"
 
 /*
- * digital_alarm structure
- * 
- * active - is the alarm currently active
- * enabled - is the alarm enabled
+ * digital alarm table, a struct of arrays indexed by the alarm's row.
+ * The per-tick flags are bitsets and the table is kept dense by
+ * swap-removing alarms.
+ *
+ * count - number of alarms in the table
+ * capacity - number of rows allocated, a multiple of 32
+ * enabled - bitset, is the alarm enabled
+ * active - bitset, is the alarm currently active
+ * mode - bitset, set if the alarm is ACTIVE_HIGH
+ * dirty - bitset, the input has been notified as changed since the last pass
+ * pending - bitset, a MGOS_ALARM_DEBOUNCE_TIMESTAMP interval is running
+ * edge - bitset, the input is edge captured, see mgos_alarm_set_edge_capture
+ * level - bitset, the input level after the last captured edge
+ * masked - bitset, the alarm is masked by its parent, see mgos_alarm_set_parent_h
+ * parent - bitset, the alarm has children, the scan evaluates it first
  * *input - pointer to the alarm trigger boolean
- * mode - is the alarm active high or low 
  * set_interval - the period that the trigger must be active for the alarm to be set
  * reset_interval - the period that the trigger must be false for the alarm to be reset
+ * timer_id - the mgos timer id of the pending transition
+ * pending_since - uptime (ms) at which the input entered the opposite state,
+ *   used by MGOS_ALARM_DEBOUNCE_TIMESTAMP and edge captured inputs
+ * *name - the name of the alarm
+ * slot - the alarm table slot of the alarm, see mgos_alarm_handle_t
+ */
+struct d_alarm_data{
+  uint32_t count, capacity;
+  uint32_t *enabled, *active, *mode, *dirty, *pending, *edge, *level, *masked, *parent;
+  bool **input;
+  int *set_interval, *reset_interval;
+  mgos_timer_id *timer_id;
+  int64_t *pending_since;
+  char **name;
+  uint32_t *slot;
+};
+
+static struct d_alarm_data s_d_alarm_data;
+
+/*
+ * analog alarm table, a struct of arrays indexed by the alarm's row.
+ * The setpoints are parallel float arrays and the table is kept dense by
+ * swap-removing alarms.
+ *
+ * count - number of alarms in the table
+ * capacity - number of rows allocated, a multiple of 32
+ * enabled - bitset, is the alarm enabled
+ * dirty - bitset, the PV has been notified as changed since the last pass
+ * pending - bitset, a MGOS_ALARM_DEBOUNCE_TIMESTAMP interval is running
+ * sampled - bitset, the alarm's value depends on the PV's history so it is
+ *   sampled every pass whatever the evaluation mode
+ * masked - bitset, the alarm is masked by its parent, see mgos_alarm_set_parent_h
+ * parent - bitset, the alarm has children, the scan evaluates it first
+ * *pv - pointer to the alarm process value that triggers alarms
+ * ll_sv, l_sv, h_sv, hh_sv - the band setpoints, NAN if unused
+ * state - the current state of the alarm as defined by the mgos_a_alarm_state enum
+ * pending_state - the band the PV has moved into, the alarm state once
+ *   the set interval elapses
+ * set_interval - the period that the PV must be in a new band for the alarm to move into it
+ * timer_id - the mgos timer id of the pending transition
+ * pending_since - uptime (ms) at which the PV entered pending_state,
+ *   used by MGOS_ALARM_DEBOUNCE_TIMESTAMP
  * *name - the name of the alarm
- * timer_id - the mgos timer id of the alarm
- * LIST ENTRY - the next alarm in the list part of the List data structure
- */
-struct d_alarm_info{
-  bool active, enabled;
-  bool *input; 
-  enum mgos_d_alarm_mode mode; 
-  int set_interval, reset_interval;
-  char *name;
+ * slot - the alarm table slot of the alarm, see mgos_alarm_handle_t
+ * pv_sample, band - scratch columns, each scan copies the PVs into pv_sample
+ *   and classifies them into band with mgos_alarm_classify
+ * kind - where the alarm's value comes from, see enum a_alarm_kind
+ * ext - the alarm's entry in the pool of its kind, MGOS_ALARM_POOL_NONE
+ *   for A_ALARM_PV
+ * deadband - the reset deadband, see mgos_alarm_set_deadband_h
+ */
+struct a_alarm_data{
+  uint32_t count, capacity;
+  uint32_t *enabled, *dirty, *pending, *sampled, *masked, *parent;
+  float **pv;
+  float *ll_sv, *l_sv, *h_sv, *hh_sv;
+  uint8_t *state, *pending_state;
+  int *set_interval;
+  mgos_timer_id *timer_id;
+  int64_t *pending_since;
+  char **name;
+  uint32_t *slot;
+  float *pv_sample;
+  uint8_t *band;
+  uint8_t *kind;
+  uint32_t *ext;
+  float *deadband;
+};
+
+static struct a_alarm_data s_a_alarm_data;
+
+/*
+ * analog alarm kinds
+ * A_ALARM_PV - a float PV classified against the float setpoints
+ * A_ALARM_RAW - a raw ADC count classified against setpoints in counts,
+ *   see struct a_alarm_raw
+ * A_ALARM_RATE - the filtered rate of change of a float PV, see
+ *   struct a_alarm_derived
+ * A_ALARM_DEVIATION - the filtered deviation of a float PV from a moving
+ *   setpoint, see struct a_alarm_derived
+ * A_ALARM_WINDOW - the minimum, maximum or mean of a float PV over a
+ *   sliding window, see struct mgos_alarm_window
+ */
+enum a_alarm_kind{
+  A_ALARM_PV,
+  A_ALARM_RAW,
+  A_ALARM_RATE,
+  A_ALARM_DEVIATION,
+  A_ALARM_WINDOW
+};
+
+/*
+ * raw count source of an A_ALARM_RAW alarm, see mgos_add_raw_alarm_h
+ *
+ * raw16, raw32 - the count, exactly one is set
+ * sv - ll, l, h and hh setpoints converted to counts when the alarm is added
+ * sv_used - bit n is set if sv[n] is in use
+ * sampled - sample holds a count
+ * sample - the count the alarm was last classified on
+ * scale, offset - the engineering value of sample is sample * scale + offset
+ */
+struct a_alarm_raw{
+  const int16_t *raw16;
+  const int32_t *raw32;
+  int32_t sv[4];
+  uint8_t sv_used;
+  bool sampled;
+  int32_t sample;
+  float scale, offset;
+};
+
+/*
+ * pool of the A_ALARM_RAW alarms' sources
+ */
+static struct mgos_alarm_pool s_raw_alarms;
+
+/*
+ * state of an A_ALARM_RATE or A_ALARM_DEVIATION alarm, the value is
+ * updated in O(1) from each sample and written to pv_sample so that it is
+ * classified with the float PVs. It is an exponential moving average, 
+ * each sample moving it dt / (filter + dt) of the way towards the new 
+ * rate or deviation, dt being the ms since the previous sample.
+ *
+ * *sp - the moving setpoint of an A_ALARM_DEVIATION alarm
+ * period - ms the rate of an A_ALARM_RATE alarm is expressed over
+ * filter - time constant of the average in ms, 0 for no filtering
+ * primed - last_pv and last_ms hold a sample
+ * last_pv, last_ms - the previous sample and its uptime (ms)
+ * value - the filtered rate or deviation, NAN until there is one
+ */
+struct a_alarm_derived{
+  const float *sp;
+  float period;
+  int filter;
+  bool primed;
+  float last_pv, value;
+  int64_t last_ms;
+};
+
+/*
+ * pool of the A_ALARM_RATE and A_ALARM_DEVIATION alarms' state
+ */
+static struct mgos_alarm_pool s_derived_alarms;
+
+/*
+ * pool of the A_ALARM_WINDOW alarms' windows
+ */
+static struct mgos_alarm_pool s_window_alarms;
+
+/*
+ * single writer lock serialising everything that changes the alarm tables,
+ * the alarm table, the name index and the change list. Readers of alarm
+ * state use s_view instead and never take it.
+ */
+static struct mgos_rlock_type *s_alarm_lock = NULL;
+
+/*
+ * reader view entry of an alarm table slot
+ *
+ * handle - the handle of the alarm in the slot, MGOS_ALARM_INVALID_HANDLE
+ *   if the slot is free
+ * type, row - where the alarm's alarm_info is in the view
+ */
+struct alarm_view_slot{
+  mgos_alarm_handle_t handle;
+  enum mgos_alarm_type type;
+  uint32_t row;
+};
+
+/*
+ * reader view of the alarm tables, a seqlock protected copy of what
+ * mgos_list_alarms, mgos_list_alarms_buf and mgos_alarm_get_state_h return.
+ * Writers publish every change of a row under s_alarm_lock, making seq odd
+ * while they do, and readers copy without any lock and retry if seq was odd
+ * or moved. The arrays are replaced when the tables grow, replaced arrays
+ * are retired and only freed once no reader is inside a read section.
+ *
+ * seq - seqlock sequence number, odd while a writer publishes
+ * readers - number of readers inside a read section
+ * d_info, a_info - the alarm_info of each digital and analog table row
+ * d_capacity, a_capacity - rows allocated in d_info and a_info
+ * d_count, a_count - rows in use
+ * slots - the handle and row of each alarm table slot
+ * slot_capacity - number of entries in slots
+ * retired - replaced arrays, chained through their first word
+ */
+struct alarm_view{
+  uint32_t seq, readers;
+  struct alarm_info *d_info, *a_info;
+  uint32_t d_capacity, a_capacity;
+  uint32_t d_count, a_count;
+  struct alarm_view_slot *slots;
+  uint32_t slot_capacity;
+  void *retired;
+};
+
+static struct alarm_view s_view;
+
+/*
+ * unlocked copy attempts a reader makes before it takes s_alarm_lock, so
+ * that a reader preempting a publishing writer cannot spin forever
+ */
+#define ALARM_VIEW_READ_ATTEMPTS 4
+
+/*
+ * one array of a struct of arrays table, lets every array of a table
+ * be grown or have a row moved in one loop
+ */
+struct alarm_column{
+  void **data;
+  size_t size;
+};
+
+#define ALARM_ROWS_MIN_CAPACITY 32
+#define ALARM_BITSET_WORDS(capacity) ((capacity) / 32)
+
+#define ALARM_NOT_PENDING ((int64_t) -1)
+
+/*
+ * how pending set/reset transitions are timed, see mgos_alarm_set_debounce_mode
+ */
+static enum mgos_alarm_debounce_mode s_debounce_mode = MGOS_ALARM_DEBOUNCE_TIMER;
+
+/*
+ * which alarms the scan evaluates, see mgos_alarm_set_eval_mode
+ */
+static enum mgos_alarm_eval_mode s_eval_mode = MGOS_ALARM_EVAL_POLL;
+
+/*
+ * main alarm service timer scheduling, see mgos_alarm_set_schedule_mode
+ *
+ * mode - the schedule mode
+ * poll_interval - the poll_interval passed to mgos_alarm_init
+ * timer_id - the repeating timer under MGOS_ALARM_SCHEDULE_POLL, the armed
+ *   one shot timer under MGOS_ALARM_SCHEDULE_ADAPTIVE, MGOS_INVALID_TIMER_ID
+ *   while the engine sleeps with nothing to wait for
+ * wake_ms - uptime (ms) the one shot timer fires at
+ * stats_since_ms - uptime (ms) the statistics were last reset at
+ */
+struct alarm_schedule{
+  enum mgos_alarm_schedule_mode mode;
+  int poll_interval;
   mgos_timer_id timer_id;
-  LIST_ENTRY (d_alarm_info) d_alarm_entries;
+  int64_t wake_ms;
+  int64_t stats_since_ms;
 };
 
+static struct alarm_schedule s_schedule = {MGOS_ALARM_SCHEDULE_POLL, 0, MGOS_INVALID_TIMER_ID, 0, 0};
+
+#ifndef MGOS_ALARM_MAX_SHARDS
+#define MGOS_ALARM_MAX_SHARDS 16
+#endif
+
 /*
- * digital alarm list structure
+ * one shard of a sharded scan, see mgos_alarm_set_shards
+ *
+ * d_begin, d_end, a_begin, a_end - the bitset words of each table the
+ *   shard evaluates, its rows, dirty bits and deadlines are the rows, bits
+ *   and pending_since entries of those words
+ * d_rows, a_rows - rows that are due to transition, made by the merge
+ * d_due - uptime (ms) each digital row's interval ran out, the time an
+ *   edge captured alarm's transition is stamped with
+ * d_count, a_count - number of rows in d_rows and a_rows
+ * d_capacity, a_capacity - rows allocated in d_rows and d_due, and in a_rows
+ * scanned - alarms evaluated by the shard this pass
+ * classify_us - time the shard spent classifying its analog PVs
  */
-struct d_alarm_data{
-  struct d_alarm_info *current;
-  int length;
-  LIST_HEAD(d_alarms, d_alarm_info) d_alarms;
+struct alarm_shard{
+  uint32_t d_begin, d_end, a_begin, a_end;
+  uint32_t *d_rows, *a_rows;
+  int64_t *d_due;
+  uint32_t d_count, a_count;
+  uint32_t d_capacity, a_capacity;
+  uint32_t scanned;
+  uint32_t classify_us;
+};
+
+/*
+ * sharded scan configuration
+ *
+ * shards - the shard array, count entries
+ * runner, arg - the shard runner and its argument, NULL runs the shards
+ *   one after another on the mgos task
+ * now - uptime (ms) of the pass being run
+ */
+struct alarm_shards{
+  struct alarm_shard *shards;
+  uint32_t count;
+  mgos_alarm_shard_runner runner;
+  void *arg;
+  int64_t now;
+};
+
+static struct alarm_shards s_shards;
+
+/*
+ * timing wheel holding the set/reset deadlines of MGOS_ALARM_DEBOUNCE_WHEEL,
+ * the wheel entry of an alarm is its alarm table slot
+ */
+static struct mgos_alarm_wheel s_wheel;
+
+/*
+ * alarm engine statistics, see mgos_alarm_get_stats
+ */
+static struct mgos_alarm_stats s_stats;
+
+/*
+ * arena the tables were reserved in by mgos_alarm_init_ex, the tables are
+ * fixed at their reserved capacity while s_arena.base is set
+ */
+static struct mgos_alarm_arena s_arena;
+
+/*
+ * capacity reserved by mgos_alarm_init_ex, valid while s_arena.base is set
+ */
+static struct mgos_alarm_capacity s_capacity;
+
+/*
+ * alarm name copies, one buffer of s_capacity.name_len + 1 bytes per alarm
+ * table slot, NULL while the caller's name pointers are kept
+ */
+static char *s_names = NULL;
+
+/*
+ * names of the alarms of one loaded configuration, retired with the last
+ * alarm holding one of them
+ *
+ * next - the next block on the retired list
+ * refs - alarms holding a name, plus one while the configuration loads
+ * names - the names, each NUL terminated
+ */
+struct alarm_name_block{
+  struct alarm_name_block *next;
+  uint32_t refs;
+  char names[];
+};
+
+/*
+ * names of removed alarms that transitions waiting for dispatch may still
+ * point to, freed or reused once no transition is buffered, queued or
+ * being dispatched, see mgos_alarm_names_reclaim
+ *
+ * blocks - name blocks released by their last alarm
+ * slots - slots freed while names are copied into the name storage of
+ *   mgos_alarm_init_ex, chained through next_free, returned to the free
+ *   list with the blocks so that a new alarm does not overwrite the name
+ * slot_count - number of slots on the slots list
+ * dispatching - number of drains and direct dispatches delivering
+ *   transitions no longer buffered or queued, atomic
+ */
+struct alarm_names_retired{
+  struct alarm_name_block *blocks;
+  uint32_t slots, slot_count;
+  uint32_t dispatching;
+};
+
+static struct alarm_names_retired s_names_retired = {.slots = UINT32_MAX};
+
+#ifndef MGOS_ALARM_EVENT_POOL_SIZE
+#define MGOS_ALARM_EVENT_POOL_SIZE 8
+#endif
+
+/*
+ * event payload pool, allocated once in mgos_alarm_init
+ *
+ * payloads - the payload array
+ * free - stack of free payloads
+ * size - number of payloads
+ * free_count - number of payloads on the free stack
+ * high_water - most payloads in use at once
+ * exhausted - number of times a payload was requested from an empty pool
+ */
+struct alarm_event_pool{
+  struct alarm_info *payloads;
+  struct alarm_info **free;
+  size_t size, free_count, high_water;
+  uint32_t exhausted;
 };
 
-static struct d_alarm_data *s_d_alarm_data = NULL;
-static struct mgos_rlock_type *s_d_alarm_data_lock = NULL;
+static struct alarm_event_pool s_event_pool;
 
 /*
- * analog_alarm structure
+ * transitions raised while the alarm tables are locked, dispatched once the
+ * locks are released so that handlers may add or remove alarms without
+ * moving rows under the scan. Holds one transition per alarm.
  * 
- * enabled - is the alarm enabled
- * state - the current state of the alarm as defined by the mgos_a_alarm_state enum
- * *pv - pointer to the alarm process value that triggers alarms
- * set_interval - the period that the trigger must be active for the alarm to be set
- * reset_interval - the period that the trigger must be false for the alarm to be reset
- * *name - the name of the alarm
- * timer_id - the mgos timer id of the alarm
- * LIST ENTRY - the next alarm in the list part of the List data structure
- */
-struct a_alarm_info{
-  bool enabled;
-  enum mgos_a_alarm_state state;
-  float *pv, ll_sv, l_sv, h_sv, hh_sv; 
-  int set_interval;
-  char *name;
-  mgos_timer_id up_timer_id, down_timer_id;
-  LIST_ENTRY (a_alarm_info) a_alarm_entries;
+ * A flush swaps the filled buffer with the spare under s_alarm_lock and
+ * dispatches the spare after unlocking, so that transitions raised on other
+ * threads meanwhile go to the other buffer.
+ *
+ * events - transitions waiting, written under s_alarm_lock
+ * count - number of transitions waiting
+ * capacity - number of transitions allocated in events
+ * spare - buffer being dispatched while flushing
+ * spare_capacity - number of transitions allocated in spare
+ * flushing - a flush is running, atomic, the spare is not reallocated 
+ *   while a handler may be reading it
+ * grow - an alarm was added while flushing, grow the spare once the flush
+ *   ends
+ */
+struct alarm_event_buffer{
+  struct alarm_transition *events, *spare;
+  size_t count, capacity, spare_capacity;
+  bool flushing, grow;
 };
 
+static struct alarm_event_buffer s_event_buffer;
+
+/*
+ * deliver transitions as MGOS_ALARM_EV_BATCH, see mgos_alarm_set_batch_events
+ */
+static bool s_batch_events = false;
+
+/*
+ * event rate limiter, see mgos_alarm_set_rate_limit
+ */
+static struct mgos_alarm_rate s_rate_limit;
+
+#ifndef MGOS_ALARM_DISPATCH_QUEUE_SIZE
+#define MGOS_ALARM_DISPATCH_QUEUE_SIZE 32
+#endif
+
+#if (MGOS_ALARM_DISPATCH_QUEUE_SIZE & (MGOS_ALARM_DISPATCH_QUEUE_SIZE - 1)) != 0
+#error "MGOS_ALARM_DISPATCH_QUEUE_SIZE must be a power of two"
+#endif
+
+#ifndef MGOS_ALARM_DISPATCH_BUDGET
+#define MGOS_ALARM_DISPATCH_BUDGET 8
+#endif
+
+/*
+ * where the handlers run, see mgos_alarm_set_dispatch_mode
+ */
+static enum mgos_alarm_dispatch_mode s_dispatch_mode = MGOS_ALARM_DISPATCH_SYNC;
+static enum mgos_alarm_overflow_policy s_overflow_policy = MGOS_ALARM_OVERFLOW_DROP_OLDEST;
+
+/*
+ * transitions waiting for the drain callback in MGOS_ALARM_DISPATCH_ASYNC,
+ * allocated once in mgos_alarm_init
+ */
+static struct mgos_alarm_queue s_queue;
+
+/*
+ * a drain callback has been invoked and not yet started
+ */
+static bool s_drain_scheduled = false;
+
+#ifndef MGOS_ALARM_EDGE_RING_SIZE
+#define MGOS_ALARM_EDGE_RING_SIZE 64
+#endif
+
+#if (MGOS_ALARM_EDGE_RING_SIZE & (MGOS_ALARM_EDGE_RING_SIZE - 1)) != 0
+#error "MGOS_ALARM_EDGE_RING_SIZE must be a power of two"
+#endif
+
+/*
+ * edges pushed by mgos_alarm_edge_push, allocated once in mgos_alarm_init
+ */
+static struct mgos_alarm_edge_ring s_edges;
+
+/*
+ * an edge consume callback has been invoked from the push and not yet started
+ */
+static bool s_edge_consume_scheduled = false;
+
+/*
+ * Record one operation that took us microseconds
+ */
+static void mgos_alarm_op_record(struct mgos_alarm_op_stats *op, uint32_t us){
+  ++op->count;
+  op->total_us += us;
+  if(us > op->max_us) op->max_us = us;
+}
+
+/*
+ * Record the duration of an operation that started at start_us. Public
+ * calls and dispatches record after releasing the alarm lock, so it is
+ * taken here, the engine may not be initialised yet.
+ */
+static void mgos_alarm_op_done(struct mgos_alarm_op_stats *op, int64_t start_us){
+  uint32_t us = (uint32_t) (mgos_uptime_micros() - start_us);
+  if(s_alarm_lock == NULL) return;
+  mgos_rlock(s_alarm_lock);
+  mgos_alarm_op_record(op, us);
+  mgos_runlock(s_alarm_lock);
+}
+
+/*
+ * calloc wrapper which counts library allocations, carved from the arena
+ * while mgos_alarm_init_ex reserves the tables
+ * hot - the allocation is made on the scan or transition path
+ */
+static void *mgos_alarm_calloc(size_t num, size_t size, bool hot){
+  //readers allocate their list copies without the alarm lock
+  __atomic_add_fetch(&s_stats.allocs, 1, __ATOMIC_RELAXED);
+  if(hot) ++s_stats.hot_allocs;
+  return mgos_alarm_arena_calloc(num, size);
+}
+
+/*
+ * realloc wrapper which counts library allocations, only used when
+ * alarms are added
+ */
+static void *mgos_alarm_realloc(void *ptr, size_t size){
+  __atomic_add_fetch(&s_stats.allocs, 1, __ATOMIC_RELAXED);
+  return mgos_alarm_arena_realloc(ptr, size);
+}
+
+/*
+ * One shot mgos_set_timer wrapper, every SDK timer is a heap allocation
+ * made from the scan path
+ */
+static mgos_timer_id mgos_alarm_set_timer(int msecs, timer_callback cb, void *arg){
+  ++s_stats.timer_sets;
+  ++s_stats.hot_allocs;
+  return mgos_set_timer(msecs, 0, cb, arg);
+}
+
+/*
+ * mgos_clear_timer wrapper
+ */
+static void mgos_alarm_clear_timer(mgos_timer_id timer_id){
+  ++s_stats.timer_clears;
+  mgos_clear_timer(timer_id);
+}
+
+static void mgos_alarm_timer(void *arg);
+
+/*
+ * Under MGOS_ALARM_SCHEDULE_ADAPTIVE arm the one shot service timer to fire
+ * at wake_ms, unless it is already armed to fire no later,
+ * must be called with s_alarm_lock held
+ */
+static void mgos_alarm_schedule_wake(int64_t wake_ms){
+  struct alarm_schedule *s = &s_schedule;
+  if(s->mode != MGOS_ALARM_SCHEDULE_ADAPTIVE || wake_ms == INT64_MAX) return;
+  if(s->timer_id != MGOS_INVALID_TIMER_ID){
+    if(s->wake_ms <= wake_ms) return;
+    mgos_alarm_clear_timer(s->timer_id);
+  }
+  int64_t delay = wake_ms - mgos_uptime_micros() / 1000;
+  if(delay < 0) delay = 0;
+  if(delay > INT_MAX) delay = INT_MAX;
+  s->wake_ms = wake_ms;
+  s->timer_id = mgos_alarm_set_timer((int) delay, mgos_alarm_timer, NULL);
+}
+
+/*
+ * Wake the engine for a pass as soon as possible, an alarm has been
+ * marked dirty outside a pass, must be called with s_alarm_lock held
+ */
+static void mgos_alarm_wake(void){
+  mgos_alarm_schedule_wake(mgos_uptime_micros() / 1000);
+}
+
+/*
+ * Bitset accessors
+ */
+static bool alarm_bit_get(const uint32_t *bits, uint32_t i){
+  return (bits[i >> 5] >> (i & 31)) & 1;
+}
+
+static void alarm_bit_set(uint32_t *bits, uint32_t i, bool value){
+  if(value) bits[i >> 5] |= (1u << (i & 31));
+  else bits[i >> 5] &= ~(1u << (i & 31));
+}
+
+/*
+ * Grow every column of a table to capacity rows
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_columns_grow(const struct alarm_column *cols, size_t num_cols,
+                                    uint32_t capacity){
+  for(size_t i = 0; i < num_cols; i++){
+    void *data = mgos_alarm_realloc(*cols[i].data, capacity * cols[i].size);
+    if(data == NULL) return false;
+    *cols[i].data = data;
+  }
+  return true;
+}
+
+/*
+ * Copy row from over row to in every column of a table
+ */
+static void mgos_alarm_columns_move(const struct alarm_column *cols, size_t num_cols,
+                                    uint32_t to, uint32_t from){
+  for(size_t i = 0; i < num_cols; i++){
+    char *data = (char *) *cols[i].data;
+    memcpy(data + to * cols[i].size, data + from * cols[i].size, cols[i].size);
+  }
+}
+
+/*
+ * Grow a bitset from capacity to new_capacity bits, the new bits are clear
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_bitset_grow(uint32_t **bits, uint32_t capacity, uint32_t new_capacity){
+  uint32_t *data = (uint32_t *) mgos_alarm_realloc(*bits,
+                                                   ALARM_BITSET_WORDS(new_capacity) * sizeof(*data));
+  if(data == NULL) return false;
+  memset(&data[ALARM_BITSET_WORDS(capacity)], 0,
+         (ALARM_BITSET_WORDS(new_capacity) - ALARM_BITSET_WORDS(capacity)) * sizeof(*data));
+  *bits = data;
+  return true;
+}
+
+/*
+ * Start publishing a change to the reader view, seq is odd until
+ * mgos_alarm_view_publish_end. Must be called with s_alarm_lock held.
+ */
+static void mgos_alarm_view_publish_begin(void){
+  __atomic_store_n(&s_view.seq, s_view.seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void mgos_alarm_view_publish_end(void){
+  __atomic_store_n(&s_view.seq, s_view.seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Free the retired view arrays if no reader is inside a read section,
+ * must be called with s_alarm_lock held
+ */
+static void mgos_alarm_view_reclaim(void){
+  if(s_view.retired == NULL) return;
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&s_view.readers, __ATOMIC_SEQ_CST) != 0) return;
+  while(s_view.retired != NULL){
+    void *next = *(void **) s_view.retired;
+    free(s_view.retired);
+    s_view.retired = next;
+  }
+}
+
+/*
+ * Replace a reader view array with a copy grown from capacity to
+ * new_capacity elements, the old array is retired as a reader may still be
+ * copying from it. The capacity is published after the array so that a
+ * reader never pairs the new capacity with the old array.
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_view_grow(void **array, uint32_t *capacity, uint32_t new_capacity, size_t size){
+  void *data = mgos_alarm_calloc(new_capacity, size, false);
+  if(data == NULL) return false;
+  void *old = *array;
+  if(old != NULL) memcpy(data, old, *capacity * size);
+  mgos_alarm_view_publish_begin();
+  __atomic_store_n(array, data, __ATOMIC_RELEASE);
+  __atomic_store_n(capacity, new_capacity, __ATOMIC_RELEASE);
+  mgos_alarm_view_publish_end();
+  if(old != NULL){
+    *(void **) old = s_view.retired;
+    s_view.retired = old;
+  }
+  mgos_alarm_view_reclaim();
+  return true;
+}
+
+/*
+ * Returns the row capacity a table needs so that one more alarm fits
+ */
+static uint32_t mgos_alarm_rows_needed(uint32_t count, uint32_t capacity){
+  if(count < capacity) return capacity;
+  return capacity < ALARM_ROWS_MIN_CAPACITY ? ALARM_ROWS_MIN_CAPACITY : capacity * 2;
+}
+
+/*
+ * Columns of the digital table, bitsets excluded, as X(arg, type, column)
+ */
+#define D_ALARM_COLUMN_LIST(X, arg) \
+    X(arg, struct d_alarm_data, input) \
+    X(arg, struct d_alarm_data, set_interval) \
+    X(arg, struct d_alarm_data, reset_interval) \
+    X(arg, struct d_alarm_data, timer_id) \
+    X(arg, struct d_alarm_data, pending_since) \
+    X(arg, struct d_alarm_data, name) \
+    X(arg, struct d_alarm_data, slot)
+
+/*
+ * Columns of the analog table, bitsets excluded, as X(arg, type, column)
+ */
+#define A_ALARM_COLUMN_LIST(X, arg) \
+    X(arg, struct a_alarm_data, pv) \
+    X(arg, struct a_alarm_data, ll_sv) \
+    X(arg, struct a_alarm_data, l_sv) \
+    X(arg, struct a_alarm_data, h_sv) \
+    X(arg, struct a_alarm_data, hh_sv) \
+    X(arg, struct a_alarm_data, state) \
+    X(arg, struct a_alarm_data, pending_state) \
+    X(arg, struct a_alarm_data, set_interval) \
+    X(arg, struct a_alarm_data, timer_id) \
+    X(arg, struct a_alarm_data, pending_since) \
+    X(arg, struct a_alarm_data, name) \
+    X(arg, struct a_alarm_data, slot) \
+    X(arg, struct a_alarm_data, pv_sample) \
+    X(arg, struct a_alarm_data, band) \
+    X(arg, struct a_alarm_data, kind) \
+    X(arg, struct a_alarm_data, ext) \
+    X(arg, struct a_alarm_data, deadband)
+
+/*
+ * alarm_column of a table, and the arena bytes of a column of rows
+ */
+#define ALARM_COLUMN(table, type, column) {(void **) &(table)->column, sizeof(*(table)->column)},
+#define ALARM_COLUMN_BYTES(rows, type, column) \
+  + MGOS_ALARM_ARENA_BLOCK((size_t) (rows) * sizeof(*((type *) 0)->column))
+
+#define D_ALARM_COLUMNS(d) {D_ALARM_COLUMN_LIST(ALARM_COLUMN, d)}
+#define A_ALARM_COLUMNS(a) {A_ALARM_COLUMN_LIST(ALARM_COLUMN, a)}
+
+#define ALARM_NUM_COLUMNS(cols) (sizeof(cols) / sizeof((cols)[0]))
+
+/*
+ * Grow the digital table to capacity rows
+ * returns false if memory could not be allocated
+ */
+static bool d_alarm_grow(uint32_t capacity){
+  struct d_alarm_data *d = &s_d_alarm_data;
+  const struct alarm_column cols[] = D_ALARM_COLUMNS(d);
+  if(!mgos_alarm_columns_grow(cols, ALARM_NUM_COLUMNS(cols), capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->enabled, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->active, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->mode, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->dirty, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->pending, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->edge, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->level, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->masked, d->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&d->parent, d->capacity, capacity)) return false;
+  if(!mgos_alarm_view_grow((void **) &s_view.d_info, &s_view.d_capacity, capacity,
+                           sizeof(*s_view.d_info))) return false;
+  d->capacity = capacity;
+  return true;
+}
+
+/*
+ * Ensure the digital table has adding free rows, a reserved table never grows
+ * returns false if memory could not be allocated or the reservation is full
+ */
+static bool d_alarm_reserve(uint32_t adding){
+  if(s_arena.base != NULL) return s_d_alarm_data.count + adding <= s_capacity.d_alarms;
+  uint32_t capacity = s_d_alarm_data.capacity;
+  while(s_d_alarm_data.count + adding > capacity) capacity = mgos_alarm_rows_needed(capacity, capacity);
+  return capacity == s_d_alarm_data.capacity || d_alarm_grow(capacity);
+}
+
+/*
+ * Grow the analog table to capacity rows
+ * returns false if memory could not be allocated
+ */
+static bool a_alarm_grow(uint32_t capacity){
+  struct a_alarm_data *a = &s_a_alarm_data;
+  const struct alarm_column cols[] = A_ALARM_COLUMNS(a);
+  if(!mgos_alarm_columns_grow(cols, ALARM_NUM_COLUMNS(cols), capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&a->enabled, a->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&a->dirty, a->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&a->pending, a->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&a->sampled, a->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&a->masked, a->capacity, capacity)) return false;
+  if(!mgos_alarm_bitset_grow(&a->parent, a->capacity, capacity)) return false;
+  if(!mgos_alarm_view_grow((void **) &s_view.a_info, &s_view.a_capacity, capacity,
+                           sizeof(*s_view.a_info))) return false;
+  a->capacity = capacity;
+  return true;
+}
+
+/*
+ * Ensure the analog table has adding free rows, a reserved table never grows
+ * returns false if memory could not be allocated or the reservation is full
+ */
+static bool a_alarm_reserve(uint32_t adding){
+  if(s_arena.base != NULL) return s_a_alarm_data.count + adding <= s_capacity.a_alarms;
+  uint32_t capacity = s_a_alarm_data.capacity;
+  while(s_a_alarm_data.count + adding > capacity) capacity = mgos_alarm_rows_needed(capacity, capacity);
+  return capacity == s_a_alarm_data.capacity || a_alarm_grow(capacity);
+}
+
+/*
+ * Move the last row of the digital table over row i and shrink the table,
+ * the moved alarm's slot is pointed at its new row
+ */
+static void d_alarm_swap_remove(uint32_t i){
+  struct d_alarm_data *d = &s_d_alarm_data;
+  uint32_t last = --d->count;
+  if(i != last){
+    const struct alarm_column cols[] = D_ALARM_COLUMNS(d);
+    mgos_alarm_columns_move(cols, ALARM_NUM_COLUMNS(cols), i, last);
+    alarm_bit_set(d->enabled, i, alarm_bit_get(d->enabled, last));
+    alarm_bit_set(d->active, i, alarm_bit_get(d->active, last));
+    alarm_bit_set(d->mode, i, alarm_bit_get(d->mode, last));
+    alarm_bit_set(d->dirty, i, alarm_bit_get(d->dirty, last));
+    alarm_bit_set(d->pending, i, alarm_bit_get(d->pending, last));
+    alarm_bit_set(d->edge, i, alarm_bit_get(d->edge, last));
+    alarm_bit_set(d->level, i, alarm_bit_get(d->level, last));
+    alarm_bit_set(d->masked, i, alarm_bit_get(d->masked, last));
+    alarm_bit_set(d->parent, i, alarm_bit_get(d->parent, last));
+  }
+  //the scan walks the enabled bitset so the vacated row must be clear
+  alarm_bit_set(d->enabled, last, false);
+}
+
+/*
+ * Move the last row of the analog table over row i and shrink the table,
+ * the moved alarm's slot is pointed at its new row
+ */
+static void a_alarm_swap_remove(uint32_t i){
+  struct a_alarm_data *a = &s_a_alarm_data;
+  uint32_t last = --a->count;
+  if(i != last){
+    const struct alarm_column cols[] = A_ALARM_COLUMNS(a);
+    mgos_alarm_columns_move(cols, ALARM_NUM_COLUMNS(cols), i, last);
+    alarm_bit_set(a->enabled, i, alarm_bit_get(a->enabled, last));
+    alarm_bit_set(a->dirty, i, alarm_bit_get(a->dirty, last));
+    alarm_bit_set(a->pending, i, alarm_bit_get(a->pending, last));
+    alarm_bit_set(a->sampled, i, alarm_bit_get(a->sampled, last));
+    alarm_bit_set(a->masked, i, alarm_bit_get(a->masked, last));
+    alarm_bit_set(a->parent, i, alarm_bit_get(a->parent, last));
+  }
+  alarm_bit_set(a->enabled, last, false);
+  alarm_bit_set(a->sampled, last, false);
+}
+
+/*
+ * Grow an event buffer to hold at least capacity transitions
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_event_grow(struct alarm_transition **events, size_t *allocated, size_t capacity){
+  if(capacity <= *allocated) return true;
+  if(capacity < 2 * *allocated) capacity = 2 * *allocated;
+  struct alarm_transition *grown = (struct alarm_transition *) mgos_alarm_realloc(*events,
+                                                                                  capacity * sizeof(*grown));
+  if(grown == NULL) return false;
+  *events = grown;
+  *allocated = capacity;
+  return true;
+}
+
+/*
+ * Ensure both event buffers can hold one transition per alarm once adding
+ * more alarms are added, must be called with s_alarm_lock held. While
+ * flushing the growth of the spare is deferred and transitions overflowing
+ * the buffer it is swapped back in as are dispatched inline.
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_event_reserve(uint32_t adding){
+  size_t capacity = s_d_alarm_data.count + s_a_alarm_data.count + adding;
+  if(capacity <= s_event_buffer.capacity && capacity <= s_event_buffer.spare_capacity) return true;
+  if(s_arena.base != NULL) return false;
+  if(!mgos_alarm_event_grow(&s_event_buffer.events, &s_event_buffer.capacity, capacity)) return false;
+  if(__atomic_load_n(&s_event_buffer.flushing, __ATOMIC_ACQUIRE)){
+    s_event_buffer.grow = true;
+    return true;
+  }
+  return mgos_alarm_event_grow(&s_event_buffer.spare, &s_event_buffer.spare_capacity, capacity);
+}
+
+/*
+ * Take a payload from the event payload pool
+ * returns NULL if the pool is exhausted
+ */
+static struct alarm_info *mgos_alarm_payload_get(void){
+  if(s_event_pool.free_count == 0){
+    ++s_event_pool.exhausted;
+    return NULL;
+  }
+  struct alarm_info *payload = s_event_pool.free[--s_event_pool.free_count];
+  size_t in_use = s_event_pool.size - s_event_pool.free_count;
+  if(in_use > s_event_pool.high_water) s_event_pool.high_water = in_use;
+  return payload;
+}
+
+/*
+ * Return a payload to the event payload pool
+ */
+static void mgos_alarm_payload_put(struct alarm_info *payload){
+  s_event_pool.free[s_event_pool.free_count++] = payload;
+}
+
+/*
+ * Trigger an alarm event with a pooled copy of info and record the time
+ * spent in the handlers.
+ *
+ * mgos_event_trigger runs the handlers synchronously so the payload is
+ * recycled as soon as it returns. Should a handler cause nested transitions
+ * that exhaust the pool, the payload is built on the stack instead.
+ */
+static void mgos_alarm_dispatch(int ev, const struct alarm_info *info){
+  int64_t start_us = mgos_uptime_micros();
+  struct alarm_info spare;
+  struct alarm_info *payload = mgos_alarm_payload_get();
+  if(payload == NULL) payload = &spare;
+  *payload = *info;
+  mgos_event_trigger(ev, payload);
+  if(payload != &spare) mgos_alarm_payload_put(payload);
+  mgos_alarm_op_done(&s_stats.dispatch, start_us);
+}
+
+/*
+ * Trigger MGOS_ALARM_EV_BATCH for a run of transitions and record the time
+ * spent in the handlers
+ */
+static void mgos_alarm_dispatch_batch(const struct alarm_transition *transitions, size_t length){
+  int64_t start_us = mgos_uptime_micros();
+  struct alarm_batch batch = {transitions, length};
+  mgos_event_trigger(MGOS_ALARM_EV_BATCH, &batch);
+  mgos_alarm_op_done(&s_stats.dispatch, start_us);
+}
+
+/*
+ * Trigger MGOS_ALARM_EV_SUMMARY for the summary made by the last pass, if
+ * there is one, and record the time spent in the handlers
+ */
+static void mgos_alarm_dispatch_summary(void){
+  mgos_rlock(s_alarm_lock);
+  struct alarm_summary summary = s_rate_limit.summary;
+  bool ready = s_rate_limit.ready;
+  s_rate_limit.ready = false;
+  mgos_runlock(s_alarm_lock);
+  if(!ready) return;
+  int64_t start_us = mgos_uptime_micros();
+  mgos_event_trigger(MGOS_ALARM_EV_SUMMARY, &summary);
+  mgos_alarm_op_done(&s_stats.dispatch, start_us);
+}
+
+/*
+ * Dispatch a single transition as its own event, or a batch of one
+ */
+static void mgos_alarm_dispatch_transition(const struct alarm_transition *transition){
+  if(s_batch_events) mgos_alarm_dispatch_batch(transition, 1);
+  else mgos_alarm_dispatch(transition->ev, &transition->info);
+}
+
+static void mgos_alarm_drain(void *arg);
+static void mgos_alarm_names_reclaim(void);
+
+/*
+ * Invoke the drain callback on the mgos task unless one is already waiting,
+ * should the invoke fail the next flush tries again
+ */
+static void mgos_alarm_schedule_drain(void){
+  if(__atomic_exchange_n(&s_drain_scheduled, true, __ATOMIC_ACQ_REL)) return;
+  if(!mgos_invoke_cb(mgos_alarm_drain, NULL, false)){
+    __atomic_store_n(&s_drain_scheduled, false, __ATOMIC_RELEASE);
+  }
+}
+
+/*
+ * Drain callback of MGOS_ALARM_DISPATCH_ASYNC, delivers at most
+ * MGOS_ALARM_DISPATCH_BUDGET transitions and then invokes itself again for
+ * the rest so that other mgos callbacks, the alarm scan among them, are not
+ * held up behind a long queue
+ */
+static void mgos_alarm_drain(void *arg){
+  __atomic_store_n(&s_drain_scheduled, false, __ATOMIC_RELEASE);
+  struct alarm_transition transitions[MGOS_ALARM_DISPATCH_BUDGET];
+  int64_t queued_us[MGOS_ALARM_DISPATCH_BUDGET];
+  size_t length = 0;
+  //counted before popping so that the names of the popped transitions are
+  //not reclaimed while the queue looks empty
+  __atomic_add_fetch(&s_names_retired.dispatching, 1, __ATOMIC_SEQ_CST);
+  while(length < MGOS_ALARM_DISPATCH_BUDGET &&
+        mgos_alarm_queue_pop(&s_queue, &transitions[length], &queued_us[length])){
+    ++length;
+  }
+  mgos_rlock(s_alarm_lock);
+  bool batch = s_batch_events;
+  if(batch && length > 0){
+    int64_t now_us = mgos_uptime_micros();
+    for(size_t i = 0; i < length; i++){
+      mgos_alarm_op_record(&s_stats.queue_latency, (uint32_t) (now_us - queued_us[i]));
+    }
+  }
+  mgos_runlock(s_alarm_lock);
+  if(batch && length > 0) mgos_alarm_dispatch_batch(transitions, length);
+  else{
+    for(size_t i = 0; i < length; i++){
+      mgos_alarm_op_done(&s_stats.queue_latency, queued_us[i]);
+      mgos_alarm_dispatch(transitions[i].ev, &transitions[i].info);
+    }
+  }
+  mgos_rlock(s_alarm_lock);
+  __atomic_sub_fetch(&s_names_retired.dispatching, 1, __ATOMIC_SEQ_CST);
+  mgos_alarm_names_reclaim();
+  mgos_runlock(s_alarm_lock);
+  mgos_alarm_dispatch_summary();
+  if(mgos_alarm_queue_depth(&s_queue) > 0) mgos_alarm_schedule_drain();
+  (void) arg;
+}
+
+/*
+ * Queue an alarm transition for mgos_alarm_flush_events. The buffer holds
+ * one transition per alarm but fills past that while a flush on another
+ * thread holds the spare, it then grows so that the transitions keep their
+ * order. If it cannot grow the transition is dispatched, or pushed to the
+ * dispatch queue, straight away. Transitions pass the chatter detection 
+ * and the rate limiter in mgos_alarm_raise first.
+ */
+static void mgos_alarm_emit(const struct alarm_transition *transition){
+  if(s_event_buffer.count == s_event_buffer.capacity &&
+     (s_arena.base != NULL ||
+      !mgos_alarm_event_grow(&s_event_buffer.events, &s_event_buffer.capacity, s_event_buffer.count + 1))){
+    if(s_dispatch_mode == MGOS_ALARM_DISPATCH_ASYNC){
+      mgos_alarm_queue_push(&s_queue, transition, mgos_uptime_micros(), s_overflow_policy);
+    }
+    else{
+      __atomic_add_fetch(&s_names_retired.dispatching, 1, __ATOMIC_SEQ_CST);
+      mgos_alarm_dispatch_transition(transition);
+      __atomic_sub_fetch(&s_names_retired.dispatching, 1, __ATOMIC_SEQ_CST);
+    }
+    return;
+  }
+  s_event_buffer.events[s_event_buffer.count++] = *transition;
+}
+
+/*
+ * Push the buffered transitions to the dispatch queue and schedule the
+ * drain callback, must be called with s_alarm_lock held so that the engine
+ * stays the queue's single producer
+ */
+static void mgos_alarm_queue_events(void){
+  int64_t now_us = mgos_uptime_micros();
+  for(size_t i = 0; i < s_event_buffer.count; i++){
+    mgos_alarm_queue_push(&s_queue, &s_event_buffer.events[i], now_us, s_overflow_policy);
+  }
+  s_event_buffer.count = 0;
+  if(mgos_alarm_queue_depth(&s_queue) > 0 || s_rate_limit.ready) mgos_alarm_schedule_drain();
+}
+
+/*
+ * Take the buffered transitions under s_alarm_lock and dispatch them after
+ * unlocking, until none are left. Transitions raised by the handlers
+ * themselves are dispatched as a further batch in batch mode.
+ */
+static void mgos_alarm_flush_buffered(void){
+  for(;;){
+    mgos_rlock(s_alarm_lock);
+    if(s_dispatch_mode == MGOS_ALARM_DISPATCH_ASYNC){
+      mgos_alarm_queue_events();
+      mgos_runlock(s_alarm_lock);
+      return;
+    }
+    bool batch = s_batch_events;
+    struct alarm_transition *events = s_event_buffer.events;
+    size_t count = s_event_buffer.count;
+    if(count > 0){
+      size_t capacity = s_event_buffer.capacity;
+      s_event_buffer.events = s_event_buffer.spare;
+      s_event_buffer.capacity = s_event_buffer.spare_capacity;
+      s_event_buffer.spare = events;
+      s_event_buffer.spare_capacity = capacity;
+      s_event_buffer.count = 0;
+    }
+    mgos_runlock(s_alarm_lock);
+    if(count == 0) return;
+    if(batch) mgos_alarm_dispatch_batch(events, count);
+    else{
+      for(size_t i = 0; i < count; i++) mgos_alarm_dispatch(events[i].ev, &events[i].info);
+    }
+  }
+}
+
+/*
+ * Dispatch the buffered alarm transitions, must be called with no alarm 
+ * locks held, and a waiting summary after them. In 
+ * MGOS_ALARM_DISPATCH_ASYNC the transitions are queued for the drain 
+ * callback instead. One flush runs at a time, a flush called while another
+ * runs on another thread, or from a handler, leaves its transitions to the
+ * running one. Names retired meanwhile are reclaimed once the last flush
+ * ends.
+ */
+static void mgos_alarm_flush_events(void){
+  bool pending = true;
+  while(pending){
+    if(__atomic_exchange_n(&s_event_buffer.flushing, true, __ATOMIC_ACQ_REL)) return;
+    mgos_alarm_flush_buffered();
+    __atomic_store_n(&s_event_buffer.flushing, false, __ATOMIC_RELEASE);
+    mgos_alarm_dispatch_summary();
+    mgos_rlock(s_alarm_lock);
+    //catch up with alarms added by the handlers
+    if(s_event_buffer.grow){
+      s_event_buffer.grow = false;
+      mgos_alarm_event_reserve(1);
+    }
+    //transitions raised by a flush that found this one running
+    pending = s_event_buffer.count > 0;
+    if(!pending) mgos_alarm_names_reclaim();
+    mgos_runlock(s_alarm_lock);
+  }
+}
+
+/*
+ * alarm table slot, a handle is a generation checked index into the table
+ *
+ * generation - incremented every time the slot is freed so that stale
+ *   handles are rejected
+ * type - whether the alarm is a row of the digital or the analog table
+ * used - the slot holds an alarm
+ * row - the alarm's row in its table, updated when rows are swap-removed
+ * name_hash - precomputed hash of the name, used by the name index
+ * next_free - the next slot in the free list
+ * seq - the change sequence number of the alarm's last change
+ * change_prev, change_next - neighbouring slots in the change list
+ * chatter - the alarm's entry in s_chatter, MGOS_ALARM_POOL_NONE if its
+ *   chatter is not detected
+ * expr - the expression of an expression alarm, NULL for other alarms
+ * expr_deps - first entry in s_expr_deps of the list of expressions that
+ *   refer to the alarm, MGOS_ALARM_POOL_NONE if none do
+ * parent, first_child, next_sibling - the alarm's place in the suppression
+ *   graph, slots or ALARM_SLOT_NONE, see mgos_alarm_set_parent_h
+ * depth - number of ancestors in the suppression graph, updated as it is
+ *   relinked so that the scan orders the parents without walking up
+ * timer_gen - incremented every time an SDK set/reset timer is armed for
+ *   the slot, kept when the slot is freed so that only the callback of the
+ *   timer armed last runs a transition
+ */
+struct alarm_slot{
+  uint16_t generation;
+  enum mgos_alarm_type type;
+  bool used;
+  uint32_t row;
+  uint32_t name_hash;
+  uint32_t next_free;
+  uint32_t seq;
+  uint32_t change_prev, change_next;
+  uint32_t chatter;
+  struct mgos_alarm_expr *expr;
+  uint32_t expr_deps;
+  uint32_t parent, first_child, next_sibling;
+  uint32_t depth;
+  struct alarm_name_block *name_block;
+  uint16_t timer_gen;
+};
+
+/*
+ * alarm table
+ *
+ * capacity - number of allocated slots
+ * free_head - first slot of the free list
+ * used - number of slots holding an alarm
+ * high_water - most slots that have held an alarm at once
+ */
+struct alarm_table{
+  struct alarm_slot *slots;
+  uint32_t capacity, free_head;
+  uint32_t used, high_water;
+};
+
+#define ALARM_SLOT_NONE UINT32_MAX
+#define ALARM_TABLE_MIN_CAPACITY 16
+#define ALARM_HANDLE_INDEX_BITS 20
+#define ALARM_HANDLE_INDEX_MASK ((1u << ALARM_HANDLE_INDEX_BITS) - 1)
+#define ALARM_HANDLE_GENERATION_MASK (UINT32_MAX >> ALARM_HANDLE_INDEX_BITS)
+
+static struct alarm_table s_alarm_table = {.free_head = ALARM_SLOT_NONE};
+
+/*
+ * alarms in the order they last changed, threaded through the alarm table
+ * slots so that mgos_list_alarm_changes only visits the changed alarms
+ *
+ * head, tail - least and most recently changed slots
+ * seq - the last change sequence number handed out
+ * removed_seq - the change sequence number of the last removal
+ */
+struct alarm_change_list{
+  uint32_t head, tail;
+  uint32_t seq, removed_seq;
+};
+
+static struct alarm_change_list s_changes = {ALARM_SLOT_NONE, ALARM_SLOT_NONE, 0, 0};
+
+/*
+ * chatter detection of the alarms, see mgos_alarm_set_chatter_h
+ */
+static struct mgos_alarm_chatter_set s_chatter;
+
+/*
+ * entry of an alarm's list of the expressions that refer to it, see
+ * mgos_add_expr_alarm_h
+ *
+ * next - the next entry in the list
+ * expr - the expression
+ */
+struct alarm_expr_dep{
+  uint32_t next;
+  struct mgos_alarm_expr *expr;
+};
+
+static struct mgos_alarm_pool s_expr_deps;
+
+/*
+ * expression alarms
+ *
+ * order - the expressions in the order they were added, which is a
+ *   topological order as an expression can only refer to alarms that
+ *   already exist
+ * count, capacity - expressions in and room in order
+ * dirty - expressions marked dirty
+ * inputs - expressions reading an input, which a pass in
+ *   MGOS_ALARM_EVAL_POLL evaluates whether dirty or not
+ */
+struct alarm_exprs{
+  struct mgos_alarm_expr **order;
+  uint32_t count, capacity;
+  uint32_t dirty, inputs;
+};
+
+static struct alarm_exprs s_exprs;
+
+/*
+ * the last cascade of the suppression graph, see mgos_alarm_get_first_out,
+ * its parent handle is MGOS_ALARM_INVALID_HANDLE until a cascade starts
+ */
+static struct alarm_first_out s_first_out = {MGOS_ALARM_INVALID_HANDLE, MGOS_ALARM_INVALID_HANDLE, 0, 0, false};
+
+static void mgos_alarm_expr_settle(int64_t now);
+
+/*
+ * alarm name index entry
+ *
+ * hash - precomputed hash of the alarm name
+ * slot - the alarm table slot of the alarm
+ * used - the entry holds an alarm
+ * tombstone - the entry held an alarm that has since been removed
+ */
+struct alarm_index_entry{
+  uint32_t hash;
+  uint32_t slot;
+  bool used, tombstone;
+};
+
+/*
+ * alarm name index, an open addressing (linear probing) hash table
+ * shared by the digital and analog alarms
+ *
+ * capacity - number of entries, always a power of two
+ * used - number of entries holding an alarm
+ * tombstones - number of entries holding a tombstone
+ * spare - second entry array of a reserved index, which is rebuilt into
+ *   the spare and swapped rather than reallocated
+ */
+struct alarm_index{
+  struct alarm_index_entry *entries;
+  size_t capacity, used, tombstones;
+  struct alarm_index_entry *spare;
+};
+
+#define ALARM_INDEX_MIN_CAPACITY 16
+
+static struct alarm_index s_alarm_index;
+
+/*
+ * Encode the handle of an alarm table slot
+ */
+static mgos_alarm_handle_t mgos_alarm_handle(uint32_t slot){
+  return ((mgos_alarm_handle_t) s_alarm_table.slots[slot].generation << ALARM_HANDLE_INDEX_BITS) | slot;
+}
+
+/*
+ * Decode a handle into its alarm table slot
+ * returns ALARM_SLOT_NONE if the handle is invalid or stale
+ */
+static uint32_t mgos_alarm_handle_slot(mgos_alarm_handle_t handle){
+  uint32_t slot = handle & ALARM_HANDLE_INDEX_MASK;
+  if(handle == MGOS_ALARM_INVALID_HANDLE || slot >= s_alarm_table.capacity) return ALARM_SLOT_NONE;
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  if(!as->used || as->generation != (handle >> ALARM_HANDLE_INDEX_BITS)) return ALARM_SLOT_NONE;
+  return slot;
+}
+
+/*
+ * Write row i of the digital table into the reader view,
+ * must be called between mgos_alarm_view_publish_begin and end
+ */
+static void d_alarm_view_row(uint32_t i){
+  struct d_alarm_data *d = &s_d_alarm_data;
+  struct alarm_info *info = &s_view.d_info[i];
+  info->name = d->name[i];
+  info->enabled = alarm_bit_get(d->enabled, i);
+  info->type = DIGITAL;
+  info->state.d_state = alarm_bit_get(d->active, i);
+  struct alarm_view_slot *vs = &s_view.slots[d->slot[i]];
+  vs->handle = mgos_alarm_handle(d->slot[i]);
+  vs->type = DIGITAL;
+  vs->row = i;
+}
+
+/*
+ * Write row i of the analog table into the reader view,
+ * must be called between mgos_alarm_view_publish_begin and end
+ */
+static void a_alarm_view_row(uint32_t i){
+  struct a_alarm_data *a = &s_a_alarm_data;
+  struct alarm_info *info = &s_view.a_info[i];
+  info->name = a->name[i];
+  info->enabled = alarm_bit_get(a->enabled, i);
+  info->type = ANALOG;
+  info->state.a_state = (enum mgos_a_alarm_state) a->state[i];
+  struct alarm_view_slot *vs = &s_view.slots[a->slot[i]];
+  vs->handle = mgos_alarm_handle(a->slot[i]);
+  vs->type = ANALOG;
+  vs->row = i;
+}
+
+/*
+ * Publish a changed or added digital table row to the reader view
+ */
+static void d_alarm_publish(uint32_t i){
+  mgos_alarm_view_publish_begin();
+  d_alarm_view_row(i);
+  s_view.d_count = s_d_alarm_data.count;
+  mgos_alarm_view_publish_end();
+}
+
+/*
+ * Publish a changed or added analog table row to the reader view
+ */
+static void a_alarm_publish(uint32_t i){
+  mgos_alarm_view_publish_begin();
+  a_alarm_view_row(i);
+  s_view.a_count = s_a_alarm_data.count;
+  mgos_alarm_view_publish_end();
+}
+
+/*
+ * Publish the removal of the alarm that was in slot, row is the row it
+ * was swap-removed from and is republished if another alarm moved into it
+ */
+static void mgos_alarm_view_remove(uint32_t slot, enum mgos_alarm_type type, uint32_t row){
+  mgos_alarm_view_publish_begin();
+  s_view.slots[slot].handle = MGOS_ALARM_INVALID_HANDLE;
+  if(type == DIGITAL){
+    if(row < s_d_alarm_data.count) d_alarm_view_row(row);
+    s_view.d_count = s_d_alarm_data.count;
+  }
+  else{
+    if(row < s_a_alarm_data.count) a_alarm_view_row(row);
+    s_view.a_count = s_a_alarm_data.count;
+  }
+  mgos_alarm_view_publish_end();
+}
+
+/*
+ * Reader view callback, copies what it needs from s_view into ctx. It may
+ * run more than once for one read and must not keep anything else.
+ */
+typedef void (*alarm_view_read_cb)(void *ctx);
+
+/*
+ * Run a reader view callback until it has made a copy no writer published
+ * into, without taking s_alarm_lock. After ALARM_VIEW_READ_ATTEMPTS tries
+ * the callback runs under s_alarm_lock instead.
+ */
+static void mgos_alarm_view_read(alarm_view_read_cb cb, void *ctx){
+  //count the reader in before any view array is loaded
+  __atomic_add_fetch(&s_view.readers, 1, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for(int attempt = 1;; attempt++){
+    if(attempt > ALARM_VIEW_READ_ATTEMPTS){
+      __atomic_add_fetch(&s_stats.view_locked_reads, 1, __ATOMIC_RELAXED);
+      mgos_rlock(s_alarm_lock);
+      cb(ctx);
+      mgos_runlock(s_alarm_lock);
+      break;
+    }
+    uint32_t seq = __atomic_load_n(&s_view.seq, __ATOMIC_ACQUIRE);
+    if((seq & 1) == 0){
+      cb(ctx);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if(__atomic_load_n(&s_view.seq, __ATOMIC_RELAXED) == seq) break;
+    }
+    __atomic_add_fetch(&s_stats.view_retries, 1, __ATOMIC_RELAXED);
+  }
+  __atomic_sub_fetch(&s_view.readers, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Grow the alarm table, and the timing wheel (one entry per slot), to
+ * capacity slots
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_slots_grow(uint32_t capacity){
+  if(!mgos_alarm_wheel_reserve(&s_wheel, capacity)) return false;
+  if(!mgos_alarm_view_grow((void **) &s_view.slots, &s_view.slot_capacity, capacity,
+                           sizeof(*s_view.slots))) return false;
+  struct alarm_slot *slots = (struct alarm_slot *) mgos_alarm_realloc(s_alarm_table.slots,
+                                                                      capacity * sizeof(*slots));
+  if(slots == NULL) return false;
+  //chain the new slots, in order, onto the head of the free list
+  for(uint32_t i = s_alarm_table.capacity; i < capacity; i++){
+    slots[i].generation = 1;
+    slots[i].timer_gen = 0;
+    slots[i].used = false;
+    slots[i].next_free = (i + 1 < capacity) ? i + 1 : s_alarm_table.free_head;
+  }
+  s_alarm_table.free_head = s_alarm_table.capacity;
+  s_alarm_table.slots = slots;
+  s_alarm_table.capacity = capacity;
+  return true;
+}
+
+/*
+ * Ensure the alarm table has adding free slots, growing it if it was not
+ * reserved
+ * returns false if the table could not grow
+ */
+static bool mgos_alarm_slots_reserve(uint32_t adding){
+  //retired slots are not free until they are reclaimed
+  mgos_alarm_names_reclaim();
+  uint32_t needed = s_alarm_table.used + s_names_retired.slot_count + adding;
+  if(needed <= s_alarm_table.capacity) return true;
+  if(s_arena.base != NULL || needed > ALARM_HANDLE_INDEX_MASK + 1) return false;
+  uint32_t capacity = s_alarm_table.capacity < ALARM_TABLE_MIN_CAPACITY ?
+                      ALARM_TABLE_MIN_CAPACITY : s_alarm_table.capacity * 2;
+  while(capacity < needed) capacity *= 2;
+  if(capacity > ALARM_HANDLE_INDEX_MASK + 1) capacity = ALARM_HANDLE_INDEX_MASK + 1;
+  return mgos_alarm_slots_grow(capacity);
+}
+
+/*
+ * Take a slot from the alarm table free list, growing the table if
+ * required and it was not reserved
+ * returns ALARM_SLOT_NONE if the table could not grow
+ */
+static uint32_t mgos_alarm_slot_alloc(enum mgos_alarm_type type, uint32_t name_hash){
+  if(s_alarm_table.free_head == ALARM_SLOT_NONE && !mgos_alarm_slots_reserve(1)) return ALARM_SLOT_NONE;
+  uint32_t slot = s_alarm_table.free_head;
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  s_alarm_table.free_head = as->next_free;
+  as->type = type;
+  as->used = true;
+  as->name_hash = name_hash;
+  as->chatter = MGOS_ALARM_POOL_NONE;
+  as->expr = NULL;
+  as->expr_deps = MGOS_ALARM_POOL_NONE;
+  as->parent = ALARM_SLOT_NONE;
+  as->first_child = ALARM_SLOT_NONE;
+  as->next_sibling = ALARM_SLOT_NONE;
+  as->depth = 0;
+  as->name_block = NULL;
+  if(++s_alarm_table.used > s_alarm_table.high_water) s_alarm_table.high_water = s_alarm_table.used;
+  return slot;
+}
+
+/*
+ * Return a slot to the alarm table free list, invalidating its handles
+ */
+static void mgos_alarm_slot_free(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  as->used = false;
+  --s_alarm_table.used;
+  as->generation = (as->generation + 1) & ALARM_HANDLE_GENERATION_MASK;
+  if(as->generation == 0) as->generation = 1;
+  if(s_names != NULL){
+    //the slot's name storage may still be read by a waiting transition
+    as->next_free = s_names_retired.slots;
+    s_names_retired.slots = slot;
+    s_names_retired.slot_count++;
+    return;
+  }
+  as->next_free = s_alarm_table.free_head;
+  s_alarm_table.free_head = slot;
+}
+
+/*
+ * Returns the name to keep for an alarm added to slot, a copy in the slot's
+ * name storage if names are reserved, otherwise the caller's pointer
+ */
+static char *mgos_alarm_slot_name_store(uint32_t slot, char *name){
+  if(s_names == NULL) return name;
+  char *copy = &s_names[(size_t) slot * (s_capacity.name_len + 1)];
+  strcpy(copy, name);
+  return copy;
+}
+
+/*
+ * Drop a reference to the names of a loaded configuration, retiring them
+ * with the last
+ */
+static void mgos_alarm_name_block_release(struct alarm_name_block *block){
+  if(block == NULL || --block->refs > 0) return;
+  block->next = s_names_retired.blocks;
+  s_names_retired.blocks = block;
+}
+
+/*
+ * Free the retired name blocks, and return the retired slots to the free
+ * list, if no transition that may point to their names is buffered,
+ * queued or being dispatched, must be called with s_alarm_lock held.
+ * The queue is read before the drains as a drain is counted before it
+ * pops.
+ */
+static void mgos_alarm_names_reclaim(void){
+  if(s_names_retired.blocks == NULL && s_names_retired.slots == ALARM_SLOT_NONE) return;
+  if(s_event_buffer.count > 0 || __atomic_load_n(&s_event_buffer.flushing, __ATOMIC_SEQ_CST) ||
+     mgos_alarm_queue_depth(&s_queue) > 0 ||
+     __atomic_load_n(&s_names_retired.dispatching, __ATOMIC_SEQ_CST) > 0) return;
+  while(s_names_retired.blocks != NULL){
+    struct alarm_name_block *next = s_names_retired.blocks->next;
+    free(s_names_retired.blocks);
+    s_names_retired.blocks = next;
+  }
+  while(s_names_retired.slots != ALARM_SLOT_NONE){
+    uint32_t slot = s_names_retired.slots;
+    s_names_retired.slots = s_alarm_table.slots[slot].next_free;
+    s_alarm_table.slots[slot].next_free = s_alarm_table.free_head;
+    s_alarm_table.free_head = slot;
+  }
+  s_names_retired.slot_count = 0;
+}
+
+/*
+ * Returns the name of the alarm held by an alarm table slot
+ */
+static const char *mgos_alarm_slot_name(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  if(as->type == DIGITAL) return s_d_alarm_data.name[as->row];
+  return s_a_alarm_data.name[as->row];
+}
+
+/*
+ * FNV-1a hash of an alarm name
+ */
+static uint32_t mgos_alarm_hash(const char *name){
+  uint32_t hash = 2166136261u;
+  while(*name){
+    hash ^= (uint8_t) *name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*
+ * Find the index entry of the alarm with the passed name
+ * returns NULL if no alarm with this name exists
+ */
+static struct alarm_index_entry *mgos_alarm_index_find(const char *name, uint32_t hash){
+  if(s_alarm_index.capacity == 0) return NULL;
+  size_t mask = s_alarm_index.capacity - 1;
+  for(size_t i = hash & mask;; i = (i + 1) & mask){
+    struct alarm_index_entry *entry = &s_alarm_index.entries[i];
+    if(!entry->used){
+      if(!entry->tombstone) return NULL;
+      continue;
+    }
+    if(entry->hash == hash && strcmp(name, mgos_alarm_slot_name(entry->slot)) == 0) return entry;
+  }
+}
+
+/*
+ * Place an alarm into the first free entry of its probe sequence
+ */
+static void mgos_alarm_index_place(struct alarm_index_entry *entries, size_t capacity,
+                                   uint32_t hash, uint32_t slot){
+  size_t mask = capacity - 1;
+  size_t i = hash & mask;
+  while(entries[i].used) i = (i + 1) & mask;
+  entries[i].hash = hash;
+  entries[i].slot = slot;
+  entries[i].used = true;
+  entries[i].tombstone = false;
+}
+
+/*
+ * Rebuild the index with the passed capacity, dropping all tombstones
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_index_resize(size_t capacity){
+  struct alarm_index_entry *entries = s_alarm_index.spare;
+  if(entries != NULL){
+    //a reserved index never grows, it only sheds its tombstones
+    if(capacity != s_alarm_index.capacity) return false;
+    memset(entries, 0, capacity * sizeof(*entries));
+  }
+  else{
+    entries = mgos_alarm_calloc(capacity, sizeof(*entries), false);
+    if(entries == NULL) return false;
+  }
+  for(size_t i = 0; i < s_alarm_index.capacity; i++){
+    struct alarm_index_entry *entry = &s_alarm_index.entries[i];
+    if(entry->used) mgos_alarm_index_place(entries, capacity, entry->hash, entry->slot);
+  }
+  if(s_alarm_index.spare != NULL) s_alarm_index.spare = s_alarm_index.entries;
+  else free(s_alarm_index.entries);
+  s_alarm_index.entries = entries;
+  s_alarm_index.capacity = capacity;
+  s_alarm_index.tombstones = 0;
+  return true;
+}
+
+/*
+ * Ensure adding alarms can be inserted into the index without it being
+ * rebuilt, keeping the load factor (including tombstones) below 3/4
+ * returns false if the index could not grow
+ */
+static bool mgos_alarm_index_reserve(uint32_t adding){
+  if((s_alarm_index.used + s_alarm_index.tombstones + adding) * 4 <= s_alarm_index.capacity * 3) return true;
+  size_t capacity = s_alarm_index.capacity < ALARM_INDEX_MIN_CAPACITY ?
+                    ALARM_INDEX_MIN_CAPACITY : s_alarm_index.capacity;
+  while((s_alarm_index.used + adding) * 2 > capacity) capacity *= 2;
+  return mgos_alarm_index_resize(capacity);
+}
+
+/*
+ * Insert an alarm into the index, the caller must ensure the name is unique
+ * returns false if the index could not grow
+ */
+static bool mgos_alarm_index_insert(uint32_t hash, uint32_t slot){
+  if(!mgos_alarm_index_reserve(1)) return false;
+  mgos_alarm_index_place(s_alarm_index.entries, s_alarm_index.capacity, hash, slot);
+  ++s_alarm_index.used;
+  return true;
+}
+
+/*
+ * Remove an entry from the index, leaving a tombstone to keep probe
+ * sequences intact
+ */
+static void mgos_alarm_index_remove(struct alarm_index_entry *entry){
+  entry->used = false;
+  entry->tombstone = true;
+  --s_alarm_index.used;
+  ++s_alarm_index.tombstones;
+}
+
+/*
+ * static alarm table of mgos_alarm_init_static, its alarm with index i is
+ * held by alarm table slot i and is not in the name index
+ */
+static const struct mgos_alarm_static_table *s_static = NULL;
+
+/*
+ * Seeded mix of a name hash, the generator's perfect hash places the
+ * alarm hashing to hash at mix(hash, seeds[hash % seed_count]) % count
+ */
+static uint32_t mgos_alarm_static_mix(uint32_t hash, uint32_t seed){
+  uint32_t x = hash ^ (seed * 0x9e3779b9u);
+  x ^= x >> 16;
+  x *= 0x85ebca6bu;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35u;
+  x ^= x >> 16;
+  return x;
+}
+
+/*
+ * Find the slot of the static alarm with the passed name
+ * returns ALARM_SLOT_NONE if no static alarm with this name exists
+ */
+static uint32_t mgos_alarm_static_find(const char *name, uint32_t hash){
+  const struct mgos_alarm_static_table *table = s_static;
+  if(table == NULL || table->count == 0) return ALARM_SLOT_NONE;
+  uint32_t i = mgos_alarm_static_mix(hash, table->seeds[hash % table->seed_count]) % table->count;
+  //the slot is reused once the static alarm has been removed
+  if(!s_alarm_table.slots[i].used || mgos_alarm_slot_name(i) != table->defs[i].name) return ALARM_SLOT_NONE;
+  if(strcmp(name, table->defs[i].name) != 0) return ALARM_SLOT_NONE;
+  return i;
+}
+
+/*
+ * Look up the slot of the alarm with the passed name, static alarms by
+ * their perfect hash and the others by the name index
+ * returns ALARM_SLOT_NONE if no alarm with this name exists
+ */
+static uint32_t mgos_alarm_lookup(const char *name, uint32_t hash){
+  uint32_t slot = mgos_alarm_static_find(name, hash);
+  if(slot != ALARM_SLOT_NONE) return slot;
+  struct alarm_index_entry *entry = mgos_alarm_index_find(name, hash);
+  return entry == NULL ? ALARM_SLOT_NONE : entry->slot;
+}
+
+/*
+ * Register a new alarm in the alarm table and the name index, the caller
+ * fills in the slot's row
+ * returns the slot of the alarm or ALARM_SLOT_NONE if either could not grow
+ */
+static uint32_t mgos_alarm_register(enum mgos_alarm_type type, uint32_t hash){
+  uint32_t slot = mgos_alarm_slot_alloc(type, hash);
+  if(slot == ALARM_SLOT_NONE) return ALARM_SLOT_NONE;
+  if(!mgos_alarm_index_insert(hash, slot)){
+    mgos_alarm_slot_free(slot);
+    return ALARM_SLOT_NONE;
+  }
+  return slot;
+}
+
+/*
+ * Returns the next change sequence number, 0 is never used so that it can
+ * mean "every alarm" to mgos_list_alarm_changes
+ */
+static uint32_t mgos_alarm_next_seq(void){
+  if(++s_changes.seq == 0) s_changes.seq = 1;
+  return s_changes.seq;
+}
+
+/*
+ * Returns true if seq is later than since, allowing for wrap around
+ */
+static bool mgos_alarm_seq_after(uint32_t seq, uint32_t since){
+  return since == 0 || (int32_t) (seq - since) > 0;
+}
+
+/*
+ * Append a slot to the tail of the change list with a new sequence number
+ */
+static void mgos_alarm_change_link(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  as->seq = mgos_alarm_next_seq();
+  as->change_prev = s_changes.tail;
+  as->change_next = ALARM_SLOT_NONE;
+  if(s_changes.tail != ALARM_SLOT_NONE) s_alarm_table.slots[s_changes.tail].change_next = slot;
+  else s_changes.head = slot;
+  s_changes.tail = slot;
+}
+
+/*
+ * Remove a slot from the change list
+ */
+static void mgos_alarm_change_unlink(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  if(as->change_prev != ALARM_SLOT_NONE) s_alarm_table.slots[as->change_prev].change_next = as->change_next;
+  else s_changes.head = as->change_next;
+  if(as->change_next != ALARM_SLOT_NONE) s_alarm_table.slots[as->change_next].change_prev = as->change_prev;
+  else s_changes.tail = as->change_prev;
+}
+
+/*
+ * Returns expression dependency entry index
+ */
+static struct alarm_expr_dep *mgos_alarm_expr_dep(uint32_t index){
+  return MGOS_ALARM_POOL_ENTRY(&s_expr_deps, struct alarm_expr_dep, index);
+}
+
+/*
+ * Mark the expressions that refer to the alarm in a slot dirty
+ */
+static void mgos_alarm_expr_mark(uint32_t slot){
+  for(uint32_t index = s_alarm_table.slots[slot].expr_deps; index != MGOS_ALARM_POOL_NONE;){
+    struct alarm_expr_dep *dep = mgos_alarm_expr_dep(index);
+    if(!dep->expr->dirty){
+      dep->expr->dirty = true;
+      ++s_exprs.dirty;
+    }
+    index = dep->next;
+  }
+}
+
+/*
+ * Record a change to the alarm in a slot, moving it to the tail of the
+ * change list, the expressions that refer to it are marked dirty. Must be
+ * called with s_alarm_lock held.
+ */
+static void mgos_alarm_touch(uint32_t slot){
+  mgos_alarm_change_unlink(slot);
+  mgos_alarm_change_link(slot);
+  if(s_alarm_table.slots[slot].expr_deps != MGOS_ALARM_POOL_NONE) mgos_alarm_expr_mark(slot);
+}
+
+/*
+ * Cancel a pending digital alarm set/reset
+ */
+static void d_alarm_cancel_pending(uint32_t i) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  if(d->timer_id[i] != MGOS_INVALID_TIMER_ID){
+    mgos_alarm_clear_timer(d->timer_id[i]);
+    d->timer_id[i] = MGOS_INVALID_TIMER_ID;
+  }
+  mgos_alarm_wheel_cancel(&s_wheel, d->slot[i]);
+  d->pending_since[i] = ALARM_NOT_PENDING;
+  alarm_bit_set(d->pending, i, false);
+}
+
+/*
+ * Cancel a pending analog alarm transition
+ */
+static void a_alarm_cancel_pending(uint32_t i) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  if(a->timer_id[i] != MGOS_INVALID_TIMER_ID){
+    mgos_alarm_clear_timer(a->timer_id[i]);
+    a->timer_id[i] = MGOS_INVALID_TIMER_ID;
+  }
+  mgos_alarm_wheel_cancel(&s_wheel, a->slot[i]);
+  a->pending_state[i] = a->state[i];
+  a->pending_since[i] = ALARM_NOT_PENDING;
+  alarm_bit_set(a->pending, i, false);
+}
+
+/*
+ * Returns true if the alarm in a slot is masked by its parent
+ */
+static bool mgos_alarm_masked(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  return alarm_bit_get(as->type == DIGITAL ? s_d_alarm_data.masked : s_a_alarm_data.masked, as->row);
+}
+
+/*
+ * Returns true if the alarm in a slot masks its children, it is active or
+ * masked itself
+ */
+static bool mgos_alarm_masking(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  if(as->type == DIGITAL){
+    return alarm_bit_get(s_d_alarm_data.active, as->row) || alarm_bit_get(s_d_alarm_data.masked, as->row);
+  }
+  return s_a_alarm_data.state[as->row] != NOM || alarm_bit_get(s_a_alarm_data.masked, as->row);
+}
+
+/*
+ * Bring the parent bit of the alarm in a slot up to date with its children
+ */
+static void mgos_alarm_parent_update(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  bool parent = as->first_child != ALARM_SLOT_NONE;
+  alarm_bit_set(as->type == DIGITAL ? s_d_alarm_data.parent : s_a_alarm_data.parent, as->row, parent);
+}
+
+static void mgos_a_alarm_classify_row(uint32_t i, int64_t now);
+
+/*
+ * Mask or unmask the alarm in a slot. A masked alarm's pending transition
+ * is cancelled and the scan skips it, an unmasked one is marked dirty so
+ * that the next pass evaluates it. When polling an unmasked analog alarm
+ * is classified here, as the pass may have classified the PVs while it
+ * was masked.
+ */
+static void mgos_alarm_mask(uint32_t slot, bool masked){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  uint32_t i = as->row;
+  if(as->type == DIGITAL){
+    struct d_alarm_data *d = &s_d_alarm_data;
+    alarm_bit_set(d->masked, i, masked);
+    if(masked) d_alarm_cancel_pending(i);
+    else alarm_bit_set(d->dirty, i, true);
+  }
+  else{
+    struct a_alarm_data *a = &s_a_alarm_data;
+    alarm_bit_set(a->masked, i, masked);
+    if(masked) a_alarm_cancel_pending(i);
+    else{
+      alarm_bit_set(a->dirty, i, true);
+      if(s_eval_mode == MGOS_ALARM_EVAL_POLL) mgos_a_alarm_classify_row(i, mgos_uptime_micros() / 1000);
+    }
+  }
+  if(masked) ++s_stats.masked;
+  else mgos_alarm_wake();
+}
+
+/*
+ * Bring the descendants of the alarm in root up to date after its masking
+ * changed. Each child is masked as its parent masks, and a subtree is only
+ * entered if its alarm's masking changed, so the walk visits the alarms
+ * affected and their siblings. It follows the slots' links, no stack is
+ * needed.
+ * first_out - if not NULL, updated to the alarm masked here that was
+ *   already active and changed before the others, and before *first_out
+ * returns the number of alarms masked
+ */
+static uint32_t mgos_alarm_suppress_propagate(uint32_t root, uint32_t *first_out){
+  struct alarm_slot *slots = s_alarm_table.slots;
+  uint32_t masked = 0;
+  uint32_t s = slots[root].first_child;
+  while(s != ALARM_SLOT_NONE){
+    bool mask = mgos_alarm_masking(slots[s].parent);
+    if(mask != mgos_alarm_masked(s)){
+      bool masking = mgos_alarm_masking(s);
+      mgos_alarm_mask(s, mask);
+      if(mask){
+        ++masked;
+        if(masking && first_out != NULL && mgos_alarm_seq_after(slots[*first_out].seq, slots[s].seq)){
+          *first_out = s;
+        }
+      }
+      //an active alarm already masked its children
+      if(mgos_alarm_masking(s) != masking && slots[s].first_child != ALARM_SLOT_NONE){
+        s = slots[s].first_child;
+        continue;
+      }
+    }
+    //the next sibling, or that of the nearest ancestor below root
+    while(s != root && slots[s].next_sibling == ALARM_SLOT_NONE) s = slots[s].parent;
+    s = (s == root) ? ALARM_SLOT_NONE : slots[s].next_sibling;
+  }
+  return masked;
+}
+
+/*
+ * Set the depth of the alarm in root after it was relinked, and that of
+ * each of its descendants from its parent's, in the same walk as
+ * mgos_alarm_suppress_propagate
+ */
+static void mgos_alarm_suppress_depth(uint32_t root, uint32_t depth){
+  struct alarm_slot *slots = s_alarm_table.slots;
+  slots[root].depth = depth;
+  uint32_t s = slots[root].first_child;
+  while(s != ALARM_SLOT_NONE){
+    slots[s].depth = slots[slots[s].parent].depth + 1;
+    if(slots[s].first_child != ALARM_SLOT_NONE){
+      s = slots[s].first_child;
+      continue;
+    }
+    while(s != root && slots[s].next_sibling == ALARM_SLOT_NONE) s = slots[s].parent;
+    s = (s == root) ? ALARM_SLOT_NONE : slots[s].next_sibling;
+  }
+}
+
+/*
+ * Bring the children of the alarm in a slot up to date after its state
+ * changed at time_ms, recording the cascade it starts or ending the one it
+ * heads
+ */
+static void mgos_alarm_suppress_changed(uint32_t slot, int64_t time_ms){
+  if(s_alarm_table.slots[slot].first_child == ALARM_SLOT_NONE) return;
+  uint32_t first_out = slot;
+  uint32_t masked = mgos_alarm_suppress_propagate(slot, &first_out);
+  mgos_alarm_handle_t handle = mgos_alarm_handle(slot);
+  if(masked > 0 && !mgos_alarm_masked(slot)){
+    s_first_out.first_out = mgos_alarm_handle(first_out);
+    s_first_out.parent = handle;
+    s_first_out.time_ms = time_ms;
+    s_first_out.masked = masked;
+    s_first_out.active = true;
+    ++s_stats.cascades;
+  }
+  else if(s_first_out.parent == handle && !mgos_alarm_masking(slot)){
+    s_first_out.active = false;
+  }
+}
+
+/*
+ * Unlink the alarm in a slot from its parent's children, it keeps its mask
+ */
+static void mgos_alarm_suppress_unlink(uint32_t slot){
+  struct alarm_slot *slots = s_alarm_table.slots;
+  struct alarm_slot *as = &slots[slot];
+  if(as->parent == ALARM_SLOT_NONE) return;
+  uint32_t *link = &slots[as->parent].first_child;
+  while(*link != slot) link = &slots[*link].next_sibling;
+  *link = as->next_sibling;
+  mgos_alarm_parent_update(as->parent);
+  as->parent = ALARM_SLOT_NONE;
+  as->next_sibling = ALARM_SLOT_NONE;
+}
+
+/*
+ * Take the alarm in a slot out of the suppression graph, its children are
+ * detached and unmasked
+ */
+static void mgos_alarm_suppress_remove(uint32_t slot){
+  struct alarm_slot *slots = s_alarm_table.slots;
+  struct alarm_slot *as = &slots[slot];
+  mgos_alarm_suppress_unlink(slot);
+  while(as->first_child != ALARM_SLOT_NONE){
+    uint32_t child = as->first_child;
+    as->first_child = slots[child].next_sibling;
+    slots[child].parent = ALARM_SLOT_NONE;
+    slots[child].next_sibling = ALARM_SLOT_NONE;
+    mgos_alarm_suppress_depth(child, 0);
+    if(mgos_alarm_masked(child)){
+      bool masking = mgos_alarm_masking(child);
+      mgos_alarm_mask(child, false);
+      if(mgos_alarm_masking(child) != masking) mgos_alarm_suppress_propagate(child, NULL);
+    }
+  }
+  mgos_alarm_parent_update(slot);
+  if(s_first_out.parent == mgos_alarm_handle(slot)) s_first_out.active = false;
+}
+
+/*
+ * Check the setpoints are ordered ll_sv < l_sv < h_sv < hh_sv, unused (NAN)
+ * setpoints are skipped. NAN never compares equal so isnan is used.
+ * returns NULL if they are valid, otherwise why they are not
+ */
+static const char *mgos_alarm_sv_check(float ll_sv, float l_sv, float h_sv, float hh_sv){
+  float tf = NAN;
+  float arr[] = {ll_sv, l_sv, h_sv, hh_sv};
+  for(int i = 0; i < 4; i++){
+    if(!isnan(arr[i])){
+      if(!isnan(tf) && tf > arr[i]) return "due to invalid sv values";
+      tf = arr[i];
+    }
+  }
+  if(isnan(tf)) return "as all sv values NAN";
+  return NULL;
+}
+
+/*
+ * Append an alarm held by slot to the analog table
+ */
+static void a_alarm_append(uint32_t slot, bool enabled, float *pv, float ll_sv, float l_sv,
+                           float h_sv, float hh_sv, int set_interval, char *name){
+  struct a_alarm_data *a = &s_a_alarm_data;
+  uint32_t i = a->count++;
+  alarm_bit_set(a->enabled, i, enabled);
+  alarm_bit_set(a->dirty, i, true);
+  alarm_bit_set(a->pending, i, false);
+  alarm_bit_set(a->sampled, i, false);
+  alarm_bit_set(a->masked, i, false);
+  alarm_bit_set(a->parent, i, false);
+  a->pv[i] = pv;
+  a->ll_sv[i] = ll_sv;
+  a->l_sv[i] = l_sv;
+  a->h_sv[i] = h_sv;
+  a->hh_sv[i] = hh_sv;
+  a->state[i] = NOM;
+  a->pending_state[i] = NOM;
+  a->set_interval[i] = set_interval;
+  a->timer_id[i] = MGOS_INVALID_TIMER_ID;
+  a->pending_since[i] = ALARM_NOT_PENDING;
+  a->name[i] = name;
+  a->slot[i] = slot;
+  a->pv_sample[i] = NAN;
+  a->kind[i] = A_ALARM_PV;
+  a->ext[i] = MGOS_ALARM_POOL_NONE;
+  a->deadband[i] = 0;
+  s_alarm_table.slots[slot].row = i;
+  mgos_alarm_change_link(slot);
+  a_alarm_publish(i);
+}
+
+/*
+ * Append an alarm held by slot to the digital table
+ */
+static void d_alarm_append(uint32_t slot, bool enabled, bool *input, enum mgos_d_alarm_mode mode,
+                           int set_interval, int reset_interval, char *name){
+  struct d_alarm_data *d = &s_d_alarm_data;
+  uint32_t i = d->count++;
+  alarm_bit_set(d->enabled, i, enabled);
+  alarm_bit_set(d->active, i, false);
+  alarm_bit_set(d->mode, i, mode == ACTIVE_HIGH);
+  alarm_bit_set(d->dirty, i, true);
+  alarm_bit_set(d->pending, i, false);
+  alarm_bit_set(d->edge, i, false);
+  alarm_bit_set(d->level, i, false);
+  alarm_bit_set(d->masked, i, false);
+  alarm_bit_set(d->parent, i, false);
+  d->input[i] = input;
+  d->set_interval[i] = set_interval;
+  d->reset_interval[i] = reset_interval;
+  d->timer_id[i] = MGOS_INVALID_TIMER_ID;
+  d->pending_since[i] = ALARM_NOT_PENDING;
+  d->name[i] = name;
+  d->slot[i] = slot;
+  s_alarm_table.slots[slot].row = i;
+  mgos_alarm_change_link(slot);
+  d_alarm_publish(i);
+}
+
+/*
+ * Convert an engineering unit setpoint of a raw alarm into counts, rounded
+ * so that comparing counts gives the band comparing raw * scale + offset
+ * would. ge is set for the h and hh setpoints, which match counts at or
+ * above them.
+ * returns false if the setpoint is unused or no count can match it
+ */
+static bool a_alarm_raw_sv(float sv, const struct a_alarm_raw *raw, bool ge, int32_t *count){
+  if(isnan(sv)) return false;
+  double x = ((double) sv - raw->offset) / raw->scale;
+  x = ge ? ceil(x) : floor(x);
+  if(ge ? x > INT32_MAX : x < INT32_MIN) return false;
+  *count = (int32_t) (x < INT32_MIN ? INT32_MIN : (x > INT32_MAX ? INT32_MAX : x));
+  return true;
+}
+
+/*
+ * Returns the pool holding the state of an analog alarm kind, NULL if
+ * the kind has none
+ */
+static struct mgos_alarm_pool *a_alarm_kind_pool(uint8_t kind){
+  switch(kind){
+    case A_ALARM_RAW:
+      return &s_raw_alarms;
+    case A_ALARM_RATE:
+    case A_ALARM_DEVIATION:
+      return &s_derived_alarms;
+    case A_ALARM_WINDOW:
+      return &s_window_alarms;
+    default:
+      return NULL;
+  }
+}
+
+/*
+ * Returns true if the value of an analog alarm kind depends on the PV's
+ * history, so that the kind is sampled every pass
+ */
+static bool a_alarm_kind_sampled(uint8_t kind){
+  return kind == A_ALARM_RATE || kind == A_ALARM_DEVIATION || kind == A_ALARM_WINDOW;
+}
+
+/*
+ * Take a pool entry for the kind of an alarm being added, must be called
+ * with s_alarm_lock held
+ * returns MGOS_ALARM_POOL_NONE if memory could not be allocated
+ */
+static uint32_t a_alarm_ext_alloc(struct mgos_alarm_pool *pool){
+  if(pool->free_head == MGOS_ALARM_POOL_NONE) ++s_stats.allocs;
+  return mgos_alarm_pool_alloc(pool);
+}
+
+/*
+ * Return the pool entry of analog row i, if its kind has one
+ */
+static void a_alarm_ext_free(uint32_t i){
+  struct a_alarm_data *a = &s_a_alarm_data;
+  struct mgos_alarm_pool *pool = a_alarm_kind_pool(a->kind[i]);
+  if(a->kind[i] == A_ALARM_WINDOW){
+    mgos_alarm_window_free(MGOS_ALARM_POOL_ENTRY(pool, struct mgos_alarm_window, a->ext[i]));
+  }
+  if(pool != NULL) mgos_alarm_pool_free(pool, a->ext[i]);
+  a->kind[i] = A_ALARM_PV;
+  a->ext[i] = MGOS_ALARM_POOL_NONE;
+  alarm_bit_set(a->sampled, i, false);
+}
+
+/*
+ * Restart the history of a rate, deviation or window alarm, its value is
+ * NAN until it has been sampled again
+ */
+static void a_alarm_history_restart(uint32_t i){
+  struct a_alarm_data *a = &s_a_alarm_data;
+  if(!a_alarm_kind_sampled(a->kind[i])) return;
+  if(a->kind[i] == A_ALARM_WINDOW){
+    mgos_alarm_window_clear(MGOS_ALARM_POOL_ENTRY(&s_window_alarms, struct mgos_alarm_window, a->ext[i]));
+  }
+  else{
+    struct a_alarm_derived *der = MGOS_ALARM_POOL_ENTRY(&s_derived_alarms, struct a_alarm_derived, a->ext[i]);
+    der->primed = false;
+    der->value = NAN;
+  }
+  a->pv_sample[i] = NAN;
+}
+
+/*
+ * Add an analog alarm of the passed kind to the analog alarm table, ext
+ * is copied into the kind's pool entry if the kind has one
+ *
+ */
+static mgos_alarm_handle_t add_a_alarm(bool enabled, float *pv, float ll_sv, float l_sv,
+                                       float h_sv, float hh_sv, int set_interval,
+                                       char *name, enum a_alarm_kind kind, const void *ext_init){
+  //ensure the name is not null
+  if(name == NULL){
+    LOG(LL_ERROR, ("Analog alarm failed to init as name is NULL"));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure the name is not empty
+  if(strcmp(name, "") == 0){
+    LOG(LL_ERROR, ("Analog alarm failed to init as name is empty"));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure the alarm sv levels are set correctly ll_sv < l_sv < h_sv < hh_sv
+  const char *sv_error = mgos_alarm_sv_check(ll_sv, l_sv, h_sv, hh_sv);
+  if(sv_error != NULL){
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init %s", strlen(name) , name, sv_error));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure the name fits the name storage reserved by mgos_alarm_init_ex
+  if(s_names != NULL && strlen(name) > s_capacity.name_len){
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as name is longer than %u", strlen(name) , name,
+                   (unsigned) s_capacity.name_len));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //look the name up in the index to ensure that the alarm has a unique name
+  uint32_t hash = mgos_alarm_hash(name);
+  mgos_rlock(s_alarm_lock);
+  if(mgos_alarm_lookup(name, hash) != ALARM_SLOT_NONE){
+    mgos_runlock(s_alarm_lock);
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as name is not unique", strlen(name) , name));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure the table and the event buffer have room for the alarm
+  if(!a_alarm_reserve(1) || !mgos_alarm_event_reserve(1)){
+    mgos_runlock(s_alarm_lock);
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as %s", strlen(name) , name,
+                   s_arena.base != NULL ? "its reserved capacity is full" : "allocated memory returned NULL"));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //kinds with more state than the table's columns keep it in their pool
+  struct mgos_alarm_pool *pool = a_alarm_kind_pool(kind);
+  uint32_t ext = MGOS_ALARM_POOL_NONE;
+  if(pool != NULL){
+    ext = a_alarm_ext_alloc(pool);
+    if(ext == MGOS_ALARM_POOL_NONE){
+      mgos_runlock(s_alarm_lock);
+      LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as allocated memory returned NULL", strlen(name) , name));
+      return MGOS_ALARM_INVALID_HANDLE;
+    }
+    memcpy(MGOS_ALARM_POOL_ENTRY(pool, uint8_t, ext), ext_init, pool->entry_size);
+  }
+  //add the alarm to the alarm table and name index
+  uint32_t slot = mgos_alarm_register(ANALOG, hash);
+  if(slot == ALARM_SLOT_NONE){
+    if(pool != NULL) mgos_alarm_pool_free(pool, ext);
+    mgos_runlock(s_alarm_lock);
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as the alarm table could not grow", strlen(name) , name));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure that the set interval is at least 0ms
+  if(set_interval < 0) set_interval = 0;
+  a_alarm_append(slot, enabled, pv, ll_sv, l_sv, h_sv, hh_sv, set_interval,
+                 mgos_alarm_slot_name_store(slot, name));
+  uint32_t i = s_a_alarm_data.count - 1;
+  s_a_alarm_data.kind[i] = kind;
+  s_a_alarm_data.ext[i] = ext;
+  alarm_bit_set(s_a_alarm_data.sampled, i, a_alarm_kind_sampled(kind));
+  mgos_alarm_wake();
+  LOG(LL_INFO, ("Analog alarm \"%*s\" has been added", strlen(name) , name));
+  mgos_runlock(s_alarm_lock);
+  return mgos_alarm_handle(slot);
+}
+
+/*
+ * Add a digital alarm to the digital alarm table
+ *
+ */
+static mgos_alarm_handle_t add_d_alarm(bool enabled, bool *input, enum mgos_d_alarm_mode mode,
+                                       int set_interval, int reset_interval, char *name){
+  //ensure the name is not null
+  if(name == NULL){
+    LOG(LL_ERROR, ("Digital alarm failed to init as name is NULL"));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure the name is not empty
+  if(strcmp(name, "") == 0){
+    LOG(LL_ERROR, ("Digital alarm failed to init as name is empty"));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure the name fits the name storage reserved by mgos_alarm_init_ex
+  if(s_names != NULL && strlen(name) > s_capacity.name_len){
+    LOG(LL_ERROR, ("Digital alarm \"%*s\" failed to init as name is longer than %u", strlen(name) , name,
+                   (unsigned) s_capacity.name_len));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //look the name up in the index to ensure that the alarm has a unique name
+  uint32_t hash = mgos_alarm_hash(name);
+  mgos_rlock(s_alarm_lock);
+  if(mgos_alarm_lookup(name, hash) != ALARM_SLOT_NONE){
+    mgos_runlock(s_alarm_lock);
+    LOG(LL_ERROR, ("Digital alarm \"%*s\" failed to init as an alarm with this name already exists", strlen(name) , name));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure the table and the event buffer have room for the alarm
+  if(!d_alarm_reserve(1) || !mgos_alarm_event_reserve(1)){
+    mgos_runlock(s_alarm_lock);
+    LOG(LL_ERROR, ("Digital alarm \"%*s\" failed to init as %s", strlen(name) , name,
+                   s_arena.base != NULL ? "its reserved capacity is full" : "allocated memory returned NULL"));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //add the alarm to the alarm table and name index
+  uint32_t slot = mgos_alarm_register(DIGITAL, hash);
+  if(slot == ALARM_SLOT_NONE){
+    mgos_runlock(s_alarm_lock);
+    LOG(LL_ERROR, ("Digital alarm \"%*s\" failed to init as the alarm table could not grow", strlen(name) , name));
+    return MGOS_ALARM_INVALID_HANDLE;
+  }
+  //ensure that the set & reset intervals are at least 0ms
+  if(set_interval < 0) set_interval = 0;
+  if(reset_interval < 0) reset_interval = 0;
+  d_alarm_append(slot, enabled, input, mode, set_interval, reset_interval,
+                 mgos_alarm_slot_name_store(slot, name));
+  mgos_alarm_wake();
+  LOG(LL_INFO, ("Digital alarm \"%*s\" has been added", strlen(name) , name));
+  mgos_runlock(s_alarm_lock);
+  return mgos_alarm_handle(slot);
+}
+
+/*
+ * Look up the alarm table slot of the alarm with the passed name,
+ * must be called with s_alarm_lock held
+ * returns ALARM_SLOT_NONE if the alarm does not exist
+ */
+static uint32_t mgos_alarm_find_slot(const char *name){
+  if(name == NULL) return ALARM_SLOT_NONE;
+  uint32_t slot = mgos_alarm_lookup(name, mgos_alarm_hash(name));
+  if(slot == ALARM_SLOT_NONE){
+    LOG(LL_INFO, ("Alarm \"%*s\" does not exist", strlen(name) , name));
+  }
+  return slot;
+}
+
+/*
+ * Unlatch and restart the chatter detection of the alarm held by slot, if
+ * it has any, after it was reset or disabled and so is back in NOM or
+ * inactive without an event
+ */
+static void chatter_restart_slot(uint32_t slot){
+  uint32_t index = s_alarm_table.slots[slot].chatter;
+  if(index != MGOS_ALARM_POOL_NONE) mgos_alarm_chatter_restart(&s_chatter, index, mgos_uptime_micros() / 1000);
+}
+
+/*
+ * Free the chatter detection of the alarm held by slot, if it has any
+ */
+static void chatter_free_slot(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  if(as->chatter == MGOS_ALARM_POOL_NONE) return;
+  mgos_alarm_chatter_free(&s_chatter, as->chatter);
+  as->chatter = MGOS_ALARM_POOL_NONE;
+}
+
+/*
+ * Add an expression to the dependency lists of the alarms it refers to,
+ * once per alarm
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_expr_link(struct mgos_alarm_expr *expr){
+  for(uint32_t r = 0; r < expr->num_refs; r++){
+    uint32_t slot = mgos_alarm_handle_slot(expr->refs[r].handle);
+    bool linked = (slot == ALARM_SLOT_NONE);
+    for(uint32_t k = 0; k < r && !linked; k++) linked = (expr->refs[k].handle == expr->refs[r].handle);
+    if(linked) continue;
+    if(s_expr_deps.free_head == MGOS_ALARM_POOL_NONE) ++s_stats.allocs;
+    uint32_t index = mgos_alarm_pool_alloc(&s_expr_deps);
+    if(index == MGOS_ALARM_POOL_NONE) return false;
+    struct alarm_expr_dep *dep = mgos_alarm_expr_dep(index);
+    dep->expr = expr;
+    dep->next = s_alarm_table.slots[slot].expr_deps;
+    s_alarm_table.slots[slot].expr_deps = index;
+  }
+  return true;
+}
+
+/*
+ * Take an expression off the dependency lists of the alarms it refers to
+ */
+static void mgos_alarm_expr_unlink(struct mgos_alarm_expr *expr){
+  for(uint32_t r = 0; r < expr->num_refs; r++){
+    uint32_t slot = mgos_alarm_handle_slot(expr->refs[r].handle);
+    if(slot == ALARM_SLOT_NONE) continue;
+    uint32_t *link = &s_alarm_table.slots[slot].expr_deps;
+    while(*link != MGOS_ALARM_POOL_NONE && mgos_alarm_expr_dep(*link)->expr != expr){
+      link = &mgos_alarm_expr_dep(*link)->next;
+    }
+    //an alarm referred to twice is only listed once
+    if(*link == MGOS_ALARM_POOL_NONE) continue;
+    uint32_t index = *link;
+    *link = mgos_alarm_expr_dep(index)->next;
+    mgos_alarm_pool_free(&s_expr_deps, index);
+  }
+}
+
+/*
+ * Free the expression of an expression alarm held by slot, and the list of
+ * the expressions that refer to the alarm, which are marked dirty as their
+ * references to it now read false
+ */
+static void mgos_alarm_expr_remove(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  struct mgos_alarm_expr *expr = as->expr;
+  if(expr != NULL){
+    mgos_alarm_expr_unlink(expr);
+    //keep the order topological
+    uint32_t k = 0;
+    while(s_exprs.order[k] != expr) k++;
+    memmove(&s_exprs.order[k], &s_exprs.order[k + 1], (s_exprs.count - k - 1) * sizeof(*s_exprs.order));
+    --s_exprs.count;
+    if(expr->dirty) --s_exprs.dirty;
+    if(expr->inputs) --s_exprs.inputs;
+    mgos_alarm_expr_free(expr);
+    as->expr = NULL;
+  }
+  if(as->expr_deps != MGOS_ALARM_POOL_NONE){
+    mgos_alarm_expr_mark(slot);
+    while(as->expr_deps != MGOS_ALARM_POOL_NONE){
+      uint32_t index = as->expr_deps;
+      as->expr_deps = mgos_alarm_expr_dep(index)->next;
+      mgos_alarm_pool_free(&s_expr_deps, index);
+    }
+    mgos_alarm_wake();
+  }
+}
+
+/*
+ * Remove the alarm held by an alarm table slot,
+ * must be called with s_alarm_lock held
+ */
+static void remove_slot(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  const char *name = mgos_alarm_slot_name(slot);
+  //the index is searched by name so remove the entry before the row moves,
+  //static alarms have no entry
+  struct alarm_index_entry *entry = mgos_alarm_index_find(name, as->name_hash);
+  if(entry != NULL) mgos_alarm_index_remove(entry);
+  mgos_alarm_change_unlink(slot);
+  s_changes.removed_seq = mgos_alarm_next_seq();
+  chatter_free_slot(slot);
+  mgos_alarm_expr_remove(slot);
+  mgos_alarm_suppress_remove(slot);
+  if(as->type == DIGITAL){
+    //a pending set/reset timer must not fire on the removed alarm
+    d_alarm_cancel_pending(as->row);
+    LOG(LL_INFO, ("Digital alarm \"%*s\" has been removed", strlen(name) , name));
+    d_alarm_swap_remove(as->row);
+    if(as->row < s_d_alarm_data.count){
+      s_alarm_table.slots[s_d_alarm_data.slot[as->row]].row = as->row;
+    }
+  }
+  else{
+    //a pending transition timer must not fire on the removed alarm
+    a_alarm_cancel_pending(as->row);
+    a_alarm_ext_free(as->row);
+    LOG(LL_INFO, ("Analog alarm \"%*s\" has been removed", strlen(name) , name));
+    a_alarm_swap_remove(as->row);
+    if(as->row < s_a_alarm_data.count){
+      s_alarm_table.slots[s_a_alarm_data.slot[as->row]].row = as->row;
+    }
+  }
+  mgos_alarm_view_remove(slot, as->type, as->row);
+  mgos_alarm_name_block_release(as->name_block);
+  mgos_alarm_slot_free(slot);
+  mgos_alarm_names_reclaim();
+}
+
+/*
+ * Enable or disable the alarm held by an alarm table slot,
+ * disabling an alarm also clears its state
+ */
+static void enable_slot(uint32_t slot, bool enabled){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  uint32_t i = as->row;
+  mgos_alarm_touch(slot);
+  if(as->type == DIGITAL){
+    struct d_alarm_data *d = &s_d_alarm_data;
+    if(!enabled){
+      alarm_bit_set(d->active, i, false);
+      d_alarm_cancel_pending(i);
+      chatter_restart_slot(slot);
+    }
+    alarm_bit_set(d->enabled, i, enabled);
+    alarm_bit_set(d->dirty, i, true);
+    d_alarm_publish(i);
+    LOG(LL_INFO, ("Digital alarm \"%*s\" has been %s", strlen(d->name[i]), d->name[i],
+                  enabled ? "enabled" : "disabled"));
+  }
+  else{
+    struct a_alarm_data *a = &s_a_alarm_data;
+    if(!enabled){
+      a->state[i] = NOM;
+      a_alarm_cancel_pending(i);
+      a_alarm_history_restart(i);
+      chatter_restart_slot(slot);
+    }
+    alarm_bit_set(a->enabled, i, enabled);
+    alarm_bit_set(a->dirty, i, true);
+    a_alarm_publish(i);
+    LOG(LL_INFO, ("Analog alarm \"%*s\" has been %s", strlen(a->name[i]), a->name[i],
+                  enabled ? "enabled" : "disabled"));
+  }
+  if(!enabled) mgos_alarm_suppress_changed(slot, mgos_uptime_micros() / 1000);
+  mgos_alarm_wake();
+}
+
+/*
+ * Reset the alarm held by an alarm table slot
+ */
+static void reset_slot(uint32_t slot){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  uint32_t i = as->row;
+  mgos_alarm_touch(slot);
+  chatter_restart_slot(slot);
+  if(as->type == DIGITAL){
+    struct d_alarm_data *d = &s_d_alarm_data;
+    alarm_bit_set(d->active, i, false);
+    d_alarm_cancel_pending(i);
+    alarm_bit_set(d->dirty, i, true);
+    d_alarm_publish(i);
+    LOG(LL_INFO, ("Digital alarm \"%*s\" has been reset", strlen(d->name[i]), d->name[i]));
+  }
+  else{
+    struct a_alarm_data *a = &s_a_alarm_data;
+    a->state[i] = NOM;
+    a_alarm_cancel_pending(i);
+    a_alarm_history_restart(i);
+    alarm_bit_set(a->dirty, i, true);
+    a_alarm_publish(i);
+    LOG(LL_INFO, ("Analog alarm \"%*s\" has been reset", strlen(a->name[i]), a->name[i]));
+  }
+  mgos_alarm_suppress_changed(slot, mgos_uptime_micros() / 1000);
+  mgos_alarm_wake();
+}
+
+/*
+ * Copy the state of the alarm held by an alarm table slot into info
+ */
+static void get_slot_state(uint32_t slot, struct alarm_info *info){
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  uint32_t i = as->row;
+  info->type = as->type;
+  if(as->type == DIGITAL){
+    info->name = s_d_alarm_data.name[i];
+    info->enabled = alarm_bit_get(s_d_alarm_data.enabled, i);
+    info->state.d_state = alarm_bit_get(s_d_alarm_data.active, i);
+  }
+  else{
+    info->name = s_a_alarm_data.name[i];
+    info->enabled = alarm_bit_get(s_a_alarm_data.enabled, i);
+    info->state.a_state = (enum mgos_a_alarm_state) s_a_alarm_data.state[i];
+  }
+}
+
+/*
+ * Slot operations selected by the public name and handle entry points
+ */
+enum alarm_slot_op{
+  ALARM_OP_REMOVE,
+  ALARM_OP_ENABLE,
+  ALARM_OP_DISABLE,
+  ALARM_OP_RESET
+};
+
+/*
+ * Apply an operation to an alarm table slot,
+ * must be called with s_alarm_lock held
+ * returns false if slot is ALARM_SLOT_NONE
+ */
+static bool mgos_alarm_slot_op(uint32_t slot, enum alarm_slot_op op){
+  if(slot == ALARM_SLOT_NONE) return false;
+  switch(op){
+    case ALARM_OP_REMOVE:
+      remove_slot(slot);
+      break;
+    case ALARM_OP_ENABLE:
+      enable_slot(slot, true);
+      break;
+    case ALARM_OP_DISABLE:
+      enable_slot(slot, false);
+      break;
+    case ALARM_OP_RESET:
+      reset_slot(slot);
+      break;
+  }
+  return true;
+}
+
+/*
+ * Apply an operation to the alarm with the passed name and record its timing
+ */
+static bool mgos_alarm_name_op(const char *name, enum alarm_slot_op op,
+                               struct mgos_alarm_op_stats *op_stats){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_rlock(s_alarm_lock);
+  bool res = mgos_alarm_slot_op(mgos_alarm_find_slot(name), op);
+  mgos_runlock(s_alarm_lock);
+  mgos_alarm_op_done(op_stats, start_us);
+  return res;
+}
+
+/*
+ * Apply an operation to the alarm with the passed handle and record its timing
+ */
+static bool mgos_alarm_handle_op(mgos_alarm_handle_t handle, enum alarm_slot_op op,
+                                 struct mgos_alarm_op_stats *op_stats){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_rlock(s_alarm_lock);
+  bool res = mgos_alarm_slot_op(mgos_alarm_handle_slot(handle), op);
+  mgos_runlock(s_alarm_lock);
+  mgos_alarm_op_done(op_stats, start_us);
+  return res;
+}
+
+/*
+ * Public entry points, timed for mgos_alarm_get_stats
+ */
+mgos_alarm_handle_t mgos_add_a_alarm_h(bool enabled, float *pv, float ll_sv, float l_sv,
+                                       float h_sv, float hh_sv, int set_interval,
+                                       char *name){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_alarm_handle_t handle = MGOS_ALARM_INVALID_HANDLE;
+  if(pv == NULL){
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as pv is NULL", name == NULL ? 0 : strlen(name),
+                   name == NULL ? "" : name));
+  }
+  else handle = add_a_alarm(enabled, pv, ll_sv, l_sv, h_sv, hh_sv, set_interval, name, A_ALARM_PV, NULL);
+  mgos_alarm_op_done(&s_stats.add, start_us);
+  return handle;
+}
+
+/*
+ * Add an A_ALARM_RAW alarm on raw16 or raw32, converting its setpoints to
+ * counts once here
+ */
+static mgos_alarm_handle_t add_raw_alarm(bool enabled, const int16_t *raw16, const int32_t *raw32,
+                                         float scale, float offset, float ll_sv, float l_sv,
+                                         float h_sv, float hh_sv, int set_interval, char *name){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_alarm_handle_t handle = MGOS_ALARM_INVALID_HANDLE;
+  //ensure counts rise with the engineering value so the bands keep their order
+  if(!(scale > 0) || isinf(scale) || !isfinite(offset)){
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as scale must be above 0", 
+                   name == NULL ? 0 : strlen(name), name == NULL ? "" : name));
+  }
+  else{
+    struct a_alarm_raw raw;
+    memset(&raw, 0, sizeof(raw));
+    raw.raw16 = raw16;
+    raw.raw32 = raw32;
+    raw.scale = scale;
+    raw.offset = offset;
+    const float sv[] = {ll_sv, l_sv, h_sv, hh_sv};
+    for(int k = 0; k < 4; k++){
+      if(a_alarm_raw_sv(sv[k], &raw, k >= 2, &raw.sv[k])) raw.sv_used |= 1 << k;
+    }
+    handle = add_a_alarm(enabled, NULL, ll_sv, l_sv, h_sv, hh_sv, set_interval, name, A_ALARM_RAW, &raw);
+  }
+  mgos_alarm_op_done(&s_stats.add, start_us);
+  return handle;
+}
+
+mgos_alarm_handle_t mgos_add_raw_alarm_h(bool enabled, const int32_t *raw, float scale, float offset,
+                                         float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                         int set_interval, char *name){
+  if(raw == NULL) return MGOS_ALARM_INVALID_HANDLE;
+  return add_raw_alarm(enabled, NULL, raw, scale, offset, ll_sv, l_sv, h_sv, hh_sv, set_interval, name);
+}
+
+mgos_alarm_handle_t mgos_add_raw16_alarm_h(bool enabled, const int16_t *raw, float scale, float offset,
+                                           float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                           int set_interval, char *name){
+  if(raw == NULL) return MGOS_ALARM_INVALID_HANDLE;
+  return add_raw_alarm(enabled, raw, NULL, scale, offset, ll_sv, l_sv, h_sv, hh_sv, set_interval, name);
+}
+
+/*
+ * Add an A_ALARM_RATE or A_ALARM_DEVIATION alarm on pv
+ */
+static mgos_alarm_handle_t add_derived_alarm(bool enabled, float *pv, enum a_alarm_kind kind,
+                                             const float *sp, int period, int filter,
+                                             float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                             int set_interval, char *name){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_alarm_handle_t handle = MGOS_ALARM_INVALID_HANDLE;
+  if(pv == NULL || (kind == A_ALARM_DEVIATION && sp == NULL) || (kind == A_ALARM_RATE && period <= 0)){
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as %s", name == NULL ? 0 : strlen(name),
+                   name == NULL ? "" : name, pv == NULL ? "pv is NULL" : kind == A_ALARM_RATE ?
+                   "period must be above 0" : "sp is NULL"));
+  }
+  else{
+    struct a_alarm_derived der;
+    memset(&der, 0, sizeof(der));
+    der.sp = sp;
+    der.period = (float) period;
+    der.filter = filter < 0 ? 0 : filter;
+    der.value = NAN;
+    handle = add_a_alarm(enabled, pv, ll_sv, l_sv, h_sv, hh_sv, set_interval, name, kind, &der);
+  }
+  mgos_alarm_op_done(&s_stats.add, start_us);
+  return handle;
+}
+
+mgos_alarm_handle_t mgos_add_rate_alarm_h(bool enabled, float *pv, int period, int filter,
+                                          float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                          int set_interval, char *name){
+  return add_derived_alarm(enabled, pv, A_ALARM_RATE, NULL, period, filter,
+                           ll_sv, l_sv, h_sv, hh_sv, set_interval, name);
+}
+
+mgos_alarm_handle_t mgos_add_deviation_alarm_h(bool enabled, float *pv, const float *sp, int filter,
+                                               float ll_sv, float l_sv, float h_sv, float hh_sv,
+                                               int set_interval, char *name){
+  return add_derived_alarm(enabled, pv, A_ALARM_DEVIATION, sp, 0, filter,
+                           ll_sv, l_sv, h_sv, hh_sv, set_interval, name);
+}
+
+mgos_alarm_handle_t mgos_add_window_alarm_h(bool enabled, float *pv, enum mgos_alarm_window_stat stat,
+                                            int samples, int window_ms, float ll_sv, float l_sv,
+                                            float h_sv, float hh_sv, int set_interval, char *name){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_alarm_handle_t handle = MGOS_ALARM_INVALID_HANDLE;
+  struct mgos_alarm_window window;
+  if(pv == NULL || samples <= 0 || (unsigned) stat > MGOS_ALARM_WINDOW_MEAN){
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as %s", name == NULL ? 0 : strlen(name),
+                   name == NULL ? "" : name, pv == NULL ? "pv is NULL" : samples <= 0 ?
+                   "samples must be above 0" : "stat is invalid"));
+  }
+  else if(!mgos_alarm_window_init(&window, (uint32_t) samples, window_ms < 0 ? 0 : (uint32_t) window_ms, stat)){
+    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as allocated memory returned NULL",
+                   name == NULL ? 0 : strlen(name), name == NULL ? "" : name));
+  }
+  else{
+    __atomic_add_fetch(&s_stats.allocs, 1, __ATOMIC_RELAXED);
+    handle = add_a_alarm(enabled, pv, ll_sv, l_sv, h_sv, hh_sv, set_interval, name, A_ALARM_WINDOW, &window);
+    if(handle == MGOS_ALARM_INVALID_HANDLE) mgos_alarm_window_free(&window);
+  }
+  mgos_alarm_op_done(&s_stats.add, start_us);
+  return handle;
+}
+
+mgos_alarm_handle_t mgos_add_d_alarm_h(bool enabled, bool *input, enum mgos_d_alarm_mode mode,
+                                       int set_interval, int reset_interval, char *name){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_alarm_handle_t handle = add_d_alarm(enabled, input, mode, set_interval, reset_interval, name);
+  mgos_alarm_op_done(&s_stats.add, start_us);
+  return handle;
+}
+
+/*
+ * Resolve an alarm name of an expression being compiled,
+ * must be called with s_alarm_lock held
+ */
+static bool mgos_alarm_expr_resolve(const char *name, mgos_alarm_handle_t *handle,
+                                    enum mgos_alarm_type *type, void *arg){
+  uint32_t slot = mgos_alarm_lookup(name, mgos_alarm_hash(name));
+  if(slot == ALARM_SLOT_NONE) return false;
+  *handle = mgos_alarm_handle(slot);
+  *type = s_alarm_table.slots[slot].type;
+  (void) arg;
+  return true;
+}
+
+/*
+ * Ensure the expression order has room for one more expression
+ * returns false if memory could not be allocated
+ */
+static bool mgos_alarm_exprs_reserve(void){
+  if(s_exprs.count < s_exprs.capacity) return true;
+  uint32_t capacity = s_exprs.capacity < 8 ? 8 : s_exprs.capacity * 2;
+  struct mgos_alarm_expr **order = (struct mgos_alarm_expr **) mgos_alarm_realloc(s_exprs.order,
+                                                                                 capacity * sizeof(*order));
+  if(order == NULL) return false;
+  s_exprs.order = order;
+  s_exprs.capacity = capacity;
+  return true;
+}
+
+/*
+ * The expression is compiled and bound under the alarm lock so that the
+ * alarms it refers to cannot be removed before it is linked to them
+ */
+mgos_alarm_handle_t mgos_add_expr_alarm_h(bool enabled, const char *expr, int set_interval,
+                                          int reset_interval, char *name){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_alarm_handle_t handle = MGOS_ALARM_INVALID_HANDLE;
+  if(expr == NULL){
+    LOG(LL_ERROR, ("Expression alarm \"%*s\" failed to init as expr is NULL", name == NULL ? 0 : strlen(name),
+                   name == NULL ? "" : name));
+    mgos_alarm_op_done(&s_stats.add, start_us);
+    return handle;
+  }
+  mgos_rlock(s_alarm_lock);
+  const char *error;
+  size_t pos;
+  //the compiler's scratch state, and the expression's block if it compiled
+  struct mgos_alarm_expr *e = mgos_alarm_expr_compile(expr, mgos_alarm_expr_resolve, NULL, &error, &pos);
+  s_stats.allocs += (e == NULL) ? 1 : 2;
+  if(e == NULL){
+    LOG(LL_ERROR, ("Expression alarm \"%*s\" failed to init as %s at offset %u of \"%s\"",
+                   name == NULL ? 0 : strlen(name), name == NULL ? "" : name, error, (unsigned) pos, expr));
+  }
+  else if(!mgos_alarm_exprs_reserve()){
+    LOG(LL_ERROR, ("Expression alarm \"%*s\" failed to init as allocated memory returned NULL",
+                   name == NULL ? 0 : strlen(name), name == NULL ? "" : name));
+    mgos_alarm_expr_free(e);
+  }
+  else{
+    //the alarm debounces the expression's result like any digital input
+    handle = add_d_alarm(enabled, &e->value, ACTIVE_HIGH, set_interval, reset_interval, name);
+    uint32_t slot = mgos_alarm_handle_slot(handle);
+    if(slot == ALARM_SLOT_NONE){
+      mgos_alarm_expr_free(e);
+    }
+    else if(!mgos_alarm_expr_link(e)){
+      LOG(LL_ERROR, ("Expression alarm \"%*s\" failed to init as allocated memory returned NULL",
+                     strlen(name), name));
+      mgos_alarm_expr_unlink(e);
+      remove_slot(slot);
+      mgos_alarm_expr_free(e);
+      handle = MGOS_ALARM_INVALID_HANDLE;
+    }
+    else{
+      //evaluated for the first time on the next pass
+      e->slot = slot;
+      e->dirty = true;
+      ++s_exprs.dirty;
+      if(e->inputs) ++s_exprs.inputs;
+      s_exprs.order[s_exprs.count++] = e;
+      s_alarm_table.slots[slot].expr = e;
+    }
+  }
+  mgos_runlock(s_alarm_lock);
+  mgos_alarm_op_done(&s_stats.add, start_us);
+  return handle;
+}
+
+bool mgos_add_a_alarm(bool enabled, float *pv, float ll_sv, float l_sv,
+                      float h_sv, float hh_sv, int set_interval,
+                      char *name){
+  return mgos_add_a_alarm_h(enabled, pv, ll_sv, l_sv, h_sv, hh_sv, set_interval, name)
+         != MGOS_ALARM_INVALID_HANDLE;
+}
+
+bool mgos_add_d_alarm(bool enabled, bool *input, enum mgos_d_alarm_mode mode,
+                      int set_interval, int reset_interval, char *name){
+  return mgos_add_d_alarm_h(enabled, input, mode, set_interval, reset_interval, name)
+         != MGOS_ALARM_INVALID_HANDLE;
+}
+
+/*
+ * a pass over a configuration
+ *
+ * io - what the input and pv indexes refer to
+ * count, d_alarms, a_alarms - alarms passed so far
+ * name_bytes - bytes the names passed so far take, NULs included
+ * block - the names of the adding pass
+ * names - where the adding pass copies the next name
+ */
+struct alarm_config_pass{
+  const struct mgos_alarm_config_io *io;
+  uint32_t count, d_alarms, a_alarms;
+  size_t name_bytes;
+  struct alarm_name_block *block;
+  char *names;
+};
+
+/*
+ * First pass, validate an alarm as mgos_add_d_alarm and mgos_add_a_alarm
+ * do and count it
+ */
+static bool mgos_alarm_config_check(const struct mgos_alarm_config_record *record, void *arg){
+  struct alarm_config_pass *pass = (struct alarm_config_pass *) arg;
+  const char *error = NULL;
+  if(record->name == NULL || record->name_len == 0) error = "as name is empty";
+  else if(!record->typed || record->malformed || memchr(record->name, '\0', record->name_len) != NULL){
+    error = "as it is malformed";
+  }
+  else if(s_names != NULL && record->name_len > s_capacity.name_len) error = "as name is too long";
+  else if(record->type == DIGITAL && record->input >= pass->io->num_inputs) error = "as input is out of range";
+  else if(record->type == ANALOG && record->input >= pass->io->num_pvs) error = "as pv is out of range";
+  else if(record->type == ANALOG){
+    error = mgos_alarm_sv_check(record->sv[0], record->sv[1], record->sv[2], record->sv[3]);
+  }
+  if(error != NULL){
+    LOG(LL_ERROR, ("Alarm config entry %u \"%.*s\" failed to load %s", (unsigned) pass->count,
+                   record->name == NULL ? 0 : (int) record->name_len, record->name == NULL ? "" : record->name,
+                   error));
+    return false;
+  }
+  ++pass->count;
+  if(record->type == DIGITAL) ++pass->d_alarms;
+  else ++pass->a_alarms;
+  pass->name_bytes += record->name_len + 1;
+  return true;
+}
+
+/*
+ * Second pass, add an alarm the first pass has validated and reserved
+ * room for, must be called with s_alarm_lock held
+ */
+static bool mgos_alarm_config_add(const struct mgos_alarm_config_record *record, void *arg){
+  struct alarm_config_pass *pass = (struct alarm_config_pass *) arg;
+  char *name = pass->names;
+  memcpy(name, record->name, record->name_len);
+  name[record->name_len] = '\0';
+  pass->names += record->name_len + 1;
+  uint32_t hash = mgos_alarm_hash(name);
+  if(mgos_alarm_lookup(name, hash) != ALARM_SLOT_NONE){
+    LOG(LL_ERROR, ("Alarm config entry %u \"%s\" failed to load as an alarm with this name already exists",
+                   (unsigned) pass->count, name));
+    return false;
+  }
+  uint32_t slot = mgos_alarm_register(record->type, hash);
+  if(slot == ALARM_SLOT_NONE) return false;
+  if(s_names == NULL){
+    s_alarm_table.slots[slot].name_block = pass->block;
+    ++pass->block->refs;
+  }
+  name = mgos_alarm_slot_name_store(slot, name);
+  if(record->type == DIGITAL){
+    d_alarm_append(slot, record->enabled, &pass->io->inputs[record->input], record->mode,
+                   record->set_interval, record->reset_interval, name);
+  }
+  else{
+    a_alarm_append(slot, record->enabled, &pass->io->pvs[record->input], record->sv[0], record->sv[1],
+                   record->sv[2], record->sv[3], record->set_interval, name);
+  }
+  ++pass->count;
+  return true;
+}
+
+/*
+ * Add every alarm of a configuration, validating them all first so that
+ * the tables are grown, and the names allocated, once. The names are kept
+ * until the last alarm of the configuration is removed
+ */
+static bool load_config(const char *data, size_t len, const struct mgos_alarm_config_io *io){
+  struct alarm_config_pass pass = {.io = io};
+  if(!mgos_alarm_config_decode(data, len, mgos_alarm_config_check, &pass)){
+    LOG(LL_ERROR, ("Alarm config failed to load as it is invalid"));
+    return false;
+  }
+  if(pass.count == 0) return true;
+  struct alarm_name_block *block = (struct alarm_name_block *) mgos_alarm_calloc(1, sizeof(*block) + pass.name_bytes,
+                                                                                 false);
+  if(block == NULL){
+    LOG(LL_ERROR, ("Alarm config failed to load as allocated memory returned NULL"));
+    return false;
+  }
+  mgos_rlock(s_alarm_lock);
+  uint32_t d_count = s_d_alarm_data.count, a_count = s_a_alarm_data.count;
+  bool ok = d_alarm_reserve(pass.d_alarms) && a_alarm_reserve(pass.a_alarms) &&
+            mgos_alarm_slots_reserve(pass.count) && mgos_alarm_index_reserve(pass.count) &&
+            mgos_alarm_event_reserve(pass.count);
+  if(!ok){
+    LOG(LL_ERROR, ("Alarm config failed to load as %s",
+                   s_arena.base != NULL ? "its reserved capacity is full" : "allocated memory returned NULL"));
+  }
+  block->refs = 1;
+  struct alarm_config_pass add = {.io = io, .block = block, .names = block->names};
+  ok = ok && mgos_alarm_config_decode(data, len, mgos_alarm_config_add, &add);
+  if(!ok){
+    //remove what was added, newest first so that each alarm is the last row
+    while(s_d_alarm_data.count > d_count) remove_slot(s_d_alarm_data.slot[s_d_alarm_data.count - 1]);
+    while(s_a_alarm_data.count > a_count) remove_slot(s_a_alarm_data.slot[s_a_alarm_data.count - 1]);
+  }
+  else mgos_alarm_wake();
+  //names copied into the name storage of mgos_alarm_init_ex, or of a
+  //configuration that failed to load, are held by no alarm
+  mgos_alarm_name_block_release(block);
+  mgos_alarm_names_reclaim();
+  mgos_runlock(s_alarm_lock);
+  if(ok){
+    LOG(LL_INFO, ("Alarm config of %u digital and %u analog alarms has been loaded",
+                  (unsigned) pass.d_alarms, (unsigned) pass.a_alarms));
+  }
+  return ok;
+}
+
+bool mgos_alarm_load_config_buf(const char *data, size_t len, const struct mgos_alarm_config_io *io){
+  if(data == NULL || io == NULL || s_alarm_lock == NULL) return false;
+  int64_t start_us = mgos_uptime_micros();
+  bool res = load_config(data, len, io);
+  mgos_alarm_op_done(&s_stats.load, start_us);
+  return res;
+}
+
+bool mgos_alarm_load_config(const char *path, const struct mgos_alarm_config_io *io){
+  if(path == NULL) return false;
+  size_t len = 0;
+  char *data = cs_read_file(path, &len);
+  if(data == NULL){
+    LOG(LL_ERROR, ("Alarm config \"%s\" could not be read", path));
+    return false;
+  }
+  bool res = mgos_alarm_load_config_buf(data, len, io);
+  free(data);
+  return res;
+}
+
+bool mgos_remove_alarm(char *name){
+  return mgos_alarm_name_op(name, ALARM_OP_REMOVE, &s_stats.remove);
+}
+
+bool mgos_disable_alarm(char *name){
+  return mgos_alarm_name_op(name, ALARM_OP_DISABLE, &s_stats.lookup);
+}
+
+bool mgos_reset_alarm(char *name){
+  return mgos_alarm_name_op(name, ALARM_OP_RESET, &s_stats.lookup);
+}
+
+mgos_alarm_handle_t mgos_alarm_find(const char *name){
+  int64_t start_us = mgos_uptime_micros();
+  mgos_alarm_handle_t handle = MGOS_ALARM_INVALID_HANDLE;
+  mgos_rlock(s_alarm_lock);
+  uint32_t slot = mgos_alarm_find_slot(name);
+  if(slot != ALARM_SLOT_NONE) handle = mgos_alarm_handle(slot);
+  mgos_runlock(s_alarm_lock);
+  mgos_alarm_op_done(&s_stats.lookup, start_us);
+  return handle;
+}
+
+bool mgos_alarm_remove_h(mgos_alarm_handle_t handle){
+  return mgos_alarm_handle_op(handle, ALARM_OP_REMOVE, &s_stats.remove);
+}
+
+bool mgos_alarm_enable_h(mgos_alarm_handle_t handle){
+  return mgos_alarm_handle_op(handle, ALARM_OP_ENABLE, &s_stats.lookup);
+}
+
+bool mgos_alarm_disable_h(mgos_alarm_handle_t handle){
+  return mgos_alarm_handle_op(handle, ALARM_OP_DISABLE, &s_stats.lookup);
+}
+
+bool mgos_alarm_reset_h(mgos_alarm_handle_t handle){
+  return mgos_alarm_handle_op(handle, ALARM_OP_RESET, &s_stats.lookup);
+}
+
+/*
+ * mgos_alarm_get_state_h reader view callback
+ */
+struct alarm_state_read{
+  mgos_alarm_handle_t handle;
+  struct alarm_info *info;
+  bool found;
+};
+
+static void mgos_alarm_state_read(void *ctx){
+  struct alarm_state_read *r = (struct alarm_state_read *) ctx;
+  uint32_t slot = r->handle & ALARM_HANDLE_INDEX_MASK;
+  //capacities are loaded before their arrays, see mgos_alarm_view_grow
+  uint32_t slot_capacity = __atomic_load_n(&s_view.slot_capacity, __ATOMIC_ACQUIRE);
+  struct alarm_view_slot *slots = __atomic_load_n(&s_view.slots, __ATOMIC_ACQUIRE);
+  r->found = false;
+  if(r->handle == MGOS_ALARM_INVALID_HANDLE || slot >= slot_capacity) return;
+  struct alarm_view_slot vs = slots[slot];
+  if(vs.handle != r->handle) return;
+  if(vs.type == DIGITAL){
+    uint32_t capacity = __atomic_load_n(&s_view.d_capacity, __ATOMIC_ACQUIRE);
+    struct alarm_info *info = __atomic_load_n(&s_view.d_info, __ATOMIC_ACQUIRE);
+    if(vs.row >= capacity) return;
+    *r->info = info[vs.row];
+  }
+  else{
+    uint32_t capacity = __atomic_load_n(&s_view.a_capacity, __ATOMIC_ACQUIRE);
+    struct alarm_info *info = __atomic_load_n(&s_view.a_info, __ATOMIC_ACQUIRE);
+    if(vs.row >= capacity) return;
+    *r->info = info[vs.row];
+  }
+  r->found = true;
+}
+
+bool mgos_alarm_get_state_h(mgos_alarm_handle_t handle, struct alarm_info *info){
+  if(info == NULL) return false;
+  struct alarm_state_read r = {handle, info, false};
+  mgos_alarm_view_read(mgos_alarm_state_read, &r);
+  return r.found;
+}
+
+/*
+ * mgos_alarm_list_fill reader view callback
+ */
+struct alarm_list_read{
+  struct alarm_info *info;
+  size_t capacity, total;
+};
+
+/*
+ * Copy up to r->capacity - length rows of one view array into r->info
+ */
+static size_t mgos_alarm_list_copy(struct alarm_list_read *r, size_t length,
+                                   struct alarm_info *const *array, const uint32_t *capacity,
+                                   const uint32_t *count){
+  uint32_t rows = __atomic_load_n(capacity, __ATOMIC_ACQUIRE);
+  struct alarm_info *info = __atomic_load_n(array, __ATOMIC_ACQUIRE);
+  uint32_t n = __atomic_load_n(count, __ATOMIC_RELAXED);
+  if(n > rows) n = rows;
+  size_t copy = n;
+  if(copy > r->capacity - length) copy = r->capacity - length;
+  if(copy > 0) memcpy(&r->info[length], info, copy * sizeof(*info));
+  r->total += n;
+  return length + copy;
+}
+
+static void mgos_alarm_list_read(void *ctx){
+  struct alarm_list_read *r = (struct alarm_list_read *) ctx;
+  r->total = 0;
+  size_t length = mgos_alarm_list_copy(r, 0, &s_view.d_info, &s_view.d_capacity, &s_view.d_count);
+  mgos_alarm_list_copy(r, length, &s_view.a_info, &s_view.a_capacity, &s_view.a_count);
+}
+
+/*
+ * Copy up to capacity alarms into info, digital alarms first
+ * returns the total number of alarms
+ */
+static size_t mgos_alarm_list_fill(struct alarm_info *info, size_t capacity){
+  struct alarm_list_read r = {info, capacity, 0};
+  mgos_alarm_view_read(mgos_alarm_list_read, &r);
+  return r.total;
+}
+
+/*
+ * Returns an array of alarm_info structs based on the alarm tables,
+ * the array is grown and refilled should alarms be added while it is copied
+ * returns null if memory could not be allocated
+ */
+struct alarm_list * mgos_list_alarms(void){
+  struct alarm_list *a_list = mgos_alarm_calloc(1, sizeof(*a_list), false);
+  if(a_list == NULL) return NULL;
+  struct alarm_info *a_info = NULL;
+  size_t capacity;
+  size_t total_alarms = mgos_alarm_list_fill(NULL, 0);
+  do{
+    capacity = total_alarms;
+    free(a_info);
+    a_info = mgos_alarm_calloc(capacity, sizeof(*a_info), false);
+    if(a_info == NULL){
+      free(a_list);
+      return NULL;
+    }
+    total_alarms = mgos_alarm_list_fill(a_info, capacity);
+  } while(total_alarms > capacity);
+  a_list->info = a_info;
+  a_list->length = total_alarms;
+  return a_list;
+}
+
+size_t mgos_list_alarms_buf(struct alarm_info *info, size_t capacity){
+  if(info == NULL) capacity = 0;
+  return mgos_alarm_list_fill(info, capacity);
+}
+
+/*
+ * List the alarms that changed after since by walking back from the tail
+ * of the change list to the first such alarm, then forwards from it
+ */
+bool mgos_list_alarm_changes(uint32_t since, struct alarm_changes *changes){
+  if(changes == NULL || s_alarm_lock == NULL) return false;
+  mgos_rlock(s_alarm_lock);
+  struct alarm_slot *slots = s_alarm_table.slots;
+  uint32_t first = ALARM_SLOT_NONE;
+  for(uint32_t slot = s_changes.tail; slot != ALARM_SLOT_NONE && mgos_alarm_seq_after(slots[slot].seq, since);
+      slot = slots[slot].change_prev){
+    first = slot;
+  }
+  changes->length = 0;
+  changes->seq = s_changes.seq;
+  for(uint32_t slot = first; slot != ALARM_SLOT_NONE; slot = slots[slot].change_next){
+    //out of room, the next call resumes after the last alarm written
+    if(changes->info == NULL || changes->length == changes->capacity){
+      changes->seq = changes->length > 0 ? slots[slots[slot].change_prev].seq : since;
+      break;
+    }
+    get_slot_state(slot, &changes->info[changes->length++]);
+  }
+  changes->removed = since != 0 && s_changes.removed_seq != 0 &&
+                     mgos_alarm_seq_after(s_changes.removed_seq, since);
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Take an event rate limiter token for an event of the alarm held by slot
+ * raised at now (ms)
+ * returns false if the bucket is empty, the transition then counts
+ * towards the next summary
+ */
+static bool mgos_alarm_rate_limit_take(uint32_t slot, int64_t now){
+  if(mgos_alarm_rate_take(&s_rate_limit, now, s_alarm_table.slots[slot].seq - 1)) return true;
+  //a sleeping engine must wake to summarise them
+  if(s_rate_limit.suppressed == 1) mgos_alarm_schedule_wake(now + s_rate_limit.period_ms);
+  ++s_stats.rate_limited;
+  return false;
+}
+
+/*
+ * Returns the state of an alarm_info as stored in mgos_alarm_chatter.reported
+ */
+static uint8_t mgos_alarm_info_state(const struct alarm_info *info){
+  return info->type == DIGITAL ? (uint8_t) info->state.d_state : (uint8_t) info->state.a_state;
+}
+
+/*
+ * Raise an alarm transition. The transition of a latched alarm raises 
+ * nothing, one taking an alarm over its chatter limit latches it and is 
+ * raised as MGOS_ALARM_EV_CHATTER. Every event then needs an event rate
+ * limiter token.
+ */
+static void mgos_alarm_raise(const struct alarm_transition *transition){
+  uint32_t slot = transition->handle & ALARM_HANDLE_INDEX_MASK;
+  uint32_t index = s_alarm_table.slots[slot].chatter;
+  struct alarm_transition chatter;
+  if(index != MGOS_ALARM_POOL_NONE){
+    enum mgos_alarm_chatter_verdict verdict = mgos_alarm_chatter_transition(&s_chatter, index, transition->time_ms,
+                                                                            mgos_alarm_info_state(&transition->info));
+    if(verdict == MGOS_ALARM_CHATTER_SUPPRESS){
+      ++s_stats.chatter_suppressed;
+      return;
+    }
+    if(verdict == MGOS_ALARM_CHATTER_LATCH){
+      struct mgos_alarm_chatter *c = MGOS_ALARM_CHATTER_ENTRY(&s_chatter, index);
+      ++s_stats.chatter_latched;
+      mgos_alarm_schedule_wake(c->last_ms + c->window_ms);
+      LOG(LL_INFO, ("Alarm \"%*s\" is chattering, its events are suppressed", strlen(transition->info.name),
+                    transition->info.name));
+      chatter = *transition;
+      chatter.ev = MGOS_ALARM_EV_CHATTER;
+      transition = &chatter;
+    }
+  }
+  if(mgos_alarm_rate_limit_take(slot, mgos_uptime_micros() / 1000)) mgos_alarm_emit(transition);
+}
+
+/*
+ * Chatter detection callback for an alarm that unlatched, raising its
+ * current state if it moved since it was last raised
+ */
+static void mgos_alarm_chatter_unlatched(struct mgos_alarm_chatter *c, int64_t now, void *arg){
+  struct alarm_transition t;
+  (void) arg;
+  get_slot_state(c->slot, &t.info);
+  LOG(LL_INFO, ("Alarm \"%*s\" has stopped chattering", strlen(t.info.name), t.info.name));
+  uint8_t state = mgos_alarm_info_state(&t.info);
+  if(state == c->reported) return;
+  t.handle = mgos_alarm_handle(c->slot);
+  if(t.info.type == DIGITAL) t.old_state.d_state = c->reported;
+  else t.old_state.a_state = (enum mgos_a_alarm_state) c->reported;
+  t.time_ms = now;
+  t.ev = state != 0 ? MGOS_ALARM_EV_SET : MGOS_ALARM_EV_RESET;
+  c->reported = state;
+  if(mgos_alarm_rate_limit_take(c->slot, now)) mgos_alarm_emit(&t);
+}
+
+/*
+ * Digital alarm transition, toggle the alarm state and raise the
+ * set or reset event stamped with time_ms
+ */
+static void d_alarm_transition_at(uint32_t i, int64_t time_ms) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  //a masked alarm holds its state and raises nothing
+  if(alarm_bit_get(d->masked, i)) return;
+  //toggle the alarm state
+  bool active = !alarm_bit_get(d->active, i);
+  alarm_bit_set(d->active, i, active);
+  mgos_alarm_touch(d->slot[i]);
+  //build the transition around a generic alarm info struct
+  struct alarm_transition t;
+  t.handle = mgos_alarm_handle(d->slot[i]);
+  t.info.name = d->name[i];
+  t.info.enabled = alarm_bit_get(d->enabled, i);
+  t.info.type = DIGITAL;
+  t.info.state.d_state = active;
+  t.old_state.d_state = !active;
+  t.time_ms = time_ms;
+  //if the alarm is now active raise set ev else raise reset ev
+  t.ev = active ? MGOS_ALARM_EV_SET : MGOS_ALARM_EV_RESET;
+  d_alarm_publish(i);
+  mgos_alarm_suppress_changed(d->slot[i], time_ms);
+  mgos_alarm_raise(&t);
+}
+
+/*
+ * Digital alarm transition made now
+ */
+static void d_alarm_transition(uint32_t i) {
+  d_alarm_transition_at(i, mgos_uptime_micros() / 1000);
+}
+
+/*
+ * Analog alarm transition, move the alarm into its pending band and raise
+ * the set event, or the reset event if it returned to NOM
+ */
+static void a_alarm_transition(uint32_t i) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  struct alarm_transition t;
+  //a masked alarm holds its state and raises nothing
+  if(alarm_bit_get(a->masked, i)) return;
+  t.old_state.a_state = (enum mgos_a_alarm_state) a->state[i];
+  a->state[i] = a->pending_state[i];
+  mgos_alarm_touch(a->slot[i]);
+  //build the transition around a generic alarm info struct
+  t.handle = mgos_alarm_handle(a->slot[i]);
+  t.info.name = a->name[i];
+  t.info.enabled = alarm_bit_get(a->enabled, i);
+  t.info.type = ANALOG;
+  t.info.state.a_state = (enum mgos_a_alarm_state) a->state[i];
+  t.time_ms = mgos_uptime_micros() / 1000;
+  t.ev = a->state[i] != NOM ? MGOS_ALARM_EV_SET : MGOS_ALARM_EV_RESET;
+  a_alarm_publish(i);
+  if((t.old_state.a_state != NOM) != (a->state[i] != NOM)) mgos_alarm_suppress_changed(a->slot[i], t.time_ms);
+  mgos_alarm_raise(&t);
+}
+
+/*
+ * Run the pending transition of the alarm held by an alarm table slot,
+ * must be called with s_alarm_lock held
+ */
+static void mgos_alarm_slot_transition(uint32_t slot) {
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  if(as->type == DIGITAL) d_alarm_transition(as->row);
+  else a_alarm_transition(as->row);
+}
+
+/*
+ * Alarm set/reset timer callback function, arg is the slot and the
+ * timer_gen it was armed with, encoded as a handle is. A timer outliving
+ * its alarm is ignored, and so is one cancelled on another task while its
+ * callback waited for s_alarm_lock, whether or not the alarm was armed
+ * again since.
+ */
+static void mgos_alarm_set_reset_timer(void *arg) {
+  mgos_rlock(s_alarm_lock);
+  uint32_t key = (uint32_t) (uintptr_t) arg;
+  uint32_t slot = key & ALARM_HANDLE_INDEX_MASK;
+  if(slot < s_alarm_table.capacity && s_alarm_table.slots[slot].used &&
+     s_alarm_table.slots[slot].timer_gen == (key >> ALARM_HANDLE_INDEX_BITS)){
+    struct alarm_slot *as = &s_alarm_table.slots[slot];
+    mgos_timer_id *timer_id = (as->type == DIGITAL) ? &s_d_alarm_data.timer_id[as->row] :
+                                                      &s_a_alarm_data.timer_id[as->row];
+    if(*timer_id != MGOS_INVALID_TIMER_ID){
+      *timer_id = MGOS_INVALID_TIMER_ID;
+      mgos_alarm_slot_transition(slot);
+      mgos_alarm_expr_settle(mgos_uptime_micros() / 1000);
+    }
+  }
+  //in batch mode the transition joins the batch of the next pass, which
+  //a sleeping engine must be woken for
+  bool batch = s_batch_events;
+  if(batch) mgos_alarm_wake();
+  mgos_runlock(s_alarm_lock);
+  if(!batch) mgos_alarm_flush_events();
+}
+
+/*
+ * Timing wheel expiry callback, the entry id is the alarm table slot
+ */
+static void mgos_alarm_wheel_expired(uint32_t id, void *arg) {
+  mgos_alarm_slot_transition(id);
+  (void) arg;
+}
+
+/*
+ * Returns true if the digital alarm input is in its active state, an edge
+ * captured input is at the level of its last edge
+ */
+static bool d_alarm_trigger(uint32_t i) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  bool level = alarm_bit_get(d->edge, i) ? alarm_bit_get(d->level, i) : *d->input[i];
+  return level == alarm_bit_get(d->mode, i);
+}
+
+/*
+ * Returns true if a digital alarm set/reset timer or deadline is running
+ */
+static bool d_alarm_timer_armed(uint32_t i) {
+  return s_d_alarm_data.timer_id[i] != MGOS_INVALID_TIMER_ID ||
+         mgos_alarm_wheel_armed(&s_wheel, s_d_alarm_data.slot[i]);
+}
+
+/*
+ * Start the set/reset timer of the alarm in an alarm table slot, either
+ * an SDK timer or a timing wheel deadline depending on the debounce mode
+ * returns the SDK timer id, MGOS_INVALID_TIMER_ID for a wheel deadline
+ */
+static mgos_timer_id mgos_alarm_arm_timer(uint32_t slot, int interval) {
+  if(s_debounce_mode == MGOS_ALARM_DEBOUNCE_WHEEL){
+    mgos_alarm_wheel_arm(&s_wheel, slot, interval);
+    return MGOS_INVALID_TIMER_ID;
+  }
+  struct alarm_slot *as = &s_alarm_table.slots[slot];
+  as->timer_gen = (as->timer_gen + 1) & ALARM_HANDLE_GENERATION_MASK;
+  return mgos_alarm_set_timer(interval, mgos_alarm_set_reset_timer,
+                              (void *) (uintptr_t) ((uint32_t) as->timer_gen << ALARM_HANDLE_INDEX_BITS | slot));
+}
+
+/*
+ * Digital alarm set/reset timer logic
+ */
+static void mgos_d_alarm_logic(uint32_t i) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  bool trigger = d_alarm_trigger(i);
+  //if the alarm is active
+  if(alarm_bit_get(d->active, i)){
+    //if the input is high and the reset timer has been started clear it
+    if(trigger && d_alarm_timer_armed(i)){
+      d_alarm_cancel_pending(i);
+    }
+    //if the input is low start the reset timer
+    else if(!trigger && !d_alarm_timer_armed(i)){
+      d->timer_id[i] = mgos_alarm_arm_timer(d->slot[i], d->reset_interval[i]);
+    }
+  }
+  else{
+    //if the input is low and the set timer has been started clear it
+    if(!trigger && d_alarm_timer_armed(i)){
+      d_alarm_cancel_pending(i);
+    }
+    //if the input is high start the set timer
+    else if(trigger && !d_alarm_timer_armed(i)){
+      d->timer_id[i] = mgos_alarm_arm_timer(d->slot[i], d->set_interval[i]);
+    }
+  }
+}
+
+/*
+ * Digital alarm set/reset timestamp logic, the alarm transitions inline
+ * once the input has been in the opposite state for the set/reset interval.
+ * An edge captured alarm transitions at the time the interval ran out.
+ */
+static void mgos_d_alarm_debounce(uint32_t i, int64_t now, struct alarm_shard *shard) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  bool active = alarm_bit_get(d->active, i);
+  //the input agrees with the alarm state, nothing is pending
+  if(d_alarm_trigger(i) == active){
+    d->pending_since[i] = ALARM_NOT_PENDING;
+    return;
+  }
+  if(d->pending_since[i] == ALARM_NOT_PENDING) d->pending_since[i] = now;
+  int interval = active ? d->reset_interval[i] : d->set_interval[i];
+  if(now - d->pending_since[i] >= interval){
+    int64_t due = d->pending_since[i] + interval;
+    d->pending_since[i] = ALARM_NOT_PENDING;
+    if(shard != NULL){
+      shard->d_rows[shard->d_count] = i;
+      shard->d_due[shard->d_count++] = due;
+    }
+    else if(alarm_bit_get(d->edge, i)) d_alarm_transition_at(i, due);
+    else d_alarm_transition(i);
+  }
+}
+
+/*
+ * Classify the gathered float PVs of analog rows begin to end - 1 into the
+ * band column
+ */
+static void mgos_a_alarm_classify_batch(uint32_t begin, uint32_t end) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  if(end <= begin) return;
+  mgos_alarm_classify(&a->pv_sample[begin], &a->ll_sv[begin], &a->l_sv[begin], &a->h_sv[begin],
+                      &a->hh_sv[begin], &a->band[begin], end - begin);
+}
+
+/*
+ * Classify an A_ALARM_RAW row on its count with integer compares only
+ */
+static void a_alarm_raw_classify(uint32_t i) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  struct a_alarm_raw *raw = MGOS_ALARM_POOL_ENTRY(&s_raw_alarms, struct a_alarm_raw, a->ext[i]);
+  raw->sample = raw->raw16 != NULL ? *raw->raw16 : *raw->raw32;
+  raw->sampled = true;
+  a->band[i] = mgos_alarm_classify_raw(raw->sample, raw->sv, raw->sv_used);
+}
+
+/*
+ * Sample the PV of an A_ALARM_RATE or A_ALARM_DEVIATION row at now (ms)
+ * and return its filtered rate or deviation. A NAN PV or setpoint restarts
+ * the history, a rate needs two samples a ms or more apart.
+ */
+static float a_alarm_derive(uint32_t i, int64_t now) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  struct a_alarm_derived *der = MGOS_ALARM_POOL_ENTRY(&s_derived_alarms, struct a_alarm_derived, a->ext[i]);
+  bool rate = (a->kind[i] == A_ALARM_RATE);
+  float pv = *a->pv[i];
+  if(isnan(pv) || (!rate && isnan(*der->sp))){
+    der->primed = false;
+    der->value = NAN;
+    return NAN;
+  }
+  int64_t dt = now - der->last_ms;
+  if(!der->primed) dt = 0;
+  else if(rate && dt <= 0) return der->value;
+  float x = rate ? (dt > 0 ? (pv - der->last_pv) * der->period / (float) dt : NAN) : pv - *der->sp;
+  if(isnan(der->value) || der->filter == 0) der->value = x;
+  else der->value += (x - der->value) * (float) dt / (float) (der->filter + dt);
+  der->primed = true;
+  der->last_pv = pv;
+  der->last_ms = now;
+  return der->value;
+}
+
+/*
+ * Classify the rows begin to end - 1 into the band column, sampling rate
+ * and deviation alarms at now (ms). The float PVs, and the values derived
+ * from them, are gathered into contiguous runs first so the classifier can
+ * vectorise, a raw row is classified on its own and splits the run. The
+ * PV of a disabled or masked row is not read and its history not sampled,
+ * the row keeps the value it was last classified on.
+ */
+static void mgos_a_alarm_classify_range(uint32_t begin, uint32_t end, int64_t now) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  uint32_t run = begin;
+  for(uint32_t i = begin; i < end; i++){
+    if(!alarm_bit_get(a->enabled, i) || alarm_bit_get(a->masked, i)) continue;
+    switch(a->kind[i]){
+      case A_ALARM_RAW:
+        mgos_a_alarm_classify_batch(run, i);
+        a_alarm_raw_classify(i);
+        run = i + 1;
+        break;
+      case A_ALARM_RATE:
+      case A_ALARM_DEVIATION:
+        a->pv_sample[i] = a_alarm_derive(i, now);
+        break;
+      case A_ALARM_WINDOW:
+        a->pv_sample[i] = mgos_alarm_window_sample(MGOS_ALARM_POOL_ENTRY(&s_window_alarms, struct mgos_alarm_window,
+                                                                         a->ext[i]), *a->pv[i], now);
+        break;
+      default:
+        a->pv_sample[i] = *a->pv[i];
+    }
+  }
+  mgos_a_alarm_classify_batch(run, end);
+}
+
+/*
+ * Classify the PV of every analog alarm into the band column
+ */
+static void mgos_a_alarm_classify_all(int64_t now) {
+  int64_t start_us = mgos_uptime_micros();
+  mgos_a_alarm_classify_range(0, s_a_alarm_data.count, now);
+  mgos_alarm_op_done(&s_stats.classify, start_us);
+}
+
+/*
+ * Classify the PV of a single analog alarm into the band column
+ */
+static void mgos_a_alarm_classify_row(uint32_t i, int64_t now) {
+  mgos_a_alarm_classify_range(i, i + 1, now);
+}
+
+/*
+ * Returns the value analog row i was last classified on in engineering
+ * units, NAN if it has not been classified
+ */
+static float a_alarm_value(uint32_t i){
+  struct a_alarm_data *a = &s_a_alarm_data;
+  if(a->kind[i] == A_ALARM_RAW){
+    const struct a_alarm_raw *raw = MGOS_ALARM_POOL_ENTRY(&s_raw_alarms, struct a_alarm_raw, a->ext[i]);
+    return raw->sampled ? (float) raw->sample * raw->scale + raw->offset : NAN;
+  }
+  return a->pv_sample[i];
+}
+
+/*
+ * Returns the band analog row i moves towards once its reset deadband is
+ * applied to band. The alarm holds its band while the value is within 
+ * deadband of that band's setpoint, and one leaving HH (LL) that is still
+ * within deadband of h_sv (l_sv) holds H (L). Moves further out are never
+ * held. A NAN value or setpoint compares false and holds nothing.
+ */
+static uint8_t a_alarm_deadband(uint32_t i, uint8_t band) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  float db = a->deadband[i];
+  float v = a_alarm_value(i);
+  switch(a->state[i]){
+    case HH:
+      if(band != HH && v > a->hh_sv[i] - db) return HH;
+      //fall through
+    case H:
+      if(band != H && band != HH && v > a->h_sv[i] - db) return H;
+      break;
+    case LL:
+      if(band != LL && v < a->ll_sv[i] + db) return LL;
+      //fall through
+    case L:
+      if(band != L && band != LL && v < a->l_sv[i] + db) return L;
+      break;
+  }
+  return band;
+}
+
+/*
+ * Analog alarm set/reset timer logic, band[i] must have been classified
+ * by mgos_a_alarm_classify_all or mgos_a_alarm_classify_row
+ *
+ * When the PV moves into a different band a timer (an SDK timer or a timing
+ * wheel deadline depending on the debounce mode) is started, if the PV
+ * is still in that band when the timer fires the alarm moves into it.
+ */
+static void mgos_a_alarm_logic(uint32_t i) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  uint8_t band = a->band[i];
+  //the PV is back in the current band, clear any pending transition
+  if(band == a->state[i]){
+    a_alarm_cancel_pending(i);
+    return;
+  }
+  //the PV moved into a new band, restart the timer for that band
+  if(band != a->pending_state[i] || (a->timer_id[i] == MGOS_INVALID_TIMER_ID &&
+                                     !mgos_alarm_wheel_armed(&s_wheel, a->slot[i]))){
+    a_alarm_cancel_pending(i);
+    a->pending_state[i] = band;
+    a->timer_id[i] = mgos_alarm_arm_timer(a->slot[i], a->set_interval[i]);
+  }
+}
+
+/*
+ * Analog alarm set/reset timestamp logic, the alarm transitions inline
+ * once the PV has been in a new band for the set interval. band[i] must
+ * have been classified by mgos_a_alarm_classify_all or mgos_a_alarm_classify_row
+ */
+static void mgos_a_alarm_debounce(uint32_t i, int64_t now, struct alarm_shard *shard) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  uint8_t band = a->band[i];
+  if(band == a->state[i]){
+    a->pending_state[i] = band;
+    a->pending_since[i] = ALARM_NOT_PENDING;
+    return;
+  }
+  if(band != a->pending_state[i] || a->pending_since[i] == ALARM_NOT_PENDING){
+    a->pending_state[i] = band;
+    a->pending_since[i] = now;
+  }
+  if(now - a->pending_since[i] >= a->set_interval[i]){
+    a->pending_since[i] = ALARM_NOT_PENDING;
+    if(shard != NULL) shard->a_rows[shard->a_count++] = i;
+    else a_alarm_transition(i);
+  }
+}
+
+/*
+ * Evaluate a digital alarm with the logic of the current debounce mode,
+ * edge captured alarms are always timed from their edge timestamps. A 
+ * shard (only ever run in MGOS_ALARM_DEBOUNCE_TIMESTAMP) records the
+ * transition for the merge instead of making it
+ */
+static void d_alarm_evaluate(uint32_t i, int64_t now, struct alarm_shard *shard) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  if(s_debounce_mode == MGOS_ALARM_DEBOUNCE_TIMESTAMP || alarm_bit_get(d->edge, i)){
+    mgos_d_alarm_debounce(i, now, shard);
+  }
+  else mgos_d_alarm_logic(i);
+  alarm_bit_set(d->pending, i, d->pending_since[i] != ALARM_NOT_PENDING);
+  if(shard != NULL) ++shard->scanned;
+  else ++s_stats.alarms_scanned;
+}
+
+/*
+ * Evaluate a classified analog alarm with the logic of the current debounce
+ * mode, its deadband is applied to the classified band first
+ */
+static void a_alarm_evaluate(uint32_t i, int64_t now, struct alarm_shard *shard) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  if(a->band[i] != a->state[i] && a->deadband[i] > 0) a->band[i] = a_alarm_deadband(i, a->band[i]);
+  if(s_debounce_mode == MGOS_ALARM_DEBOUNCE_TIMESTAMP) mgos_a_alarm_debounce(i, now, shard);
+  else mgos_a_alarm_logic(i);
+  alarm_bit_set(a->pending, i, a->pending_since[i] != ALARM_NOT_PENDING);
+  if(shard != NULL) ++shard->scanned;
+  else ++s_stats.alarms_scanned;
+}
+
+/*
+ * Returns the alarms of one bitset word the scan must evaluate out of
+ * those in filter, every enabled alarm that is not masked when polling
+ * otherwise only the dirty, pending and sampled ones. sampled may be NULL.
+ */
+static uint32_t mgos_alarm_scan_word(const uint32_t *enabled, const uint32_t *masked, const uint32_t *dirty,
+                                     const uint32_t *pending, const uint32_t *sampled, uint32_t w,
+                                     uint32_t filter) {
+  uint32_t bits = enabled[w] & ~masked[w] & filter;
+  if(s_eval_mode != MGOS_ALARM_EVAL_POLL){
+    bits &= dirty[w] | pending[w] | (sampled != NULL ? sampled[w] : 0);
+  }
+  return bits;
+}
+
+/*
+ * Evaluate the alarms in bitset words d_begin to d_end - 1 of the digital
+ * table and a_begin to a_end - 1 of the analog table. A serial pass covers
+ * every word and passes no shard. Parents are evaluated before the other
+ * alarms, shallowest first, so that a parent tripping in this pass masks
+ * its descendants before they can transition, and an alarm masked during
+ * the pass is skipped.
+ */
+static void mgos_alarm_scan_words(uint32_t d_begin, uint32_t d_end, uint32_t a_begin, uint32_t a_end,
+                                  int64_t now, struct alarm_shard *shard) {
+  bool poll = (s_eval_mode == MGOS_ALARM_EVAL_POLL);
+  struct d_alarm_data *d = &s_d_alarm_data;
+  //when polling classify every analog PV in one batch, otherwise classify
+  //only the alarms being evaluated
+  struct a_alarm_data *a = &s_a_alarm_data;
+  uint32_t a_rows = a_end * 32 < a->count ? a_end * 32 : a->count;
+  if(poll && a_begin * 32 < a_rows){
+    if(shard == NULL) mgos_a_alarm_classify_all(now);
+    else{
+      int64_t start_us = mgos_uptime_micros();
+      mgos_a_alarm_classify_range(a_begin * 32, a_rows, now);
+      shard->classify_us = (uint32_t) (mgos_uptime_micros() - start_us);
+    }
+  }
+  //the parents a level of the graph at a time, each evaluated at its own
+  //depth once the levels above may have masked or unmasked it
+  bool deeper = true;
+  for(uint32_t depth = 0; deeper; depth++){
+    deeper = false;
+    for(uint32_t w = d_begin; w < d_end; w++){
+      uint32_t due = mgos_alarm_scan_word(d->enabled, d->masked, d->dirty, d->pending, NULL, w, d->parent[w]);
+      for(uint32_t bits = d->parent[w] & d->enabled[w]; bits; bits &= bits - 1){
+        uint32_t i = w * 32 + __builtin_ctz(bits);
+        uint32_t row_depth = s_alarm_table.slots[d->slot[i]].depth;
+        if(row_depth > depth) deeper = true;
+        if(row_depth != depth || !(due & (bits & -bits))) continue;
+        alarm_bit_set(d->dirty, i, false);
+        d_alarm_evaluate(i, now, shard);
+      }
+    }
+    for(uint32_t w = a_begin; w < a_end; w++){
+      uint32_t due = mgos_alarm_scan_word(a->enabled, a->masked, a->dirty, a->pending, a->sampled, w, a->parent[w]);
+      for(uint32_t bits = a->parent[w] & a->enabled[w]; bits; bits &= bits - 1){
+        uint32_t i = w * 32 + __builtin_ctz(bits);
+        uint32_t row_depth = s_alarm_table.slots[a->slot[i]].depth;
+        if(row_depth > depth) deeper = true;
+        if(row_depth != depth || !(due & (bits & -bits))) continue;
+        alarm_bit_set(a->dirty, i, false);
+        if(!poll) mgos_a_alarm_classify_row(i, now);
+        a_alarm_evaluate(i, now, shard);
+      }
+    }
+  }
+  //iterate through the digital alarms to evaluate a bitset word at a time,
+  //consuming the dirty bits, skipping those masked by a parent on the way
+  for(uint32_t w = d_begin; w < d_end; w++){
+    uint32_t bits = mgos_alarm_scan_word(d->enabled, d->masked, d->dirty, d->pending, NULL, w, ~d->parent[w]);
+    d->dirty[w] = 0;
+    while(bits){
+      uint32_t i = w * 32 + __builtin_ctz(bits);
+      d_alarm_evaluate(i, now, shard);
+      bits &= ~d->masked[w] & (bits - 1);
+    }
+  }
+  for(uint32_t w = a_begin; w < a_end; w++){
+    uint32_t bits = mgos_alarm_scan_word(a->enabled, a->masked, a->dirty, a->pending, a->sampled, w, ~a->parent[w]);
+    a->dirty[w] = 0;
+    while(bits){
+      uint32_t i = w * 32 + __builtin_ctz(bits);
+      if(!poll) mgos_a_alarm_classify_row(i, now);
+      a_alarm_evaluate(i, now, shard);
+      bits &= ~a->masked[w] & (bits - 1);
+    }
+  }
+}
+
 /*
- * analog alarm list structure
+ * Shard function handed to the shard runner, evaluates one shard
  */
-struct a_alarm_data{
-  struct a_alarm_info *current;
-  int length;
-  LIST_HEAD(a_alarms, a_alarm_info) a_alarms;
-};
-
-static struct a_alarm_data *s_a_alarm_data = NULL;
-static struct mgos_rlock_type *s_a_alarm_data_lock = NULL;
+static void mgos_alarm_shard_run(uint32_t index, void *ctx) {
+  struct alarm_shards *shards = (struct alarm_shards *) ctx;
+  if(index >= shards->count) return;
+  struct alarm_shard *shard = &shards->shards[index];
+  shard->d_count = 0;
+  shard->a_count = 0;
+  shard->scanned = 0;
+  shard->classify_us = 0;
+  mgos_alarm_scan_words(shard->d_begin, shard->d_end, shard->a_begin, shard->a_end,
+                        shards->now, shard);
+}
 
 /*
- * Add an analog alarm to the analog alarm list
- * 
+ * Grow a shard's transition row arrays to hold needed rows, due is NULL
+ * for the analog table which records no due times
+ * returns false if memory could not be allocated, the arrays that did
+ * grow are kept and capacity is unchanged
  */
-bool mgos_add_a_alarm(bool enabled, float *pv, float ll_sv, float l_sv,
-                      float h_sv, float hh_sv, int set_interval, 
-                      char *name){
-  //ensure the name is not null
-  if(name == NULL){
-    LOG(LL_ERROR, ("Analog alarm failed to init as name is NULL"));
-    return false;
-  }
-  //ensure the name is not empty
-  if(strcmp(name, "") == 0){
-    LOG(LL_ERROR, ("Analog alarm failed to init as name is empty"));
-    return false;
-  }
-  //allocate memory for struck
-  struct a_alarm_info *aa_info = (struct a_alarm_info *) calloc(1, sizeof(*aa_info));
-  //ensure the accolated memory is not null
-  if(aa_info == NULL){
-    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as allocated memory returned NULL", strlen(name) , name));
-    return false;
-  } 
-  //iterate through the alarm list to ensure that the alarm has a unique name 
-  struct a_alarm_info *aa_info_2;
-  LIST_FOREACH(aa_info_2, &s_a_alarm_data->a_alarms, a_alarm_entries) {
-    if(strcmp(name, aa_info_2->name) == 0){
-      LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as name is not unique", strlen(name) , name));
-      free(aa_info);
-      return false;
-    }
+static bool mgos_alarm_shard_reserve(uint32_t **rows, int64_t **due, uint32_t *capacity, uint32_t needed) {
+  if(needed <= *capacity) return true;
+  uint32_t *data = (uint32_t *) mgos_alarm_realloc(*rows, needed * sizeof(*data));
+  if(data == NULL) return false;
+  *rows = data;
+  if(due != NULL){
+    int64_t *times = (int64_t *) mgos_alarm_realloc(*due, needed * sizeof(*times));
+    if(times == NULL) return false;
+    *due = times;
   }
-  //ensure the alarm sv levels are set correctly ll_sv < l_sv < h_sv < hh_sv
-  float tf = ll_sv;
-  float arr[] = {l_sv, h_sv, hh_sv};
-  for(int i = 0; i < 3; i++){
-    if(arr[i] != NAN){
-      if(tf != NAN){
-        if(tf > arr[i]){
-          LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init due to invalid sv values", strlen(name) , name));
-          return false;
-        }
+  *capacity = needed;
+  return true;
+}
+
+/*
+ * Make the transitions the shards recorded of the parents at depth in the
+ * suppression graph, ALARM_SLOT_NONE for the alarms that are not parents
+ * returns true if a deeper parent recorded a transition
+ */
+static bool mgos_alarm_shards_merge(uint32_t n, uint32_t depth) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  struct a_alarm_data *a = &s_a_alarm_data;
+  bool deeper = false;
+  for(uint32_t k = 0; k < n; k++){
+    struct alarm_shard *shard = &s_shards.shards[k];
+    for(uint32_t j = 0; j < shard->d_count; j++){
+      uint32_t i = shard->d_rows[j];
+      uint32_t row_depth = alarm_bit_get(d->parent, i) ? s_alarm_table.slots[d->slot[i]].depth : ALARM_SLOT_NONE;
+      if(row_depth != depth){
+        if(row_depth > depth && row_depth != ALARM_SLOT_NONE) deeper = true;
       }
-      tf = arr[i];
+      else if(alarm_bit_get(d->edge, i)) d_alarm_transition_at(i, shard->d_due[j]);
+      else d_alarm_transition(i);
     }
   }
-  if(tf == NAN){
-    LOG(LL_ERROR, ("Analog alarm \"%*s\" failed to init as all sv values NAN", strlen(name) , name));
-    return false;
+  for(uint32_t k = 0; k < n; k++){
+    struct alarm_shard *shard = &s_shards.shards[k];
+    for(uint32_t j = 0; j < shard->a_count; j++){
+      uint32_t i = shard->a_rows[j];
+      uint32_t row_depth = alarm_bit_get(a->parent, i) ? s_alarm_table.slots[a->slot[i]].depth : ALARM_SLOT_NONE;
+      if(row_depth == depth) a_alarm_transition(i);
+      else if(row_depth > depth && row_depth != ALARM_SLOT_NONE) deeper = true;
+    }
   }
-  //set alarm struct vars
-  aa_info->name = name;
-  aa_info->enabled = enabled;
-  aa_info->pv = pv;
-  aa_info->ll_sv = ll_sv;
-  aa_info->l_sv = l_sv;
-  aa_info->h_sv = h_sv;
-  aa_info->hh_sv = hh_sv;
-  //increment analog list length
-  ++s_a_alarm_data->length;
-  //ensure that the set & reset intervals are at least 0ms
-  if(set_interval < 0) set_interval = 0;
-  aa_info->set_interval = set_interval;
-  //insert the alarm into the list
-  mgos_rlock(s_a_alarm_data_lock);
-  LOG(LL_ERROR, ("Analog alarm \"%*s\"", strlen(name) , name));
-  LIST_INSERT_HEAD(&s_a_alarm_data->a_alarms, aa_info, a_alarm_entries);
-  mgos_runlock(s_a_alarm_data_lock);
-  return true;
+  return deeper;
 }
 
 /*
- * Add a digital alarm to the digital alarm list
- * 
+ * Sharded pass, the words of each table are split evenly between the
+ * shards, which evaluate them through the shard runner. The shards only
+ * write their own rows and bitset words. The merge then makes the
+ * transitions the shards recorded shard by shard, digital table first,
+ * which is row order and so the same event order as a serial pass, see
+ * mgos_alarm_shards_merge.
+ * returns false if the shard row arrays could not grow, nothing has been
+ * evaluated and the caller falls back to a serial pass
  */
-bool mgos_add_d_alarm(bool enabled, bool *input, enum mgos_d_alarm_mode mode,
-                      int set_interval, int reset_interval, char *name){
-  //ensure the name is not null
-  if(name == NULL){
-    LOG(LL_ERROR, ("Digital alarm failed to init as name is NULL"));
-    return false;
+static bool mgos_alarm_scan_sharded(int64_t now) {
+  uint32_t n = s_shards.count;
+  uint32_t d_words = (s_d_alarm_data.count + 31) / 32;
+  uint32_t a_words = (s_a_alarm_data.count + 31) / 32;
+  for(uint32_t k = 0; k < n; k++){
+    struct alarm_shard *shard = &s_shards.shards[k];
+    shard->d_begin = (uint32_t) ((uint64_t) d_words * k / n);
+    shard->d_end = (uint32_t) ((uint64_t) d_words * (k + 1) / n);
+    shard->a_begin = (uint32_t) ((uint64_t) a_words * k / n);
+    shard->a_end = (uint32_t) ((uint64_t) a_words * (k + 1) / n);
+    if(!mgos_alarm_shard_reserve(&shard->d_rows, &shard->d_due, &shard->d_capacity, (shard->d_end - shard->d_begin) * 32) ||
+       !mgos_alarm_shard_reserve(&shard->a_rows, NULL, &shard->a_capacity, (shard->a_end - shard->a_begin) * 32)){
+      return false;
+    }
   }
-  //ensure the name is not empty
-  if(strcmp(name, "") == 0){
-    LOG(LL_ERROR, ("Digital alarm failed to init as name is empty"));
-    return false;
+  s_shards.now = now;
+  if(s_shards.runner != NULL) s_shards.runner(n, mgos_alarm_shard_run, &s_shards, s_shards.arg);
+  else{
+    for(uint32_t k = 0; k < n; k++) mgos_alarm_shard_run(k, &s_shards);
   }
-  //allocate memory for struck
-  struct d_alarm_info *da_info = (struct d_alarm_info *) calloc(1, sizeof(*da_info));
-  //ensure the accolated memory is not null
-  if(da_info == NULL){
-    LOG(LL_ERROR, ("Digital alarm \"%*s\" failed to init as allocated memory returned NULL", strlen(name) , name));
-    return false;
-  } 
-  //iterate through the alarm list to ensure that the alarm has a unique name 
-  struct d_alarm_info *da_info2;
-  LIST_FOREACH(da_info2, &s_d_alarm_data->d_alarms, d_alarm_entries) {
-    if(strcmp(name, da_info2->name) == 0){
-      LOG(LL_ERROR, ("Digital alarm \"%*s\" failed to init as an alarm with this name already exists", strlen(name) , name));
-      free(da_info);
-      return false;
+  //merge the shards in row order, parents first and shallowest first so
+  //that they mask their descendants before those transitions are made
+  int64_t start_us = mgos_uptime_micros();
+  uint32_t depth = 0;
+  while(mgos_alarm_shards_merge(n, depth)) depth++;
+  mgos_alarm_shards_merge(n, ALARM_SLOT_NONE);
+  for(uint32_t k = 0; k < n; k++){
+    struct alarm_shard *shard = &s_shards.shards[k];
+    s_stats.alarms_scanned += shard->scanned;
+    if(shard->a_begin < shard->a_end && s_eval_mode == MGOS_ALARM_EVAL_POLL){
+      mgos_alarm_op_record(&s_stats.classify, shard->classify_us);
     }
   }
-  //set alarm struct vars
-  da_info->name = name;
-  da_info->enabled = enabled;
-  da_info->input = input;
-  da_info->mode = mode;
-  //increment digital list length
-  ++s_d_alarm_data->length;
-  //ensure that the set & reset intervals are at least 0ms
-  if(set_interval < 0) set_interval = 0;
-  da_info->set_interval = set_interval;
-  if(reset_interval < 0) reset_interval = 0;
-  da_info->reset_interval = reset_interval;
-  //insert the alarm into the list
-  mgos_rlock(s_d_alarm_data_lock);
-  LIST_INSERT_HEAD(&s_d_alarm_data->d_alarms, da_info, d_alarm_entries);
-  mgos_runlock(s_d_alarm_data_lock);
+  mgos_alarm_op_done(&s_stats.merge, start_us);
   return true;
 }
 
 /*
- * Remove an alarm from the alarm lists if it has a name identical
- * to passed string 
+ * Make the pending transition of an edge captured digital alarm if its
+ * interval had run out by time_ms, stamped with the time it ran out
  */
-bool mgos_remove_alarm(char *name){
-  if(name == NULL) return false;
-
-  //loop through digital alarms and check if an alarm with passed name exists
-  struct d_alarm_info *da_info;
-  mgos_rlock(s_d_alarm_data_lock);
-  LIST_FOREACH(da_info, &s_d_alarm_data->d_alarms, d_alarm_entries) {
-    if(strcmp(name, da_info->name) == 0){
-      LIST_REMOVE(da_info, d_alarm_entries);
-      mgos_runlock(s_d_alarm_data_lock);
-      LOG(LL_INFO, ("Digital alarm \"%*s\" has been removed", strlen(name) , name));
-      if(da_info != NULL) free(da_info);
-      //decrement digital alarm list length
-      --s_d_alarm_data->length;
-      return true;
-    }
-  }
-  mgos_runlock(s_d_alarm_data_lock);
-
-  //loop through analog alarms and check if an alarm with passed name exists
-  struct a_alarm_info *aa_info;
-  mgos_rlock(s_a_alarm_data_lock);
-  LIST_FOREACH(aa_info, &s_a_alarm_data->a_alarms, a_alarm_entries) {
-    if(strcmp(name, aa_info->name) == 0){
-      LIST_REMOVE(aa_info, a_alarm_entries);
-      mgos_runlock(s_a_alarm_data_lock);
-      LOG(LL_INFO, ("Analog alarm \"%*s\" has been removed", strlen(name) , name));
-      if(aa_info != NULL) free(aa_info);
-      //decrement analog alarm list length
-      --s_a_alarm_data->length;
-      return true;
-    }
-  }
-  mgos_runlock(s_a_alarm_data_lock);
-
-  //return false if the alarm does not exist
-  LOG(LL_INFO, ("Alarm \"%*s\" does not exist", strlen(name) , name));
-  return false;
+static void d_alarm_edge_due(uint32_t i, int64_t time_ms) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  if(d->pending_since[i] == ALARM_NOT_PENDING) return;
+  int interval = alarm_bit_get(d->active, i) ? d->reset_interval[i] : d->set_interval[i];
+  if(time_ms - d->pending_since[i] < interval) return;
+  int64_t due = d->pending_since[i] + interval;
+  d->pending_since[i] = ALARM_NOT_PENDING;
+  d_alarm_transition_at(i, due);
 }
 
 /*
- * Disable an alarm from the alarm list with the passed name
- * returns true if the alarm is disabled
- * returns false otherwise
- * 
+ * Apply a captured edge to digital alarm row i. The interval pending
+ * before the edge is settled at the edge's time first, so a pulse that
+ * lasted the set interval sets the alarm however soon it ended and one
+ * that did not never does.
  */
-bool mgos_disable_alarm(char *name){
-  if(name == NULL) return false;
-
-  //loop through digital alarms and check if an alarm with passed name exists
-  struct d_alarm_info *da_info;
-  mgos_rlock(s_d_alarm_data_lock);
-  LIST_FOREACH(da_info, &s_d_alarm_data->d_alarms, d_alarm_entries) {
-    if(strcmp(name, da_info->name) == 0){
-      da_info->active = false;
-      da_info->enabled = false;
-      mgos_runlock(s_d_alarm_data_lock);
-      LOG(LL_INFO, ("Digital alarm \"%*s\" has been disabled", strlen(name) , name));
-      return true;
-    }
-  }
-  mgos_runlock(s_d_alarm_data_lock);
-
-  //loop through analog alarms and check if an alarm with passed name exists
-  struct a_alarm_info *aa_info;
-  mgos_rlock(s_a_alarm_data_lock);
-  LIST_FOREACH(aa_info, &s_a_alarm_data->a_alarms, a_alarm_entries) {
-    if(strcmp(name, aa_info->name) == 0){
-      aa_info->state = NOM;
-      aa_info->enabled = false;
-      mgos_runlock(s_a_alarm_data_lock);
-      LOG(LL_INFO, ("Analog alarm \"%*s\" has been disabled", strlen(name) , name));
-      return true;
-    }
-  }
-  mgos_runlock(s_a_alarm_data_lock);
-
-  //return false if the alarm does not exist
-  LOG(LL_INFO, ("Alarm \"%*s\" does not exist", strlen(name) , name));
-  return false;
+static void d_alarm_edge(uint32_t i, bool level, int64_t time_ms) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  if(!alarm_bit_get(d->edge, i)) return;
+  bool enabled = alarm_bit_get(d->enabled, i) && !alarm_bit_get(d->masked, i);
+  if(enabled) d_alarm_edge_due(i, time_ms);
+  alarm_bit_set(d->level, i, level);
+  if(!enabled) return;
+  if(d_alarm_trigger(i) == alarm_bit_get(d->active, i)) d->pending_since[i] = ALARM_NOT_PENDING;
+  else if(d->pending_since[i] == ALARM_NOT_PENDING) d->pending_since[i] = time_ms;
+  //a zero interval transitions on the edge itself
+  d_alarm_edge_due(i, time_ms);
+  alarm_bit_set(d->pending, i, d->pending_since[i] != ALARM_NOT_PENDING);
 }
 
 /*
- * Reset an alarm from the alarm list with the passed name
- * returns true if the alarm is reset
- * returns false otherwise
+ * Consume the edge ring, at most one ring of edges per call so a chattering
+ * input cannot hold the alarm lock indefinitely. An edge can make two
+ * transitions, the event buffer is flushed before it could overflow.
  */
-bool mgos_reset_alarm(char *name){
-  if(name == NULL) return false;
-
-  //loop through digital alarms and check if an alarm with passed name exists
-  struct d_alarm_info *da_info;
-  mgos_rlock(s_d_alarm_data_lock);
-  LIST_FOREACH(da_info, &s_d_alarm_data->d_alarms, d_alarm_entries) {
-    if(strcmp(name, da_info->name) == 0){
-      da_info->active = false;
-      mgos_runlock(s_d_alarm_data_lock);
-      LOG(LL_INFO, ("Digital alarm \"%*s\" has been reset", strlen(name) , name));
-      return true;
+static void mgos_alarm_edges_consume(void) {
+  struct mgos_alarm_edge edge;
+  uint32_t budget = s_edges.size;
+  mgos_rlock(s_alarm_lock);
+  while(budget-- > 0 && mgos_alarm_edge_ring_pop(&s_edges, &edge)){
+    ++s_stats.edges;
+    //edges of removed alarms and of analog handles are discarded
+    uint32_t slot = mgos_alarm_handle_slot(edge.handle);
+    if(slot == ALARM_SLOT_NONE || s_alarm_table.slots[slot].type != DIGITAL) continue;
+    d_alarm_edge(s_alarm_table.slots[slot].row, edge.level, edge.time_us / 1000);
+    //the edge changed the input expressions may read
+    mgos_alarm_expr_mark(slot);
+    if(s_event_buffer.capacity - s_event_buffer.count < 2){
+      mgos_runlock(s_alarm_lock);
+      mgos_alarm_flush_events();
+      mgos_rlock(s_alarm_lock);
     }
   }
-  mgos_runlock(s_d_alarm_data_lock);
+  mgos_runlock(s_alarm_lock);
+}
 
-  //loop through analog alarms and check if an alarm with passed name exists
-  struct a_alarm_info *aa_info;
-  mgos_rlock(s_a_alarm_data_lock);
-  LIST_FOREACH(aa_info, &s_a_alarm_data->a_alarms, a_alarm_entries) {
-    if(strcmp(name, aa_info->name) == 0){
-      aa_info->state = NOM;
-      mgos_runlock(s_a_alarm_data_lock);
-      LOG(LL_INFO, ("Analog alarm \"%*s\" has been reset", strlen(name) , name));
-      return true;
-    }
-  }
-  mgos_runlock(s_a_alarm_data_lock);
+static int64_t mgos_alarm_next_wake(int64_t now);
 
-  //return false if the alarm does not exist
-  LOG(LL_INFO, ("Alarm \"%*s\" does not exist", strlen(name) , name));
-  return false;
+/*
+ * Edge callback invoked by mgos_alarm_edge_push in MGOS_ALARM_EVAL_IMMEDIATE
+ * mode, which consumes the edges, or under MGOS_ALARM_SCHEDULE_ADAPTIVE,
+ * which wakes the engine for them or for the intervals they started
+ */
+static void mgos_alarm_edge_cb(void *arg) {
+  __atomic_store_n(&s_edge_consume_scheduled, false, __ATOMIC_RELEASE);
+  bool immediate = (s_eval_mode == MGOS_ALARM_EVAL_IMMEDIATE);
+  if(immediate){
+    mgos_alarm_edges_consume();
+    mgos_rlock(s_alarm_lock);
+    mgos_alarm_expr_settle(mgos_uptime_micros() / 1000);
+    mgos_runlock(s_alarm_lock);
+    mgos_alarm_flush_events();
+  }
+  if(s_schedule.mode == MGOS_ALARM_SCHEDULE_ADAPTIVE){
+    mgos_rlock(s_alarm_lock);
+    if(immediate) mgos_alarm_schedule_wake(mgos_alarm_next_wake(mgos_uptime_micros() / 1000));
+    else mgos_alarm_wake();
+    mgos_runlock(s_alarm_lock);
+  }
+  (void) arg;
 }
 
 /*
- * Returns an array of alarm_info structs based on alarms in the alarm list
- * returns null if no alarms are returned
+ * Returns the uptime (ms) the pending interval or wheel deadline of digital
+ * alarm row i runs out at, INT64_MAX if nothing is pending
  */
-struct alarm_list * mgos_list_alarms(void){
-  //calc total number of alarms and allocate memory for them
-  int total_alarms = s_a_alarm_data->length + s_d_alarm_data->length;
-  //LOG(LL_INFO, ("%i", total_alarms));
-  struct alarm_list *a_list = calloc(1, sizeof(*a_list));
-  struct alarm_info *a_info = calloc(total_alarms, sizeof(*a_info));
-  a_list->info = a_info;
-  a_list->length = 0;
-
-  //loop through digital alarms and 
-  struct d_alarm_info *da_info;
-  mgos_rlock(s_d_alarm_data_lock);
-  LIST_FOREACH(da_info, &s_d_alarm_data->d_alarms, d_alarm_entries) {
-    //LOG(LL_INFO, ("name %*s", strlen(da_info->name), da_info->name));
-    a_info[a_list->length].name = da_info->name;
-    a_info[a_list->length].enabled = da_info->enabled;
-    a_info[a_list->length].type = DIGITAL;
-    a_info[a_list->length].state.d_state = da_info->active;
-    ++a_list->length;
-  }
-  LOG(LL_INFO, ("%i", a_list->length));
-  mgos_runlock(s_d_alarm_data_lock);
-
-  //loop through analog alarms and check if an alarm with passed name exits
-  struct a_alarm_info *aa_info;
-  mgos_rlock(s_a_alarm_data_lock);
-  LIST_FOREACH(aa_info, &s_a_alarm_data->a_alarms, a_alarm_entries) {
-    a_info[a_list->length].name = aa_info->name;
-    a_info[a_list->length].enabled = aa_info->enabled;
-    a_info[a_list->length].type = ANALOG;
-    a_info[a_list->length].state.a_state = aa_info->state;
-    ++a_list->length;
-  }
-  mgos_runlock(s_a_alarm_data_lock);
+static int64_t d_alarm_deadline(uint32_t i) {
+  struct d_alarm_data *d = &s_d_alarm_data;
+  int64_t next = mgos_alarm_wheel_deadline(&s_wheel, d->slot[i]);
+  if(d->pending_since[i] != ALARM_NOT_PENDING){
+    int interval = alarm_bit_get(d->active, i) ? d->reset_interval[i] : d->set_interval[i];
+    if(d->pending_since[i] + interval < next) next = d->pending_since[i] + interval;
+  }
+  return next;
+}
 
-  return a_list;
+/*
+ * Returns the uptime (ms) the pending interval or wheel deadline of analog
+ * alarm row i runs out at, INT64_MAX if nothing is pending
+ */
+static int64_t a_alarm_deadline(uint32_t i) {
+  struct a_alarm_data *a = &s_a_alarm_data;
+  int64_t next = mgos_alarm_wheel_deadline(&s_wheel, a->slot[i]);
+  if(a->pending_since[i] != ALARM_NOT_PENDING && a->pending_since[i] + a->set_interval[i] < next){
+    next = a->pending_since[i] + a->set_interval[i];
+  }
+  return next;
 }
 
 /*
- * Digital alarm timer callback function
+ * Returns the value of an expression's reference, false for a removed alarm
  */
-static void d_alarm_timer(void *arg) {
-  struct d_alarm_info *da_info = (struct d_alarm_info *) arg;
-  //toggle the alarm state
-  da_info->active = !da_info->active;
-  //build generic alarm info struct 
-  //allocate memory for struc
-  struct alarm_info *a_info = (struct alarm_info *) calloc(1, sizeof(*a_info));
-  //set struct parameters
-  a_info->name = da_info->name;
-  a_info->enabled = da_info->enabled;
-  a_info->type = DIGITAL;
-  a_info->state.d_state = da_info->active ;
-  //if the alarm is now active trigger set ev else trigger reset ev
-  if(da_info->active){
-    mgos_event_trigger(MGOS_ALARM_EV_SET, a_info);
+static bool mgos_alarm_expr_read(const struct mgos_alarm_expr_ref *ref, void *arg){
+  uint32_t slot = mgos_alarm_handle_slot(ref->handle);
+  (void) arg;
+  if(slot == ALARM_SLOT_NONE) return false;
+  uint32_t i = s_alarm_table.slots[slot].row;
+  if(s_alarm_table.slots[slot].type == DIGITAL){
+    if(ref->test == MGOS_ALARM_EXPR_INPUT) return d_alarm_trigger(i);
+    return alarm_bit_get(s_d_alarm_data.active, i);
   }
-  else{
-    mgos_event_trigger(MGOS_ALARM_EV_RESET, a_info);
+  if(ref->test == MGOS_ALARM_EXPR_ACTIVE) return s_a_alarm_data.state[i] != NOM;
+  return s_a_alarm_data.state[i] == ref->test - MGOS_ALARM_EXPR_STATE;
+}
+
+/*
+ * Evaluate the dirty expressions in topological order, and in
+ * MGOS_ALARM_EVAL_POLL those reading an input, then evaluate the alarm of
+ * each whose result changed. An alarm that transitions marks the later
+ * expressions that refer to it, which this walk then reaches.
+ */
+static void mgos_alarm_expr_run(int64_t now){
+  bool poll = (s_eval_mode == MGOS_ALARM_EVAL_POLL);
+  if(s_exprs.dirty == 0 && !(poll && s_exprs.inputs > 0)) return;
+  struct d_alarm_data *d = &s_d_alarm_data;
+  for(uint32_t k = 0; k < s_exprs.count; k++){
+    struct mgos_alarm_expr *e = s_exprs.order[k];
+    if(!e->dirty && !(poll && e->inputs)) continue;
+    if(e->dirty){
+      e->dirty = false;
+      --s_exprs.dirty;
+    }
+    ++s_stats.expr_evals;
+    bool value = mgos_alarm_expr_eval(e, mgos_alarm_expr_read, NULL);
+    if(value == e->value) continue;
+    e->value = value;
+    //a disabled or masked alarm is evaluated once it is enabled or unmasked
+    uint32_t i = s_alarm_table.slots[e->slot].row;
+    if(alarm_bit_get(d->enabled, i) && !alarm_bit_get(d->masked, i)){
+      d_alarm_evaluate(i, now, NULL);
+      mgos_alarm_schedule_wake(d_alarm_deadline(i));
+    }
   }
 }
 
 /*
- * Digital alarm set/reset timer logic
+ * Evaluate the expressions marked dirty by a change made outside a pass,
+ * straight away in MGOS_ALARM_EVAL_IMMEDIATE mode otherwise on a pass woken
+ * for them, must be called with s_alarm_lock held
  */
-static void mgos_d_alarm_logic(struct d_alarm_info *da_info) {
-  bool trigger = false;
-  if((da_info->mode == ACTIVE_HIGH && *da_info->input) ||
-    (da_info->mode == ACTIVE_LOW && !(*da_info->input))){
-    trigger = true;
+static void mgos_alarm_expr_settle(int64_t now){
+  if(s_exprs.dirty == 0) return;
+  if(s_eval_mode == MGOS_ALARM_EVAL_IMMEDIATE) mgos_alarm_expr_run(now);
+  else mgos_alarm_wake();
+}
+
+/*
+ * Returns the uptime (ms) the next pass is needed at under
+ * MGOS_ALARM_SCHEDULE_ADAPTIVE, the earliest pending interval or wheel
+ * deadline, chatter unlatch or rate limiter summary. Inputs that are not
+ * notified can only be polled, in MGOS_ALARM_EVAL_POLL, or while a rate
+ * or deviation alarm is enabled, the pass is never further than 
+ * poll_interval away.
+ * SDK debounce timers fire on their own and need no pass.
+ * returns INT64_MAX if nothing is waiting
+ */
+static int64_t mgos_alarm_next_wake(int64_t now) {
+  int64_t next = mgos_alarm_wheel_next(&s_wheel);
+  if(s_eval_mode == MGOS_ALARM_EVAL_POLL && now + s_schedule.poll_interval < next){
+    next = now + s_schedule.poll_interval;
   }
-  //if the alarm is active
-  if(da_info->active){
-    //if the input is high and the reset timer has been started clear it
-    if(trigger && da_info->timer_id != MGOS_INVALID_TIMER_ID){
-      mgos_clear_timer(da_info->timer_id);
-      da_info->timer_id = MGOS_INVALID_TIMER_ID;
+  struct d_alarm_data *d = &s_d_alarm_data;
+  for(uint32_t w = 0; w < ALARM_BITSET_WORDS(d->capacity); w++){
+    uint32_t bits = d->pending[w] & d->enabled[w];
+    while(bits){
+      int64_t deadline = d_alarm_deadline(w * 32 + __builtin_ctz(bits));
+      if(deadline < next) next = deadline;
+      bits &= bits - 1;
     }
-    //if the input is low start the reset timer
-    else if(!trigger && da_info->timer_id == MGOS_INVALID_TIMER_ID){
-      da_info->timer_id = mgos_set_timer(da_info->reset_interval, 0, d_alarm_timer, da_info);
+  }
+  struct a_alarm_data *a = &s_a_alarm_data;
+  for(uint32_t w = 0; w < ALARM_BITSET_WORDS(a->capacity); w++){
+    if((a->sampled[w] & a->enabled[w]) && now + s_schedule.poll_interval < next){
+      next = now + s_schedule.poll_interval;
+    }
+    uint32_t bits = a->pending[w] & a->enabled[w];
+    while(bits){
+      int64_t deadline = a_alarm_deadline(w * 32 + __builtin_ctz(bits));
+      if(deadline < next) next = deadline;
+      bits &= bits - 1;
     }
-    return;
   }
-  //if the input is low and the set timer has been started clear it
-  if(!trigger && da_info->timer_id != MGOS_INVALID_TIMER_ID){
-    mgos_clear_timer(da_info->timer_id);
-    da_info->timer_id = MGOS_INVALID_TIMER_ID;
+  //latched alarms unlatch, and refused events are summarised, on a pass
+  next = mgos_alarm_chatter_next(&s_chatter, next);
+  return mgos_alarm_rate_next(&s_rate_limit, next);
+}
+
+/*
+ * Main alarm service timer, under MGOS_ALARM_SCHEDULE_ADAPTIVE a one shot
+ * timer that re-arms itself for the next deadline
+ */
+static void mgos_alarm_timer(void *arg) {
+  int64_t start_us = mgos_uptime_micros();
+  int64_t now = start_us / 1000;
+  //edges captured since the last pass are applied before it evaluates
+  mgos_alarm_edges_consume();
+  mgos_rlock(s_alarm_lock);
+  if(s_schedule.mode == MGOS_ALARM_SCHEDULE_ADAPTIVE) s_schedule.timer_id = MGOS_INVALID_TIMER_ID;
+  //process the timing wheel deadlines that expired since the last pass
+  if(s_debounce_mode == MGOS_ALARM_DEBOUNCE_WHEEL){
+    mgos_alarm_wheel_advance(&s_wheel, now);
   }
-  //if the input is high start the set timer 
-  else if(trigger && da_info->timer_id == MGOS_INVALID_TIMER_ID){
-    da_info->timer_id = mgos_set_timer(da_info->set_interval, 0, d_alarm_timer, da_info);
+  //shards only run with timestamp debouncing, arming an SDK timer or a
+  //timing wheel deadline is not local to a shard
+  bool sharded = s_shards.count > 1 && s_debounce_mode == MGOS_ALARM_DEBOUNCE_TIMESTAMP;
+  if(!sharded || !mgos_alarm_scan_sharded(now)){
+    mgos_alarm_scan_words(0, ALARM_BITSET_WORDS(s_d_alarm_data.capacity),
+                          0, ALARM_BITSET_WORDS(s_a_alarm_data.capacity), now, NULL);
   }
+  //the expressions follow the alarms they refer to
+  mgos_alarm_expr_run(now);
+  //unlatch the alarms that stopped chattering and summarise the refused events
+  mgos_alarm_chatter_tick(&s_chatter, now, mgos_alarm_chatter_unlatched, NULL);
+  if(mgos_alarm_rate_tick(&s_rate_limit, now)) ++s_stats.summaries;
+  //free the view arrays retired by alarms added since the last pass
+  mgos_alarm_view_reclaim();
+  //sleep until the earliest deadline, or until an alarm is marked dirty
+  if(s_schedule.mode == MGOS_ALARM_SCHEDULE_ADAPTIVE) mgos_alarm_schedule_wake(mgos_alarm_next_wake(now));
+  mgos_runlock(s_alarm_lock);
+  ++s_stats.ticks;
+  mgos_alarm_op_done(&s_stats.scan, start_us);
+  //the handlers run after the scan has released the tables
+  mgos_alarm_flush_events();
+  (void) arg;
 }
 
 /*
- * Analog alarm timer callback function
+ * Mark the alarm with the passed handle dirty, writing *value to its PV
+ * first if value is not NULL. In MGOS_ALARM_EVAL_IMMEDIATE mode the alarm
+ * is evaluated straight away.
  */
-static void a_alarm_timer(void *arg) {
+static bool mgos_alarm_notify(mgos_alarm_handle_t handle, const float *value){
+  bool res = false;
+  mgos_rlock(s_alarm_lock);
+  uint32_t slot = mgos_alarm_handle_slot(handle);
+  if(slot != ALARM_SLOT_NONE){
+    struct alarm_slot *as = &s_alarm_table.slots[slot];
+    uint32_t i = as->row;
+    bool immediate = (s_eval_mode == MGOS_ALARM_EVAL_IMMEDIATE);
+    int64_t now = mgos_uptime_micros() / 1000;
+    //the wheel of a sleeping engine lags, bring it up to now before arming
+    if(immediate && s_schedule.mode == MGOS_ALARM_SCHEDULE_ADAPTIVE &&
+       s_debounce_mode == MGOS_ALARM_DEBOUNCE_WHEEL){
+      mgos_alarm_wheel_advance(&s_wheel, now);
+    }
+    //an immediate evaluation needs a pass at its deadline, a dirty alarm
+    //needs one now
+    if(as->type == DIGITAL && value == NULL){
+      struct d_alarm_data *d = &s_d_alarm_data;
+      //expressions reading the input
+      mgos_alarm_expr_mark(slot);
+      if(immediate && alarm_bit_get(d->enabled, i) && !alarm_bit_get(d->masked, i)){
+        d_alarm_evaluate(i, now, NULL);
+        mgos_alarm_schedule_wake(d_alarm_deadline(i));
+      }
+      else{
+        alarm_bit_set(d->dirty, i, true);
+        mgos_alarm_wake();
+      }
+      res = true;
+    }
+    else if(as->type == ANALOG && (value == NULL || s_a_alarm_data.kind[i] != A_ALARM_RAW)){
+      struct a_alarm_data *a = &s_a_alarm_data;
+      if(value != NULL) *a->pv[i] = *value;
+      if(immediate && alarm_bit_get(a->enabled, i) && !alarm_bit_get(a->masked, i)){
+        mgos_a_alarm_classify_row(i, now);
+        a_alarm_evaluate(i, now, NULL);
+        mgos_alarm_schedule_wake(a_alarm_deadline(i));
+      }
+      else{
+        alarm_bit_set(a->dirty, i, true);
+        mgos_alarm_wake();
+      }
+      res = true;
+    }
+    if(res) mgos_alarm_expr_settle(now);
+  }
+  if(res) ++s_stats.notifications;
+  mgos_runlock(s_alarm_lock);
+  mgos_alarm_flush_events();
+  return res;
+}
 
+bool mgos_alarm_get_value_h(mgos_alarm_handle_t handle, float *value){
+  if(value == NULL || s_alarm_lock == NULL) return false;
+  bool res = false;
+  mgos_rlock(s_alarm_lock);
+  uint32_t slot = mgos_alarm_handle_slot(handle);
+  if(slot != ALARM_SLOT_NONE && s_alarm_table.slots[slot].type == ANALOG){
+    *value = a_alarm_value(s_alarm_table.slots[slot].row);
+    res = true;
+  }
+  mgos_runlock(s_alarm_lock);
+  return res;
+}
+
+/*
+ * Set the reset deadband of an analog alarm, it is re-evaluated on the
+ * next pass
+ */
+bool mgos_alarm_set_deadband_h(mgos_alarm_handle_t handle, float deadband){
+  if(s_alarm_lock == NULL || !(deadband >= 0)) return false;
+  bool res = false;
+  mgos_rlock(s_alarm_lock);
+  uint32_t slot = mgos_alarm_handle_slot(handle);
+  if(slot != ALARM_SLOT_NONE && s_alarm_table.slots[slot].type == ANALOG){
+    uint32_t i = s_alarm_table.slots[slot].row;
+    s_a_alarm_data.deadband[i] = deadband;
+    alarm_bit_set(s_a_alarm_data.dirty, i, true);
+    mgos_alarm_wake();
+    res = true;
+  }
+  mgos_runlock(s_alarm_lock);
+  return res;
 }
 
 /*
- * Analog alarm set/reset timer logic
+ * Start, change or stop the chatter detection of an alarm. Changing the
+ * limit or window of an alarm keeps its count and latch, a new detection
+ * starts from the alarm's current state.
  */
-static void mgos_a_alarm_logic(struct a_alarm_info *aa_info) {
-  if(aa_info->h_sv != NAN && *aa_info->pv >= aa_info->h_sv && *aa_info->pv < aa_info->hh_sv){
-    if(aa_info->state != H && aa_info->up_timer_id == MGOS_INVALID_TIMER_ID){
-      aa_info->up_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
+bool mgos_alarm_set_chatter_h(mgos_alarm_handle_t handle, uint32_t limit, int window_ms){
+  if(s_alarm_lock == NULL || (limit > 0 && window_ms <= 0)) return false;
+  bool res = false;
+  mgos_rlock(s_alarm_lock);
+  uint32_t slot = mgos_alarm_handle_slot(handle);
+  if(slot != ALARM_SLOT_NONE && limit == 0){
+    chatter_free_slot(slot);
+    res = true;
+  }
+  else if(slot != ALARM_SLOT_NONE){
+    struct alarm_slot *as = &s_alarm_table.slots[slot];
+    if(as->chatter == MGOS_ALARM_POOL_NONE){
+      struct alarm_info info;
+      get_slot_state(slot, &info);
+      if(s_chatter.pool.free_head == MGOS_ALARM_POOL_NONE) ++s_stats.allocs;
+      as->chatter = mgos_alarm_chatter_alloc(&s_chatter, slot, mgos_alarm_info_state(&info),
+                                             mgos_uptime_micros() / 1000);
     }
-    if(aa_info->down_timer_id != MGOS_INVALID_TIMER_ID){
-      aa_info->down_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
+    if(as->chatter != MGOS_ALARM_POOL_NONE){
+      struct mgos_alarm_chatter *c = MGOS_ALARM_CHATTER_ENTRY(&s_chatter, as->chatter);
+      c->limit = limit;
+      c->window_ms = (uint32_t) window_ms;
+      res = true;
     }
-    return;
   }
-  else if(aa_info->l_sv != NAN && *aa_info->pv <= aa_info->l_sv && *aa_info->pv > aa_info->ll_sv){
-    if(aa_info->state != L && aa_info->down_timer_id == MGOS_INVALID_TIMER_ID){
-      aa_info->down_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
+  mgos_runlock(s_alarm_lock);
+  return res;
+}
+
+bool mgos_alarm_set_parent_h(mgos_alarm_handle_t child, mgos_alarm_handle_t parent){
+  if(s_alarm_lock == NULL) return false;
+  bool res = false;
+  mgos_rlock(s_alarm_lock);
+  struct alarm_slot *slots = s_alarm_table.slots;
+  uint32_t slot = mgos_alarm_handle_slot(child);
+  uint32_t p = ALARM_SLOT_NONE;
+  if(parent != MGOS_ALARM_INVALID_HANDLE) p = mgos_alarm_handle_slot(parent);
+  //the parent must exist and must not be the child or below it
+  bool valid = slot != ALARM_SLOT_NONE && (parent == MGOS_ALARM_INVALID_HANDLE || p != ALARM_SLOT_NONE);
+  for(uint32_t s = p; valid && s != ALARM_SLOT_NONE; s = slots[s].parent){
+    if(s == slot) valid = false;
+  }
+  if(valid){
+    struct alarm_slot *as = &slots[slot];
+    mgos_alarm_suppress_unlink(slot);
+    if(p != ALARM_SLOT_NONE){
+      as->parent = p;
+      as->next_sibling = slots[p].first_child;
+      slots[p].first_child = slot;
+      mgos_alarm_parent_update(p);
     }
-    if(aa_info->up_timer_id != MGOS_INVALID_TIMER_ID){
-      aa_info->up_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
-    }      
-    return;
+    mgos_alarm_suppress_depth(slot, p != ALARM_SLOT_NONE ? slots[p].depth + 1 : 0);
+    //mask or unmask the child, and its descendants if that changes whether it masks
+    bool mask = p != ALARM_SLOT_NONE && mgos_alarm_masking(p);
+    if(mask != mgos_alarm_masked(slot)){
+      bool masking = mgos_alarm_masking(slot);
+      mgos_alarm_mask(slot, mask);
+      if(mgos_alarm_masking(slot) != masking) mgos_alarm_suppress_propagate(slot, NULL);
+    }
+    res = true;
+  }
+  mgos_runlock(s_alarm_lock);
+  return res;
+}
+
+bool mgos_alarm_get_first_out(struct alarm_first_out *first_out){
+  if(s_alarm_lock == NULL || first_out == NULL) return false;
+  mgos_rlock(s_alarm_lock);
+  *first_out = s_first_out;
+  mgos_runlock(s_alarm_lock);
+  return first_out->parent != MGOS_ALARM_INVALID_HANDLE;
+}
+
+bool mgos_alarm_input_changed(mgos_alarm_handle_t handle){
+  return mgos_alarm_notify(handle, NULL);
+}
+
+bool mgos_alarm_pv_update(mgos_alarm_handle_t handle, float value){
+  return mgos_alarm_notify(handle, &value);
+}
+
+/*
+ * Switch a digital alarm between edge capture and reading its input, the
+ * captured level starts from the input and any pending transition is
+ * cancelled
+ */
+bool mgos_alarm_set_edge_capture(mgos_alarm_handle_t handle, bool capture){
+  if(s_alarm_lock == NULL) return false;
+  bool res = false;
+  mgos_rlock(s_alarm_lock);
+  uint32_t slot = mgos_alarm_handle_slot(handle);
+  if(slot != ALARM_SLOT_NONE && s_alarm_table.slots[slot].type == DIGITAL &&
+     s_alarm_table.slots[slot].expr == NULL){
+    struct d_alarm_data *d = &s_d_alarm_data;
+    uint32_t i = s_alarm_table.slots[slot].row;
+    d_alarm_cancel_pending(i);
+    if(capture && !alarm_bit_get(d->edge, i)){
+      alarm_bit_set(d->level, i, d->input[i] != NULL && *d->input[i]);
+    }
+    alarm_bit_set(d->edge, i, capture);
+    alarm_bit_set(d->dirty, i, true);
+    mgos_alarm_wake();
+    res = true;
   }
-  else if(aa_info->hh_sv != NAN && *aa_info->pv >= aa_info->hh_sv){
-    if(aa_info->state != HH && aa_info->down_timer_id == MGOS_INVALID_TIMER_ID){
-      aa_info->down_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
+  mgos_runlock(s_alarm_lock);
+  return res;
+}
+
+/*
+ * Push a captured edge, takes no lock so it may be called from an
+ * interrupt handler. In MGOS_ALARM_EVAL_IMMEDIATE mode the edge is consumed
+ * by a callback on the mgos task rather than on the next pass, under
+ * MGOS_ALARM_SCHEDULE_ADAPTIVE the callback wakes the engine.
+ */
+IRAM bool mgos_alarm_edge_push(mgos_alarm_handle_t handle, bool level, int64_t time_us){
+  struct mgos_alarm_edge edge;
+  edge.handle = handle;
+  edge.level = level;
+  edge.time_us = time_us;
+  if(!mgos_alarm_edge_ring_push(&s_edges, &edge)) return false;
+  bool wake = (s_eval_mode == MGOS_ALARM_EVAL_IMMEDIATE ||
+               s_schedule.mode == MGOS_ALARM_SCHEDULE_ADAPTIVE);
+  if(wake && !__atomic_exchange_n(&s_edge_consume_scheduled, true, __ATOMIC_ACQ_REL)){
+    if(!mgos_invoke_cb(mgos_alarm_edge_cb, NULL, true)){
+      __atomic_store_n(&s_edge_consume_scheduled, false, __ATOMIC_RELEASE);
     }
-    if(aa_info->up_timer_id != MGOS_INVALID_TIMER_ID){
-      aa_info->up_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
-    }    
-    return;  
   }
-  else if(aa_info->ll_sv != NAN && *aa_info->pv <= aa_info->ll_sv){
-    if(aa_info->state != LL && aa_info->down_timer_id == MGOS_INVALID_TIMER_ID){
-      aa_info->down_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
+  return true;
+}
+
+/*
+ * Select per-alarm or batched transition events
+ */
+bool mgos_alarm_set_batch_events(bool batch){
+  if(s_alarm_lock == NULL) return false;
+  mgos_rlock(s_alarm_lock);
+  s_batch_events = batch;
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Set the event rate limit, the bucket starts full. Transitions refused
+ * under the previous limit are still summarised.
+ */
+bool mgos_alarm_set_rate_limit(uint32_t max_events, int period_ms){
+  if(s_alarm_lock == NULL || (max_events > 0 && period_ms <= 0)) return false;
+  mgos_rlock(s_alarm_lock);
+  mgos_alarm_rate_set(&s_rate_limit, max_events, (uint32_t) period_ms, mgos_uptime_micros() / 1000);
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Select where the alarm event handlers run and what the dispatch queue
+ * drops when full
+ */
+bool mgos_alarm_set_dispatch_mode(enum mgos_alarm_dispatch_mode mode,
+                                  enum mgos_alarm_overflow_policy policy){
+  if(s_alarm_lock == NULL) return false;
+  if(mode != MGOS_ALARM_DISPATCH_SYNC && mode != MGOS_ALARM_DISPATCH_ASYNC) return false;
+  if(policy != MGOS_ALARM_OVERFLOW_DROP_OLDEST && policy != MGOS_ALARM_OVERFLOW_DROP_NEWEST &&
+     policy != MGOS_ALARM_OVERFLOW_COALESCE) return false;
+  mgos_rlock(s_alarm_lock);
+  s_overflow_policy = policy;
+  s_dispatch_mode = mode;
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Split the scan into shards run by the passed runner, the shard array is
+ * replaced under the alarm lock so no pass is using it
+ */
+bool mgos_alarm_set_shards(uint32_t shards, mgos_alarm_shard_runner runner, void *arg){
+  if(s_alarm_lock == NULL || shards == 0 || shards > MGOS_ALARM_MAX_SHARDS) return false;
+  struct alarm_shard *array = NULL;
+  if(shards > 1){
+    array = (struct alarm_shard *) mgos_alarm_calloc(shards, sizeof(*array), false);
+    if(array == NULL) return false;
+  }
+  mgos_rlock(s_alarm_lock);
+  for(uint32_t k = 0; k < s_shards.count && s_shards.shards != NULL; k++){
+    free(s_shards.shards[k].d_rows);
+    free(s_shards.shards[k].d_due);
+    free(s_shards.shards[k].a_rows);
+  }
+  free(s_shards.shards);
+  s_shards.shards = array;
+  s_shards.count = shards;
+  s_shards.runner = runner;
+  s_shards.arg = arg;
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Switch between the repeating service timer and the one shot timer armed
+ * for the next deadline, the new mode's first pass runs straight away
+ */
+bool mgos_alarm_set_schedule_mode(enum mgos_alarm_schedule_mode mode){
+  if(s_alarm_lock == NULL) return false;
+  if(mode != MGOS_ALARM_SCHEDULE_POLL && mode != MGOS_ALARM_SCHEDULE_ADAPTIVE) return false;
+  mgos_rlock(s_alarm_lock);
+  if(mode != s_schedule.mode){
+    if(s_schedule.timer_id != MGOS_INVALID_TIMER_ID) mgos_alarm_clear_timer(s_schedule.timer_id);
+    s_schedule.timer_id = MGOS_INVALID_TIMER_ID;
+    s_schedule.mode = mode;
+    if(mode == MGOS_ALARM_SCHEDULE_POLL){
+      s_schedule.timer_id = mgos_set_timer(s_schedule.poll_interval, MGOS_TIMER_REPEAT, mgos_alarm_timer, NULL);
     }
-    if(aa_info->up_timer_id != MGOS_INVALID_TIMER_ID){
-      aa_info->up_timer_id = mgos_set_timer(aa_info->set_interval, 0, a_alarm_timer, aa_info);
-    }     
-    return; 
+    else mgos_alarm_wake();
   }
+  mgos_runlock(s_alarm_lock);
+  return true;
 }
 
 /*
- * Main alarm service timer
+ * Select which alarms the scan evaluates, every alarm is marked dirty so
+ * the first pass under the new mode sees them all
  */
-static void mgos_alarm_timer(void *arg) {
-  //iterate through digital alarms
-  struct d_alarm_info *da_info;
-  mgos_rlock(s_d_alarm_data_lock);
-  LIST_FOREACH(da_info, &s_d_alarm_data->d_alarms, d_alarm_entries) {
-    if(da_info->enabled) mgos_d_alarm_logic(da_info);
+bool mgos_alarm_set_eval_mode(enum mgos_alarm_eval_mode mode){
+  if(s_alarm_lock == NULL) return false;
+  if(mode != MGOS_ALARM_EVAL_POLL && mode != MGOS_ALARM_EVAL_CHANGED &&
+     mode != MGOS_ALARM_EVAL_IMMEDIATE) return false;
+  mgos_rlock(s_alarm_lock);
+  for(uint32_t i = 0; i < s_d_alarm_data.count; i++){
+    alarm_bit_set(s_d_alarm_data.dirty, i, true);
+  }
+  for(uint32_t i = 0; i < s_a_alarm_data.count; i++){
+    alarm_bit_set(s_a_alarm_data.dirty, i, true);
+  }
+  s_eval_mode = mode;
+  mgos_alarm_wake();
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Select how pending set/reset transitions are timed,
+ * any transition pending under the previous mode is cancelled and the
+ * alarm marked dirty so it is re-evaluated under the new mode
+ */
+bool mgos_alarm_set_debounce_mode(enum mgos_alarm_debounce_mode mode){
+  if(s_alarm_lock == NULL) return false;
+  if(mode != MGOS_ALARM_DEBOUNCE_TIMER && mode != MGOS_ALARM_DEBOUNCE_TIMESTAMP &&
+     mode != MGOS_ALARM_DEBOUNCE_WHEEL) return false;
+  mgos_rlock(s_alarm_lock);
+  for(uint32_t i = 0; i < s_d_alarm_data.count; i++){
+    d_alarm_cancel_pending(i);
+    alarm_bit_set(s_d_alarm_data.dirty, i, true);
+  }
+  for(uint32_t i = 0; i < s_a_alarm_data.count; i++){
+    a_alarm_cancel_pending(i);
+    alarm_bit_set(s_a_alarm_data.dirty, i, true);
+  }
+  s_debounce_mode = mode;
+  mgos_alarm_wake();
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Copy the alarm engine statistics into the passed struct
+ */
+bool mgos_alarm_get_stats(struct mgos_alarm_stats *stats){
+  if(stats == NULL || s_alarm_lock == NULL) return false;
+  mgos_rlock(s_alarm_lock);
+  *stats = s_stats;
+  stats->d_alarms = s_d_alarm_data.count;
+  stats->a_alarms = s_a_alarm_data.count;
+  stats->classify_kernel = mgos_alarm_classify_kernel();
+  stats->wheel_pending = s_wheel.pending;
+  stats->wheel_expired = s_wheel.expired;
+  stats->event_pool_size = s_event_pool.size;
+  stats->event_pool_high_water = s_event_pool.high_water;
+  stats->event_pool_exhausted = s_event_pool.exhausted;
+  stats->shards = s_shards.count;
+  stats->queue_size = s_queue.size;
+  stats->queue_depth = mgos_alarm_queue_depth(&s_queue);
+  stats->queue_high_water = s_queue.high_water;
+  stats->queue_dropped = s_queue.dropped;
+  stats->queue_coalesced = s_queue.coalesced;
+  stats->edge_ring_size = s_edges.size;
+  stats->edge_ring_high_water = s_edges.high_water;
+  stats->edges_dropped = s_edges.dropped;
+  stats->arena_size = s_arena.size;
+  stats->arena_used = s_arena.used;
+  if(s_arena.base != NULL && s_capacity.d_alarms + s_capacity.a_alarms > 0){
+    stats->bytes_per_alarm = s_arena.used / (s_capacity.d_alarms + s_capacity.a_alarms);
   }
-  mgos_runlock(s_d_alarm_data_lock);
-  
-  //loop through analog alarms and check if an alarm with passed name exists
-  struct a_alarm_info *aa_info;
-  mgos_rlock(s_a_alarm_data_lock);
-  LIST_FOREACH(aa_info, &s_a_alarm_data->a_alarms, a_alarm_entries) {
-    if(aa_info->enabled) mgos_a_alarm_logic(aa_info);
+  stats->alarms_high_water = s_alarm_table.high_water;
+  if(stats->alarms_scanned > 0){
+    stats->scan_ns_per_alarm = (uint32_t) (stats->scan.total_us * 1000 / stats->alarms_scanned);
   }
-  mgos_runlock(s_a_alarm_data_lock);
+  if(stats->scan.count > 0) stats->scan_avg_us = (uint32_t) (stats->scan.total_us / stats->scan.count);
+  int64_t elapsed_ms = mgos_uptime_micros() / 1000 - s_schedule.stats_since_ms;
+  if(elapsed_ms > 0) stats->wakeups_per_hour = (uint32_t) ((uint64_t) stats->ticks * 3600000 / elapsed_ms);
+  mgos_runlock(s_alarm_lock);
+  return true;
+}
+
+/*
+ * Zero the alarm engine statistics counters
+ */
+void mgos_alarm_reset_stats(void){
+  if(s_alarm_lock == NULL) return;
+  mgos_rlock(s_alarm_lock);
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_schedule.stats_since_ms = mgos_uptime_micros() / 1000;
+  mgos_runlock(s_alarm_lock);
 }
 
 /*
- * Initilise alarm list, rlock and main timer routine
+ * Initilise alarm tables, the alarm lock and main timer routine
  */
 bool mgos_alarm_init(int poll_interval) {
   //register alarm event base, exit if this fails
   if (!mgos_event_register_base(MGOS_EVENT_GRP_ALARM, "alm")) {
     return false;
   }
-  //initilise digital and analog list headers
-  struct d_alarm_data *da_data = (struct d_alarm_data *) calloc(1, sizeof(*da_data));
-  struct a_alarm_data *aa_data = (struct a_alarm_data *) calloc(1, sizeof(*aa_data));
-  //if memory is not allocated for either list exit
-  if(da_data == NULL) return false;
-  if(aa_data == NULL) return false;
-  //set list header pointer to allocated memory pointer 
-  s_d_alarm_data = da_data;
-  s_d_alarm_data->length = 0;
-  s_a_alarm_data = aa_data;
-  s_a_alarm_data->length = 0;
-  //create recursive lock 
-  s_d_alarm_data_lock = mgos_rlock_create();
-  s_a_alarm_data_lock = mgos_rlock_create();
-  //set alarm master checker
-  mgos_set_timer(poll_interval, MGOS_TIMER_REPEAT, mgos_alarm_timer, NULL);
+  //allocate the event payload pool, no payloads are allocated after this
+  s_event_pool.payloads = (struct alarm_info *) mgos_alarm_calloc(MGOS_ALARM_EVENT_POOL_SIZE,
+                                                                  sizeof(*s_event_pool.payloads), false);
+  s_event_pool.free = (struct alarm_info **) mgos_alarm_calloc(MGOS_ALARM_EVENT_POOL_SIZE,
+                                                               sizeof(*s_event_pool.free), false);
+  if(s_event_pool.payloads == NULL || s_event_pool.free == NULL) return false;
+  s_event_pool.size = MGOS_ALARM_EVENT_POOL_SIZE;
+  for(size_t i = 0; i < s_event_pool.size; i++){
+    s_event_pool.free[i] = &s_event_pool.payloads[i];
+  }
+  s_event_pool.free_count = s_event_pool.size;
+  //allocate the dispatch queue, used once MGOS_ALARM_DISPATCH_ASYNC is selected
+  if(!mgos_alarm_queue_init(&s_queue, MGOS_ALARM_DISPATCH_QUEUE_SIZE)) return false;
+  //allocate the edge ring, the producer never allocates
+  if(!mgos_alarm_edge_ring_init(&s_edges, MGOS_ALARM_EDGE_RING_SIZE)) return false;
+  //create recursive lock
+  s_alarm_lock = mgos_rlock_create();
+  s_shards.count = 1;
+  mgos_alarm_pool_init(&s_raw_alarms, sizeof(struct a_alarm_raw));
+  mgos_alarm_pool_init(&s_derived_alarms, sizeof(struct a_alarm_derived));
+  mgos_alarm_pool_init(&s_window_alarms, sizeof(struct mgos_alarm_window));
+  mgos_alarm_chatter_init(&s_chatter);
+  mgos_alarm_pool_init(&s_expr_deps, sizeof(struct alarm_expr_dep));
+  //the timing wheel advances one slot per poll_interval, its entries are
+  //reserved as the alarm table grows
+  mgos_alarm_wheel_init(&s_wheel, poll_interval, mgos_uptime_micros() / 1000,
+                        mgos_alarm_wheel_expired, NULL);
+  //set alarm master checker, repeating until MGOS_ALARM_SCHEDULE_ADAPTIVE is selected
+  s_schedule.poll_interval = poll_interval;
+  s_schedule.stats_since_ms = mgos_uptime_micros() / 1000;
+  s_schedule.timer_id = mgos_set_timer(poll_interval, MGOS_TIMER_REPEAT, mgos_alarm_timer, NULL);
   //init successful
   return true;
-}
\ No newline at end of file
+}
+
+/*
+ * Rows reserved in a table for count alarms, the bitsets need a multiple
+ * of 32
+ */
+#define ALARM_ROWS_RESERVED(count) (((count) + 31) / 32 * 32)
+
+/*
+ * v with every bit below its highest set bit set
+ */
+#define ALARM_SMEAR_1(v) ((v) | (v) >> 1)
+#define ALARM_SMEAR_2(v) (ALARM_SMEAR_1(v) | ALARM_SMEAR_1(v) >> 2)
+#define ALARM_SMEAR_4(v) (ALARM_SMEAR_2(v) | ALARM_SMEAR_2(v) >> 4)
+#define ALARM_SMEAR_8(v) (ALARM_SMEAR_4(v) | ALARM_SMEAR_4(v) >> 8)
+#define ALARM_SMEAR_16(v) (ALARM_SMEAR_8(v) | ALARM_SMEAR_8(v) >> 16)
+
+/*
+ * Name index capacity reserved for the passed number of alarms, the
+ * smallest power of two of at least twice the alarms. At half load or less
+ * an insert never needs the index to grow.
+ */
+#define ALARM_INDEX_RESERVED(alarms) ((alarms) * 2 <= ALARM_INDEX_MIN_CAPACITY ? \
+                                      ALARM_INDEX_MIN_CAPACITY : ALARM_SMEAR_16((uint32_t) (alarms) * 2 - 1) + 1)
+
+/*
+ * Bytes of an arena block holding count elements of type
+ */
+#define ALARM_ARENA_BYTES(count, type) MGOS_ALARM_ARENA_BLOCK((size_t) (count) * sizeof(type))
+
+/*
+ * Arena bytes mgos_alarm_init_ex reserves, one aligned block for every
+ * allocation made by mgos_alarm_init and mgos_alarm_reserve. A constant
+ * expression for constant arguments.
+ */
+#define ALARM_ARENA_SIZE(d_alarms, a_alarms, name_len) ( \
+    ALARM_ARENA_BYTES(MGOS_ALARM_EVENT_POOL_SIZE, struct alarm_info) + \
+    ALARM_ARENA_BYTES(MGOS_ALARM_EVENT_POOL_SIZE, struct alarm_info *) + \
+    ALARM_ARENA_BYTES(MGOS_ALARM_DISPATCH_QUEUE_SIZE, struct mgos_alarm_queue_entry) + \
+    ALARM_ARENA_BYTES(MGOS_ALARM_EDGE_RING_SIZE, struct mgos_alarm_edge) \
+    D_ALARM_COLUMN_LIST(ALARM_COLUMN_BYTES, ALARM_ROWS_RESERVED(d_alarms)) + \
+    9 * ALARM_ARENA_BYTES(ALARM_BITSET_WORDS(ALARM_ROWS_RESERVED(d_alarms)), uint32_t) + \
+    ALARM_ARENA_BYTES(ALARM_ROWS_RESERVED(d_alarms), struct alarm_info) \
+    A_ALARM_COLUMN_LIST(ALARM_COLUMN_BYTES, ALARM_ROWS_RESERVED(a_alarms)) + \
+    6 * ALARM_ARENA_BYTES(ALARM_BITSET_WORDS(ALARM_ROWS_RESERVED(a_alarms)), uint32_t) + \
+    ALARM_ARENA_BYTES(ALARM_ROWS_RESERVED(a_alarms), struct alarm_info) + \
+    ALARM_ARENA_BYTES((d_alarms) + (a_alarms), struct mgos_alarm_wheel_entry) + \
+    ALARM_ARENA_BYTES((d_alarms) + (a_alarms), struct alarm_view_slot) + \
+    ALARM_ARENA_BYTES((d_alarms) + (a_alarms), struct alarm_slot) + \
+    2 * ALARM_ARENA_BYTES(ALARM_INDEX_RESERVED((d_alarms) + (a_alarms)), struct alarm_index_entry) + \
+    2 * ALARM_ARENA_BYTES((d_alarms) + (a_alarms) + 1, struct alarm_transition) + \
+    ((name_len) > 0 ? ALARM_ARENA_BYTES((size_t) ((d_alarms) + (a_alarms)) * ((name_len) + 1), char) : 0))
+
+/*
+ * Returns the bytes mgos_alarm_init_ex reserves
+ */
+size_t mgos_alarm_arena_size(const struct mgos_alarm_capacity *capacity){
+  if(capacity == NULL) return 0;
+  return ALARM_ARENA_SIZE(capacity->d_alarms, capacity->a_alarms, capacity->name_len);
+}
+
+/*
+ * Allocate every table at the capacity reserved by mgos_alarm_init_ex,
+ * must be called with the arena open
+ * returns false if the arena is too small
+ */
+static bool mgos_alarm_reserve(const struct mgos_alarm_capacity *capacity){
+  uint32_t d_rows = ALARM_ROWS_RESERVED(capacity->d_alarms);
+  uint32_t a_rows = ALARM_ROWS_RESERVED(capacity->a_alarms);
+  uint32_t alarms = capacity->d_alarms + capacity->a_alarms;
+  size_t index = ALARM_INDEX_RESERVED(alarms);
+  if(d_rows > 0 && !d_alarm_grow(d_rows)) return false;
+  if(a_rows > 0 && !a_alarm_grow(a_rows)) return false;
+  if(!mgos_alarm_slots_grow(alarms)) return false;
+  //the spare is taken after the index so that a resize swaps the two
+  if(!mgos_alarm_index_resize(index)) return false;
+  s_alarm_index.spare = (struct alarm_index_entry *) mgos_alarm_calloc(index, sizeof(*s_alarm_index.spare),
+                                                                       false);
+  if(s_alarm_index.spare == NULL) return false;
+  if(!mgos_alarm_event_grow(&s_event_buffer.events, &s_event_buffer.capacity, alarms + 1) ||
+     !mgos_alarm_event_grow(&s_event_buffer.spare, &s_event_buffer.spare_capacity, alarms + 1)) return false;
+  if(capacity->name_len > 0){
+    s_names = (char *) mgos_alarm_calloc(alarms, capacity->name_len + 1, false);
+    if(s_names == NULL) return false;
+  }
+  return true;
+}
+
+/*
+ * Initilise with every table reserved in s_arena for capacity
+ */
+static bool mgos_alarm_init_reserved(int poll_interval, const struct mgos_alarm_capacity *capacity){
+  s_capacity = *capacity;
+  //every allocation made until the arena is closed is carved from it
+  mgos_alarm_arena_open(&s_arena);
+  bool ok = mgos_alarm_init(poll_interval) && mgos_alarm_reserve(capacity);
+  mgos_alarm_arena_close();
+  if(ok){
+    LOG(LL_INFO, ("Alarm tables reserved for %u digital and %u analog alarms in %u bytes",
+                  (unsigned) capacity->d_alarms, (unsigned) capacity->a_alarms, (unsigned) s_arena.used));
+  }
+  return ok;
+}
+
+/*
+ * Initilise as mgos_alarm_init with every table carved out of one arena
+ */
+bool mgos_alarm_init_ex(int poll_interval, const struct mgos_alarm_capacity *capacity){
+  if(capacity == NULL) return false;
+  uint32_t alarms = capacity->d_alarms + capacity->a_alarms;
+  if(alarms == 0 || alarms > ALARM_HANDLE_INDEX_MASK + 1) return false;
+  if(!mgos_alarm_arena_init(&s_arena, mgos_alarm_arena_size(capacity))) return false;
+  return mgos_alarm_init_reserved(poll_interval, capacity);
+}
+
+/*
+ * capacity of mgos_alarm_init_static, the static alarm tables are sized 
+ * at build time from these, with neither set the tables are reserved on 
+ * the heap at the size of the table passed
+ */
+#ifndef MGOS_ALARM_STATIC_D_ALARMS
+#define MGOS_ALARM_STATIC_D_ALARMS 0
+#endif
+
+#ifndef MGOS_ALARM_STATIC_A_ALARMS
+#define MGOS_ALARM_STATIC_A_ALARMS 0
+#endif
+
+#define ALARM_STATIC_ALARMS (MGOS_ALARM_STATIC_D_ALARMS + MGOS_ALARM_STATIC_A_ALARMS)
+
+#if ALARM_STATIC_ALARMS > 0
+/*
+ * RAM the static alarm tables are carved from, in words so that it is
+ * aligned like a heap block
+ */
+static uint64_t s_static_arena[ALARM_ARENA_SIZE(MGOS_ALARM_STATIC_D_ALARMS, MGOS_ALARM_STATIC_A_ALARMS, 0) /
+                               sizeof(uint64_t)];
+#endif
+
+/*
+ * Initilise with the alarms of a static table added straight into the
+ * reserved tables, the generator has checked them so they are neither 
+ * validated nor indexed here
+ */
+/*
+ * Check that a static table's counts match its descriptors and that it
+ * has the seeds to look its names up
+ * returns NULL if it is valid, otherwise the reason it is not
+ */
+static const char *mgos_alarm_static_check(const struct mgos_alarm_static_table *table){
+  if(table->defs == NULL || table->count == 0) return "is empty";
+  if(table->count > ALARM_HANDLE_INDEX_MASK + 1) return "has too many alarms";
+  if(table->seeds == NULL || table->seed_count == 0) return "has no perfect hash seeds";
+  uint32_t d_alarms = 0;
+  for(uint32_t i = 0; i < table->count; i++){
+    const struct mgos_alarm_def *def = &table->defs[i];
+    if(def->type == DIGITAL ? def->input == NULL : def->pv == NULL) return "has an alarm without an input";
+    if(def->type == DIGITAL) d_alarms++;
+  }
+  if(d_alarms != table->d_alarms || table->count - d_alarms != table->a_alarms){
+    return "has counts that do not match its alarms";
+  }
+  return NULL;
+}
+
+bool mgos_alarm_init_static(int poll_interval, const struct mgos_alarm_static_table *table){
+  if(table == NULL) return false;
+  const char *error = mgos_alarm_static_check(table);
+  if(error != NULL){
+    LOG(LL_ERROR, ("Static alarm table %s", error));
+    return false;
+  }
+#if ALARM_STATIC_ALARMS > 0
+  if(table->d_alarms > MGOS_ALARM_STATIC_D_ALARMS || table->a_alarms > MGOS_ALARM_STATIC_A_ALARMS){
+    LOG(LL_ERROR, ("Static alarm table of %u digital and %u analog alarms exceeds MGOS_ALARM_STATIC_D_ALARMS "
+                   "or MGOS_ALARM_STATIC_A_ALARMS", (unsigned) table->d_alarms, (unsigned) table->a_alarms));
+    return false;
+  }
+  const struct mgos_alarm_capacity capacity = {MGOS_ALARM_STATIC_D_ALARMS, MGOS_ALARM_STATIC_A_ALARMS, 0};
+  mgos_alarm_arena_init_static(&s_arena, s_static_arena, sizeof(s_static_arena));
+#else
+  const struct mgos_alarm_capacity capacity = {table->d_alarms, table->a_alarms, 0};
+  if(!mgos_alarm_arena_init(&s_arena, mgos_alarm_arena_size(&capacity))) return false;
+#endif
+  if(!mgos_alarm_init_reserved(poll_interval, &capacity)) return false;
+  //the free list hands out the slots in order, so alarm i takes slot i
+  mgos_rlock(s_alarm_lock);
+  for(uint32_t i = 0; i < table->count; i++){
+    const struct mgos_alarm_def *def = &table->defs[i];
+    uint32_t slot = mgos_alarm_slot_alloc(def->type, def->hash);
+    if(def->type == DIGITAL){
+      d_alarm_append(slot, def->enabled, def->input, def->mode, def->set_interval,
+                     def->reset_interval, (char *) def->name);
+    }
+    else{
+      a_alarm_append(slot, def->enabled, def->pv, def->ll_sv, def->l_sv, def->h_sv,
+                     def->hh_sv, def->set_interval, (char *) def->name);
+    }
+  }
+  s_static = table;
+  mgos_runlock(s_alarm_lock);
+  LOG(LL_INFO, ("Static alarm table of %u alarms has been added", (unsigned) table->count));
+  return true;
+}
+
+/*
+ * Returns the handle of the alarm held by slot index if it is still the
+ * static alarm
+ */
+mgos_alarm_handle_t mgos_alarm_static_handle(uint32_t index){
+  mgos_alarm_handle_t handle = MGOS_ALARM_INVALID_HANDLE;
+  if(s_static == NULL || index >= s_static->count) return handle;
+  mgos_rlock(s_alarm_lock);
+  if(s_alarm_table.slots[index].used && mgos_alarm_slot_name(index) == s_static->defs[index].name){
+    handle = mgos_alarm_handle(index);
+  }
+  mgos_runlock(s_alarm_lock);
+  return handle;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_arena.h"
+
+/*
+ * the arena allocations are carved from, NULL while none is open
+ */
+static struct mgos_alarm_arena *s_open_arena = NULL;
+
+/*
+ * Allocate the arena block, calloc'd so every carved block starts zeroed
+ */
+bool mgos_alarm_arena_init(struct mgos_alarm_arena *arena, size_t size){
+  arena->base = (uint8_t *) calloc(1, size);
+  if(arena->base == NULL) return false;
+  arena->size = size;
+  arena->used = 0;
+  return true;
+}
+
+void mgos_alarm_arena_init_static(struct mgos_alarm_arena *arena, void *buf, size_t size){
+  arena->base = (uint8_t *) buf;
+  arena->size = size;
+  arena->used = 0;
+}
+
+void mgos_alarm_arena_open(struct mgos_alarm_arena *arena){
+  s_open_arena = arena;
+}
+
+void mgos_alarm_arena_close(void){
+  s_open_arena = NULL;
+}
+
+/*
+ * Carve the next aligned block from the open arena
+ */
+static void *arena_carve(size_t size){
+  struct mgos_alarm_arena *arena = s_open_arena;
+  size = MGOS_ALARM_ARENA_BLOCK(size);
+  if(size > arena->size - arena->used) return NULL;
+  void *data = arena->base + arena->used;
+  arena->used += size;
+  return data;
+}
+
+void *mgos_alarm_arena_calloc(size_t num, size_t size){
+  if(s_open_arena == NULL) return calloc(num, size);
+  return arena_carve(num * size);
+}
+
+void *mgos_alarm_arena_realloc(void *ptr, size_t size){
+  if(s_open_arena == NULL) return realloc(ptr, size);
+  return ptr == NULL ? arena_carve(size) : NULL;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Alarm storage arena of mgos_alarm_init_ex
+ *
+ * One heap block that every alarm module carves its tables out of while
+ * the arena is open. The blocks are never freed or grown, so once the
+ * reservation is made the library allocates nothing more for its tables
+ * and cannot fragment the heap. While no arena is open the allocation
+ * functions fall back to the heap.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_ARENA_H_
+#define CS_FW_SRC_MGOS_ALARM_ARENA_H_
+
+#include "mgos.h"
+
+/*
+ * every block is aligned to this many bytes
+ */
+#define MGOS_ALARM_ARENA_ALIGN 8
+
+/*
+ * Returns size rounded up to a whole number of aligned blocks
+ */
+#define MGOS_ALARM_ARENA_BLOCK(size) \
+  (((size) + MGOS_ALARM_ARENA_ALIGN - 1) & ~((size_t) MGOS_ALARM_ARENA_ALIGN - 1))
+
+/*
+ * arena
+ *
+ * base - the heap block, NULL if no arena has been allocated
+ * size - bytes in the block
+ * used - bytes carved from the block
+ */
+struct mgos_alarm_arena{
+  uint8_t *base;
+  size_t size, used;
+};
+
+/*
+ * Allocate a zeroed arena of size bytes
+ * returns false if memory could not be allocated
+ */
+bool mgos_alarm_arena_init(struct mgos_alarm_arena *arena, size_t size);
+
+/*
+ * Use a zeroed static buffer of size bytes as the arena
+ */
+void mgos_alarm_arena_init_static(struct mgos_alarm_arena *arena, void *buf, size_t size);
+
+/*
+ * Direct mgos_alarm_arena_calloc and mgos_alarm_arena_realloc to the
+ * passed arena until mgos_alarm_arena_close
+ */
+void mgos_alarm_arena_open(struct mgos_alarm_arena *arena);
+void mgos_alarm_arena_close(void);
+
+/*
+ * Zeroed allocation of num elements of size bytes, carved from the open
+ * arena or taken from the heap
+ * returns NULL if memory could not be allocated
+ */
+void *mgos_alarm_arena_calloc(size_t num, size_t size);
+
+/*
+ * realloc, while an arena is open only a NULL ptr can be "grown" as arena
+ * blocks have no room after them
+ * returns NULL if memory could not be allocated
+ */
+void *mgos_alarm_arena_realloc(void *ptr, size_t size);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_ARENA_H_ */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_chatter.h"
+
+void mgos_alarm_chatter_init(struct mgos_alarm_chatter_set *set){
+  mgos_alarm_pool_init(&set->pool, sizeof(struct mgos_alarm_chatter));
+  set->latched = MGOS_ALARM_POOL_NONE;
+}
+
+/*
+ * Take a latched entry off the latched list
+ */
+static void chatter_unlink(struct mgos_alarm_chatter_set *set, uint32_t index){
+  uint32_t *link = &set->latched;
+  while(*link != index) link = &MGOS_ALARM_CHATTER_ENTRY(set, *link)->next_latched;
+  *link = MGOS_ALARM_CHATTER_ENTRY(set, index)->next_latched;
+}
+
+uint32_t mgos_alarm_chatter_alloc(struct mgos_alarm_chatter_set *set, uint32_t slot, uint8_t reported,
+                                  int64_t now){
+  uint32_t index = mgos_alarm_pool_alloc(&set->pool);
+  if(index == MGOS_ALARM_POOL_NONE) return index;
+  struct mgos_alarm_chatter *c = MGOS_ALARM_CHATTER_ENTRY(set, index);
+  c->next_latched = MGOS_ALARM_POOL_NONE;
+  c->slot = slot;
+  c->start_ms = now;
+  c->last_ms = now;
+  c->reported = reported;
+  return index;
+}
+
+void mgos_alarm_chatter_free(struct mgos_alarm_chatter_set *set, uint32_t index){
+  if(MGOS_ALARM_CHATTER_ENTRY(set, index)->latched) chatter_unlink(set, index);
+  mgos_alarm_pool_free(&set->pool, index);
+}
+
+void mgos_alarm_chatter_restart(struct mgos_alarm_chatter_set *set, uint32_t index, int64_t now){
+  struct mgos_alarm_chatter *c = MGOS_ALARM_CHATTER_ENTRY(set, index);
+  if(c->latched) chatter_unlink(set, index);
+  c->latched = false;
+  c->start_ms = now;
+  c->count = 0;
+  c->prev = 0;
+  c->reported = 0;
+}
+
+/*
+ * Count a transition made at time_ms, rolling the fixed windows forward
+ * returns the sliding window estimate of the transitions in the last
+ * window_ms, the transition included
+ */
+static uint32_t chatter_count(struct mgos_alarm_chatter *c, int64_t time_ms){
+  int64_t elapsed = time_ms - c->start_ms;
+  if(elapsed >= c->window_ms){
+    int64_t windows = elapsed / c->window_ms;
+    c->prev = windows == 1 ? c->count : 0;
+    c->count = 0;
+    c->start_ms += windows * c->window_ms;
+    elapsed -= windows * c->window_ms;
+  }
+  //an edge can be stamped before the current window started
+  else if(elapsed < 0) elapsed = 0;
+  ++c->count;
+  if(time_ms > c->last_ms) c->last_ms = time_ms;
+  return c->count + (uint32_t) ((uint64_t) c->prev * (uint64_t) (c->window_ms - elapsed) / c->window_ms);
+}
+
+enum mgos_alarm_chatter_verdict mgos_alarm_chatter_transition(struct mgos_alarm_chatter_set *set, uint32_t index,
+                                                              int64_t time_ms, uint8_t state){
+  struct mgos_alarm_chatter *c = MGOS_ALARM_CHATTER_ENTRY(set, index);
+  uint32_t count = chatter_count(c, time_ms);
+  if(c->latched) return MGOS_ALARM_CHATTER_SUPPRESS;
+  c->reported = state;
+  if(count <= c->limit) return MGOS_ALARM_CHATTER_RAISE;
+  c->latched = true;
+  c->next_latched = set->latched;
+  set->latched = index;
+  return MGOS_ALARM_CHATTER_LATCH;
+}
+
+void mgos_alarm_chatter_tick(struct mgos_alarm_chatter_set *set, int64_t now, mgos_alarm_chatter_fn fn,
+                             void *arg){
+  uint32_t *link = &set->latched;
+  while(*link != MGOS_ALARM_POOL_NONE){
+    struct mgos_alarm_chatter *c = MGOS_ALARM_CHATTER_ENTRY(set, *link);
+    if(now - c->last_ms < c->window_ms){
+      link = &c->next_latched;
+      continue;
+    }
+    *link = c->next_latched;
+    c->latched = false;
+    c->start_ms = now;
+    c->count = 0;
+    c->prev = 0;
+    fn(c, now, arg);
+  }
+}
+
+int64_t mgos_alarm_chatter_next(const struct mgos_alarm_chatter_set *set, int64_t next){
+  for(uint32_t index = set->latched; index != MGOS_ALARM_POOL_NONE;){
+    const struct mgos_alarm_chatter *c = MGOS_ALARM_CHATTER_ENTRY(set, index);
+    if(c->last_ms + c->window_ms < next) next = c->last_ms + c->window_ms;
+    index = c->next_latched;
+  }
+  return next;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Chatter detection, see mgos_alarm_set_chatter_h
+ *
+ * Each alarm with chatter detection has an entry in a pool, referenced
+ * from its alarm table slot. An entry counts the alarm's transitions in
+ * two fixed windows, and weighs the previous window by how much of it
+ * the sliding window still covers, so each alarm costs O(1) memory. An
+ * alarm over its limit latches and its transitions are suppressed until
+ * a window passes without one. Latched entries are chained on a list so
+ * a pass only walks those.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_CHATTER_H_
+#define CS_FW_SRC_MGOS_ALARM_CHATTER_H_
+
+#include "mgos.h"
+#include "mgos_alarm_pool.h"
+
+/*
+ * chatter detection of an alarm
+ *
+ * next_latched - the next entry in the latched list while latched
+ * slot - the alarm table slot of the alarm
+ * limit - transitions allowed per window
+ * window_ms - the window
+ * start_ms - uptime (ms) the current fixed window started at
+ * count, prev - transitions in the current and the previous fixed window
+ * last_ms - uptime (ms) of the alarm's last transition
+ * latched - the alarm's transitions raise no events
+ * reported - the state last raised, d_state or a_state as the alarm's type
+ */
+struct mgos_alarm_chatter{
+  uint32_t next_latched;
+  uint32_t slot;
+  uint32_t limit, window_ms;
+  int64_t start_ms;
+  uint32_t count, prev;
+  int64_t last_ms;
+  bool latched;
+  uint8_t reported;
+};
+
+/*
+ * the chatter detection of every alarm
+ *
+ * pool - the entries
+ * latched - first entry of the latched list, MGOS_ALARM_POOL_NONE if none
+ */
+struct mgos_alarm_chatter_set{
+  struct mgos_alarm_pool pool;
+  uint32_t latched;
+};
+
+/*
+ * what a transition does, see mgos_alarm_chatter_transition
+ * MGOS_ALARM_CHATTER_RAISE - the transition is raised
+ * MGOS_ALARM_CHATTER_LATCH - the transition took the alarm over its limit
+ *   and latched it, it is raised as MGOS_ALARM_EV_CHATTER
+ * MGOS_ALARM_CHATTER_SUPPRESS - the alarm is latched, nothing is raised
+ */
+enum mgos_alarm_chatter_verdict{
+  MGOS_ALARM_CHATTER_RAISE,
+  MGOS_ALARM_CHATTER_LATCH,
+  MGOS_ALARM_CHATTER_SUPPRESS
+};
+
+/*
+ * called for each alarm that unlatched, with the time it unlatched at
+ */
+typedef void (*mgos_alarm_chatter_fn)(struct mgos_alarm_chatter *chatter, int64_t now, void *arg);
+
+/*
+ * Returns entry index of a set, the pointer is only valid until the pool
+ * next grows
+ */
+#define MGOS_ALARM_CHATTER_ENTRY(set, index) \
+  MGOS_ALARM_POOL_ENTRY(&(set)->pool, struct mgos_alarm_chatter, index)
+
+/*
+ * Initialise an empty set, nothing is allocated
+ */
+void mgos_alarm_chatter_init(struct mgos_alarm_chatter_set *set);
+
+/*
+ * Start the chatter detection of the alarm held by slot, whose state is
+ * reported, with its first window at now
+ * returns the entry, MGOS_ALARM_POOL_NONE if memory could not be allocated
+ */
+uint32_t mgos_alarm_chatter_alloc(struct mgos_alarm_chatter_set *set, uint32_t slot, uint8_t reported,
+                                  int64_t now);
+
+/*
+ * Stop the chatter detection of an entry, unlatching it
+ */
+void mgos_alarm_chatter_free(struct mgos_alarm_chatter_set *set, uint32_t index);
+
+/*
+ * Unlatch an entry and restart its count at now, its alarm is back in NOM
+ * or inactive without an event
+ */
+void mgos_alarm_chatter_restart(struct mgos_alarm_chatter_set *set, uint32_t index, int64_t now);
+
+/*
+ * Count a transition of an entry's alarm made at time_ms to state
+ * returns what the transition does
+ */
+enum mgos_alarm_chatter_verdict mgos_alarm_chatter_transition(struct mgos_alarm_chatter_set *set, uint32_t index,
+                                                              int64_t time_ms, uint8_t state);
+
+/*
+ * Unlatch the latched entries whose alarm made no transition for a
+ * window, calling fn for each
+ */
+void mgos_alarm_chatter_tick(struct mgos_alarm_chatter_set *set, int64_t now, mgos_alarm_chatter_fn fn,
+                             void *arg);
+
+/*
+ * Returns the earlier of next and the time the first latched entry can
+ * unlatch at
+ */
+int64_t mgos_alarm_chatter_next(const struct mgos_alarm_chatter_set *set, int64_t next);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_CHATTER_H_ */
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm.h"
+#include "mgos_alarm_classify.h"
+
+#if !defined(MGOS_ALARM_CLASSIFY_SCALAR) && defined(__AVX__)
+#include <immintrin.h>
+#define ALARM_CLASSIFY_AVX
+#elif !defined(MGOS_ALARM_CLASSIFY_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ALARM_CLASSIFY_SSE2
+#elif !defined(MGOS_ALARM_CLASSIFY_SCALAR) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ALARM_CLASSIFY_NEON
+#endif
+
+/*
+ * Every kernel builds the band from the lowest priority comparison up so
+ * that a later (higher priority) match overwrites an earlier one:
+ * 
+ *   band = pv <= l_sv ? L : NOM
+ *   band = pv <= ll_sv ? LL : band
+ *   band = pv >= h_sv ? H : band
+ *   band = pv >= hh_sv ? HH : band
+ * 
+ * Ordered comparisons are false when either side is NAN. The scalar kernel
+ * folds the same four comparisons into a table lookup.
+ */
+
+/*
+ * Scalar band lookup indexed by the four comparison results
+ * bit 0 pv <= l_sv, bit 1 pv <= ll_sv, bit 2 pv >= h_sv, bit 3 pv >= hh_sv
+ */
+static const uint8_t s_classify_bands[16] = {
+  NOM, L, LL, LL,
+  H, H, H, H,
+  HH, HH, HH, HH,
+  HH, HH, HH, HH,
+};
+
+/*
+ * Scalar kernel, also classifies the tail left over by the vector kernels
+ */
+static void classify_scalar(const float *pv, const float *ll_sv, const float *l_sv,
+                            const float *h_sv, const float *hh_sv, uint8_t *band,
+                            uint32_t start, uint32_t count){
+  for(uint32_t i = start; i < count; i++){
+    unsigned idx = (unsigned) (pv[i] <= l_sv[i]) | (unsigned) (pv[i] <= ll_sv[i]) << 1 |
+                   (unsigned) (pv[i] >= h_sv[i]) << 2 | (unsigned) (pv[i] >= hh_sv[i]) << 3;
+    band[i] = s_classify_bands[idx];
+  }
+}
+
+#if defined(ALARM_CLASSIFY_AVX)
+
+/*
+ * Returns a where m is set else r, AVX has no 256 bit integer ops so the
+ * integer bands are carried in float registers
+ */
+static __m256 classify_blend(__m256 m, __m256 a, __m256 r){
+  return _mm256_or_ps(_mm256_and_ps(m, a), _mm256_andnot_ps(m, r));
+}
+
+/*
+ * AVX kernel, 8 alarms per iteration
+ */
+static uint32_t classify_vector(const float *pv, const float *ll_sv, const float *l_sv,
+                                const float *h_sv, const float *hh_sv, uint8_t *band,
+                                uint32_t count){
+  const __m256 ll = _mm256_castsi256_ps(_mm256_set1_epi32(LL));
+  const __m256 l = _mm256_castsi256_ps(_mm256_set1_epi32(L));
+  const __m256 h = _mm256_castsi256_ps(_mm256_set1_epi32(H));
+  const __m256 hh = _mm256_castsi256_ps(_mm256_set1_epi32(HH));
+  uint32_t i = 0;
+  for(; i + 8 <= count; i += 8){
+    __m256 v = _mm256_loadu_ps(&pv[i]);
+    __m256 r = _mm256_and_ps(_mm256_cmp_ps(v, _mm256_loadu_ps(&l_sv[i]), _CMP_LE_OQ), l);
+    r = classify_blend(_mm256_cmp_ps(v, _mm256_loadu_ps(&ll_sv[i]), _CMP_LE_OQ), ll, r);
+    r = classify_blend(_mm256_cmp_ps(v, _mm256_loadu_ps(&h_sv[i]), _CMP_GE_OQ), h, r);
+    r = classify_blend(_mm256_cmp_ps(v, _mm256_loadu_ps(&hh_sv[i]), _CMP_GE_OQ), hh, r);
+    __m256i b = _mm256_castps_si256(r);
+    __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(b), _mm256_extractf128_si256(b, 1));
+    _mm_storel_epi64((__m128i *) &band[i], _mm_packus_epi16(w, w));
+  }
+  return i;
+}
+
+const char *mgos_alarm_classify_kernel(void){
+  return "avx";
+}
+
+#elif defined(ALARM_CLASSIFY_SSE2)
+
+/*
+ * Returns a where m is set else r
+ */
+static __m128i classify_blend(__m128i m, __m128i a, __m128i r){
+  return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, r));
+}
+
+/*
+ * SSE2 kernel, 4 alarms per iteration
+ */
+static uint32_t classify_vector(const float *pv, const float *ll_sv, const float *l_sv,
+                                const float *h_sv, const float *hh_sv, uint8_t *band,
+                                uint32_t count){
+  const __m128i ll = _mm_set1_epi32(LL), l = _mm_set1_epi32(L);
+  const __m128i h = _mm_set1_epi32(H), hh = _mm_set1_epi32(HH);
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4){
+    __m128 v = _mm_loadu_ps(&pv[i]);
+    __m128i r = _mm_and_si128(_mm_castps_si128(_mm_cmple_ps(v, _mm_loadu_ps(&l_sv[i]))), l);
+    r = classify_blend(_mm_castps_si128(_mm_cmple_ps(v, _mm_loadu_ps(&ll_sv[i]))), ll, r);
+    r = classify_blend(_mm_castps_si128(_mm_cmpge_ps(v, _mm_loadu_ps(&h_sv[i]))), h, r);
+    r = classify_blend(_mm_castps_si128(_mm_cmpge_ps(v, _mm_loadu_ps(&hh_sv[i]))), hh, r);
+    __m128i w = _mm_packs_epi32(r, r);
+    int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+    memcpy(&band[i], &bytes, sizeof(bytes));
+  }
+  return i;
+}
+
+const char *mgos_alarm_classify_kernel(void){
+  return "sse2";
+}
+
+#elif defined(ALARM_CLASSIFY_NEON)
+
+/*
+ * NEON kernel, 4 alarms per iteration
+ */
+static uint32_t classify_vector(const float *pv, const float *ll_sv, const float *l_sv,
+                                const float *h_sv, const float *hh_sv, uint8_t *band,
+                                uint32_t count){
+  const uint32x4_t ll = vdupq_n_u32(LL), l = vdupq_n_u32(L);
+  const uint32x4_t h = vdupq_n_u32(H), hh = vdupq_n_u32(HH);
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4){
+    float32x4_t v = vld1q_f32(&pv[i]);
+    uint32x4_t r = vandq_u32(vcleq_f32(v, vld1q_f32(&l_sv[i])), l);
+    r = vbslq_u32(vcleq_f32(v, vld1q_f32(&ll_sv[i])), ll, r);
+    r = vbslq_u32(vcgeq_f32(v, vld1q_f32(&h_sv[i])), h, r);
+    r = vbslq_u32(vcgeq_f32(v, vld1q_f32(&hh_sv[i])), hh, r);
+    uint16x4_t w = vmovn_u32(r);
+    uint8x8_t b = vmovn_u16(vcombine_u16(w, w));
+    vst1_lane_u32((uint32_t *) &band[i], vreinterpret_u32_u8(b), 0);
+  }
+  return i;
+}
+
+const char *mgos_alarm_classify_kernel(void){
+  return "neon";
+}
+
+#else
+
+/*
+ * No vector unit, everything goes through the scalar kernel
+ */
+static uint32_t classify_vector(const float *pv, const float *ll_sv, const float *l_sv,
+                                const float *h_sv, const float *hh_sv, uint8_t *band,
+                                uint32_t count){
+  (void) pv; (void) ll_sv; (void) l_sv; (void) h_sv; (void) hh_sv; (void) band; (void) count;
+  return 0;
+}
+
+const char *mgos_alarm_classify_kernel(void){
+  return "scalar";
+}
+
+#endif
+
+/*
+ * Classify a run of process values
+ */
+void mgos_alarm_classify(const float *pv, const float *ll_sv, const float *l_sv,
+                         const float *h_sv, const float *hh_sv, uint8_t *band,
+                         uint32_t count){
+  uint32_t done = classify_vector(pv, ll_sv, l_sv, h_sv, hh_sv, band, count);
+  classify_scalar(pv, ll_sv, l_sv, h_sv, hh_sv, band, done, count);
+}
+
+uint8_t mgos_alarm_classify_raw(int32_t raw, const int32_t *sv, uint8_t used){
+  unsigned idx = ((unsigned) (raw <= sv[1]) & (used >> 1)) | ((unsigned) (raw <= sv[0]) & used) << 1 |
+                 ((unsigned) (raw >= sv[2]) & (used >> 2)) << 2 | ((unsigned) (raw >= sv[3]) & (used >> 3)) << 3;
+  return s_classify_bands[idx];
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Batch analog alarm band classification
+ * 
+ * Classifies a run of process values against their ll/l/h/hh setpoints
+ * without branching on the values, so noisy signals do not cost branch
+ * mispredictions. The kernel uses AVX, SSE2 or NEON when the compiler 
+ * targets them and a branchless scalar loop otherwise; every variant gives
+ * the same result as the per-alarm comparison chain
+ * 
+ *   pv >= hh_sv -> HH, pv >= h_sv -> H, pv <= ll_sv -> LL, pv <= l_sv -> L,
+ *   otherwise NOM
+ * 
+ * A NAN setpoint never matches and a NAN process value is NOM. Define
+ * MGOS_ALARM_CLASSIFY_SCALAR to force the scalar loop.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_CLASSIFY_H_
+#define CS_FW_SRC_MGOS_ALARM_CLASSIFY_H_
+
+#include "mgos.h"
+
+/*
+ * Write the mgos_a_alarm_state band of pv[i] to band[i] for every i < count
+ */
+void mgos_alarm_classify(const float *pv, const float *ll_sv, const float *l_sv,
+                         const float *h_sv, const float *hh_sv, uint8_t *band,
+                         uint32_t count);
+
+/*
+ * Returns the mgos_a_alarm_state band of a raw ADC count using integer
+ * compares only, the same comparison chain against setpoints in counts
+ *
+ * sv - ll, l, h and hh setpoints in counts
+ * used - bit n is set if sv[n] is in use, an unused setpoint never matches
+ */
+uint8_t mgos_alarm_classify_raw(int32_t raw, const int32_t *sv, uint8_t used);
+
+/*
+ * Returns the name of the kernel mgos_alarm_classify was built with
+ */
+const char *mgos_alarm_classify_kernel(void);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_CLASSIFY_H_ */
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits.h>
+
+#include "mgos_alarm_config.h"
+#include "frozen.h"
+
+/*
+ * magic, version and layout of the binary configuration compiled by
+ * tools/mgos_alarm_config.py, all fields are little endian
+ *
+ * header - magic[4], version u8, 3 reserved bytes, count u32
+ * digital record - type u8 (0), flags u8, name_len u16, input u32,
+ *   set_interval i32, reset_interval i32, name
+ * analog record - type u8 (1), flags u8, name_len u16, pv u32,
+ *   ll_sv, l_sv, h_sv, hh_sv f32 (NAN if unused), set_interval i32, name
+ * flags - bit 0 enabled, bit 1 ACTIVE_HIGH
+ */
+#define CONFIG_MAGIC "ALMC"
+#define CONFIG_VERSION 1
+#define CONFIG_HEADER_SIZE 12
+#define CONFIG_D_RECORD_SIZE 16
+#define CONFIG_A_RECORD_SIZE 28
+#define CONFIG_ENABLED 0x01
+#define CONFIG_ACTIVE_HIGH 0x02
+
+/*
+ * state of json_walk over a JSON configuration
+ *
+ * record - the alarm object being walked
+ * ok - false once the callback stops decoding
+ */
+struct config_json{
+  mgos_alarm_config_cb cb;
+  void *arg;
+  struct mgos_alarm_config_record record;
+  bool ok;
+};
+
+static void config_record_init(struct mgos_alarm_config_record *record){
+  memset(record, 0, sizeof(*record));
+  record->enabled = true;
+  record->mode = ACTIVE_HIGH;
+  record->input = UINT32_MAX;
+  for(int i = 0; i < 4; i++) record->sv[i] = NAN;
+}
+
+static uint32_t config_u32(const uint8_t *p){
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static float config_f32(const uint8_t *p){
+  uint32_t bits = config_u32(p);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/*
+ * Decode a binary configuration
+ * returns false if it is truncated or the callback stopped decoding
+ */
+static bool config_binary(const uint8_t *data, size_t len, mgos_alarm_config_cb cb, void *arg){
+  const uint8_t *end = data + len;
+  if(len < CONFIG_HEADER_SIZE || data[4] != CONFIG_VERSION) return false;
+  uint32_t count = config_u32(data + 8);
+  const uint8_t *p = data + CONFIG_HEADER_SIZE;
+  for(uint32_t i = 0; i < count; i++){
+    struct mgos_alarm_config_record record;
+    config_record_init(&record);
+    if(end - p < CONFIG_D_RECORD_SIZE || p[0] > ANALOG) return false;
+    size_t size = p[0] == DIGITAL ? CONFIG_D_RECORD_SIZE : CONFIG_A_RECORD_SIZE;
+    record.type = (enum mgos_alarm_type) p[0];
+    record.typed = true;
+    record.enabled = (p[1] & CONFIG_ENABLED) != 0;
+    record.mode = (p[1] & CONFIG_ACTIVE_HIGH) ? ACTIVE_HIGH : ACTIVE_LOW;
+    record.name_len = (size_t) p[2] | ((size_t) p[3] << 8);
+    record.input = config_u32(p + 4);
+    if((size_t) (end - p) < size + record.name_len) return false;
+    if(record.type == DIGITAL){
+      record.set_interval = (int32_t) config_u32(p + 8);
+      record.reset_interval = (int32_t) config_u32(p + 12);
+    }
+    else{
+      for(int k = 0; k < 4; k++) record.sv[k] = config_f32(p + 8 + 4 * k);
+      record.set_interval = (int32_t) config_u32(p + 24);
+    }
+    record.malformed = record.set_interval < 0 || record.reset_interval < 0;
+    record.name = (const char *) p + size;
+    p += size + record.name_len;
+    if(!cb(&record, arg)) return false;
+  }
+  return p == end;
+}
+
+/*
+ * Returns true if a JSON string token equals str
+ */
+static bool config_json_is(const struct json_token *token, const char *str){
+  return token->type == JSON_TYPE_STRING && (size_t) token->len == strlen(str) &&
+         memcmp(token->ptr, str, token->len) == 0;
+}
+
+/*
+ * Parse a JSON number token
+ * returns false if the token is not a number
+ */
+static bool config_json_number(const struct json_token *token, double *value){
+  char buf[32];
+  if(token->type != JSON_TYPE_NUMBER || token->len >= (int) sizeof(buf)) return false;
+  memcpy(buf, token->ptr, token->len);
+  buf[token->len] = '\0';
+  char *end;
+  *value = strtod(buf, &end);
+  return *end == '\0';
+}
+
+/*
+ * Set a field of the alarm object being walked
+ */
+static void config_json_field(struct mgos_alarm_config_record *record, const char *field,
+                                         const struct json_token *token){
+  static const char *const sv_fields[] = {"ll_sv", "l_sv", "h_sv", "hh_sv"};
+  double value = 0;
+  bool number = config_json_number(token, &value);
+  if(strcmp(field, "name") == 0){
+    if(token->type != JSON_TYPE_STRING) record->malformed = true;
+    record->name = token->ptr;
+    record->name_len = token->len;
+  }
+  else if(strcmp(field, "type") == 0){
+    record->typed = true;
+    if(config_json_is(token, "digital")) record->type = DIGITAL;
+    else if(config_json_is(token, "analog")) record->type = ANALOG;
+    else record->malformed = true;
+  }
+  else if(strcmp(field, "mode") == 0){
+    if(config_json_is(token, "ACTIVE_HIGH")) record->mode = ACTIVE_HIGH;
+    else if(config_json_is(token, "ACTIVE_LOW")) record->mode = ACTIVE_LOW;
+    else record->malformed = true;
+  }
+  else if(strcmp(field, "enabled") == 0){
+    if(token->type != JSON_TYPE_TRUE && token->type != JSON_TYPE_FALSE) record->malformed = true;
+    record->enabled = token->type == JSON_TYPE_TRUE;
+  }
+  else if(strcmp(field, "input") == 0 || strcmp(field, "pv") == 0){
+    if(!number || value < 0 || value >= UINT32_MAX || value != (uint32_t) value) record->malformed = true;
+    else record->input = (uint32_t) value;
+  }
+  else if(strcmp(field, "set_interval") == 0 || strcmp(field, "reset_interval") == 0){
+    //whole, non-negative milliseconds
+    if(!number || value < 0 || value > INT_MAX || value != (int) value) record->malformed = true;
+    else if(field[0] == 's') record->set_interval = (int) value;
+    else record->reset_interval = (int) value;
+  }
+  else{
+    for(int i = 0; i < 4; i++){
+      if(strcmp(field, sv_fields[i]) != 0) continue;
+      //null is an unused setpoint
+      if(number) record->sv[i] = (float) value;
+      else if(token->type != JSON_TYPE_NULL) record->malformed = true;
+    }
+  }
+}
+
+/*
+ * json_walk callback, alarm objects are at ".alarms[n]" and their fields
+ * at ".alarms[n].field"
+ */
+static void config_json_cb(void *data, const char *name, size_t name_len,
+                                      const char *path, const struct json_token *token){
+  struct config_json *json = (struct config_json *) data;
+  (void) name;
+  (void) name_len;
+  if(!json->ok || strncmp(path, ".alarms[", 8) != 0) return;
+  const char *rest = strchr(path + 8, ']');
+  if(rest == NULL) return;
+  ++rest;
+  if(*rest == '\0'){
+    if(token->type == JSON_TYPE_OBJECT_START) config_record_init(&json->record);
+    else if(token->type == JSON_TYPE_OBJECT_END) json->ok = json->cb(&json->record, json->arg);
+    return;
+  }
+  //values nested inside a field are not alarm fields
+  if(rest[0] != '.' || strpbrk(rest + 1, ".[") != NULL) return;
+  config_json_field(&json->record, rest + 1, token);
+}
+
+bool mgos_alarm_config_decode(const char *data, size_t len, mgos_alarm_config_cb cb, void *arg){
+  if(len >= 4 && memcmp(data, CONFIG_MAGIC, 4) == 0){
+    return config_binary((const uint8_t *) data, len, cb, arg);
+  }
+  struct config_json json = {.cb = cb, .arg = arg, .ok = true};
+  if(json_walk(data, (int) len, config_json_cb, &json) < 0) return false;
+  return json.ok;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Decoder of the bulk alarm configurations of mgos_alarm_load_config
+ *
+ * A configuration is JSON, an "alarms" array of alarm objects, or the
+ * compact binary form tools/mgos_alarm_config.py compiles from the same
+ * JSON. Either is decoded into one record per alarm, handed to a callback
+ * in order. The decoder only checks the form of each field, the loader
+ * validates the alarms as mgos_add_d_alarm and mgos_add_a_alarm do.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_CONFIG_H_
+#define CS_FW_SRC_MGOS_ALARM_CONFIG_H_
+
+#include "mgos.h"
+#include "mgos_alarm.h"
+
+/*
+ * alarm decoded from a configuration
+ *
+ * type, enabled, mode - see mgos_add_d_alarm and mgos_add_a_alarm
+ * typed - type was given
+ * malformed - a field had the wrong type or an unknown value
+ * name, name_len - the name, not NUL terminated, NULL if not given
+ * input - index of the input or pv in mgos_alarm_config_io, UINT32_MAX if
+ *   not given
+ * sv - ll_sv, l_sv, h_sv and hh_sv
+ * set_interval, reset_interval - see mgos_add_d_alarm
+ */
+struct mgos_alarm_config_record{
+  enum mgos_alarm_type type;
+  bool enabled;
+  enum mgos_d_alarm_mode mode;
+  bool typed, malformed;
+  const char *name;
+  size_t name_len;
+  uint32_t input;
+  float sv[4];
+  int set_interval, reset_interval;
+};
+
+/*
+ * called for each alarm of a configuration in order, returns false to
+ * stop decoding
+ */
+typedef bool (*mgos_alarm_config_cb)(const struct mgos_alarm_config_record *record, void *arg);
+
+/*
+ * Decode a configuration, binary if it starts with the "ALMC" magic and
+ * JSON otherwise
+ * returns false if it is malformed or the callback stopped decoding
+ */
+bool mgos_alarm_config_decode(const char *data, size_t len, mgos_alarm_config_cb cb, void *arg);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_CONFIG_H_ */
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_edge.h"
+#include "mgos_alarm_arena.h"
+
+/*
+ * Allocate the ring
+ */
+bool mgos_alarm_edge_ring_init(struct mgos_alarm_edge_ring *ring, uint32_t size){
+  if(size == 0 || (size & (size - 1)) != 0) return false;
+  ring->edges = (struct mgos_alarm_edge *) mgos_alarm_arena_calloc(size, sizeof(*ring->edges));
+  if(ring->edges == NULL) return false;
+  ring->size = size;
+  ring->mask = size - 1;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->high_water = 0;
+  ring->dropped = 0;
+  return true;
+}
+
+/*
+ * Push an edge, the entry is written before head is released so the
+ * consumer never sees it half written
+ */
+IRAM bool mgos_alarm_edge_ring_push(struct mgos_alarm_edge_ring *ring, const struct mgos_alarm_edge *edge){
+  uint32_t head = ring->head;
+  uint32_t depth = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if(depth >= ring->size){
+    ++ring->dropped;
+    return false;
+  }
+  ring->edges[head & ring->mask] = *edge;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  if(depth + 1 > ring->high_water) ring->high_water = depth + 1;
+  return true;
+}
+
+/*
+ * Pop the oldest edge, the entry is read before tail is released so the
+ * producer never overwrites it while it is being read
+ */
+bool mgos_alarm_edge_ring_pop(struct mgos_alarm_edge_ring *ring, struct mgos_alarm_edge *edge){
+  uint32_t tail = ring->tail;
+  if(tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) return false;
+  *edge = ring->edges[tail & ring->mask];
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/*
+ * Returns the number of queued edges
+ */
+uint32_t mgos_alarm_edge_ring_depth(const struct mgos_alarm_edge_ring *ring){
+  return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
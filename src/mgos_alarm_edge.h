@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Input edge ring of the digital alarm edge capture mode
+ *
+ * A power of two ring with one producer, typically a GPIO interrupt
+ * handler, and one consumer, the alarm engine. Neither side takes a lock
+ * or waits. The producer owns head and the consumer owns tail, an edge
+ * pushed into a full ring is dropped and counted rather than overwriting
+ * an edge the consumer may be reading. The push is placed in IRAM so it
+ * may run while the flash cache is disabled.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_EDGE_H_
+#define CS_FW_SRC_MGOS_ALARM_EDGE_H_
+
+#include "mgos.h"
+#include "mgos_alarm.h"
+
+/*
+ * captured input edge
+ *
+ * handle - the digital alarm the input belongs to
+ * level - the input level after the edge
+ * time_us - uptime of the edge in microseconds
+ */
+struct mgos_alarm_edge{
+  mgos_alarm_handle_t handle;
+  bool level;
+  int64_t time_us;
+};
+
+/*
+ * edge ring
+ *
+ * edges - the ring, size entries
+ * mask - size - 1
+ * head - count of edges pushed, written by the producer
+ * tail - count of edges popped, written by the consumer
+ * high_water - most edges queued at once, written by the producer
+ * dropped - edges pushed into a full ring, written by the producer
+ */
+struct mgos_alarm_edge_ring{
+  struct mgos_alarm_edge *edges;
+  uint32_t size, mask;
+  uint32_t head, tail;
+  uint32_t high_water, dropped;
+};
+
+/*
+ * Allocate a ring of size edges, size must be a power of two
+ * returns false if memory could not be allocated
+ */
+bool mgos_alarm_edge_ring_init(struct mgos_alarm_edge_ring *ring, uint32_t size);
+
+/*
+ * Push an edge, producer side
+ * returns false if the ring is full and the edge was dropped
+ */
+bool mgos_alarm_edge_ring_push(struct mgos_alarm_edge_ring *ring, const struct mgos_alarm_edge *edge);
+
+/*
+ * Pop the oldest edge into *edge, consumer side
+ * returns false if the ring is empty
+ */
+bool mgos_alarm_edge_ring_pop(struct mgos_alarm_edge_ring *ring, struct mgos_alarm_edge *edge);
+
+/*
+ * Returns the number of queued edges
+ */
+uint32_t mgos_alarm_edge_ring_depth(const struct mgos_alarm_edge_ring *ring);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_EDGE_H_ */
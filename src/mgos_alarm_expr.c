@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_expr.h"
+#include "mgos_alarm_arena.h"
+
+/*
+ * bytecode, REF is followed by the reference index and KOFN by k and n
+ */
+enum expr_op{
+  EXPR_OP_FALSE,
+  EXPR_OP_TRUE,
+  EXPR_OP_REF,
+  EXPR_OP_NOT,
+  EXPR_OP_AND,
+  EXPR_OP_OR,
+  EXPR_OP_XOR,
+  EXPR_OP_KOFN
+};
+
+/*
+ * compiler state, the code and references are built here and copied to
+ * the expression's block once the whole text compiled
+ *
+ * depth, max_depth - stack depth after the code so far and its maximum
+ * nesting - open parentheses, bounding the recursion
+ */
+struct expr_parser{
+  const char *text, *p;
+  mgos_alarm_expr_resolve_cb resolve;
+  void *arg;
+  uint8_t code[MGOS_ALARM_EXPR_MAX_CODE];
+  struct mgos_alarm_expr_ref refs[MGOS_ALARM_EXPR_MAX_REFS];
+  uint32_t code_len, num_refs;
+  uint32_t depth, max_depth;
+  uint32_t nesting;
+  const char *error;
+};
+
+static bool expr_or(struct expr_parser *ps);
+
+static bool expr_fail(struct expr_parser *ps, const char *error){
+  if(ps->error == NULL) ps->error = error;
+  return false;
+}
+
+static void expr_space(struct expr_parser *ps){
+  while(*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\r' || *ps->p == '\n') ps->p++;
+}
+
+/*
+ * Consume token if it is next
+ */
+static bool expr_accept(struct expr_parser *ps, const char *token){
+  expr_space(ps);
+  size_t len = strlen(token);
+  if(strncmp(ps->p, token, len) != 0) return false;
+  ps->p += len;
+  return true;
+}
+
+static bool expr_name_start(char c){
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+static bool expr_name_char(char c){
+  return expr_name_start(c) || (c >= '0' && c <= '9') || c == '-';
+}
+
+/*
+ * Append an op with its operands, pushed values and popped values
+ */
+static bool expr_emit(struct expr_parser *ps, const uint8_t *op, uint32_t len, uint32_t pop, uint32_t push){
+  if(ps->code_len + len > MGOS_ALARM_EXPR_MAX_CODE) return expr_fail(ps, "expression too long");
+  memcpy(ps->code + ps->code_len, op, len);
+  ps->code_len += len;
+  ps->depth = ps->depth - pop + push;
+  if(ps->depth > ps->max_depth) ps->max_depth = ps->depth;
+  if(ps->max_depth > MGOS_ALARM_EXPR_MAX_DEPTH) return expr_fail(ps, "expression nested too deep");
+  return true;
+}
+
+static bool expr_emit_op(struct expr_parser *ps, enum expr_op op){
+  uint8_t code = op;
+  switch(op){
+    case EXPR_OP_FALSE:
+    case EXPR_OP_TRUE:
+      return expr_emit(ps, &code, 1, 0, 1);
+    case EXPR_OP_NOT:
+      return expr_emit(ps, &code, 1, 1, 1);
+    default:
+      return expr_emit(ps, &code, 1, 2, 1);
+  }
+}
+
+/*
+ * Read a bare or quoted name into name
+ */
+static bool expr_name(struct expr_parser *ps, char *name){
+  size_t len = 0;
+  if(*ps->p == '"'){
+    ps->p++;
+    while(*ps->p != '"'){
+      if(*ps->p == '\0') return expr_fail(ps, "unterminated name");
+      if(len == MGOS_ALARM_EXPR_MAX_NAME) return expr_fail(ps, "name too long");
+      name[len++] = *ps->p++;
+    }
+    ps->p++;
+  }
+  else{
+    while(expr_name_char(*ps->p)){
+      if(len == MGOS_ALARM_EXPR_MAX_NAME) return expr_fail(ps, "name too long");
+      name[len++] = *ps->p++;
+    }
+  }
+  if(len == 0) return expr_fail(ps, "name expected");
+  name[len] = '\0';
+  return true;
+}
+
+/*
+ * Compile a reference, name[.in|.active|.NOM|.LL|.L|.H|.HH]
+ */
+static bool expr_ref(struct expr_parser *ps){
+  static const char *const tests[] = {"active", "in", "NOM", "LL", "L", "H", "HH"};
+  char name[MGOS_ALARM_EXPR_MAX_NAME + 1], test_name[8];
+  const char *start = ps->p;
+  if(!expr_name(ps, name)) return false;
+  uint8_t test = MGOS_ALARM_EXPR_ACTIVE;
+  if(*ps->p == '.'){
+    ps->p++;
+    size_t len = 0;
+    while(expr_name_char(*ps->p) && len < sizeof(test_name) - 1) test_name[len++] = *ps->p++;
+    test_name[len] = '\0';
+    for(test = 0; test < sizeof(tests) / sizeof(tests[0]); test++){
+      if(strcmp(test_name, tests[test]) == 0) break;
+    }
+    if(test == sizeof(tests) / sizeof(tests[0])) return expr_fail(ps, "unknown reference suffix");
+  }
+  mgos_alarm_handle_t handle;
+  enum mgos_alarm_type type;
+  if(!ps->resolve(name, &handle, &type, ps->arg)){
+    ps->p = start;
+    return expr_fail(ps, "unknown alarm");
+  }
+  if(type == ANALOG ? test == MGOS_ALARM_EXPR_INPUT : test >= MGOS_ALARM_EXPR_STATE){
+    ps->p = start;
+    return expr_fail(ps, "suffix does not apply to the alarm");
+  }
+  //each distinct reference is read once
+  uint32_t index;
+  for(index = 0; index < ps->num_refs; index++){
+    if(ps->refs[index].handle == handle && ps->refs[index].test == test) break;
+  }
+  if(index == ps->num_refs){
+    if(index == MGOS_ALARM_EXPR_MAX_REFS) return expr_fail(ps, "too many references");
+    ps->refs[index].handle = handle;
+    ps->refs[index].test = test;
+    ps->num_refs++;
+  }
+  uint8_t op[2] = {EXPR_OP_REF, (uint8_t) index};
+  return expr_emit(ps, op, sizeof(op), 0, 1);
+}
+
+/*
+ * Compile K of (e1, e2, ...)
+ */
+static bool expr_k_of_n(struct expr_parser *ps){
+  uint32_t k = 0;
+  while(*ps->p >= '0' && *ps->p <= '9'){
+    k = k * 10 + (uint32_t) (*ps->p++ - '0');
+    if(k > MGOS_ALARM_EXPR_MAX_DEPTH) return expr_fail(ps, "count too large");
+  }
+  expr_space(ps);
+  if(strncmp(ps->p, "of", 2) != 0 || expr_name_char(ps->p[2])) return expr_fail(ps, "'of' expected");
+  ps->p += 2;
+  if(!expr_accept(ps, "(")) return expr_fail(ps, "'(' expected");
+  uint32_t n = 0;
+  do{
+    if(!expr_or(ps)) return false;
+    n++;
+  }while(expr_accept(ps, ","));
+  if(!expr_accept(ps, ")")) return expr_fail(ps, "')' expected");
+  if(k == 0 || k > n) return expr_fail(ps, "count out of range");
+  uint8_t op[3] = {EXPR_OP_KOFN, (uint8_t) k, (uint8_t) n};
+  return expr_emit(ps, op, sizeof(op), n, 1);
+}
+
+static bool expr_primary(struct expr_parser *ps){
+  expr_space(ps);
+  if(expr_accept(ps, "(")){
+    if(!expr_or(ps)) return false;
+    if(!expr_accept(ps, ")")) return expr_fail(ps, "')' expected");
+    return true;
+  }
+  if(*ps->p >= '0' && *ps->p <= '9') return expr_k_of_n(ps);
+  if(strncmp(ps->p, "true", 4) == 0 && !expr_name_char(ps->p[4])){
+    ps->p += 4;
+    return expr_emit_op(ps, EXPR_OP_TRUE);
+  }
+  if(strncmp(ps->p, "false", 5) == 0 && !expr_name_char(ps->p[5])){
+    ps->p += 5;
+    return expr_emit_op(ps, EXPR_OP_FALSE);
+  }
+  if(expr_name_start(*ps->p) || *ps->p == '"') return expr_ref(ps);
+  return expr_fail(ps, "operand expected");
+}
+
+static bool expr_not(struct expr_parser *ps){
+  bool invert = false;
+  while(expr_accept(ps, "!")) invert = !invert;
+  if(!expr_primary(ps)) return false;
+  return !invert || expr_emit_op(ps, EXPR_OP_NOT);
+}
+
+static bool expr_and(struct expr_parser *ps){
+  if(!expr_not(ps)) return false;
+  while(expr_accept(ps, "&&") || expr_accept(ps, "&")){
+    if(!expr_not(ps) || !expr_emit_op(ps, EXPR_OP_AND)) return false;
+  }
+  return true;
+}
+
+static bool expr_xor(struct expr_parser *ps){
+  if(!expr_and(ps)) return false;
+  while(expr_accept(ps, "^")){
+    if(!expr_and(ps) || !expr_emit_op(ps, EXPR_OP_XOR)) return false;
+  }
+  return true;
+}
+
+static bool expr_or(struct expr_parser *ps){
+  if(ps->nesting == MGOS_ALARM_EXPR_MAX_DEPTH) return expr_fail(ps, "expression nested too deep");
+  ps->nesting++;
+  bool ok = expr_xor(ps);
+  while(ok && (expr_accept(ps, "||") || expr_accept(ps, "|"))){
+    ok = expr_xor(ps) && expr_emit_op(ps, EXPR_OP_OR);
+  }
+  ps->nesting--;
+  return ok;
+}
+
+struct mgos_alarm_expr *mgos_alarm_expr_compile(const char *text, mgos_alarm_expr_resolve_cb resolve,
+                                                void *arg, const char **error, size_t *pos){
+  struct expr_parser *ps = (struct expr_parser *) calloc(1, sizeof(*ps));
+  struct mgos_alarm_expr *expr = NULL;
+  if(ps == NULL){
+    *error = "out of memory";
+    *pos = 0;
+    return NULL;
+  }
+  ps->text = ps->p = text;
+  ps->resolve = resolve;
+  ps->arg = arg;
+  if(expr_or(ps)){
+    expr_space(ps);
+    if(*ps->p != '\0') expr_fail(ps, "unexpected text");
+  }
+  if(ps->error == NULL){
+    //the expression, its references and its code in one block
+    size_t refs_size = ps->num_refs * sizeof(struct mgos_alarm_expr_ref);
+    expr = (struct mgos_alarm_expr *) mgos_alarm_arena_calloc(1, sizeof(*expr) + refs_size + ps->code_len);
+    if(expr != NULL){
+      expr->refs = (struct mgos_alarm_expr_ref *) (expr + 1);
+      expr->code = (uint8_t *) expr->refs + refs_size;
+      memcpy(expr->refs, ps->refs, refs_size);
+      memcpy(expr->code, ps->code, ps->code_len);
+      expr->num_refs = (uint8_t) ps->num_refs;
+      expr->code_len = (uint8_t) ps->code_len;
+      for(uint32_t i = 0; i < ps->num_refs; i++){
+        if(ps->refs[i].test == MGOS_ALARM_EXPR_INPUT) expr->inputs = true;
+      }
+    }
+    else{
+      ps->error = "out of memory";
+    }
+  }
+  *error = ps->error;
+  *pos = (size_t) (ps->p - text);
+  free(ps);
+  return expr;
+}
+
+void mgos_alarm_expr_free(struct mgos_alarm_expr *expr){
+  free(expr);
+}
+
+/*
+ * The stack is a word of bits, the top of the stack is bit 0
+ */
+bool mgos_alarm_expr_eval(const struct mgos_alarm_expr *expr, mgos_alarm_expr_read_cb read, void *arg){
+  uint64_t stack = 0;
+  const uint8_t *code = expr->code, *end = code + expr->code_len;
+  while(code < end){
+    switch(*code++){
+      case EXPR_OP_FALSE:
+        stack <<= 1;
+        break;
+      case EXPR_OP_TRUE:
+        stack = (stack << 1) | 1;
+        break;
+      case EXPR_OP_REF:
+        stack = (stack << 1) | read(&expr->refs[*code++], arg);
+        break;
+      case EXPR_OP_NOT:
+        stack ^= 1;
+        break;
+      case EXPR_OP_AND:
+        stack = (stack >> 1) & (stack | ~(uint64_t) 1);
+        break;
+      case EXPR_OP_OR:
+        stack = (stack >> 1) | (stack & 1);
+        break;
+      case EXPR_OP_XOR:
+        stack = (stack >> 1) ^ (stack & 1);
+        break;
+      case EXPR_OP_KOFN:{
+        uint32_t k = code[0], n = code[1];
+        code += 2;
+        uint32_t count = (uint32_t) __builtin_popcountll(stack & (((uint64_t) 1 << n) - 1));
+        stack = ((stack >> n) << 1) | (count >= k);
+        break;
+      }
+    }
+  }
+  return stack & 1;
+}
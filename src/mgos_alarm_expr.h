@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Alarm expressions of the expression alarms
+ *
+ * An expression over other alarms' states and inputs, see
+ * mgos_add_expr_alarm_h, is compiled once into postfix bytecode with its
+ * alarm references bound to handles. The bytecode runs on a stack of bits
+ * held in one word, so an evaluation reads each reference once, allocates
+ * nothing and never looks a name up. Each expression is one block holding
+ * its references and code.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_EXPR_H_
+#define CS_FW_SRC_MGOS_ALARM_EXPR_H_
+
+#include "mgos.h"
+#include "mgos_alarm.h"
+
+/*
+ * most code bytes, references, stack depth and name length of an expression
+ */
+#ifndef MGOS_ALARM_EXPR_MAX_CODE
+#define MGOS_ALARM_EXPR_MAX_CODE 128
+#endif
+#define MGOS_ALARM_EXPR_MAX_REFS 32
+#define MGOS_ALARM_EXPR_MAX_DEPTH 32
+#define MGOS_ALARM_EXPR_MAX_NAME 64
+
+/*
+ * what a reference reads of its alarm
+ * MGOS_ALARM_EXPR_ACTIVE - a digital alarm is active, an analog one is not NOM
+ * MGOS_ALARM_EXPR_INPUT - a digital alarm's input is in its active state,
+ *   before debouncing
+ * MGOS_ALARM_EXPR_STATE + state - an analog alarm is in that state
+ */
+enum mgos_alarm_expr_test{
+  MGOS_ALARM_EXPR_ACTIVE,
+  MGOS_ALARM_EXPR_INPUT,
+  MGOS_ALARM_EXPR_STATE
+};
+
+/*
+ * reference to another alarm
+ *
+ * handle - the alarm, bound when the expression is compiled
+ * test - what is read, see enum mgos_alarm_expr_test
+ */
+struct mgos_alarm_expr_ref{
+  mgos_alarm_handle_t handle;
+  uint8_t test;
+};
+
+/*
+ * compiled expression
+ *
+ * refs, num_refs - the references, each distinct reference once
+ * code, code_len - the bytecode
+ * inputs - a reference reads an input, see MGOS_ALARM_EXPR_INPUT
+ * slot, value, dirty - kept for the engine, the alarm table slot of the
+ *   expression alarm, the result its input points at, and whether a
+ *   dependency changed since it was last evaluated
+ */
+struct mgos_alarm_expr{
+  struct mgos_alarm_expr_ref *refs;
+  uint8_t *code;
+  uint8_t num_refs, code_len;
+  bool inputs;
+  uint32_t slot;
+  bool value, dirty;
+};
+
+/*
+ * Look up the handle of the alarm name refers to and whether it is ANALOG
+ * returns false if the alarm does not exist
+ */
+typedef bool (*mgos_alarm_expr_resolve_cb)(const char *name, mgos_alarm_handle_t *handle,
+                                           enum mgos_alarm_type *type, void *arg);
+
+/*
+ * Returns the value of a reference
+ */
+typedef bool (*mgos_alarm_expr_read_cb)(const struct mgos_alarm_expr_ref *ref, void *arg);
+
+/*
+ * Compile an expression, resolving its alarm names with resolve
+ * returns the expression in one block, NULL with *error and *pos set to
+ *   the problem and its offset in text if it does not compile or memory
+ *   could not be allocated
+ */
+struct mgos_alarm_expr *mgos_alarm_expr_compile(const char *text, mgos_alarm_expr_resolve_cb resolve,
+                                                void *arg, const char **error, size_t *pos);
+
+/*
+ * Free a compiled expression
+ */
+void mgos_alarm_expr_free(struct mgos_alarm_expr *expr);
+
+/*
+ * Evaluate an expression, reading each reference with read
+ */
+bool mgos_alarm_expr_eval(const struct mgos_alarm_expr *expr, mgos_alarm_expr_read_cb read, void *arg);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_EXPR_H_ */
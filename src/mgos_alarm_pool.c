@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_pool.h"
+#include "mgos_alarm_arena.h"
+
+void mgos_alarm_pool_init(struct mgos_alarm_pool *pool, size_t entry_size){
+  pool->entries = NULL;
+  pool->entry_size = MGOS_ALARM_ARENA_BLOCK(entry_size < sizeof(uint32_t) ? sizeof(uint32_t) : entry_size);
+  pool->capacity = 0;
+  pool->used = 0;
+  pool->free_head = MGOS_ALARM_POOL_NONE;
+}
+
+/*
+ * Double the pool and chain the new entries onto the free list
+ */
+static bool pool_grow(struct mgos_alarm_pool *pool){
+  uint32_t capacity = pool->capacity < MGOS_ALARM_POOL_MIN_CAPACITY ? MGOS_ALARM_POOL_MIN_CAPACITY
+                                                                    : pool->capacity * 2;
+  uint8_t *entries = (uint8_t *) mgos_alarm_arena_realloc(pool->entries, capacity * pool->entry_size);
+  if(entries == NULL) return false;
+  pool->entries = entries;
+  for(uint32_t i = capacity; i-- > pool->capacity;){
+    *MGOS_ALARM_POOL_ENTRY(pool, uint32_t, i) = pool->free_head;
+    pool->free_head = i;
+  }
+  pool->capacity = capacity;
+  return true;
+}
+
+uint32_t mgos_alarm_pool_alloc(struct mgos_alarm_pool *pool){
+  if(pool->free_head == MGOS_ALARM_POOL_NONE && !pool_grow(pool)) return MGOS_ALARM_POOL_NONE;
+  uint32_t index = pool->free_head;
+  void *entry = MGOS_ALARM_POOL_ENTRY(pool, void, index);
+  pool->free_head = *(uint32_t *) entry;
+  memset(entry, 0, pool->entry_size);
+  ++pool->used;
+  return index;
+}
+
+void mgos_alarm_pool_free(struct mgos_alarm_pool *pool, uint32_t index){
+  *MGOS_ALARM_POOL_ENTRY(pool, uint32_t, index) = pool->free_head;
+  pool->free_head = index;
+  --pool->used;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Fixed size entry pool
+ *
+ * Holds the per-alarm state of the analog alarm kinds that need more than
+ * the analog table's columns, so that only alarms of that kind pay for it.
+ * An alarm refers to its entry by index, entries never move between
+ * alarms and freed entries are reused before the pool grows. The pool
+ * doubles from the heap as needed.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_POOL_H_
+#define CS_FW_SRC_MGOS_ALARM_POOL_H_
+
+#include "mgos.h"
+
+#define MGOS_ALARM_POOL_NONE UINT32_MAX
+#define MGOS_ALARM_POOL_MIN_CAPACITY 8
+
+/*
+ * pool
+ *
+ * entries - the entry array, capacity entries of entry_size bytes
+ * entry_size - bytes per entry, at least sizeof(uint32_t) as a free
+ *   entry holds the index of the next free entry
+ * capacity - number of entries allocated
+ * used - number of entries allocated to alarms
+ * free_head - first free entry, MGOS_ALARM_POOL_NONE if every entry is used
+ */
+struct mgos_alarm_pool{
+  uint8_t *entries;
+  size_t entry_size;
+  uint32_t capacity, used, free_head;
+};
+
+/*
+ * Initialise an empty pool of entry_size byte entries, nothing is allocated
+ */
+void mgos_alarm_pool_init(struct mgos_alarm_pool *pool, size_t entry_size);
+
+/*
+ * Take a zeroed entry, growing the pool if none is free
+ * returns MGOS_ALARM_POOL_NONE if memory could not be allocated
+ */
+uint32_t mgos_alarm_pool_alloc(struct mgos_alarm_pool *pool);
+
+/*
+ * Return an entry to the pool
+ */
+void mgos_alarm_pool_free(struct mgos_alarm_pool *pool, uint32_t index);
+
+/*
+ * Returns entry index of a pool, the pointer is only valid until the
+ * pool next grows
+ */
+#define MGOS_ALARM_POOL_ENTRY(pool, type, index) \
+  ((type *) ((pool)->entries + (size_t) (index) * (pool)->entry_size))
+
+#endif /* CS_FW_SRC_MGOS_ALARM_POOL_H_ */
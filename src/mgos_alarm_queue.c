@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_queue.h"
+#include "mgos_alarm_arena.h"
+
+/*
+ * entry states
+ * FREE - not queued
+ * READY - queued, may be popped, dropped or coalesced
+ * BUSY - claimed by the consumer popping it or the producer coalescing
+ *   into it
+ * CANCELLED - coalesced back to the alarm's old state, skipped by the
+ *   consumer
+ */
+#define QUEUE_ENTRY_FREE 0
+#define QUEUE_ENTRY_READY 1
+#define QUEUE_ENTRY_BUSY 2
+#define QUEUE_ENTRY_CANCELLED 3
+
+/*
+ * Sequence number of an entry at ring position pos in state state, the
+ * position wraps at 2^30 which no stalled side lags by
+ */
+#define QUEUE_SEQ(pos, state) (((uint32_t) (pos) << 2) | (state))
+
+/*
+ * Claim the entry of ring position pos by moving it from state from to
+ * state to, fails if the entry has been reused for another position
+ */
+static bool queue_claim(struct mgos_alarm_queue_entry *entry, uint32_t pos, uint32_t from, uint32_t to){
+  uint32_t expected = QUEUE_SEQ(pos, from);
+  return __atomic_compare_exchange_n(&entry->seq, &expected, QUEUE_SEQ(pos, to), false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/*
+ * Release a claimed entry of ring position pos into state state
+ */
+static void queue_release(struct mgos_alarm_queue_entry *entry, uint32_t pos, uint32_t state){
+  __atomic_store_n(&entry->seq, QUEUE_SEQ(pos, state), __ATOMIC_RELEASE);
+}
+
+/*
+ * Allocate the ring
+ */
+bool mgos_alarm_queue_init(struct mgos_alarm_queue *queue, uint32_t size){
+  if(size == 0 || (size & (size - 1)) != 0) return false;
+  queue->entries = (struct mgos_alarm_queue_entry *) mgos_alarm_arena_calloc(size, sizeof(*queue->entries));
+  if(queue->entries == NULL) return false;
+  queue->size = size;
+  queue->mask = size - 1;
+  queue->head = 0;
+  queue->tail = 0;
+  queue->high_water = 0;
+  queue->dropped = 0;
+  queue->coalesced = 0;
+  return true;
+}
+
+/*
+ * Returns true if the transition leaves the alarm in the state it was in
+ * before the queued transition it would be coalesced into
+ */
+static bool queue_net_unchanged(const struct alarm_transition *queued,
+                                const struct alarm_transition *transition){
+  if(transition->info.type == DIGITAL){
+    return transition->info.state.d_state == queued->old_state.d_state;
+  }
+  return transition->info.state.a_state == queued->old_state.a_state;
+}
+
+/*
+ * Merge the transition into the newest queued entry of the same alarm,
+ * the entry keeps its old state and queue time. An entry merged back to
+ * its old state is cancelled, and revived should the alarm change again.
+ * returns false if no queued entry of the alarm could be claimed
+ */
+static bool queue_coalesce(struct mgos_alarm_queue *queue, const struct alarm_transition *transition){
+  uint32_t head = queue->head;
+  uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+  for(uint32_t n = head; n != tail; n--){
+    uint32_t pos = n - 1;
+    struct mgos_alarm_queue_entry *entry = &queue->entries[pos & queue->mask];
+    //entries already popped are FREE or BUSY and are not claimed
+    if(entry->transition.handle != transition->handle) continue;
+    if(!queue_claim(entry, pos, QUEUE_ENTRY_READY, QUEUE_ENTRY_BUSY) &&
+       !queue_claim(entry, pos, QUEUE_ENTRY_CANCELLED, QUEUE_ENTRY_BUSY)) return false;
+    uint32_t state = QUEUE_ENTRY_READY;
+    if(queue_net_unchanged(&entry->transition, transition)) state = QUEUE_ENTRY_CANCELLED;
+    entry->transition.ev = transition->ev;
+    entry->transition.info = transition->info;
+    entry->transition.time_ms = transition->time_ms;
+    queue_release(entry, pos, state);
+    ++queue->coalesced;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Drop the oldest entry to make room, waits for the consumer should it be
+ * popping that entry, which frees the room itself. Dropping a cancelled
+ * entry loses nothing and is not counted.
+ */
+static void queue_drop_oldest(struct mgos_alarm_queue *queue){
+  for(;;){
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if(queue->head - tail < queue->size) return;
+    struct mgos_alarm_queue_entry *entry = &queue->entries[tail & queue->mask];
+    bool cancelled = queue_claim(entry, tail, QUEUE_ENTRY_CANCELLED, QUEUE_ENTRY_BUSY);
+    if(cancelled || queue_claim(entry, tail, QUEUE_ENTRY_READY, QUEUE_ENTRY_BUSY)){
+      queue_release(entry, tail, QUEUE_ENTRY_FREE);
+      __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+      if(!cancelled) ++queue->dropped;
+      return;
+    }
+  }
+}
+
+/*
+ * Push a transition, applying the overflow policy when full. Coalescing
+ * is tried on every push so that each alarm holds at most one entry.
+ */
+bool mgos_alarm_queue_push(struct mgos_alarm_queue *queue, const struct alarm_transition *transition,
+                           int64_t queued_us, enum mgos_alarm_overflow_policy policy){
+  if(policy == MGOS_ALARM_OVERFLOW_COALESCE && queue_coalesce(queue, transition)) return true;
+  uint32_t head = queue->head;
+  if(head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) >= queue->size){
+    if(policy == MGOS_ALARM_OVERFLOW_DROP_NEWEST){
+      ++queue->dropped;
+      return false;
+    }
+    queue_drop_oldest(queue);
+  }
+  struct mgos_alarm_queue_entry *entry = &queue->entries[head & queue->mask];
+  entry->transition = *transition;
+  entry->queued_us = queued_us;
+  queue_release(entry, head, QUEUE_ENTRY_READY);
+  __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+  uint32_t depth = head + 1 - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+  if(depth > queue->high_water) queue->high_water = depth;
+  return true;
+}
+
+/*
+ * Pop the oldest transition, skipping cancelled entries. The claim is of
+ * the position read from tail, so a tail that went stale while the
+ * producer dropped the entry and reused it fails the claim and is read
+ * again rather than popping the reused entry out of order.
+ */
+bool mgos_alarm_queue_pop(struct mgos_alarm_queue *queue, struct alarm_transition *transition,
+                          int64_t *queued_us){
+  for(;;){
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if(tail == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) return false;
+    struct mgos_alarm_queue_entry *entry = &queue->entries[tail & queue->mask];
+    bool cancelled = false;
+    if(!queue_claim(entry, tail, QUEUE_ENTRY_READY, QUEUE_ENTRY_BUSY)){
+      //dropped under us, reused or being coalesced, look again
+      if(!queue_claim(entry, tail, QUEUE_ENTRY_CANCELLED, QUEUE_ENTRY_BUSY)) continue;
+      cancelled = true;
+    }
+    if(!cancelled){
+      *transition = entry->transition;
+      *queued_us = entry->queued_us;
+    }
+    queue_release(entry, tail, QUEUE_ENTRY_FREE);
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    if(!cancelled) return true;
+  }
+}
+
+/*
+ * Returns the number of queued transitions
+ */
+uint32_t mgos_alarm_queue_depth(const struct mgos_alarm_queue *queue){
+  return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
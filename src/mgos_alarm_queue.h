@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Bounded transition queue of MGOS_ALARM_DISPATCH_ASYNC
+ *
+ * A power of two ring with one producer, the alarm engine, and one
+ * consumer, the drain callback. Neither side takes a lock. The producer
+ * owns head and the consumer owns tail, except when the ring is full and
+ * the producer drops the oldest entry. Each entry carries a sequence
+ * number, the ring position it was queued at and its state, which the side
+ * touching an entry it does not own claims with a compare and swap. A
+ * dropped or coalesced entry is never half read, and a consumer that read
+ * tail before a drop cannot claim the entry once reused for a later
+ * position.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_QUEUE_H_
+#define CS_FW_SRC_MGOS_ALARM_QUEUE_H_
+
+#include "mgos.h"
+#include "mgos_alarm.h"
+
+/*
+ * queue entry
+ *
+ * transition - the queued transition
+ * queued_us - uptime the transition was first queued at
+ * seq - ring position the entry was last queued at in the upper 30 bits, 
+ *   one of the QUEUE_ENTRY_ states in mgos_alarm_queue.c in the lower 2
+ */
+struct mgos_alarm_queue_entry{
+  struct alarm_transition transition;
+  int64_t queued_us;
+  uint32_t seq;
+};
+
+/*
+ * transition queue
+ *
+ * entries - the ring, size entries
+ * mask - size - 1
+ * head - count of entries pushed, written by the producer
+ * tail - count of entries popped or dropped
+ * high_water - most entries queued at once
+ * dropped - entries dropped by the overflow policy
+ * coalesced - transitions merged into a queued entry
+ */
+struct mgos_alarm_queue{
+  struct mgos_alarm_queue_entry *entries;
+  uint32_t size, mask;
+  uint32_t head, tail;
+  uint32_t high_water, dropped, coalesced;
+};
+
+/*
+ * Allocate a queue of size entries, size must be a power of two
+ * returns false if memory could not be allocated
+ */
+bool mgos_alarm_queue_init(struct mgos_alarm_queue *queue, uint32_t size);
+
+/*
+ * Push a transition, queued_us is the current uptime. When the queue is
+ * full the overflow policy decides what is dropped, MGOS_ALARM_OVERFLOW_COALESCE
+ * merges the transition into an entry of the same alarm whenever one is queued.
+ * returns false if the transition itself was dropped
+ */
+bool mgos_alarm_queue_push(struct mgos_alarm_queue *queue, const struct alarm_transition *transition,
+                           int64_t queued_us, enum mgos_alarm_overflow_policy policy);
+
+/*
+ * Pop the oldest transition into *transition and the uptime it was queued
+ * at into *queued_us
+ * returns false if the queue is empty
+ */
+bool mgos_alarm_queue_pop(struct mgos_alarm_queue *queue, struct alarm_transition *transition,
+                          int64_t *queued_us);
+
+/*
+ * Returns the number of queued transitions
+ */
+uint32_t mgos_alarm_queue_depth(const struct mgos_alarm_queue *queue);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_QUEUE_H_ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_rate.h"
+
+/*
+ * Returns true if change sequence number seq is after since, every
+ * number is after 0
+ */
+static bool rate_seq_after(uint32_t seq, uint32_t since){
+  return since == 0 || (int32_t) (seq - since) > 0;
+}
+
+void mgos_alarm_rate_set(struct mgos_alarm_rate *rate, uint32_t max_events, uint32_t period_ms, int64_t now){
+  if(max_events > 0){
+    rate->period_ms = period_ms;
+    rate->tokens = (uint64_t) max_events * period_ms;
+    rate->refill_ms = now;
+  }
+  rate->max_events = max_events;
+}
+
+bool mgos_alarm_rate_take(struct mgos_alarm_rate *rate, int64_t now, uint32_t since){
+  if(rate->max_events == 0) return true;
+  //refill for the time since the last event, a period refills it all
+  uint64_t full = (uint64_t) rate->max_events * rate->period_ms;
+  int64_t elapsed = now - rate->refill_ms;
+  if(elapsed >= rate->period_ms) rate->tokens = full;
+  else if(elapsed > 0) rate->tokens += (uint64_t) elapsed * rate->max_events;
+  if(rate->tokens > full) rate->tokens = full;
+  if(elapsed > 0) rate->refill_ms = now;
+  if(rate->tokens >= rate->period_ms){
+    rate->tokens -= rate->period_ms;
+    return true;
+  }
+  //the summary lists the changes from before the earliest refused one
+  if(rate->suppressed == 0){
+    rate->from_ms = now;
+    rate->since = since;
+  }
+  else if(rate_seq_after(rate->since, since)) rate->since = since;
+  rate->to_ms = now;
+  ++rate->suppressed;
+  return false;
+}
+
+bool mgos_alarm_rate_tick(struct mgos_alarm_rate *rate, int64_t now){
+  if(rate->suppressed == 0 || now - rate->from_ms < rate->period_ms) return false;
+  bool made = !rate->ready;
+  if(rate->ready){
+    rate->summary.suppressed += rate->suppressed;
+    rate->summary.to_ms = rate->to_ms;
+    if(rate_seq_after(rate->summary.since, rate->since)) rate->summary.since = rate->since;
+  }
+  else{
+    rate->summary.suppressed = rate->suppressed;
+    rate->summary.from_ms = rate->from_ms;
+    rate->summary.to_ms = rate->to_ms;
+    rate->summary.since = rate->since;
+  }
+  rate->ready = true;
+  rate->suppressed = 0;
+  return made;
+}
+
+int64_t mgos_alarm_rate_next(const struct mgos_alarm_rate *rate, int64_t next){
+  if(rate->suppressed > 0 && rate->from_ms + rate->period_ms < next) next = rate->from_ms + rate->period_ms;
+  return next;
+}
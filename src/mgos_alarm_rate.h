@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Event rate limiter, see mgos_alarm_set_rate_limit
+ *
+ * A token bucket of max_events per period_ms, kept in event milliseconds
+ * so that it refills by whole milliseconds without rounding. Transitions
+ * refused for want of a token are counted, and once a period has passed
+ * since the first of them are summarised into one struct alarm_summary.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_RATE_H_
+#define CS_FW_SRC_MGOS_ALARM_RATE_H_
+
+#include "mgos.h"
+#include "mgos_alarm.h"
+
+/*
+ * event rate limiter
+ *
+ * max_events, period_ms - the limit, max_events 0 for none
+ * tokens - the bucket in event milliseconds, an event costs period_ms and 
+ *   every ms adds max_events up to max_events * period_ms
+ * refill_ms - uptime (ms) the bucket was last refilled at
+ * suppressed, from_ms, to_ms, since - the transitions refused since the
+ *   last summary, as struct alarm_summary
+ * ready - summary is waiting to be raised
+ * summary - the summary made by the last pass
+ */
+struct mgos_alarm_rate{
+  uint32_t max_events, period_ms;
+  uint64_t tokens;
+  int64_t refill_ms;
+  uint32_t suppressed;
+  int64_t from_ms, to_ms;
+  uint32_t since;
+  bool ready;
+  struct alarm_summary summary;
+};
+
+/*
+ * Set the limit at now, the bucket starts full. max_events 0 removes the
+ * limit, transitions already refused are still summarised.
+ */
+void mgos_alarm_rate_set(struct mgos_alarm_rate *rate, uint32_t max_events, uint32_t period_ms, int64_t now);
+
+/*
+ * Take a token for an event raised at now
+ * since - change sequence number before the event's alarm changed, see
+ *   mgos_list_alarm_changes
+ * returns false if the bucket is empty, the transition then counts
+ * towards the next summary
+ */
+bool mgos_alarm_rate_take(struct mgos_alarm_rate *rate, int64_t now, uint32_t since);
+
+/*
+ * Summarise the refused transitions once a period has passed since the
+ * first of them. A summary still waiting to be raised takes in the new one.
+ * returns true if a new summary was made
+ */
+bool mgos_alarm_rate_tick(struct mgos_alarm_rate *rate, int64_t now);
+
+/*
+ * Returns the earlier of next and the time the refused transitions are
+ * summarised at
+ */
+int64_t mgos_alarm_rate_next(const struct mgos_alarm_rate *rate, int64_t next);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_RATE_H_ */
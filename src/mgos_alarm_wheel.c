@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_wheel.h"
+#include "mgos_alarm_arena.h"
+
+#define WHEEL_SLOT_MASK (MGOS_ALARM_WHEEL_SLOTS - 1)
+#define WHEEL_EXPIRED_LIST MGOS_ALARM_WHEEL_SLOTS
+
+/*
+ * Initialise an empty wheel
+ */
+void mgos_alarm_wheel_init(struct mgos_alarm_wheel *wheel, int tick_ms, int64_t now_ms,
+                           mgos_alarm_wheel_cb cb, void *cb_arg){
+  if(tick_ms < 1) tick_ms = 1;
+  for(int i = 0; i <= MGOS_ALARM_WHEEL_SLOTS; i++){
+    wheel->heads[i] = MGOS_ALARM_WHEEL_NONE;
+  }
+  wheel->tick_ms = tick_ms;
+  wheel->tick = (uint64_t) (now_ms / tick_ms);
+  wheel->pending = 0;
+  wheel->expired = 0;
+  wheel->cb = cb;
+  wheel->cb_arg = cb_arg;
+}
+
+/*
+ * Grow the entry array
+ */
+bool mgos_alarm_wheel_reserve(struct mgos_alarm_wheel *wheel, uint32_t capacity){
+  if(capacity <= wheel->capacity) return true;
+  struct mgos_alarm_wheel_entry *entries = 
+    (struct mgos_alarm_wheel_entry *) mgos_alarm_arena_realloc(wheel->entries, capacity * sizeof(*entries));
+  if(entries == NULL) return false;
+  memset(&entries[wheel->capacity], 0, (capacity - wheel->capacity) * sizeof(*entries));
+  wheel->entries = entries;
+  wheel->capacity = capacity;
+  return true;
+}
+
+/*
+ * Link an entry at the head of a list
+ */
+static void wheel_link(struct mgos_alarm_wheel *wheel, uint32_t id, uint16_t list){
+  struct mgos_alarm_wheel_entry *entry = &wheel->entries[id];
+  entry->list = list;
+  entry->prev = MGOS_ALARM_WHEEL_NONE;
+  entry->next = wheel->heads[list];
+  if(entry->next != MGOS_ALARM_WHEEL_NONE) wheel->entries[entry->next].prev = id;
+  wheel->heads[list] = id;
+}
+
+/*
+ * Unlink an entry from its list
+ */
+static void wheel_unlink(struct mgos_alarm_wheel *wheel, uint32_t id){
+  struct mgos_alarm_wheel_entry *entry = &wheel->entries[id];
+  if(entry->prev == MGOS_ALARM_WHEEL_NONE) wheel->heads[entry->list] = entry->next;
+  else wheel->entries[entry->prev].next = entry->next;
+  if(entry->next != MGOS_ALARM_WHEEL_NONE) wheel->entries[entry->next].prev = entry->prev;
+}
+
+/*
+ * Remove an entry from the wheel
+ */
+void mgos_alarm_wheel_cancel(struct mgos_alarm_wheel *wheel, uint32_t id){
+  if(id >= wheel->capacity || !wheel->entries[id].armed) return;
+  wheel_unlink(wheel, id);
+  wheel->entries[id].armed = false;
+  --wheel->pending;
+}
+
+/*
+ * Returns true if an entry is armed
+ */
+bool mgos_alarm_wheel_armed(const struct mgos_alarm_wheel *wheel, uint32_t id){
+  return id < wheel->capacity && wheel->entries[id].armed;
+}
+
+/*
+ * Arm an entry, hashing it into the slot of the tick it expires on
+ */
+void mgos_alarm_wheel_arm(struct mgos_alarm_wheel *wheel, uint32_t id, int delay_ms){
+  if(id >= wheel->capacity) return;
+  mgos_alarm_wheel_cancel(wheel, id);
+  //round up to whole ticks, an entry always waits for at least one tick
+  uint64_t ticks = delay_ms <= 0 ? 1 : ((uint64_t) delay_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+  struct mgos_alarm_wheel_entry *entry = &wheel->entries[id];
+  entry->expires = wheel->tick + ticks;
+  entry->armed = true;
+  wheel_link(wheel, id, entry->expires & WHEEL_SLOT_MASK);
+  ++wheel->pending;
+}
+
+/*
+ * Returns the uptime of an entry's expiry tick
+ */
+int64_t mgos_alarm_wheel_deadline(const struct mgos_alarm_wheel *wheel, uint32_t id){
+  if(!mgos_alarm_wheel_armed(wheel, id)) return INT64_MAX;
+  return (int64_t) wheel->entries[id].expires * wheel->tick_ms;
+}
+
+/*
+ * Returns the uptime of the earliest expiry tick
+ */
+int64_t mgos_alarm_wheel_next(const struct mgos_alarm_wheel *wheel){
+  if(wheel->pending == 0) return INT64_MAX;
+  uint64_t next = UINT64_MAX;
+  for(int i = 0; i <= MGOS_ALARM_WHEEL_SLOTS; i++){
+    for(uint32_t id = wheel->heads[i]; id != MGOS_ALARM_WHEEL_NONE; id = wheel->entries[id].next){
+      if(wheel->entries[id].expires < next) next = wheel->entries[id].expires;
+    }
+  }
+  return (int64_t) next * wheel->tick_ms;
+}
+
+/*
+ * Process every tick up to now_ms
+ */
+void mgos_alarm_wheel_advance(struct mgos_alarm_wheel *wheel, int64_t now_ms){
+  uint64_t target = (uint64_t) (now_ms / wheel->tick_ms);
+  if(target <= wheel->tick) return;
+  //move the expired entries of all the elapsed ticks into the expired 
+  //batch, after a full rotation every slot has been visited once
+  uint64_t ticks = target - wheel->tick;
+  if(ticks > MGOS_ALARM_WHEEL_SLOTS) ticks = MGOS_ALARM_WHEEL_SLOTS;
+  for(uint64_t t = target - ticks + 1; t <= target; t++){
+    uint32_t id = wheel->heads[t & WHEEL_SLOT_MASK];
+    while(id != MGOS_ALARM_WHEEL_NONE){
+      uint32_t next = wheel->entries[id].next;
+      if(wheel->entries[id].expires <= target){
+        wheel_unlink(wheel, id);
+        wheel_link(wheel, id, WHEEL_EXPIRED_LIST);
+      }
+      id = next;
+    }
+  }
+  wheel->tick = target;
+  //run the batch, each entry is disarmed before the callback so that 
+  //the callback may re-arm it
+  uint32_t id;
+  while((id = wheel->heads[WHEEL_EXPIRED_LIST]) != MGOS_ALARM_WHEEL_NONE){
+    wheel_unlink(wheel, id);
+    wheel->entries[id].armed = false;
+    --wheel->pending;
+    ++wheel->expired;
+    wheel->cb(id, wheel->cb_arg);
+  }
+}
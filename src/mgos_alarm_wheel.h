@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Hashed timing wheel used for alarm set/reset deadlines
+ * 
+ * The wheel is owned by the alarm library and advanced from the main alarm
+ * service timer, one slot per poll_interval. A deadline is hashed into the
+ * slot of the tick it expires on, deadlines further away than one rotation
+ * simply stay in their slot until their tick comes round. Arming and 
+ * cancelling a deadline is O(1) and no SDK timers are used.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_WHEEL_H_
+#define CS_FW_SRC_MGOS_ALARM_WHEEL_H_
+
+#include "mgos.h"
+
+#define MGOS_ALARM_WHEEL_SLOTS 256
+#define MGOS_ALARM_WHEEL_NONE UINT32_MAX
+
+/*
+ * Wheel expiry callback, id is the id of the expired entry
+ */
+typedef void (*mgos_alarm_wheel_cb)(uint32_t id, void *arg);
+
+/*
+ * wheel entry, entries are identified by their index in the entry array
+ * so that the array can grow and the owner can refer to them by id
+ * 
+ * next, prev - neighbouring entries in the same list
+ * list - the wheel slot the entry is in, or MGOS_ALARM_WHEEL_SLOTS while 
+ *   it waits in the expired batch
+ * expires - the wheel tick the entry expires on
+ * armed - the entry is currently in the wheel or the expired batch
+ */
+struct mgos_alarm_wheel_entry{
+  uint32_t next, prev;
+  uint16_t list;
+  uint64_t expires;
+  bool armed;
+};
+
+/*
+ * timing wheel
+ * 
+ * heads - first entry of each wheel slot, the last list holds the 
+ *   expired batch
+ * entries - the entry array
+ * capacity - number of entries
+ * tick - the last tick that has been processed
+ * tick_ms - the period of one tick
+ * pending - number of armed entries
+ * expired - number of entries that have expired
+ * cb, cb_arg - callback run for every expired entry
+ */
+struct mgos_alarm_wheel{
+  uint32_t heads[MGOS_ALARM_WHEEL_SLOTS + 1];
+  struct mgos_alarm_wheel_entry *entries;
+  uint32_t capacity;
+  uint64_t tick;
+  int tick_ms;
+  uint32_t pending, expired;
+  mgos_alarm_wheel_cb cb;
+  void *cb_arg;
+};
+
+/*
+ * Initialise an empty wheel with the passed tick period and expiry 
+ * callback, now_ms is the current uptime
+ */
+void mgos_alarm_wheel_init(struct mgos_alarm_wheel *wheel, int tick_ms, int64_t now_ms,
+                           mgos_alarm_wheel_cb cb, void *cb_arg);
+
+/*
+ * Grow the entry array so that ids below capacity can be armed
+ * returns false if memory could not be allocated
+ */
+bool mgos_alarm_wheel_reserve(struct mgos_alarm_wheel *wheel, uint32_t capacity);
+
+/*
+ * Arm entry id to expire delay_ms from the last processed tick,
+ * an armed entry is re-armed. The delay is rounded up to whole ticks.
+ */
+void mgos_alarm_wheel_arm(struct mgos_alarm_wheel *wheel, uint32_t id, int delay_ms);
+
+/*
+ * Remove entry id from the wheel, does nothing if the entry is not armed
+ */
+void mgos_alarm_wheel_cancel(struct mgos_alarm_wheel *wheel, uint32_t id);
+
+/*
+ * Returns true if entry id is armed
+ */
+bool mgos_alarm_wheel_armed(const struct mgos_alarm_wheel *wheel, uint32_t id);
+
+/*
+ * Returns the uptime (ms) of the tick entry id expires on,
+ * INT64_MAX if it is not armed
+ */
+int64_t mgos_alarm_wheel_deadline(const struct mgos_alarm_wheel *wheel, uint32_t id);
+
+/*
+ * Returns the uptime (ms) of the tick the earliest armed entry expires on,
+ * INT64_MAX if no entry is armed. Every slot is visited, O(slots + pending).
+ */
+int64_t mgos_alarm_wheel_next(const struct mgos_alarm_wheel *wheel);
+
+/*
+ * Process every tick up to now_ms, the expired entries of all the ticks
+ * are collected first and the callback then runs for each as one batch.
+ * The callback may re-arm or cancel any entry.
+ */
+void mgos_alarm_wheel_advance(struct mgos_alarm_wheel *wheel, int64_t now_ms);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_WHEEL_H_ */
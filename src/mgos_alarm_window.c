@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_alarm_window.h"
+#include "mgos_alarm_arena.h"
+
+/*
+ * Allocate the ring, the times and the deque in one block
+ */
+bool mgos_alarm_window_init(struct mgos_alarm_window *window, uint32_t size, uint32_t window_ms,
+                            enum mgos_alarm_window_stat stat){
+  if(size == 0) return false;
+  size_t words = (size_t) size * (1 + (window_ms > 0) + (stat != MGOS_ALARM_WINDOW_MEAN));
+  uint32_t *block = (uint32_t *) mgos_alarm_arena_calloc(words, sizeof(uint32_t));
+  if(block == NULL) return false;
+  window->values = (float *) block;
+  block += size;
+  window->times = window_ms > 0 ? block : NULL;
+  if(window_ms > 0) block += size;
+  window->deque = stat != MGOS_ALARM_WINDOW_MEAN ? block : NULL;
+  window->size = size;
+  window->window_ms = window_ms;
+  window->stat = stat;
+  mgos_alarm_window_clear(window);
+  return true;
+}
+
+void mgos_alarm_window_free(struct mgos_alarm_window *window){
+  free(window->values);
+  window->values = NULL;
+}
+
+void mgos_alarm_window_clear(struct mgos_alarm_window *window){
+  window->head = 0;
+  window->count = 0;
+  window->dq_first = 0;
+  window->dq_count = 0;
+  window->sum = 0;
+}
+
+/*
+ * Returns the ring position n positions after pos, n <= size
+ */
+static uint32_t window_pos(const struct mgos_alarm_window *window, uint32_t pos, uint32_t n){
+  pos += n;
+  return pos >= window->size ? pos - window->size : pos;
+}
+
+/*
+ * Drop the oldest sample, it is the front of the deque if it is in it as
+ * the deque is ordered by age
+ */
+static void window_pop(struct mgos_alarm_window *window){
+  uint32_t oldest = window_pos(window, window->head, window->size - window->count);
+  window->sum -= window->values[oldest];
+  if(window->dq_count > 0 && window->deque[window->dq_first] == oldest){
+    window->dq_first = window_pos(window, window->dq_first, 1);
+    --window->dq_count;
+  }
+  --window->count;
+}
+
+/*
+ * Append a sample, samples it makes unable to become the minimum (or the
+ * maximum) are dropped from the back of the deque first
+ */
+static void window_push(struct mgos_alarm_window *window, float value, uint32_t time_ms){
+  uint32_t pos = window->head;
+  window->values[pos] = value;
+  if(window->times != NULL) window->times[pos] = time_ms;
+  window->head = window_pos(window, pos, 1);
+  ++window->count;
+  if(window->deque != NULL){
+    bool min = (window->stat == MGOS_ALARM_WINDOW_MIN);
+    while(window->dq_count > 0){
+      float back = window->values[window->deque[window_pos(window, window->dq_first, window->dq_count - 1)]];
+      if(min ? back < value : back > value) break;
+      --window->dq_count;
+    }
+    window->deque[window_pos(window, window->dq_first, window->dq_count)] = pos;
+    ++window->dq_count;
+  }
+  else{
+    window->sum += value;
+    //rebuild the sum once per lap of the ring
+    if(window->head == 0){
+      window->sum = 0;
+      for(uint32_t k = 0; k < window->count; k++){
+        window->sum += window->values[window_pos(window, window->head, window->size - window->count + k)];
+      }
+    }
+  }
+}
+
+float mgos_alarm_window_sample(struct mgos_alarm_window *window, float value, int64_t now){
+  if(isnan(value)){
+    mgos_alarm_window_clear(window);
+    return NAN;
+  }
+  uint32_t time_ms = (uint32_t) now;
+  if(window->count == window->size) window_pop(window);
+  window_push(window, value, time_ms);
+  //the sample just pushed is never older than window_ms
+  if(window->times != NULL){
+    while(time_ms - window->times[window_pos(window, window->head, window->size - window->count)] >=
+          window->window_ms){
+      window_pop(window);
+    }
+  }
+  switch(window->stat){
+    case MGOS_ALARM_WINDOW_MIN:
+    case MGOS_ALARM_WINDOW_MAX:
+      return window->values[window->deque[window->dq_first]];
+    default:
+      return window->sum / (float) window->count;
+  }
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Sliding window of the windowed analog alarms
+ *
+ * A fixed ring of the last samples, allocated once when the alarm is
+ * added, holding at most size samples and, if window_ms is set, only the
+ * samples taken in the last window_ms. The minimum or maximum is kept by
+ * a monotonic deque of ring positions, whose front is the extreme of the
+ * window, and the mean by a running sum. Every sample is pushed and
+ * popped once, so each costs O(1) amortized whatever the window length.
+ * The running sum is rebuilt each time the ring wraps so rounding cannot
+ * accumulate.
+ */
+
+#ifndef CS_FW_SRC_MGOS_ALARM_WINDOW_H_
+#define CS_FW_SRC_MGOS_ALARM_WINDOW_H_
+
+#include "mgos.h"
+#include "mgos_alarm.h"
+
+/*
+ * window
+ *
+ * values - the sample ring, size entries
+ * times - uptime (ms, truncated to 32 bits) of each sample, NULL if
+ *   window_ms is 0
+ * deque - ring of the positions of the samples that can still become the
+ *   window's minimum or maximum, oldest first, NULL for a mean
+ * size - samples the ring holds
+ * head - ring position the next sample is written to
+ * count - samples in the window
+ * dq_first, dq_count - front position and length of deque
+ * window_ms - age at which a sample leaves the window, 0 for no limit
+ * stat - the statistic, see enum mgos_alarm_window_stat
+ * sum - sum of the samples in the window
+ */
+struct mgos_alarm_window{
+  float *values;
+  uint32_t *times;
+  uint32_t *deque;
+  uint32_t size, head, count;
+  uint32_t dq_first, dq_count;
+  uint32_t window_ms;
+  uint8_t stat;
+  float sum;
+};
+
+/*
+ * Allocate the ring of an empty window of size samples
+ * returns false if size is 0 or memory could not be allocated
+ */
+bool mgos_alarm_window_init(struct mgos_alarm_window *window, uint32_t size, uint32_t window_ms,
+                            enum mgos_alarm_window_stat stat);
+
+/*
+ * Free the ring
+ */
+void mgos_alarm_window_free(struct mgos_alarm_window *window);
+
+/*
+ * Empty the window
+ */
+void mgos_alarm_window_clear(struct mgos_alarm_window *window);
+
+/*
+ * Add a sample taken at now (ms) and drop the samples that left the
+ * window, a NAN sample empties the window
+ * returns the statistic of the window, NAN if it is empty
+ */
+float mgos_alarm_window_sample(struct mgos_alarm_window *window, float value, int64_t now);
+
+#endif /* CS_FW_SRC_MGOS_ALARM_WINDOW_H_ */
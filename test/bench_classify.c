@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Batch classification benchmark
+ *
+ * Classifies 4096 analog PVs against ll/l/h/hh setpoints, with the batch
+ * kernel and with the per-alarm comparison chain the kernel replaces,
+ * for PVs that sit in one band (predictable branches) and PVs that are
+ * random across all five bands (noisy signals). Reports ns per alarm for
+ * each, and checks the kernel agrees with the chain on random setpoints,
+ * NAN included.
+ *
+ * usage: bench_classify
+ */
+
+#include "mgos_alarm.h"
+#include "mgos_alarm_classify.h"
+
+#define BENCH_ALARMS 4096
+#define BENCH_ROUNDS 2000
+
+static float s_pv[BENCH_ALARMS], s_ll[BENCH_ALARMS], s_l[BENCH_ALARMS];
+static float s_h[BENCH_ALARMS], s_hh[BENCH_ALARMS];
+static uint8_t s_band[BENCH_ALARMS];
+
+/*
+ * The per-alarm comparison chain, kept out of line as it was called once
+ * per alarm so that the compiler does not vectorise the reference loop
+ */
+static __attribute__((noinline)) uint8_t bench_classify_one(float pv, float ll, float l, float h, float hh){
+  if(pv >= hh) return HH;
+  if(pv >= h) return H;
+  if(pv <= ll) return LL;
+  if(pv <= l) return L;
+  return NOM;
+}
+
+static float bench_random(unsigned *seed, bool nan){
+  int r = rand_r(seed);
+  if(nan && r % 20 == 0) return NAN;
+  return (float) (r % 2000) / 10.0f - 100.0f;
+}
+
+static uint32_t bench_check(void){
+  unsigned seed = 1;
+  uint32_t bad = 0;
+  for(int k = 0; k < 100; k++){
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+      s_pv[i] = bench_random(&seed, true);
+      s_ll[i] = bench_random(&seed, true);
+      s_l[i] = bench_random(&seed, true);
+      s_h[i] = bench_random(&seed, true);
+      s_hh[i] = bench_random(&seed, true);
+    }
+    mgos_alarm_classify(s_pv, s_ll, s_l, s_h, s_hh, s_band, BENCH_ALARMS);
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+      bad += s_band[i] != bench_classify_one(s_pv[i], s_ll[i], s_l[i], s_h[i], s_hh[i]);
+    }
+  }
+  return bad;
+}
+
+static void bench_run(const char *label, bool noisy){
+  unsigned seed = 2;
+  volatile uint32_t sink = 0;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    s_ll[i] = -50.0f;
+    s_l[i] = -20.0f;
+    s_h[i] = 20.0f;
+    s_hh[i] = 50.0f;
+    s_pv[i] = noisy ? bench_random(&seed, false) : 0.0f;
+  }
+  uint64_t start = mgos_host_clock_ns();
+  for(int k = 0; k < BENCH_ROUNDS; k++){
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+      s_band[i] = bench_classify_one(s_pv[i], s_ll[i], s_l[i], s_h[i], s_hh[i]);
+    }
+    sink += s_band[k % BENCH_ALARMS];
+  }
+  uint64_t chain_ns = mgos_host_clock_ns() - start;
+  start = mgos_host_clock_ns();
+  for(int k = 0; k < BENCH_ROUNDS; k++){
+    mgos_alarm_classify(s_pv, s_ll, s_l, s_h, s_hh, s_band, BENCH_ALARMS);
+    sink += s_band[k % BENCH_ALARMS];
+  }
+  uint64_t batch_ns = mgos_host_clock_ns() - start;
+  double per = (double) BENCH_ROUNDS * BENCH_ALARMS;
+  printf("%-8s %14.2f %14.2f %8.1fx\n", label, chain_ns / per, batch_ns / per,
+         batch_ns ? (double) chain_ns / batch_ns : 0);
+}
+
+int main(void){
+  uint32_t bad = bench_check();
+  printf("kernel %s, %u mismatches against the comparison chain\n", mgos_alarm_classify_kernel(), bad);
+  printf("pvs      chain ns/alarm batch ns/alarm  speedup\n");
+  bench_run("steady", false);
+  bench_run("noisy", true);
+  return bad != 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Startup benchmark, adding an alarm set one call at a time against
+ * loading it as a configuration
+ *
+ * 2000 alarms, alternately digital and analog, are added with
+ * mgos_add_d_alarm and mgos_add_a_alarm, then loaded with
+ * mgos_alarm_load_config_buf from JSON and from the binary form of
+ * tools/mgos_alarm_config.py, built in memory here. Each way runs in its
+ * own process from a freshly initialised engine, and each run is checked
+ * by looking up every alarm and its state.
+ * Reports:
+ * first us, allocs - wall time and library heap allocations of the first
+ *   run, where every table grows from empty as at startup
+ * best us - fastest of the runs, the tables already have room The JSON time depends on json_walk, on the host the
+ * stand-in in stubs/frozen.h.
+ *
+ * usage: bench_config
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mgos_alarm.h"
+
+#define BENCH_ALARMS 2000
+#define BENCH_RUNS 5
+
+static bool s_inputs[BENCH_ALARMS];
+static float s_pvs[BENCH_ALARMS];
+static char s_names[BENCH_ALARMS][12];
+static char s_json[BENCH_ALARMS * 160];
+static uint8_t s_binary[12 + BENCH_ALARMS * (28 + 12)];
+static size_t s_json_len, s_binary_len;
+
+static void bench_name(uint32_t i, char *name, size_t size){
+  snprintf(name, size, (i & 1) ? "ana%u" : "dig%u", (unsigned) i);
+}
+
+static void bench_build_json(void){
+  size_t n = (size_t) snprintf(s_json, sizeof(s_json), "{\"alarms\": [");
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    char name[12];
+    bench_name(i, name, sizeof(name));
+    if(i & 1){
+      n += (size_t) snprintf(s_json + n, sizeof(s_json) - n,
+                             "%s{\"name\": \"%s\", \"type\": \"analog\", \"pv\": %u, \"ll_sv\": 10, \"l_sv\": 20, "
+                             "\"h_sv\": 80, \"hh_sv\": 90}", i ? ", " : "", name, (unsigned) i);
+    }
+    else{
+      n += (size_t) snprintf(s_json + n, sizeof(s_json) - n,
+                             "%s{\"name\": \"%s\", \"type\": \"digital\", \"input\": %u, \"mode\": \"ACTIVE_HIGH\"}",
+                             i ? ", " : "", name, (unsigned) i);
+    }
+  }
+  n += (size_t) snprintf(s_json + n, sizeof(s_json) - n, "]}");
+  s_json_len = n;
+}
+
+static uint8_t *bench_u32(uint8_t *p, uint32_t value){
+  for(int k = 0; k < 4; k++) *p++ = (uint8_t) (value >> (8 * k));
+  return p;
+}
+
+static uint8_t *bench_f32(uint8_t *p, float value){
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bench_u32(p, bits);
+}
+
+/*
+ * Encode the alarms as tools/mgos_alarm_config.py does
+ */
+static void bench_build_binary(void){
+  uint8_t *p = s_binary;
+  memcpy(p, "ALMC\x01\0\0\0", 8);
+  p = bench_u32(p + 8, BENCH_ALARMS);
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    char name[12];
+    bench_name(i, name, sizeof(name));
+    size_t len = strlen(name);
+    *p++ = (i & 1) ? 1 : 0;
+    *p++ = 0x01 | 0x02;
+    *p++ = (uint8_t) len;
+    *p++ = (uint8_t) (len >> 8);
+    p = bench_u32(p, i);
+    if(i & 1){
+      p = bench_f32(bench_f32(bench_f32(bench_f32(p, 10), 20), 80), 90);
+      p = bench_u32(p, 0);
+    }
+    else p = bench_u32(bench_u32(p, 0), 0);
+    memcpy(p, name, len);
+    p += len;
+  }
+  s_binary_len = (size_t) (p - s_binary);
+}
+
+/*
+ * Look up every alarm and check its state
+ * returns the number of alarms missing or in the wrong state
+ */
+static uint32_t bench_check(void){
+  uint32_t bad = 0;
+  mgos_host_advance(100);
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    char name[12];
+    struct alarm_info info;
+    bench_name(i, name, sizeof(name));
+    mgos_alarm_handle_t handle = mgos_alarm_find(name);
+    if(handle == MGOS_ALARM_INVALID_HANDLE || !mgos_alarm_get_state_h(handle, &info)){
+      bad++;
+      continue;
+    }
+    if(i & 1){
+      uint32_t v = i % 100;
+      enum mgos_a_alarm_state state = v <= 10 ? LL : v <= 20 ? L : v >= 90 ? HH : v >= 80 ? H : NOM;
+      bad += info.state.a_state != state;
+    }
+    else bad += info.state.d_state != (i % 3 == 0);
+  }
+  return bad;
+}
+
+static void bench_remove(void){
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    char name[12];
+    bench_name(i, name, sizeof(name));
+    mgos_alarm_remove_h(mgos_alarm_find(name));
+  }
+  mgos_host_advance(100);
+}
+
+/*
+ * Add the alarms BENCH_RUNS times in one of three ways
+ * returns the number of failed checks
+ */
+static uint32_t bench_run(const char *label, int how){
+  struct mgos_alarm_config_io io = {s_inputs, BENCH_ALARMS, s_pvs, BENCH_ALARMS};
+  uint64_t first = 0, best = UINT64_MAX;
+  uint32_t allocs = 0, bad = 0;
+  for(int run = 0; run < BENCH_RUNS; run++){
+    struct mgos_alarm_stats before, after;
+    mgos_alarm_get_stats(&before);
+    uint64_t start = mgos_host_clock_ns();
+    if(how == 0){
+      for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+        if(i & 1) bad += !mgos_add_a_alarm(true, &s_pvs[i], 10, 20, 80, 90, 0, s_names[i]);
+        else bad += !mgos_add_d_alarm(true, &s_inputs[i], ACTIVE_HIGH, 0, 0, s_names[i]);
+      }
+    }
+    else if(how == 1) bad += !mgos_alarm_load_config_buf(s_json, s_json_len, &io);
+    else bad += !mgos_alarm_load_config_buf((const char *) s_binary, s_binary_len, &io);
+    uint64_t elapsed = mgos_host_clock_ns() - start;
+    mgos_alarm_get_stats(&after);
+    if(run == 0){
+      first = elapsed;
+      allocs = after.allocs - before.allocs;
+    }
+    if(elapsed < best) best = elapsed;
+    bad += bench_check();
+    bench_remove();
+  }
+  printf("%-10s %10.0f %8u %10.0f %5s\n", label, first / 1e3, allocs, best / 1e3, bad ? "FAIL" : "ok");
+  return bad;
+}
+
+int main(void){
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    bench_name(i, s_names[i], sizeof(s_names[i]));
+    s_inputs[i] = i % 3 == 0;
+    s_pvs[i] = (float) (i % 100);
+  }
+  bench_build_json();
+  bench_build_binary();
+  static const char *const labels[] = {"add calls", "json", "binary"};
+  printf("how          first us   allocs    best us\n");
+  fflush(stdout);
+  int failed = 0;
+  for(int how = 0; how < 3; how++){
+    //mgos_alarm_init runs once per process
+    pid_t pid = fork();
+    if(pid == 0){
+      if(!mgos_alarm_init(10)) _exit(1);
+      uint32_t bad = bench_run(labels[how], how);
+      fflush(stdout);
+      _exit(bad != 0);
+    }
+    int status = 1;
+    if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+  }
+  return failed != 0;
+}
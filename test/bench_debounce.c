@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Debounce mode benchmark under noisy inputs
+ *
+ * 1000 digital alarms with 200ms set and reset delays read inputs that
+ * chatter: every 10ms pass each input reads its true level with 70%
+ * probability and the opposite level otherwise, and the true level of
+ * each input flips every 5s on average. For each debounce mode, over 60s
+ * of simulated time, reports:
+ * timers/s - SDK timer arm and clear calls per second
+ * invokes/s - callbacks deferred to the SDK task per second
+ * tick ns - wall time of a service timer pass, SDK timer callbacks included
+ * events - SET/RESET events raised. The timing wheel expires deadlines at
+ *   the start of a pass, before the pass reads the inputs, so an input that
+ *   flips back on the pass its deadline falls on still transitions and the
+ *   wheel raises more events under this much noise.
+ *
+ * usage: bench_debounce
+ */
+
+#include "mgos_alarm.h"
+
+#define BENCH_ALARMS 1000
+#define BENCH_POLL_MS 10
+#define BENCH_DELAY_MS 200
+#define BENCH_SECONDS 60
+
+static bool s_inputs[BENCH_ALARMS];
+static bool s_levels[BENCH_ALARMS];
+static char s_names[BENCH_ALARMS][8];
+static mgos_alarm_handle_t s_handles[BENCH_ALARMS];
+static uint32_t s_events;
+
+static void bench_handler(int ev, void *ev_data, void *userdata){
+  (void) ev_data;
+  (void) userdata;
+  if(ev == MGOS_ALARM_EV_SET || ev == MGOS_ALARM_EV_RESET) s_events++;
+}
+
+static void bench_run(enum mgos_alarm_debounce_mode mode, const char *label){
+  unsigned seed = 1;
+  memset(s_inputs, 0, sizeof(s_inputs));
+  memset(s_levels, 0, sizeof(s_levels));
+  mgos_alarm_set_debounce_mode(mode);
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    s_handles[i] = mgos_add_d_alarm_h(true, &s_inputs[i], ACTIVE_HIGH, BENCH_DELAY_MS, BENCH_DELAY_MS, s_names[i]);
+  }
+  mgos_host_advance(BENCH_POLL_MS);
+  struct mgos_host_stats before, after;
+  mgos_host_get_stats(&before);
+  s_events = 0;
+  uint32_t ticks = BENCH_SECONDS * 1000 / BENCH_POLL_MS;
+  uint64_t total = 0;
+  for(uint32_t t = 0; t < ticks; t++){
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+      uint32_t r = (uint32_t) rand_r(&seed) % 1000;
+      //a flip every 500 passes on average
+      if(r < 2) s_levels[i] = !s_levels[i];
+      bool in = (r % 10 < 7) ? s_levels[i] : !s_levels[i];
+      if(in != s_inputs[i]){
+        s_inputs[i] = in;
+        mgos_alarm_input_changed(s_handles[i]);
+      }
+    }
+    uint64_t start = mgos_host_clock_ns();
+    mgos_host_advance(BENCH_POLL_MS);
+    total += mgos_host_clock_ns() - start;
+  }
+  mgos_host_get_stats(&after);
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) mgos_alarm_remove_h(s_handles[i]);
+  mgos_host_advance(BENCH_POLL_MS);
+  printf("%-10s %10.0f %10.0f %10.0f %10.0f %8u\n", label,
+         (double) (after.timer_sets - before.timer_sets) / BENCH_SECONDS,
+         (double) (after.timer_clears - before.timer_clears) / BENCH_SECONDS,
+         (double) (after.invokes - before.invokes) / BENCH_SECONDS,
+         (double) total / ticks, s_events);
+}
+
+int main(void){
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) snprintf(s_names[i], sizeof(s_names[i]), "n%u", i);
+  if(!mgos_alarm_init(BENCH_POLL_MS)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, bench_handler, NULL);
+  printf("mode         timers/s   clears/s  invokes/s    tick ns   events\n");
+  bench_run(MGOS_ALARM_DEBOUNCE_TIMER, "timer");
+  bench_run(MGOS_ALARM_DEBOUNCE_TIMESTAMP, "timestamp");
+  bench_run(MGOS_ALARM_DEBOUNCE_WHEEL, "wheel");
+  return 0;
+}
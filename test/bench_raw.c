@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Float against raw count analog alarm benchmark
+ *
+ * 2000 analog alarms with value = raw * 0.5 - 10 and setpoints exact in
+ * both domains, some of them between two counts, are scanned on float
+ * PVs (mgos_add_a_alarm_h), 32 bit counts (mgos_add_raw_alarm_h) and 16
+ * bit counts (mgos_add_raw16_alarm_h) whose values change every pass.
+ * Reports the wall time of a pass per alarm for each. Beforehand a float
+ * and a raw alarm on each value are scanned side by side and must agree
+ * on the band and on the value reported by mgos_alarm_get_value_h, the
+ * mismatches are reported and fail the benchmark.
+ *
+ * usage: bench_raw
+ */
+
+#include "mgos_alarm.h"
+
+#define BENCH_ALARMS 2000
+#define BENCH_PASSES 500
+#define BENCH_POLL_MS 10
+#define BENCH_SCALE 0.5f
+#define BENCH_OFFSET (-10.0f)
+
+enum bench_kind{
+  BENCH_FLOAT,
+  BENCH_RAW,
+  BENCH_RAW16
+};
+
+static const float s_setpoints[][4] = {
+  {0, 100, 1000, 1500},
+  {NAN, 100.25f, NAN, 1500.75f},
+  {-5, NAN, 1000, NAN},
+  {-2000, -1000, 5000, 20000},
+};
+
+static float s_pvs[BENCH_ALARMS];
+static int32_t s_raw[BENCH_ALARMS];
+static int16_t s_raw16[BENCH_ALARMS];
+static char s_names[2][BENCH_ALARMS][12];
+static mgos_alarm_handle_t s_handles[2][BENCH_ALARMS];
+
+static mgos_alarm_handle_t bench_add(enum bench_kind kind, uint32_t i, char *name){
+  const float *sv = s_setpoints[i % 4];
+  if(kind == BENCH_FLOAT) return mgos_add_a_alarm_h(true, &s_pvs[i], sv[0], sv[1], sv[2], sv[3], 0, name);
+  if(kind == BENCH_RAW){
+    return mgos_add_raw_alarm_h(true, &s_raw[i], BENCH_SCALE, BENCH_OFFSET, sv[0], sv[1], sv[2], sv[3], 0, name);
+  }
+  return mgos_add_raw16_alarm_h(true, &s_raw16[i], BENCH_SCALE, BENCH_OFFSET, sv[0], sv[1], sv[2], sv[3], 0, name);
+}
+
+/*
+ * Set every alarm's count, and the float PV to its value
+ */
+static void bench_set(uint32_t i, int32_t count){
+  if(count > INT16_MAX) count = INT16_MAX;
+  s_raw[i] = count;
+  s_raw16[i] = (int16_t) count;
+  s_pvs[i] = (float) count * BENCH_SCALE + BENCH_OFFSET;
+}
+
+/*
+ * Scan float alarms beside raw alarms, every third a 16 bit one
+ * returns the number of mismatches
+ */
+static uint32_t bench_check(void){
+  unsigned seed = 7;
+  uint32_t bad = 0;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    s_handles[0][i] = bench_add(BENCH_FLOAT, i, s_names[0][i]);
+    s_handles[1][i] = bench_add(i % 3 == 0 ? BENCH_RAW16 : BENCH_RAW, i, s_names[1][i]);
+  }
+  for(int k = 0; k < 300; k++){
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+      //every fifth pass sits on and around the setpoints between counts
+      bench_set(i, (k % 5 == 0) ? 220 + (int32_t) (i % 3) : (int32_t) (rand_r(&seed) % 44000) - 4000);
+    }
+    mgos_host_advance(BENCH_POLL_MS);
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+      struct alarm_info f, r;
+      float value;
+      if(!mgos_alarm_get_state_h(s_handles[0][i], &f) || !mgos_alarm_get_state_h(s_handles[1][i], &r) ||
+         f.state.a_state != r.state.a_state || !mgos_alarm_get_value_h(s_handles[1][i], &value) ||
+         value != s_pvs[i]){
+        bad++;
+      }
+    }
+  }
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    mgos_alarm_remove_h(s_handles[0][i]);
+    mgos_alarm_remove_h(s_handles[1][i]);
+  }
+  mgos_host_advance(BENCH_POLL_MS);
+  return bad;
+}
+
+/*
+ * returns the wall time of a pass per alarm in ns
+ */
+static double bench_run(enum bench_kind kind){
+  unsigned seed = 11;
+  uint64_t total = 0;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) s_handles[0][i] = bench_add(kind, i, s_names[0][i]);
+  mgos_host_advance(BENCH_POLL_MS);
+  for(int k = 0; k < BENCH_PASSES; k++){
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++) bench_set(i, rand_r(&seed) % 6000);
+    uint64_t start = mgos_host_clock_ns();
+    mgos_host_advance(BENCH_POLL_MS);
+    total += mgos_host_clock_ns() - start;
+  }
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) mgos_alarm_remove_h(s_handles[0][i]);
+  mgos_host_advance(BENCH_POLL_MS);
+  return (double) total / BENCH_PASSES / BENCH_ALARMS;
+}
+
+int main(void){
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    snprintf(s_names[0][i], sizeof(s_names[0][i]), "f%u", (unsigned) i);
+    snprintf(s_names[1][i], sizeof(s_names[1][i]), "r%u", (unsigned) i);
+  }
+  if(!mgos_alarm_init(BENCH_POLL_MS)) return 1;
+  mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP);
+  uint32_t bad = bench_check();
+  struct mgos_alarm_stats stats;
+  mgos_alarm_get_stats(&stats);
+  printf("kernel %s, %u mismatches between float and raw alarms\n", stats.classify_kernel, bad);
+  printf("pvs        ns/alarm\n");
+  printf("%-10s %8.1f\n", "float", bench_run(BENCH_FLOAT));
+  printf("%-10s %8.1f\n", "raw", bench_run(BENCH_RAW));
+  printf("%-10s %8.1f\n", "raw16", bench_run(BENCH_RAW16));
+  return bad != 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Scaling benchmark of the alarm engine
+ *
+ * For 10, 1k, 10k and 100k alarms, half digital and half analog, in the
+ * default evaluation and debounce modes, measures:
+ * add, remove, lookup - wall time per mgos_add_*_alarm_h, mgos_alarm_remove_h
+ *   and mgos_alarm_find call
+ * idle tick - wall time of a service timer pass in which no input changed,
+ *   and that per alarm
+ * busy tick - the same with 1% of the inputs changing every pass
+ * event - the extra cost of a busy tick per SET/RESET event dispatched,
+ *   evaluation of the transition and its handler call included
+ * allocs/tick - library heap allocations and SDK timers armed per busy tick
+ *
+ * usage: bench_scale [max alarms]
+ */
+
+#include "mgos_alarm.h"
+
+#define BENCH_MAX_ALARMS 100000
+#define BENCH_TICKS 50
+#define BENCH_POLL_MS 10
+
+static bool s_inputs[BENCH_MAX_ALARMS / 2];
+static float s_pvs[BENCH_MAX_ALARMS / 2];
+static char s_names[BENCH_MAX_ALARMS][12];
+static mgos_alarm_handle_t s_handles[BENCH_MAX_ALARMS];
+static uint32_t s_events;
+
+static void bench_handler(int ev, void *ev_data, void *userdata){
+  (void) ev_data;
+  (void) userdata;
+  if(ev == MGOS_ALARM_EV_SET || ev == MGOS_ALARM_EV_RESET) s_events++;
+}
+
+/*
+ * Run ticks passes, changing changes inputs before each
+ * returns the wall time in nanoseconds
+ */
+static uint64_t bench_ticks(uint32_t n, uint32_t ticks, uint32_t changes, unsigned *seed){
+  uint64_t total = 0;
+  for(uint32_t t = 0; t < ticks; t++){
+    for(uint32_t c = 0; c < changes; c++){
+      uint32_t i = (uint32_t) rand_r(seed) % (n / 2);
+      s_inputs[i] = !s_inputs[i];
+      s_pvs[i] = (s_pvs[i] > 0) ? -1.0f : 60.0f;
+    }
+    uint64_t start = mgos_host_clock_ns();
+    mgos_host_advance(BENCH_POLL_MS);
+    total += mgos_host_clock_ns() - start;
+  }
+  return total;
+}
+
+static void bench_run(uint32_t n){
+  unsigned seed = n;
+  uint32_t half = n / 2;
+  memset(s_inputs, 0, sizeof(s_inputs));
+  for(uint32_t i = 0; i < half; i++) s_pvs[i] = -1.0f;
+  //add
+  uint64_t start = mgos_host_clock_ns();
+  for(uint32_t i = 0; i < half; i++){
+    s_handles[i] = mgos_add_d_alarm_h(true, &s_inputs[i], ACTIVE_HIGH, 0, 0, s_names[i]);
+    s_handles[half + i] = mgos_add_a_alarm_h(true, &s_pvs[i], NAN, NAN, 10.0f, 50.0f, 0,
+                                             s_names[BENCH_MAX_ALARMS / 2 + i]);
+  }
+  uint64_t add_ns = mgos_host_clock_ns() - start;
+  //lookup
+  start = mgos_host_clock_ns();
+  uint32_t found = 0;
+  for(uint32_t i = 0; i < half; i++){
+    found += mgos_alarm_find(s_names[i]) == s_handles[i];
+    found += mgos_alarm_find(s_names[BENCH_MAX_ALARMS / 2 + i]) == s_handles[half + i];
+  }
+  uint64_t lookup_ns = mgos_host_clock_ns() - start;
+  //settle, then idle and busy ticks
+  mgos_host_advance(BENCH_POLL_MS);
+  uint64_t idle_ns = bench_ticks(n, BENCH_TICKS, 0, &seed);
+  struct mgos_alarm_stats before, after;
+  struct mgos_host_stats host_before, host_after;
+  mgos_alarm_get_stats(&before);
+  mgos_host_get_stats(&host_before);
+  s_events = 0;
+  uint32_t changes = n / 100 ? n / 100 : 1;
+  uint64_t busy_ns = bench_ticks(n, BENCH_TICKS, changes, &seed);
+  mgos_host_advance(BENCH_POLL_MS);
+  mgos_alarm_get_stats(&after);
+  mgos_host_get_stats(&host_after);
+  //remove
+  start = mgos_host_clock_ns();
+  for(uint32_t i = 0; i < n; i++) mgos_alarm_remove_h(s_handles[i]);
+  uint64_t remove_ns = mgos_host_clock_ns() - start;
+  double idle_tick = (double) idle_ns / BENCH_TICKS;
+  double busy_tick = (double) busy_ns / BENCH_TICKS;
+  double event_ns = s_events ? (double) (busy_ns - (busy_ns < idle_ns ? busy_ns : idle_ns)) / s_events : 0;
+  printf("%7u %8.0f %8.0f %8.0f %10.0f %8.1f %10.0f %8u %8.0f %6.2f %6.2f%s\n", n,
+         (double) add_ns / n, (double) remove_ns / n, (double) lookup_ns / n,
+         idle_tick, idle_tick / n, busy_tick, s_events, event_ns,
+         (double) (after.allocs - before.allocs) / BENCH_TICKS,
+         (double) (host_after.timer_sets - host_before.timer_sets) / BENCH_TICKS,
+         found == n ? "" : " lookup mismatch");
+}
+
+int main(int argc, char **argv){
+  uint32_t max = (argc > 1) ? (uint32_t) atoi(argv[1]) : BENCH_MAX_ALARMS;
+  if(max > BENCH_MAX_ALARMS) max = BENCH_MAX_ALARMS;
+  for(uint32_t i = 0; i < BENCH_MAX_ALARMS / 2; i++){
+    snprintf(s_names[i], sizeof(s_names[i]), "d%u", i);
+    snprintf(s_names[BENCH_MAX_ALARMS / 2 + i], sizeof(s_names[i]), "a%u", i);
+  }
+  if(!mgos_alarm_init(BENCH_POLL_MS)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, bench_handler, NULL);
+  printf("alarms   add ns   rem ns  find ns  idle tick  ns/alarm  busy tick   events  ns/event allocs timers\n");
+  for(uint32_t n = 10; n <= max; n = (n == 10) ? 1000 : n * 10) bench_run(n);
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Schedule mode benchmark, wakeups of a mostly idle engine
+ *
+ * 200 alarms, half digital and half analog, with 1 to 4 s set and reset
+ * delays and a 100 ms poll interval. One input or PV changes every 20 s on
+ * average, at a 10 ms granularity, over an hour of simulated time. For each
+ * schedule and evaluation mode, with timestamp debouncing, reports:
+ * wakeups/h - service passes per hour, from mgos_alarm_stats
+ * busy ms/h - wall time spent in the simulated SDK per hour, the passes
+ *   and the host's own timer bookkeeping for every 10 ms step
+ * events - SET/RESET events raised
+ * same - whether every alarm raises the same events in the same order as
+ *   under the polled schedule of the same evaluation mode. The order across
+ *   alarms may differ, a polled pass makes the transitions of several
+ *   deadlines together which adaptive passes make at each deadline.
+ *
+ * usage: bench_schedule [hours]
+ */
+
+#include "mgos_alarm.h"
+
+#define BENCH_ALARMS 200
+#define BENCH_POLL_MS 100
+#define BENCH_STEP_MS 10
+
+static bool s_inputs[BENCH_ALARMS];
+static float s_pvs[BENCH_ALARMS];
+static char s_names[BENCH_ALARMS][8];
+static mgos_alarm_handle_t s_handles[BENCH_ALARMS];
+static uint32_t s_events;
+static uint64_t s_hashes[BENCH_ALARMS];
+
+/*
+ * Fold each alarm's events into an FNV-1a hash of event and new state
+ */
+static void bench_handler(int ev, void *ev_data, void *userdata){
+  (void) userdata;
+  if(ev != MGOS_ALARM_EV_SET && ev != MGOS_ALARM_EV_RESET) return;
+  struct alarm_info *info = (struct alarm_info *) ev_data;
+  uint64_t alarm = (uint64_t) (info->name - s_names[0]) / sizeof(s_names[0]);
+  int state = (info->type == DIGITAL) ? info->state.d_state : (int) info->state.a_state;
+  s_hashes[alarm] = (s_hashes[alarm] ^ ((uint64_t) ev * 7 + (uint64_t) state)) * 1099511628211ULL;
+  s_events++;
+}
+
+/*
+ * Run hours of simulated time
+ * returns the sum of the alarms' event hashes
+ */
+static uint64_t bench_run(enum mgos_alarm_schedule_mode schedule, enum mgos_alarm_eval_mode eval,
+                          uint32_t hours, const char *label, uint64_t reference){
+  unsigned seed = 7;
+  mgos_alarm_set_schedule_mode(MGOS_ALARM_SCHEDULE_POLL);
+  mgos_alarm_set_eval_mode(eval);
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    s_inputs[i] = false;
+    s_pvs[i] = 50;
+    if(i & 1){
+      s_handles[i] = mgos_add_d_alarm_h(true, &s_inputs[i], ACTIVE_HIGH, 1000 + i * 20, 2000 + i * 10, s_names[i]);
+    }
+    else{
+      s_handles[i] = mgos_add_a_alarm_h(true, &s_pvs[i], 10, 20, 80, 90, 1500 + i * 10, s_names[i]);
+    }
+  }
+  mgos_alarm_set_schedule_mode(schedule);
+  mgos_host_advance(1000);
+  mgos_alarm_reset_stats();
+  s_events = 0;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) s_hashes[i] = 1469598103934665603ULL;
+  uint64_t busy_ns = 0;
+  for(int64_t t = 0; t < (int64_t) hours * 3600 * 1000; t += BENCH_STEP_MS){
+    if(rand_r(&seed) % 2000 == 0){
+      uint32_t i = (uint32_t) rand_r(&seed) % BENCH_ALARMS;
+      if(i & 1) s_inputs[i] = !s_inputs[i];
+      else s_pvs[i] = (float) (rand_r(&seed) % 100);
+      if(eval != MGOS_ALARM_EVAL_POLL) mgos_alarm_input_changed(s_handles[i]);
+    }
+    uint64_t start = mgos_host_clock_ns();
+    mgos_host_advance(BENCH_STEP_MS);
+    busy_ns += mgos_host_clock_ns() - start;
+  }
+  struct mgos_alarm_stats stats;
+  mgos_alarm_get_stats(&stats);
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) mgos_alarm_remove_h(s_handles[i]);
+  mgos_host_advance(BENCH_POLL_MS);
+  uint64_t hash = 0;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) hash += s_hashes[i] * (i + 1);
+  printf("%-18s %10u %10.1f %8u %5s\n", label, stats.wakeups_per_hour, busy_ns / 1e6 / hours, s_events,
+         (reference == 0) ? "-" : (hash == reference) ? "yes" : "NO");
+  return hash;
+}
+
+int main(int argc, char **argv){
+  uint32_t hours = (argc > 1) ? (uint32_t) atoi(argv[1]) : 1;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) snprintf(s_names[i], sizeof(s_names[i]), "s%u", i);
+  if(!mgos_alarm_init(BENCH_POLL_MS)) return 1;
+  mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP);
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, bench_handler, NULL);
+  printf("mode                wakeups/h  busy ms/h   events  same\n");
+  uint64_t polled = bench_run(MGOS_ALARM_SCHEDULE_POLL, MGOS_ALARM_EVAL_POLL, hours, "poll/poll", 0);
+  bool same = bench_run(MGOS_ALARM_SCHEDULE_ADAPTIVE, MGOS_ALARM_EVAL_POLL, hours, "adaptive/poll", polled) == polled;
+  polled = bench_run(MGOS_ALARM_SCHEDULE_POLL, MGOS_ALARM_EVAL_CHANGED, hours, "poll/changed", 0);
+  same &= bench_run(MGOS_ALARM_SCHEDULE_ADAPTIVE, MGOS_ALARM_EVAL_CHANGED, hours, "adaptive/changed", polled) == polled;
+  return same ? 0 : 1;
+}
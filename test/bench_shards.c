@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Sharded pass benchmark
+ *
+ * For 10k and 100k alarms, half digital and half analog with timestamp
+ * debouncing and 1% of the inputs changing every pass, runs the service
+ * pass unsharded and split into 2, 4 and 8 shards, and reports:
+ * pass us - wall time of a pass with the shards run one after another on
+ *   the calling thread, each shard timed
+ * shard us - the slowest shard of a pass, and the sum over the shards
+ * merge us - the serial part left, the pass less its shards
+ * projected - speedup over the unsharded pass with the shards on their
+ *   own cores, the serial part plus the slowest shard
+ * threads us - wall time of a pass with the shards run on a pool of
+ *   threads, only meaningful with at least as many cores as shards
+ *
+ * usage: bench_shards [max alarms]
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "mgos_alarm.h"
+
+#define BENCH_MAX_ALARMS 100000
+#define BENCH_PASSES 300
+#define BENCH_POLL_MS 10
+#define BENCH_MAX_THREADS 8
+
+static bool s_inputs[BENCH_MAX_ALARMS / 2];
+static float s_pvs[BENCH_MAX_ALARMS / 2];
+static char s_names[BENCH_MAX_ALARMS][12];
+static mgos_alarm_handle_t s_handles[BENCH_MAX_ALARMS];
+
+/*
+ * time spent in the shards of the passes run so far
+ */
+static struct{
+  uint64_t sum_ns, max_ns;
+} s_shard_time;
+
+/*
+ * Runner timing each shard, run one after another
+ */
+static void bench_timed_runner(uint32_t shards, mgos_alarm_shard_fn fn, void *ctx, void *arg){
+  uint64_t max = 0;
+  (void) arg;
+  for(uint32_t k = 0; k < shards; k++){
+    uint64_t start = mgos_host_clock_ns();
+    fn(k, ctx);
+    uint64_t ns = mgos_host_clock_ns() - start;
+    s_shard_time.sum_ns += ns;
+    if(ns > max) max = ns;
+  }
+  s_shard_time.max_ns += max;
+}
+
+/*
+ * persistent thread pool, the caller runs shard 0 and worker k the shards
+ * k, k + workers...
+ */
+static struct{
+  pthread_t threads[BENCH_MAX_THREADS];
+  pthread_barrier_t start, done;
+  uint32_t workers, shards;
+  mgos_alarm_shard_fn fn;
+  void *ctx;
+  bool quit;
+} s_pool;
+
+static void *bench_worker(void *arg){
+  uint32_t k = (uint32_t) (uintptr_t) arg;
+  for(;;){
+    pthread_barrier_wait(&s_pool.start);
+    if(s_pool.quit) return NULL;
+    for(uint32_t s = k; s < s_pool.shards; s += s_pool.workers) s_pool.fn(s, s_pool.ctx);
+    pthread_barrier_wait(&s_pool.done);
+  }
+}
+
+static void bench_pool_runner(uint32_t shards, mgos_alarm_shard_fn fn, void *ctx, void *arg){
+  (void) arg;
+  s_pool.fn = fn;
+  s_pool.ctx = ctx;
+  s_pool.shards = shards;
+  pthread_barrier_wait(&s_pool.start);
+  for(uint32_t s = 0; s < shards; s += s_pool.workers) fn(s, ctx);
+  pthread_barrier_wait(&s_pool.done);
+}
+
+static void bench_pool_start(uint32_t workers){
+  s_pool.workers = workers;
+  s_pool.quit = false;
+  pthread_barrier_init(&s_pool.start, NULL, workers);
+  pthread_barrier_init(&s_pool.done, NULL, workers);
+  for(uint32_t k = 1; k < workers; k++){
+    pthread_create(&s_pool.threads[k], NULL, bench_worker, (void *) (uintptr_t) k);
+  }
+}
+
+static void bench_pool_stop(void){
+  s_pool.quit = true;
+  pthread_barrier_wait(&s_pool.start);
+  for(uint32_t k = 1; k < s_pool.workers; k++) pthread_join(s_pool.threads[k], NULL);
+  pthread_barrier_destroy(&s_pool.start);
+  pthread_barrier_destroy(&s_pool.done);
+}
+
+/*
+ * Run the passes, changing 1% of the inputs before each
+ * returns the wall time in nanoseconds
+ */
+static uint64_t bench_passes(uint32_t n, unsigned *seed){
+  uint64_t total = 0;
+  for(uint32_t p = 0; p < BENCH_PASSES; p++){
+    for(uint32_t c = 0; c < n / 100; c++){
+      uint32_t i = (uint32_t) rand_r(seed) % (n / 2);
+      s_inputs[i] = !s_inputs[i];
+      s_pvs[i] = (float) (rand_r(seed) % 300) / 10.0f - 15.0f;
+    }
+    uint64_t start = mgos_host_clock_ns();
+    mgos_host_advance(BENCH_POLL_MS);
+    total += mgos_host_clock_ns() - start;
+  }
+  return total;
+}
+
+static void bench_run(uint32_t n){
+  uint32_t half = n / 2;
+  for(uint32_t i = 0; i < half; i++){
+    s_handles[i] = mgos_add_d_alarm_h(true, &s_inputs[i], ACTIVE_HIGH, i % 50, i % 30, s_names[i]);
+    s_handles[half + i] = mgos_add_a_alarm_h(true, &s_pvs[i], -5.0f, -1.0f, 5.0f, 9.0f, i % 40,
+                                             s_names[BENCH_MAX_ALARMS / 2 + i]);
+  }
+  unsigned seed = 7;
+  mgos_alarm_set_shards(1, NULL, NULL);
+  bench_passes(n, &seed);
+  double base = (double) bench_passes(n, &seed) / BENCH_PASSES;
+  printf("%7u %6u %9.0f %9s %9s %9s %9s %10s\n", n, 1, base / 1000, "-", "-", "-", "1.00x", "-");
+  for(uint32_t shards = 2; shards <= BENCH_MAX_THREADS; shards *= 2){
+    mgos_alarm_set_shards(shards, bench_timed_runner, NULL);
+    bench_passes(n, &seed);
+    memset(&s_shard_time, 0, sizeof(s_shard_time));
+    double pass = (double) bench_passes(n, &seed) / BENCH_PASSES;
+    double max = (double) s_shard_time.max_ns / BENCH_PASSES;
+    double sum = (double) s_shard_time.sum_ns / BENCH_PASSES;
+    double serial = pass - sum;
+    bench_pool_start(shards);
+    mgos_alarm_set_shards(shards, bench_pool_runner, NULL);
+    bench_passes(n, &seed);
+    double threads = (double) bench_passes(n, &seed) / BENCH_PASSES;
+    mgos_alarm_set_shards(1, NULL, NULL);
+    bench_pool_stop();
+    printf("%7u %6u %9.0f %9.0f %9.0f %9.0f %8.2fx %10.0f\n", n, shards, pass / 1000, max / 1000,
+           sum / 1000, serial / 1000, base / (serial + max), threads / 1000);
+  }
+  for(uint32_t i = 0; i < n; i++) mgos_alarm_remove_h(s_handles[i]);
+  mgos_host_advance(BENCH_POLL_MS);
+}
+
+int main(int argc, char **argv){
+  uint32_t max = (argc > 1) ? (uint32_t) atoi(argv[1]) : BENCH_MAX_ALARMS;
+  if(max > BENCH_MAX_ALARMS) max = BENCH_MAX_ALARMS;
+  for(uint32_t i = 0; i < BENCH_MAX_ALARMS / 2; i++){
+    snprintf(s_names[i], sizeof(s_names[i]), "d%u", i);
+    snprintf(s_names[BENCH_MAX_ALARMS / 2 + i], sizeof(s_names[i]), "a%u", i);
+  }
+  if(!mgos_alarm_init(BENCH_POLL_MS)) return 1;
+  mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP);
+  printf("%ld cores\n", sysconf(_SC_NPROCESSORS_ONLN));
+  printf(" alarms shards   pass us  shard us    sum us  merge us projected threads us\n");
+  for(uint32_t n = 10000; n <= max; n *= 10) bench_run(n);
+  return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Window size sweep of the windowed analog alarms
+ *
+ * 1000 windowed alarms on PVs that change every pass, with windows of 4
+ * to 4096 samples. Once the windows are full, reports the wall time of a
+ * pass per alarm for the min, max and mean statistics, which should not
+ * grow with the window, against a plain band alarm (window 0). The last
+ * column is the cost of the rescan the monotonic deque replaces, the min
+ * recomputed over the whole ring every sample, measured here outside the
+ * engine.
+ *
+ * usage: bench_window [max window]
+ */
+
+#include "mgos_alarm.h"
+
+#define BENCH_ALARMS 1000
+#define BENCH_PASSES 300
+#define BENCH_POLL_MS 10
+#define BENCH_MAX_WINDOW 4096
+
+static float s_pvs[BENCH_ALARMS];
+static char s_names[BENCH_ALARMS][8];
+static mgos_alarm_handle_t s_handles[BENCH_ALARMS];
+static float s_rings[BENCH_ALARMS][BENCH_MAX_WINDOW];
+
+static void bench_sample(unsigned *seed){
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) s_pvs[i] = (float) (rand_r(seed) % 1000) * 0.001f;
+}
+
+/*
+ * returns the wall time of a pass per alarm in ns, size 0 for plain
+ * band alarms
+ */
+static double bench_engine(uint32_t size, enum mgos_alarm_window_stat stat){
+  unsigned seed = 3;
+  uint64_t total = 0;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+    if(size == 0) s_handles[i] = mgos_add_a_alarm_h(true, &s_pvs[i], -50, -10, 10, 50, 0, s_names[i]);
+    else{
+      s_handles[i] = mgos_add_window_alarm_h(true, &s_pvs[i], stat, (int) size, 0, -50, -10, 10, 50, 0,
+                                             s_names[i]);
+    }
+  }
+  //fill the windows, then time
+  for(uint32_t k = 0; k <= size; k++){
+    bench_sample(&seed);
+    mgos_host_advance(BENCH_POLL_MS);
+  }
+  for(int k = 0; k < BENCH_PASSES; k++){
+    bench_sample(&seed);
+    uint64_t start = mgos_host_clock_ns();
+    mgos_host_advance(BENCH_POLL_MS);
+    total += mgos_host_clock_ns() - start;
+  }
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) mgos_alarm_remove_h(s_handles[i]);
+  mgos_host_advance(BENCH_POLL_MS);
+  return (double) total / BENCH_PASSES / BENCH_ALARMS;
+}
+
+/*
+ * returns the time per alarm in ns of pushing a sample into a ring of
+ * size and rescanning the ring for its min
+ */
+static double bench_rescan(uint32_t size){
+  unsigned seed = 3;
+  volatile float sink = 0;
+  uint64_t total = 0;
+  for(int k = 0; k < BENCH_PASSES; k++){
+    bench_sample(&seed);
+    uint64_t start = mgos_host_clock_ns();
+    for(uint32_t i = 0; i < BENCH_ALARMS; i++){
+      float *ring = s_rings[i];
+      ring[(uint32_t) k % size] = s_pvs[i];
+      float min = ring[0];
+      for(uint32_t j = 1; j < size; j++){
+        if(ring[j] < min) min = ring[j];
+      }
+      sink += min;
+    }
+    total += mgos_host_clock_ns() - start;
+  }
+  return (double) total / BENCH_PASSES / BENCH_ALARMS;
+}
+
+int main(int argc, char **argv){
+  uint32_t max = (argc > 1) ? (uint32_t) atoi(argv[1]) : BENCH_MAX_WINDOW;
+  if(max > BENCH_MAX_WINDOW) max = BENCH_MAX_WINDOW;
+  for(uint32_t i = 0; i < BENCH_ALARMS; i++) snprintf(s_names[i], sizeof(s_names[i]), "w%u", (unsigned) i);
+  if(!mgos_alarm_init(BENCH_POLL_MS)) return 1;
+  mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP);
+  printf("window   min ns/alarm  max ns/alarm mean ns/alarm   rescan ns\n");
+  printf("%6u %14.1f %13s %13s %11s\n", 0u, bench_engine(0, MGOS_ALARM_WINDOW_MIN), "-", "-", "-");
+  for(uint32_t size = 4; size <= max; size *= 4){
+    printf("%6u", (unsigned) size);
+    printf(" %14.1f", bench_engine(size, MGOS_ALARM_WINDOW_MIN));
+    printf(" %13.1f", bench_engine(size, MGOS_ALARM_WINDOW_MAX));
+    printf(" %13.1f", bench_engine(size, MGOS_ALARM_WINDOW_MEAN));
+    printf(" %11.1f\n", bench_rescan(size));
+  }
+  return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for common/cs_file.h
+ */
+
+#ifndef CS_FW_TEST_STUBS_COMMON_CS_FILE_H_
+#define CS_FW_TEST_STUBS_COMMON_CS_FILE_H_
+
+#include <stddef.h>
+
+/*
+ * Read a whole file into a NUL terminated heap buffer, *size is set to its length
+ * returns NULL if the file could not be read
+ */
+char *cs_read_file(const char *path, size_t *size);
+
+#endif /* CS_FW_TEST_STUBS_COMMON_CS_FILE_H_ */
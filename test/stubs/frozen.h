@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for frozen.h, only json_walk is provided
+ */
+
+#ifndef CS_FW_TEST_STUBS_FROZEN_H_
+#define CS_FW_TEST_STUBS_FROZEN_H_
+
+#include <stddef.h>
+
+enum json_token_type{
+  JSON_TYPE_INVALID = 0,
+  JSON_TYPE_STRING,
+  JSON_TYPE_NUMBER,
+  JSON_TYPE_TRUE,
+  JSON_TYPE_FALSE,
+  JSON_TYPE_NULL,
+  JSON_TYPE_OBJECT_START,
+  JSON_TYPE_OBJECT_END,
+  JSON_TYPE_ARRAY_START,
+  JSON_TYPE_ARRAY_END,
+  JSON_TYPES_CNT
+};
+
+struct json_token{
+  const char *ptr;
+  int len;
+  enum json_token_type type;
+};
+
+typedef void (*json_walk_callback_t)(void *callback_data, const char *name, size_t name_len,
+                                     const char *path, const struct json_token *token);
+
+/*
+ * Walk a JSON document calling callback for every value, as frozen does
+ * returns the number of bytes parsed, negative if the document is invalid
+ */
+int json_walk(const char *json_string, int json_string_length, json_walk_callback_t callback,
+              void *callback_data);
+
+#endif /* CS_FW_TEST_STUBS_FROZEN_H_ */
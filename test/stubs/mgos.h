@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for the Mongoose OS core API
+ *
+ * Declares the part of the SDK the alarm library uses so that it builds
+ * and runs on Linux, see mgos_host.c. Logging goes to stdout at or below
+ * mgos_host_log_level.
+ */
+
+#ifndef CS_FW_TEST_STUBS_MGOS_H_
+#define CS_FW_TEST_STUBS_MGOS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#define IRAM
+
+/*
+ * logging
+ */
+enum cs_log_level{
+  LL_NONE = -1,
+  LL_ERROR = 0,
+  LL_WARN = 1,
+  LL_INFO = 2,
+  LL_DEBUG = 3,
+  LL_VERBOSE_DEBUG = 4
+};
+extern int mgos_host_log_level;
+void mgos_host_log(const char *fmt, ...);
+#define LOG(l, x)                             \
+  do {                                        \
+    if((int) (l) <= mgos_host_log_level){     \
+      mgos_host_log x;                        \
+    }                                         \
+  } while(0)
+
+/*
+ * uptime, driven by mgos_host_advance
+ */
+int64_t mgos_uptime_micros(void);
+double mgos_uptime(void);
+
+/*
+ * events
+ */
+#define MGOS_EVENT_BASE(a, b, c) ((int) (((a) << 24) | ((b) << 16) | ((c) << 8)))
+typedef void (*mgos_event_handler_t)(int ev, void *ev_data, void *userdata);
+bool mgos_event_register_base(int base_event_number, const char *name);
+int mgos_event_trigger(int ev, void *ev_data);
+bool mgos_event_add_handler(int ev, mgos_event_handler_t cb, void *userdata);
+bool mgos_event_add_group_handler(int evgrp, mgos_event_handler_t cb, void *userdata);
+
+/*
+ * callbacks deferred to the main task
+ */
+typedef void (*mgos_cb_t)(void *arg);
+bool mgos_invoke_cb(mgos_cb_t cb, void *arg, bool from_isr);
+
+/*
+ * recursive locks
+ */
+struct mgos_rlock_type;
+struct mgos_rlock_type *mgos_rlock_create(void);
+void mgos_rlock(struct mgos_rlock_type *l);
+void mgos_runlock(struct mgos_rlock_type *l);
+void mgos_rlock_destroy(struct mgos_rlock_type *l);
+
+/*
+ * timers
+ */
+typedef uintptr_t mgos_timer_id;
+typedef void (*timer_callback)(void *arg);
+#define MGOS_INVALID_TIMER_ID 0
+#define MGOS_TIMER_REPEAT 1
+mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb, void *cb_arg);
+void mgos_clear_timer(mgos_timer_id id);
+
+/*
+ * app init
+ */
+enum mgos_app_init_result{
+  MGOS_APP_INIT_SUCCESS = 0,
+  MGOS_APP_INIT_ERROR = -2
+};
+
+#include "mgos_host.h"
+
+#endif /* CS_FW_TEST_STUBS_MGOS_H_ */
@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-ins for the SDK functions the alarm library calls, see mgos.h
+ * and mgos_host.h
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "mgos.h"
+#include "frozen.h"
+#include "common/cs_file.h"
+
+int mgos_host_log_level = LL_ERROR;
+
+/*
+ * timer
+ *
+ * due_us - uptime the timer next fires at
+ * ms, flags - as passed to mgos_set_timer
+ * cb, arg - the callback, NULL if the timer is free
+ * next_free - next free timer, timer ids are index + 1
+ * gen - bumped each time the timer is armed
+ * running - a one shot timer whose callback is running, as in the SDK it
+ *   is freed once the callback returns and clearing it does nothing, so
+ *   that its id is not reused under a caller still holding it
+ */
+struct host_timer{
+  int64_t due_us;
+  int ms, flags;
+  timer_callback cb;
+  void *arg;
+  uint32_t next_free, gen;
+  bool running;
+};
+
+/*
+ * timer collected as due by a step of mgos_host_advance
+ */
+struct host_due{
+  uint32_t index, gen;
+};
+
+#define HOST_TIMER_NONE UINT32_MAX
+
+/*
+ * host state
+ *
+ * lock - guards everything below
+ * now_us - the uptime
+ * timers, capacity - the timer array, grown as needed
+ * free_head - first free timer
+ * next_due_us - earliest due time of an armed timer, INT64_MAX if none
+ * due, due_capacity - the timers collected by a step of mgos_host_advance
+ * stats - the SDK call counters
+ */
+static struct{
+  pthread_mutex_t lock;
+  int64_t now_us;
+  struct host_timer *timers;
+  uint32_t capacity, free_head;
+  int64_t next_due_us;
+  struct host_due *due;
+  uint32_t due_capacity;
+  struct mgos_host_stats stats;
+} s_host = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .free_head = HOST_TIMER_NONE,
+  .next_due_us = INT64_MAX
+};
+
+/*
+ * event handler, grp is set for a group handler
+ */
+struct host_handler{
+  int ev;
+  bool grp;
+  mgos_event_handler_t cb;
+  void *userdata;
+};
+
+#define HOST_MAX_HANDLERS 64
+static struct host_handler s_handlers[HOST_MAX_HANDLERS];
+static int s_num_handlers;
+
+void mgos_host_log(const char *fmt, ...){
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+  printf("\n");
+}
+
+int64_t mgos_uptime_micros(void){
+  return __atomic_load_n(&s_host.now_us, __ATOMIC_ACQUIRE);
+}
+
+double mgos_uptime(void){
+  return mgos_uptime_micros() / 1e6;
+}
+
+uint64_t mgos_host_clock_ns(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000u + (uint64_t) t.tv_nsec;
+}
+
+bool mgos_event_register_base(int base_event_number, const char *name){
+  (void) base_event_number;
+  (void) name;
+  return true;
+}
+
+static bool host_add_handler(int ev, bool grp, mgos_event_handler_t cb, void *userdata){
+  pthread_mutex_lock(&s_host.lock);
+  bool res = s_num_handlers < HOST_MAX_HANDLERS;
+  if(res){
+    s_handlers[s_num_handlers].ev = ev;
+    s_handlers[s_num_handlers].grp = grp;
+    s_handlers[s_num_handlers].cb = cb;
+    s_handlers[s_num_handlers].userdata = userdata;
+    __atomic_store_n(&s_num_handlers, s_num_handlers + 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&s_host.lock);
+  return res;
+}
+
+bool mgos_event_add_handler(int ev, mgos_event_handler_t cb, void *userdata){
+  return host_add_handler(ev, false, cb, userdata);
+}
+
+bool mgos_event_add_group_handler(int evgrp, mgos_event_handler_t cb, void *userdata){
+  return host_add_handler(evgrp, true, cb, userdata);
+}
+
+int mgos_event_trigger(int ev, void *ev_data){
+  int count = 0;
+  int n = __atomic_load_n(&s_num_handlers, __ATOMIC_ACQUIRE);
+  for(int i = 0; i < n; i++){
+    struct host_handler *h = &s_handlers[i];
+    if(h->grp ? (ev & ~0xff) == h->ev : ev == h->ev){
+      h->cb(ev, ev_data, h->userdata);
+      count++;
+    }
+  }
+  return count;
+}
+
+struct mgos_rlock_type{
+  pthread_mutex_t m;
+};
+
+struct mgos_rlock_type *mgos_rlock_create(void){
+  struct mgos_rlock_type *l = (struct mgos_rlock_type *) calloc(1, sizeof(*l));
+  if(l == NULL) return NULL;
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&l->m, &attr);
+  pthread_mutexattr_destroy(&attr);
+  return l;
+}
+
+void mgos_rlock(struct mgos_rlock_type *l){
+  pthread_mutex_lock(&l->m);
+}
+
+void mgos_runlock(struct mgos_rlock_type *l){
+  pthread_mutex_unlock(&l->m);
+}
+
+void mgos_rlock_destroy(struct mgos_rlock_type *l){
+  pthread_mutex_destroy(&l->m);
+  free(l);
+}
+
+/*
+ * Arm a timer, must be called with the host lock held
+ */
+static mgos_timer_id host_timer_arm(int msecs, int flags, timer_callback cb, void *arg){
+  if(s_host.free_head == HOST_TIMER_NONE){
+    uint32_t capacity = s_host.capacity ? s_host.capacity * 2 : 64;
+    struct host_timer *timers = (struct host_timer *) realloc(s_host.timers, capacity * sizeof(*timers));
+    if(timers == NULL) return MGOS_INVALID_TIMER_ID;
+    for(uint32_t i = s_host.capacity; i < capacity; i++){
+      timers[i].cb = NULL;
+      timers[i].gen = 0;
+      timers[i].running = false;
+      timers[i].next_free = (i + 1 < capacity) ? i + 1 : HOST_TIMER_NONE;
+    }
+    s_host.timers = timers;
+    s_host.free_head = s_host.capacity;
+    s_host.capacity = capacity;
+  }
+  uint32_t i = s_host.free_head;
+  struct host_timer *t = &s_host.timers[i];
+  s_host.free_head = t->next_free;
+  t->due_us = s_host.now_us + (int64_t) msecs * 1000;
+  t->ms = msecs;
+  t->flags = flags;
+  t->cb = cb;
+  t->arg = arg;
+  t->gen++;
+  if(t->due_us < s_host.next_due_us) s_host.next_due_us = t->due_us;
+  ++s_host.stats.timers_armed;
+  return (mgos_timer_id) i + 1;
+}
+
+/*
+ * Free a timer, must be called with the host lock held
+ */
+static void host_timer_free(uint32_t i){
+  s_host.timers[i].cb = NULL;
+  s_host.timers[i].running = false;
+  s_host.timers[i].next_free = s_host.free_head;
+  s_host.free_head = i;
+  --s_host.stats.timers_armed;
+}
+
+mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb, void *cb_arg){
+  pthread_mutex_lock(&s_host.lock);
+  ++s_host.stats.timer_sets;
+  mgos_timer_id id = host_timer_arm(msecs, flags, cb, cb_arg);
+  pthread_mutex_unlock(&s_host.lock);
+  return id;
+}
+
+void mgos_clear_timer(mgos_timer_id id){
+  pthread_mutex_lock(&s_host.lock);
+  ++s_host.stats.timer_clears;
+  if(id != MGOS_INVALID_TIMER_ID && id <= s_host.capacity && s_host.timers[id - 1].cb != NULL &&
+     !s_host.timers[id - 1].running){
+    host_timer_free((uint32_t) id - 1);
+  }
+  pthread_mutex_unlock(&s_host.lock);
+}
+
+bool mgos_invoke_cb(mgos_cb_t cb, void *arg, bool from_isr){
+  (void) from_isr;
+  pthread_mutex_lock(&s_host.lock);
+  ++s_host.stats.invokes;
+  mgos_timer_id id = host_timer_arm(0, 0, cb, arg);
+  pthread_mutex_unlock(&s_host.lock);
+  return id != MGOS_INVALID_TIMER_ID;
+}
+
+/*
+ * Collect the timers due into s_host.due, must be called with the host
+ * lock held
+ * returns the number collected
+ */
+static uint32_t host_timers_due(void){
+  uint32_t n = 0;
+  int64_t next = INT64_MAX;
+  for(uint32_t i = 0; i < s_host.capacity; i++){
+    struct host_timer *t = &s_host.timers[i];
+    if(t->cb == NULL || t->running) continue;
+    if(t->due_us > s_host.now_us){
+      if(t->due_us < next) next = t->due_us;
+      continue;
+    }
+    if(n == s_host.due_capacity){
+      uint32_t capacity = s_host.due_capacity ? s_host.due_capacity * 2 : 64;
+      struct host_due *due = (struct host_due *) realloc(s_host.due, capacity * sizeof(*due));
+      if(due == NULL) break;
+      s_host.due = due;
+      s_host.due_capacity = capacity;
+    }
+    s_host.due[n].index = i;
+    s_host.due[n].gen = t->gen;
+    n++;
+  }
+  s_host.next_due_us = next;
+  return n;
+}
+
+/*
+ * Take a collected timer if it is still armed and due, rearming a repeating
+ * timer and marking a one shot timer running
+ * returns false if it was cleared by a callback run before it
+ */
+static bool host_timer_take(const struct host_due *due, timer_callback *cb, void **arg){
+  struct host_timer *t = &s_host.timers[due->index];
+  if(t->cb == NULL || t->running || t->gen != due->gen || t->due_us > s_host.now_us) return false;
+  *cb = t->cb;
+  *arg = t->arg;
+  if(t->flags & MGOS_TIMER_REPEAT){
+    t->due_us += (int64_t) (t->ms > 0 ? t->ms : 1) * 1000;
+    if(t->due_us < s_host.next_due_us) s_host.next_due_us = t->due_us;
+  }
+  else t->running = true;
+  return true;
+}
+
+void mgos_host_advance(int ms){
+  for(int k = 0; k < ms; k++){
+    pthread_mutex_lock(&s_host.lock);
+    __atomic_store_n(&s_host.now_us, s_host.now_us + 1000, __ATOMIC_RELEASE);
+    //callbacks may arm timers due now, collect until none is left
+    while(s_host.next_due_us <= s_host.now_us){
+      uint32_t n = host_timers_due();
+      for(uint32_t j = 0; j < n; j++){
+        timer_callback cb;
+        void *arg;
+        struct host_due due = s_host.due[j];
+        if(!host_timer_take(&due, &cb, &arg)) continue;
+        pthread_mutex_unlock(&s_host.lock);
+        cb(arg);
+        pthread_mutex_lock(&s_host.lock);
+        if(s_host.timers[due.index].running) host_timer_free(due.index);
+      }
+    }
+    pthread_mutex_unlock(&s_host.lock);
+  }
+}
+
+void mgos_host_get_stats(struct mgos_host_stats *stats){
+  pthread_mutex_lock(&s_host.lock);
+  *stats = s_host.stats;
+  pthread_mutex_unlock(&s_host.lock);
+}
+
+/*
+ * json_walk, a recursive descent over one value reporting the names and
+ * paths frozen reports
+ */
+struct host_json{
+  const char *p, *end;
+  json_walk_callback_t cb;
+  void *data;
+  char path[256];
+  bool bad;
+};
+
+static void host_json_ws(struct host_json *j){
+  while(j->p < j->end && (*j->p == ' ' || *j->p == '\t' || *j->p == '\n' || *j->p == '\r')) j->p++;
+}
+
+static void host_json_emit(struct host_json *j, const char *name, size_t name_len, const char *ptr,
+                           int len, enum json_token_type type){
+  struct json_token token = {ptr, len, type};
+  if(j->cb != NULL) j->cb(j->data, name, name_len, j->path, &token);
+}
+
+static bool host_json_next(struct host_json *j, char close){
+  host_json_ws(j);
+  if(j->p < j->end && *j->p == ','){
+    j->p++;
+    return true;
+  }
+  if(j->p < j->end && *j->p == close){
+    j->p++;
+    return false;
+  }
+  j->bad = true;
+  return false;
+}
+
+static void host_json_value(struct host_json *j, const char *name, size_t name_len){
+  host_json_ws(j);
+  if(j->p >= j->end){
+    j->bad = true;
+    return;
+  }
+  const char *start = j->p;
+  size_t path_len = strlen(j->path);
+  if(*j->p == '{' || *j->p == '['){
+    bool object = *j->p == '{';
+    char close = object ? '}' : ']';
+    host_json_emit(j, name, name_len, NULL, 0, object ? JSON_TYPE_OBJECT_START : JSON_TYPE_ARRAY_START);
+    j->p++;
+    host_json_ws(j);
+    bool more = true;
+    if(j->p < j->end && *j->p == close){
+      j->p++;
+      more = false;
+    }
+    for(int index = 0; more && !j->bad; index++){
+      char buf[16];
+      const char *key = buf;
+      size_t key_len;
+      host_json_ws(j);
+      if(object){
+        if(j->p >= j->end || *j->p != '"'){
+          j->bad = true;
+          return;
+        }
+        key = ++j->p;
+        while(j->p < j->end && *j->p != '"') j->p++;
+        key_len = (size_t) (j->p - key);
+        if(j->p >= j->end) break;
+        j->p++;
+        host_json_ws(j);
+        if(j->p >= j->end || *j->p != ':') break;
+        j->p++;
+        snprintf(j->path + path_len, sizeof(j->path) - path_len, ".%.*s", (int) key_len, key);
+      }
+      else{
+        key_len = (size_t) snprintf(buf, sizeof(buf), "%d", index);
+        snprintf(j->path + path_len, sizeof(j->path) - path_len, "[%d]", index);
+      }
+      host_json_value(j, key, key_len);
+      j->path[path_len] = 0;
+      if(!j->bad) more = host_json_next(j, close);
+    }
+    if(more) j->bad = true;
+    if(j->bad) return;
+    host_json_emit(j, name, name_len, start, (int) (j->p - start), object ? JSON_TYPE_OBJECT_END : JSON_TYPE_ARRAY_END);
+  }
+  else if(*j->p == '"'){
+    const char *s = ++j->p;
+    while(j->p < j->end && *j->p != '"') j->p += (*j->p == '\\') ? 2 : 1;
+    if(j->p >= j->end){
+      j->bad = true;
+      return;
+    }
+    host_json_emit(j, name, name_len, s, (int) (j->p - s), JSON_TYPE_STRING);
+    j->p++;
+  }
+  else if(j->end - j->p >= 4 && strncmp(j->p, "true", 4) == 0){
+    host_json_emit(j, name, name_len, j->p, 4, JSON_TYPE_TRUE);
+    j->p += 4;
+  }
+  else if(j->end - j->p >= 5 && strncmp(j->p, "false", 5) == 0){
+    host_json_emit(j, name, name_len, j->p, 5, JSON_TYPE_FALSE);
+    j->p += 5;
+  }
+  else if(j->end - j->p >= 4 && strncmp(j->p, "null", 4) == 0){
+    host_json_emit(j, name, name_len, j->p, 4, JSON_TYPE_NULL);
+    j->p += 4;
+  }
+  else if(*j->p == '-' || (*j->p >= '0' && *j->p <= '9')){
+    while(j->p < j->end && strchr("+-0123456789.eE", *j->p) != NULL) j->p++;
+    host_json_emit(j, name, name_len, start, (int) (j->p - start), JSON_TYPE_NUMBER);
+  }
+  else j->bad = true;
+}
+
+int json_walk(const char *json_string, int json_string_length, json_walk_callback_t callback,
+              void *callback_data){
+  struct host_json j;
+  memset(&j, 0, sizeof(j));
+  j.p = json_string;
+  j.end = json_string + json_string_length;
+  j.cb = callback;
+  j.data = callback_data;
+  host_json_value(&j, NULL, 0);
+  if(j.bad) return -1;
+  host_json_ws(&j);
+  return (int) (j.p - json_string);
+}
+
+char *cs_read_file(const char *path, size_t *size){
+  FILE *f = fopen(path, "rb");
+  if(f == NULL) return NULL;
+  char *buf = NULL;
+  long n = -1;
+  if(fseek(f, 0, SEEK_END) == 0) n = ftell(f);
+  if(n >= 0 && fseek(f, 0, SEEK_SET) == 0) buf = (char *) malloc((size_t) n + 1);
+  if(buf != NULL && fread(buf, 1, (size_t) n, f) != (size_t) n){
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  if(buf == NULL) return NULL;
+  buf[n] = 0;
+  *size = (size_t) n;
+  return buf;
+}
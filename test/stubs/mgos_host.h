@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Controls of the host stand-ins used by the tests and benchmarks
+ *
+ * Time only moves when a program calls mgos_host_advance, which runs the
+ * timers and deferred callbacks that fall due on the way, one millisecond
+ * at a time, on the calling thread. Every stand-in may be called from any
+ * thread.
+ */
+
+#ifndef CS_FW_TEST_STUBS_MGOS_HOST_H_
+#define CS_FW_TEST_STUBS_MGOS_HOST_H_
+
+#include <stdint.h>
+
+/*
+ * counters of the SDK calls made
+ *
+ * timer_sets, timer_clears - calls to mgos_set_timer and mgos_clear_timer
+ * timers_armed - timers currently armed
+ * invokes - calls to mgos_invoke_cb
+ */
+struct mgos_host_stats{
+  uint64_t timer_sets, timer_clears;
+  uint32_t timers_armed;
+  uint64_t invokes;
+};
+
+/*
+ * Move the uptime on by ms, running the timers and callbacks due
+ */
+void mgos_host_advance(int ms);
+
+/*
+ * Copy the SDK call counters into stats
+ */
+void mgos_host_get_stats(struct mgos_host_stats *stats);
+
+/*
+ * Returns the wall clock time in nanoseconds, for timing
+ */
+uint64_t mgos_host_clock_ns(void);
+
+#endif /* CS_FW_TEST_STUBS_MGOS_HOST_H_ */
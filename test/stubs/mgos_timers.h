@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for mgos_timers.h, the timer API is declared in mgos.h
+ */
+
+#ifndef CS_FW_TEST_STUBS_MGOS_TIMERS_H_
+#define CS_FW_TEST_STUBS_MGOS_TIMERS_H_
+
+#include "mgos.h"
+
+#endif /* CS_FW_TEST_STUBS_MGOS_TIMERS_H_ */
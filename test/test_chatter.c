@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Deadband, chatter and event rate limiter test
+ *
+ * Drives an analog PV hovering around h_sv, one value per 10 ms pass, and
+ * counts the events raised. With a deadband the hovering raises nothing
+ * until the PV moves deadband back past the setpoint. With chatter
+ * detection the transition over the limit latches the alarm as
+ * MGOS_ALARM_EV_CHATTER, later ones are only counted, and a window
+ * without a transition unlatches it and raises the state it settled in.
+ * With the event rate limiter the events raised follow a token bucket
+ * modelled here, and every refused transition is reported by exactly one
+ * MGOS_ALARM_EV_SUMMARY.
+ *
+ * usage: test_chatter
+ */
+
+#include "mgos_alarm.h"
+
+#define TEST_POLL_MS 10
+#define TEST_H_SV 50
+#define TEST_CHATTER_LIMIT 4
+#define TEST_CHATTER_WINDOW_MS 200
+#define TEST_RATE_EVENTS 3
+#define TEST_RATE_PERIOD_MS 100
+
+static float s_pv;
+static char s_name[] = "level";
+static int s_pass;
+
+/*
+ * events counted by the handler
+ *
+ * set, reset, chatter - MGOS_ALARM_EV_SET, RESET and CHATTER
+ * summaries, suppressed - MGOS_ALARM_EV_SUMMARY and the transitions they
+ *   report
+ * state - a_state of the last SET/RESET/CHATTER
+ * last_pass - pass the last of them was raised on
+ */
+static struct{
+  int set, reset, chatter;
+  int summaries;
+  uint32_t suppressed;
+  enum mgos_a_alarm_state state;
+  int last_pass;
+} s_events;
+
+static int s_failed;
+
+static void test_handler(int ev, void *ev_data, void *arg){
+  (void) arg;
+  if(ev == MGOS_ALARM_EV_SUMMARY){
+    s_events.summaries++;
+    s_events.suppressed += ((struct alarm_summary *) ev_data)->suppressed;
+    return;
+  }
+  if(ev == MGOS_ALARM_EV_SET) s_events.set++;
+  else if(ev == MGOS_ALARM_EV_RESET) s_events.reset++;
+  else if(ev == MGOS_ALARM_EV_CHATTER) s_events.chatter++;
+  else return;
+  s_events.state = ((struct alarm_info *) ev_data)->state.a_state;
+  s_events.last_pass = s_pass;
+}
+
+/*
+ * Run one pass on pv
+ */
+static void test_pass(float pv){
+  s_pv = pv;
+  s_pass++;
+  mgos_host_advance(TEST_POLL_MS);
+}
+
+/*
+ * Hover passes times around h_sv, alternately just above and just below,
+ * starting above
+ */
+static void test_hover(int passes){
+  for(int k = 0; k < passes; k++) test_pass(k % 2 == 0 ? TEST_H_SV + 1 : TEST_H_SV - 1);
+}
+
+static void test_check(const char *label, bool ok){
+  if(ok) return;
+  fprintf(stderr, "%s: pass %d, SET %d RESET %d CHATTER %d SUMMARY %d of %u\n", label, s_pass, s_events.set,
+          s_events.reset, s_events.chatter, s_events.summaries, (unsigned) s_events.suppressed);
+  s_failed++;
+}
+
+static void test_clear(void){
+  memset(&s_events, 0, sizeof(s_events));
+}
+
+/*
+ * A deadband of 5 holds H while the PV hovers, only going 5 below h_sv
+ * resets it. HH is entered at once and left for H within the deadband
+ * of h_sv.
+ */
+static void test_deadband(void){
+  mgos_alarm_handle_t handle = mgos_add_a_alarm_h(true, &s_pv, NAN, NAN, TEST_H_SV, 80, 0, s_name);
+  test_check("deadband rejected", !mgos_alarm_set_deadband_h(handle, -1) && !mgos_alarm_set_deadband_h(handle, NAN));
+  test_check("deadband", mgos_alarm_set_deadband_h(handle, 5));
+  test_clear();
+  test_hover(40);
+  test_check("deadband hover", s_events.set == 1 && s_events.reset == 0 && s_events.state == H);
+  test_pass(TEST_H_SV - 4.5f);
+  test_check("deadband held", s_events.set == 1 && s_events.reset == 0);
+  test_pass(TEST_H_SV - 5.5f);
+  test_check("deadband left", s_events.reset == 1 && s_events.state == NOM);
+  test_pass(81);
+  test_check("deadband HH", s_events.set == 2 && s_events.state == HH);
+  test_pass(78);
+  test_check("deadband HH held", s_events.set == 2);
+  test_pass(TEST_H_SV - 3);
+  test_check("deadband HH to H", s_events.set == 3 && s_events.reset == 1 && s_events.state == H);
+  mgos_alarm_remove_h(handle);
+}
+
+/*
+ * Latch on the transition over the limit, count the suppressed ones,
+ * unlatch a window after the last transition raising the state the
+ * alarm settled in, and latch again on the next hovering
+ */
+static void test_chatter(void){
+  struct mgos_alarm_stats before, after;
+  mgos_alarm_handle_t handle = mgos_add_a_alarm_h(true, &s_pv, NAN, NAN, TEST_H_SV, NAN, 0, s_name);
+  test_check("chatter window rejected", !mgos_alarm_set_chatter_h(handle, TEST_CHATTER_LIMIT, 0));
+  test_check("chatter", mgos_alarm_set_chatter_h(handle, TEST_CHATTER_LIMIT, TEST_CHATTER_WINDOW_MS));
+  mgos_alarm_get_stats(&before);
+  test_clear();
+  test_hover(TEST_CHATTER_LIMIT);
+  test_check("chatter under limit", s_events.set + s_events.reset == TEST_CHATTER_LIMIT && s_events.chatter == 0);
+  test_hover(1);
+  test_check("chatter latched", s_events.chatter == 1 && s_events.state == H);
+  //the transition over the limit was to H, hovering on from H makes 10
+  //more that end in H
+  test_hover(11);
+  test_check("chatter suppressed", s_events.set + s_events.reset == TEST_CHATTER_LIMIT && s_events.chatter == 1);
+  //settled in H as last raised, unlatching raises nothing
+  for(int k = 0; k < 2 * TEST_CHATTER_WINDOW_MS / TEST_POLL_MS; k++) test_pass(TEST_H_SV + 1);
+  test_check("chatter unlatched in raised state", s_events.set + s_events.reset == TEST_CHATTER_LIMIT);
+  mgos_alarm_get_stats(&after);
+  test_check("chatter counters", after.chatter_latched - before.chatter_latched == 1 &&
+             after.chatter_suppressed - before.chatter_suppressed == 10);
+
+  //latch again on a transition to NOM, settle in H and unlatch a window
+  //after the last transition raising the SET that was suppressed
+  test_clear();
+  test_hover(TEST_CHATTER_LIMIT + 3);
+  test_check("chatter latched again", s_events.set + s_events.reset == TEST_CHATTER_LIMIT &&
+             s_events.chatter == 1 && s_events.state == NOM);
+  int last = s_pass;
+  for(int k = 0; k < 2 * TEST_CHATTER_WINDOW_MS / TEST_POLL_MS; k++) test_pass(TEST_H_SV + 1);
+  test_check("chatter unlatched", s_events.set == TEST_CHATTER_LIMIT / 2 + 1 && s_events.state == H &&
+             s_events.last_pass == last + TEST_CHATTER_WINDOW_MS / TEST_POLL_MS);
+  mgos_alarm_get_stats(&before);
+  test_check("chatter counters again", before.chatter_latched - after.chatter_latched == 1 &&
+             before.chatter_suppressed - after.chatter_suppressed == 1);
+  mgos_alarm_remove_h(handle);
+}
+
+/*
+ * Toggle the alarm every pass under a limit of 3 events per 100 ms. The
+ * events raised follow the bucket modelled here, refilled by 3 event ms
+ * per ms, and once the PV settles every refused transition has been
+ * summarised, at most one summary per period.
+ */
+static void test_rate_limit(void){
+  struct mgos_alarm_stats before, after;
+  mgos_alarm_handle_t handle = mgos_add_a_alarm_h(true, &s_pv, NAN, NAN, TEST_H_SV, NAN, 0, s_name);
+  test_check("rate limit period rejected", !mgos_alarm_set_rate_limit(TEST_RATE_EVENTS, 0));
+  test_check("rate limit", mgos_alarm_set_rate_limit(TEST_RATE_EVENTS, TEST_RATE_PERIOD_MS));
+  mgos_alarm_get_stats(&before);
+  test_clear();
+  uint32_t full = TEST_RATE_EVENTS * TEST_RATE_PERIOD_MS, tokens = full;
+  int raised = 0, refused = 0, transitions = 100, start = s_pass;
+  for(int k = 0; k < transitions; k++){
+    if(k > 0) tokens += TEST_RATE_EVENTS * TEST_POLL_MS;
+    if(tokens > full) tokens = full;
+    if(tokens >= TEST_RATE_PERIOD_MS){
+      tokens -= TEST_RATE_PERIOD_MS;
+      raised++;
+    }
+    else refused++;
+    //the alarm starts in NOM below h_sv
+    test_pass(k % 2 == 0 ? TEST_H_SV + 1 : TEST_H_SV - 1);
+  }
+  test_check("rate limited", s_events.set + s_events.reset == raised);
+  //settle and let the last refused transitions be summarised
+  for(int k = 0; k < 2 * TEST_RATE_PERIOD_MS / TEST_POLL_MS; k++) test_pass(s_pv);
+  mgos_alarm_get_stats(&after);
+  test_check("rate limit summaries", (int) s_events.suppressed == refused &&
+             s_events.set + s_events.reset + (int) s_events.suppressed == transitions &&
+             s_events.summaries > 0 &&
+             s_events.summaries <= (s_pass - start) * TEST_POLL_MS / TEST_RATE_PERIOD_MS + 1);
+  test_check("rate limit counters", (int) (after.rate_limited - before.rate_limited) == refused &&
+             (int) (after.summaries - before.summaries) == s_events.summaries);
+  mgos_alarm_set_rate_limit(0, 0);
+  mgos_alarm_remove_h(handle);
+}
+
+int main(void){
+  if(!mgos_alarm_init(TEST_POLL_MS)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_handler, NULL);
+  test_deadband();
+  test_chatter();
+  test_rate_limit();
+  printf("deadband, chatter and rate limit %s\n", s_failed ? "FAIL" : "ok");
+  return s_failed != 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Configuration loader test
+ *
+ * Loads configurations that are each invalid in one way and checks that
+ * every load fails and leaves the alarms already added untouched, then
+ * loads a valid one in JSON and in binary form and checks the alarms.
+ * Last, two alarms of a configuration trip within one pass and the SET
+ * handler removes both, the second SET must still carry the name of its
+ * alarm after the first removal.
+ *
+ * usage: test_config
+ */
+
+#include "mgos_alarm.h"
+
+#define TEST_IO 4
+
+static bool s_inputs[TEST_IO];
+static float s_pvs[TEST_IO];
+
+#define TEST_D(fields) "{\"name\": \"d1\", \"type\": \"digital\", \"input\": 0" fields "}"
+#define TEST_A(fields) "{\"name\": \"a1\", \"type\": \"analog\", \"pv\": 0" fields "}"
+#define TEST_JSON(alarms) "{\"alarms\": [" alarms "]}"
+
+static const char *const s_invalid[] = {
+  TEST_JSON(TEST_D("") ", " TEST_D("")),
+  TEST_JSON("{\"name\": \"existing\", \"type\": \"digital\", \"input\": 0}"),
+  TEST_JSON(TEST_D(", \"input\": 4")),
+  TEST_JSON(TEST_D(", \"input\": 1.5")),
+  TEST_JSON(TEST_A(", \"l_sv\": 20, \"ll_sv\": 30")),
+  TEST_JSON("{\"name\": \"x1\", \"type\": \"counter\", \"input\": 0}"),
+  TEST_JSON(TEST_D(", \"mode\": \"ACTIVE_SIDEWAYS\"")),
+  TEST_JSON(TEST_D(", \"set_interval\": 2.5")),
+  TEST_JSON(TEST_D(", \"reset_interval\": -100")),
+  TEST_JSON(TEST_A(", \"set_interval\": -1")),
+  TEST_JSON(TEST_D(", \"set_interval\": 1e12")),
+  TEST_JSON(TEST_D(", \"set_interval\": \"100\"")),
+  TEST_JSON("{\"type\": \"digital\", \"input\": 0}"),
+  "{\"alarms\": [" TEST_D(""),
+};
+
+/*
+ * binary digital record with a reset_interval of -1, see CONFIG_MAGIC in
+ * src/mgos_alarm_config.c
+ */
+static const uint8_t s_negative_binary[] = {
+  'A', 'L', 'M', 'C', 1, 0, 0, 0, 1, 0, 0, 0,
+  0, 0x03, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0xff, 0xff, 'd', '1',
+};
+
+static const char s_valid[] = TEST_JSON(
+  TEST_D(", \"mode\": \"ACTIVE_LOW\", \"set_interval\": 0, \"reset_interval\": 1000") ", "
+  TEST_A(", \"ll_sv\": null, \"l_sv\": 20, \"h_sv\": 80, \"hh_sv\": 90, \"set_interval\": 0, \"enabled\": true"));
+
+/*
+ * the valid configuration in binary form
+ */
+static const uint8_t s_valid_binary[] = {
+  'A', 'L', 'M', 'C', 1, 0, 0, 0, 2, 0, 0, 0,
+  0, 0x01, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xe8, 0x03, 0, 0, 'd', '1',
+  1, 0x03, 2, 0, 0, 0, 0, 0, 0, 0, 0xc0, 0x7f, 0, 0, 0xa0, 0x41, 0, 0, 0xa0, 0x42, 0, 0, 0xb4, 0x42,
+  0, 0, 0, 0, 'a', '1',
+};
+
+/*
+ * two digital alarms tripped within one pass
+ */
+static const char s_tripped[] = TEST_JSON(
+  "{\"name\": \"t1\", \"type\": \"digital\", \"input\": 2}, "
+  "{\"name\": \"t2\", \"type\": \"digital\", \"input\": 3}");
+
+static char s_set_names[2][4];
+static int s_sets;
+
+/*
+ * Records the name of each SET and removes its alarm, and the other
+ * alarm of the configuration with the first
+ */
+static void test_remove_handler(int ev, void *ev_data, void *arg){
+  (void) arg;
+  struct alarm_info *info = (struct alarm_info *) ev_data;
+  if(ev != MGOS_ALARM_EV_SET || s_sets >= 2) return;
+  snprintf(s_set_names[s_sets++], sizeof(s_set_names[0]), "%s", info->name);
+  mgos_alarm_remove_h(mgos_alarm_find("t1"));
+  mgos_alarm_remove_h(mgos_alarm_find("t2"));
+}
+
+/*
+ * Check the alarms of the valid configuration, d1 is active as its input
+ * is low, a1 is high
+ * returns the number of failed checks
+ */
+static int test_valid_alarms(void){
+  struct alarm_info info;
+  int failed = 0;
+  mgos_host_advance(100);
+  if(!mgos_alarm_get_state_h(mgos_alarm_find("d1"), &info) || !info.state.d_state) failed++;
+  if(!mgos_alarm_get_state_h(mgos_alarm_find("a1"), &info) || info.state.a_state != H) failed++;
+  mgos_alarm_remove_h(mgos_alarm_find("d1"));
+  mgos_alarm_remove_h(mgos_alarm_find("a1"));
+  return failed;
+}
+
+int main(void){
+  struct mgos_alarm_config_io io = {s_inputs, TEST_IO, s_pvs, TEST_IO};
+  int failed = 0;
+  s_pvs[0] = 85;
+  if(!mgos_alarm_init(10)) return 1;
+  if(!mgos_add_d_alarm(true, &s_inputs[1], ACTIVE_HIGH, 0, 0, "existing")) return 1;
+  for(size_t k = 0; k < sizeof(s_invalid) / sizeof(s_invalid[0]); k++){
+    bool loaded = mgos_alarm_load_config_buf(s_invalid[k], strlen(s_invalid[k]), &io);
+    if(loaded || mgos_alarm_find("d1") != MGOS_ALARM_INVALID_HANDLE || mgos_alarm_find("a1") != MGOS_ALARM_INVALID_HANDLE ||
+       mgos_alarm_find("existing") == MGOS_ALARM_INVALID_HANDLE){
+      fprintf(stderr, "invalid configuration %u %s\n", (unsigned) k, loaded ? "loaded" : "left alarms behind");
+      failed++;
+    }
+  }
+  if(mgos_alarm_load_config_buf((const char *) s_negative_binary, sizeof(s_negative_binary), &io) ||
+     mgos_alarm_load_config_buf((const char *) s_valid_binary, sizeof(s_valid_binary) - 1, &io)){
+    fprintf(stderr, "invalid binary configuration loaded\n");
+    failed++;
+  }
+  if(!mgos_alarm_load_config_buf(s_valid, strlen(s_valid), &io) || test_valid_alarms() != 0){
+    fprintf(stderr, "valid configuration failed\n");
+    failed++;
+  }
+  if(!mgos_alarm_load_config_buf((const char *) s_valid_binary, sizeof(s_valid_binary), &io) ||
+     test_valid_alarms() != 0){
+    fprintf(stderr, "valid binary configuration failed\n");
+    failed++;
+  }
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_remove_handler, NULL);
+  if(!mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP) ||
+     !mgos_alarm_load_config_buf(s_tripped, strlen(s_tripped), &io)){
+    fprintf(stderr, "tripped configuration failed to load\n");
+    failed++;
+  }
+  s_inputs[2] = s_inputs[3] = true;
+  mgos_host_advance(20);
+  if(s_sets != 2 || strcmp(s_set_names[0], "t1") != 0 || strcmp(s_set_names[1], "t2") != 0 ||
+     mgos_alarm_find("t1") != MGOS_ALARM_INVALID_HANDLE){
+    fprintf(stderr, "removed by handler: %d SET \"%s\" \"%s\"\n", s_sets, s_set_names[0], s_set_names[1]);
+    failed++;
+  }
+  printf("invalid configurations %u %s\n", (unsigned) (sizeof(s_invalid) / sizeof(s_invalid[0]) + 2),
+         failed ? "FAIL" : "ok");
+  return failed != 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Edge capture test
+ *
+ * A producer thread stands in for a GPIO interrupt handler and pushes
+ * timestamped edges of eight edge captured digital alarms, with set and
+ * reset intervals from 0 to 29 ms, while the main thread runs the service
+ * passes. Every alarm's transitions are compared with a model that
+ * debounces the same edges exactly, times and states, so a transition
+ * stamped with the pass time instead of the time its interval ran out
+ * fails. The test runs with a serial pass and with the pass split into
+ * four shards, where a transition whose interval runs out between edges
+ * is found by a shard and made by the merge.
+ *
+ * usage: test_edge [simulated ms per phase]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "mgos_alarm.h"
+
+#define TEST_ALARMS 8
+#define TEST_MAX_EDGES 200000
+#define TEST_MAX_TRANSITIONS 20000
+#define TEST_SHARDS 4
+
+/*
+ * an edge pushed by the producer, time_us is relative to the phase start
+ */
+struct test_edge{
+  int alarm;
+  bool level;
+  int64_t time_us;
+};
+
+/*
+ * a transition, time_ms is relative to the phase start
+ */
+struct test_transition{
+  int64_t time_ms;
+  bool active;
+};
+
+static struct test_edge s_edges[TEST_MAX_EDGES];
+static int s_edge_count, s_pushed;
+static int64_t s_start_us, s_end_ms;
+static int s_set[TEST_ALARMS], s_reset[TEST_ALARMS];
+static bool s_high[TEST_ALARMS], s_inputs[TEST_ALARMS];
+static char s_names[TEST_ALARMS][8];
+static mgos_alarm_handle_t s_handles[TEST_ALARMS];
+static struct test_transition s_got[TEST_ALARMS][TEST_MAX_TRANSITIONS];
+static struct test_transition s_expected[TEST_ALARMS][TEST_MAX_TRANSITIONS];
+static int s_got_count[TEST_ALARMS], s_expected_count[TEST_ALARMS];
+
+static int test_alarm_of(const char *name){
+  for(int a = 0; a < TEST_ALARMS; a++){
+    if(name == s_names[a]) return a;
+  }
+  return -1;
+}
+
+static void test_handler(int ev, void *ev_data, void *arg){
+  (void) arg;
+  if(ev != MGOS_ALARM_EV_BATCH) return;
+  struct alarm_batch *batch = (struct alarm_batch *) ev_data;
+  for(size_t k = 0; k < batch->length; k++){
+    const struct alarm_transition *t = &batch->transitions[k];
+    int a = test_alarm_of(t->info.name);
+    if(a < 0 || s_got_count[a] == TEST_MAX_TRANSITIONS) continue;
+    s_got[a][s_got_count[a]++] = (struct test_transition){t->time_ms - s_start_us / 1000, t->info.state.d_state};
+  }
+}
+
+/*
+ * Generate the edges of a phase, even alarms bounce faster than their
+ * intervals and odd alarms mostly slower, some edges repeat the level
+ */
+static void test_generate(void){
+  unsigned seed = 12345;
+  int64_t next[TEST_ALARMS];
+  bool level[TEST_ALARMS];
+  s_edge_count = 0;
+  for(int a = 0; a < TEST_ALARMS; a++){
+    next[a] = 5 + rand_r(&seed) % 50;
+    level[a] = !s_high[a];
+  }
+  for(;;){
+    int a = 0;
+    for(int k = 1; k < TEST_ALARMS; k++){
+      if(next[k] < next[a]) a = k;
+    }
+    if(next[a] >= s_end_ms - 200 || s_edge_count == TEST_MAX_EDGES) break;
+    if(rand_r(&seed) % 8 != 0) level[a] = !level[a];
+    s_edges[s_edge_count++] = (struct test_edge){a, level[a], next[a] * 1000 + rand_r(&seed) % 1000};
+    next[a] += 1 + rand_r(&seed) % ((a & 1) ? 80 : 8);
+  }
+}
+
+/*
+ * Debounce alarm a's edges exactly into s_expected, a pending interval is
+ * settled at each edge and at the end of the phase
+ */
+static void test_model_settle(int a, bool *active, int64_t *pending, int64_t time_ms){
+  if(*pending < 0) return;
+  int interval = *active ? s_reset[a] : s_set[a];
+  if(time_ms - *pending < interval) return;
+  *active = !*active;
+  s_expected[a][s_expected_count[a]++] = (struct test_transition){*pending + interval, *active};
+  *pending = -1;
+}
+
+static void test_model(void){
+  for(int a = 0; a < TEST_ALARMS; a++){
+    bool active = false;
+    int64_t pending = -1;
+    s_expected_count[a] = 0;
+    for(int k = 0; k < s_edge_count; k++){
+      if(s_edges[k].alarm != a) continue;
+      int64_t time_ms = s_edges[k].time_us / 1000;
+      test_model_settle(a, &active, &pending, time_ms);
+      if((s_edges[k].level == s_high[a]) == active) pending = -1;
+      else if(pending < 0) pending = time_ms;
+      test_model_settle(a, &active, &pending, time_ms);
+    }
+    test_model_settle(a, &active, &pending, s_end_ms);
+  }
+}
+
+/*
+ * Push the edges no earlier than 10 ms ahead of the uptime, like an
+ * interrupt handler, retrying while the ring is full
+ */
+static void *test_producer(void *arg){
+  (void) arg;
+  for(int k = 0; k < s_edge_count; k++){
+    int64_t time_us = s_start_us + s_edges[k].time_us;
+    while(time_us > mgos_uptime_micros() + 10000) sched_yield();
+    while(!mgos_alarm_edge_push(s_handles[s_edges[k].alarm], s_edges[k].level, time_us)) sched_yield();
+    __atomic_store_n(&s_pushed, k + 1, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+/*
+ * Runs the shards one after another, last first
+ */
+static void test_runner(uint32_t shards, mgos_alarm_shard_fn fn, void *ctx, void *arg){
+  (void) arg;
+  for(uint32_t k = shards; k-- > 0;) fn(k, ctx);
+}
+
+/*
+ * Run a phase with the pass split into shards
+ * returns the number of failed checks
+ */
+static int test_phase(const char *label, uint32_t shards){
+  pthread_t producer;
+  struct mgos_alarm_stats stats;
+  mgos_alarm_get_stats(&stats);
+  uint32_t edges = stats.edges, dropped = stats.edges_dropped;
+  if(!mgos_alarm_set_shards(shards, shards > 1 ? test_runner : NULL, NULL)) return 1;
+  s_start_us = mgos_uptime_micros();
+  s_pushed = 0;
+  for(int a = 0; a < TEST_ALARMS; a++){
+    s_inputs[a] = !s_high[a];
+    s_got_count[a] = 0;
+    s_handles[a] = mgos_add_d_alarm_h(true, &s_inputs[a], s_high[a] ? ACTIVE_HIGH : ACTIVE_LOW,
+                                      s_set[a], s_reset[a], s_names[a]);
+    if(!mgos_alarm_set_edge_capture(s_handles[a], true)) return 1;
+  }
+  pthread_create(&producer, NULL, test_producer, NULL);
+  while(mgos_uptime_micros() - s_start_us < s_end_ms * 1000){
+    //every edge up to the next pass is in the ring before it runs
+    for(;;){
+      int pushed = __atomic_load_n(&s_pushed, __ATOMIC_ACQUIRE);
+      if(pushed == s_edge_count || s_start_us + s_edges[pushed].time_us > mgos_uptime_micros() + 1000) break;
+      sched_yield();
+    }
+    mgos_host_advance(1);
+  }
+  pthread_join(producer, NULL);
+  mgos_host_advance(50);
+  int failed = 0, transitions = 0;
+  for(int a = 0; a < TEST_ALARMS; a++){
+    transitions += s_expected_count[a];
+    if(s_got_count[a] != s_expected_count[a]){
+      fprintf(stderr, "%s: alarm %d made %d transitions, expected %d\n", label, a, s_got_count[a],
+              s_expected_count[a]);
+      failed++;
+    }
+    for(int j = 0; j < s_got_count[a] && j < s_expected_count[a]; j++){
+      if(s_got[a][j].time_ms != s_expected[a][j].time_ms || s_got[a][j].active != s_expected[a][j].active){
+        fprintf(stderr, "%s: alarm %d transition %d at %lld to %d, expected at %lld to %d\n", label, a, j,
+                (long long) s_got[a][j].time_ms, s_got[a][j].active, (long long) s_expected[a][j].time_ms,
+                s_expected[a][j].active);
+        failed++;
+        break;
+      }
+    }
+    mgos_alarm_remove_h(s_handles[a]);
+  }
+  mgos_alarm_get_stats(&stats);
+  printf("%-8s edges %d transitions %d consumed %u dropped %u high water %u/%u %s\n", label, s_edge_count,
+         transitions, stats.edges - edges, stats.edges_dropped - dropped, stats.edge_ring_high_water, stats.edge_ring_size,
+         failed ? "FAIL" : "ok");
+  return failed;
+}
+
+int main(int argc, char **argv){
+  s_end_ms = (argc > 1) ? atoi(argv[1]) : 20000;
+  for(int a = 0; a < TEST_ALARMS; a++){
+    snprintf(s_names[a], sizeof(s_names[a]), "e%d", a);
+    s_set[a] = (a * 7) % 30;
+    s_reset[a] = (a * 11) % 25;
+    s_high[a] = (a % 3) != 0;
+  }
+  test_generate();
+  test_model();
+  if(!mgos_alarm_init(10)) return 1;
+  mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP);
+  mgos_alarm_set_eval_mode(MGOS_ALARM_EVAL_POLL);
+  mgos_alarm_set_batch_events(true);
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_handler, NULL);
+  int failed = test_phase("serial", 1);
+  failed += test_phase("sharded", TEST_SHARDS);
+  return failed != 0;
+}
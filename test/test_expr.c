@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Alarm expression test
+ *
+ * Compiles expressions against a table of stand-in alarms and checks
+ * every operator and the precedence against the truth table computed
+ * here for every combination of their references, K of (...) included.
+ * Quoted names and reference suffixes are resolved or rejected, the
+ * depth, reference and code limits are hit one past where they allow,
+ * and every compile error is reported at its offset in the text. Then
+ * expression alarms run in the engine, where an expression is only
+ * evaluated when an alarm it refers to changed, and one referring to
+ * another follows it within the same pass.
+ *
+ * usage: test_expr
+ */
+
+#include "mgos_alarm.h"
+#include "mgos_alarm_expr.h"
+
+#define TEST_POLL_MS 10
+
+/*
+ * stand-in alarms, the handle of an alarm is its index + 1, "r<n>" are
+ * digital alarms with handle 100 + n
+ */
+static const struct{
+  const char *name;
+  enum mgos_alarm_type type;
+} s_alarms[] = {
+  {"a", DIGITAL}, {"b", DIGITAL}, {"c", DIGITAL}, {"d", DIGITAL}, {"pt1", ANALOG}, {"pump 1", DIGITAL},
+};
+
+#define TEST_ALARMS (sizeof(s_alarms) / sizeof(s_alarms[0]))
+#define TEST_PT1 5
+#define TEST_PUMP1 6
+
+/*
+ * values read, bit handle of s_active and s_input, and the state of pt1
+ */
+static uint32_t s_active, s_input;
+static enum mgos_a_alarm_state s_pt1;
+
+static int s_failed;
+
+static bool test_resolve(const char *name, mgos_alarm_handle_t *handle, enum mgos_alarm_type *type, void *arg){
+  (void) arg;
+  for(uint32_t i = 0; i < TEST_ALARMS; i++){
+    if(strcmp(name, s_alarms[i].name) != 0) continue;
+    *handle = i + 1;
+    *type = s_alarms[i].type;
+    return true;
+  }
+  if(name[0] == 'r' && name[1] >= '0' && name[1] <= '9'){
+    *handle = 100 + (mgos_alarm_handle_t) atoi(name + 1);
+    *type = DIGITAL;
+    return true;
+  }
+  return false;
+}
+
+static bool test_read(const struct mgos_alarm_expr_ref *ref, void *arg){
+  (void) arg;
+  if(ref->handle == TEST_PT1){
+    if(ref->test == MGOS_ALARM_EXPR_ACTIVE) return s_pt1 != NOM;
+    return ref->test - MGOS_ALARM_EXPR_STATE == (uint8_t) s_pt1;
+  }
+  if(ref->handle >= 32) return false;
+  if(ref->test == MGOS_ALARM_EXPR_INPUT) return (s_input >> ref->handle) & 1;
+  return (s_active >> ref->handle) & 1;
+}
+
+static struct mgos_alarm_expr *test_compile(const char *text){
+  const char *error;
+  size_t pos;
+  struct mgos_alarm_expr *expr = mgos_alarm_expr_compile(text, test_resolve, NULL, &error, &pos);
+  if(expr == NULL){
+    fprintf(stderr, "\"%s\" failed to compile as %s at %u\n", text, error, (unsigned) pos);
+    s_failed++;
+  }
+  return expr;
+}
+
+/*
+ * Check an expression over a, b, c and d against model for all 16
+ * combinations, bit 0 of v is a
+ */
+static void test_table(const char *text, bool (*model)(unsigned v)){
+  struct mgos_alarm_expr *expr = test_compile(text);
+  if(expr == NULL) return;
+  for(unsigned v = 0; v < 16; v++){
+    s_active = v << 1;
+    if(mgos_alarm_expr_eval(expr, test_read, NULL) != model(v)){
+      fprintf(stderr, "\"%s\" is wrong for a=%u b=%u c=%u d=%u\n", text, v & 1, (v >> 1) & 1, (v >> 2) & 1,
+              (v >> 3) & 1);
+      s_failed++;
+      break;
+    }
+  }
+  mgos_alarm_expr_free(expr);
+}
+
+#define A (v & 1)
+#define B ((v >> 1) & 1)
+#define C ((v >> 2) & 1)
+#define D ((v >> 3) & 1)
+
+static bool test_and(unsigned v){ return A && B; }
+static bool test_or(unsigned v){ return A || B; }
+static bool test_xor(unsigned v){ return A ^ B; }
+static bool test_not_and(unsigned v){ return !A && !!B; }
+static bool test_precedence(unsigned v){ return A | (B ^ (C & D)); }
+static bool test_precedence_rev(unsigned v){ return ((A & B) ^ C) | D; }
+static bool test_grouped(unsigned v){ return (A | B) & (C ^ D); }
+static bool test_2_of_3(unsigned v){ return A + B + C >= 2; }
+static bool test_3_of_4(unsigned v){ return A + B + C + D >= 3; }
+static bool test_1_of_nested(unsigned v){ return (A & B) || (C & !D); }
+static bool test_k_of_in_expr(unsigned v){ return D ^ (A + B + C >= 2); }
+static bool test_constants(unsigned v){ return (A & true) | (B & false); }
+
+/*
+ * Check that an expression does not compile with error at pos
+ */
+static void test_error(const char *text, const char *error, size_t pos){
+  const char *got;
+  size_t got_pos;
+  struct mgos_alarm_expr *expr = mgos_alarm_expr_compile(text, test_resolve, NULL, &got, &got_pos);
+  if(expr != NULL || got == NULL || strcmp(got, error) != 0 || got_pos != pos){
+    fprintf(stderr, "\"%.40s\" gave %s at %u, expected %s at %u\n", text, expr != NULL ? "no error" : got,
+            (unsigned) got_pos, error, (unsigned) pos);
+    s_failed++;
+  }
+  mgos_alarm_expr_free(expr);
+}
+
+/*
+ * Build prefix, count times item joined by sep, then suffix into buf
+ */
+static const char *test_repeat(char *buf, const char *prefix, const char *item, const char *sep, int count,
+                               const char *suffix){
+  strcpy(buf, prefix);
+  for(int k = 0; k < count; k++){
+    if(k > 0) strcat(buf, sep);
+    sprintf(buf + strlen(buf), item, k);
+  }
+  strcat(buf, suffix);
+  return buf;
+}
+
+static void test_operators(void){
+  test_table("a & b", test_and);
+  test_table("a && b", test_and);
+  test_table("a | b", test_or);
+  test_table("a || b", test_or);
+  test_table("a ^ b", test_xor);
+  test_table("!a & !!b", test_not_and);
+  test_table("a | b ^ c & d", test_precedence);
+  test_table("a & b ^ c | d", test_precedence_rev);
+  test_table("(a | b) & (c ^ d)", test_grouped);
+  test_table("2 of (a, b, c)", test_2_of_3);
+  test_table("3 of (a, b, c, d)", test_3_of_4);
+  test_table("1 of (a & b, c & !d)", test_1_of_nested);
+  test_table("d ^ 2 of (a, b, c)", test_k_of_in_expr);
+  test_table("a & true | b & false", test_constants);
+}
+
+static void test_references(void){
+  struct mgos_alarm_expr *expr = test_compile("\"pump 1\".in & !\"a\".active & pt1.HH & a.in & pt1");
+  if(expr != NULL){
+    //a.in and "a".active are distinct references, pt1 and pt1.HH too
+    if(expr->num_refs != 5 || !expr->inputs) s_failed++;
+    s_input = 1u << TEST_PUMP1 | 1u << 1;
+    s_active = 0;
+    s_pt1 = HH;
+    if(!mgos_alarm_expr_eval(expr, test_read, NULL)) s_failed++;
+    s_pt1 = H;
+    if(mgos_alarm_expr_eval(expr, test_read, NULL)) s_failed++;
+    mgos_alarm_expr_free(expr);
+  }
+  expr = test_compile("a & a & a.active");
+  if(expr != NULL && (expr->num_refs != 1 || expr->inputs)) s_failed++;
+  mgos_alarm_expr_free(expr);
+  test_error("pt1.in", "suffix does not apply to the alarm", 0);
+  test_error("a & b.HH", "suffix does not apply to the alarm", 4);
+  test_error("a & \"pump 1\".NOM", "suffix does not apply to the alarm", 4);
+  test_error("a.high", "unknown reference suffix", 6);
+  test_error("a & missing", "unknown alarm", 4);
+  test_error("a | \"pump 2\".in", "unknown alarm", 4);
+  test_error("a & \"pump 1", "unterminated name", 11);
+}
+
+static void test_limits(void){
+  static char buf[1024];
+  //nesting, 31 parentheses around a reference compile and 32 do not
+  char open[40], close[40];
+  memset(open, '(', 31);
+  open[31] = '\0';
+  memset(close, ')', 31);
+  close[31] = '\0';
+  mgos_alarm_expr_free(test_compile(test_repeat(buf, open, "a", "", 1, close)));
+  strcat(open, "(");
+  strcat(close, ")");
+  test_error(test_repeat(buf, open, "a", "", 1, close), "expression nested too deep", 32);
+  //stack depth, K of 32 operands compiles and of 33 does not
+  mgos_alarm_expr_free(test_compile(test_repeat(buf, "1 of (", "a", ", ", 32, ")")));
+  test_repeat(buf, "1 of (", "a", ", ", 33, ")");
+  test_error(buf, "expression nested too deep", strlen(buf) - 1);
+  //distinct references, 32 compile, the 33rd fails at its end
+  mgos_alarm_expr_free(test_compile(test_repeat(buf, "", "r%d", " | ", 32, "")));
+  test_repeat(buf, "", "r%d", " | ", 33, "");
+  test_error(buf, "too many references", strlen(buf));
+  //code, 64 constants or'ed are 127 bytes, 65 are 129
+  mgos_alarm_expr_free(test_compile(test_repeat(buf, "", "true", "|", 64, "")));
+  test_repeat(buf, "", "true", "|", 65, "");
+  test_error(buf, "expression too long", strlen(buf));
+  //counts
+  test_error("0 of (a)", "count out of range", 8);
+  test_error("3 of (a, b)", "count out of range", 11);
+  test_error("33 of (a)", "count too large", 2);
+}
+
+static void test_positions(void){
+  test_error("", "operand expected", 0);
+  test_error("a & ", "operand expected", 4);
+  test_error("a & )", "operand expected", 4);
+  test_error("a b", "unexpected text", 2);
+  test_error("(a | b", "')' expected", 6);
+  test_error("2 (a, b)", "'of' expected", 2);
+  test_error("2 often", "'of' expected", 2);
+  test_error("2 of a", "'(' expected", 5);
+  test_error("2 of (a, b", "')' expected", 10);
+  test_error("a & \"\"", "name expected", 6);
+}
+
+/*
+ * Expression alarms in the engine, debounced by timestamp so that a
+ * set_interval of 0 transitions within the evaluation rather than from
+ * an SDK timer after the pass
+ */
+static bool s_inputs[3];
+static char s_names[][4] = {"d1", "d2", "d3", "e1", "e2", "e3"};
+
+static uint32_t test_evals(void){
+  struct mgos_alarm_stats stats;
+  mgos_alarm_get_stats(&stats);
+  return stats.expr_evals;
+}
+
+static bool test_active(mgos_alarm_handle_t handle){
+  struct alarm_info info;
+  return mgos_alarm_get_state_h(handle, &info) && info.state.d_state;
+}
+
+static void test_engine_check(const char *label, bool ok){
+  if(ok) return;
+  fprintf(stderr, "engine: %s, %u evaluations\n", label, (unsigned) test_evals());
+  s_failed++;
+}
+
+static void test_engine(void){
+  mgos_alarm_handle_t d[3], e1, e2, e3;
+  if(!mgos_alarm_init(TEST_POLL_MS) || !mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP)){
+    s_failed++;
+    return;
+  }
+  for(int k = 0; k < 3; k++) d[k] = mgos_add_d_alarm_h(true, &s_inputs[k], ACTIVE_HIGH, 0, 0, s_names[k]);
+  //an expression that does not compile only allocated the compiler's scratch state
+  struct mgos_alarm_stats before, after;
+  mgos_alarm_get_stats(&before);
+  test_engine_check("unknown alarm added", mgos_add_expr_alarm_h(true, "d1 & e1", 0, 0, s_names[3]) ==
+                    MGOS_ALARM_INVALID_HANDLE);
+  mgos_alarm_get_stats(&after);
+  test_engine_check("failed compile allocations", after.allocs - before.allocs == 1);
+  e1 = mgos_add_expr_alarm_h(true, "d1 & d2", 0, 0, s_names[3]);
+  e2 = mgos_add_expr_alarm_h(true, "e1 | d3", 0, 0, s_names[4]);
+  e3 = mgos_add_expr_alarm_h(true, "d3.in", 0, 0, s_names[5]);
+  test_engine_check("add", e1 != MGOS_ALARM_INVALID_HANDLE && e2 != MGOS_ALARM_INVALID_HANDLE &&
+                    e3 != MGOS_ALARM_INVALID_HANDLE);
+  mgos_host_advance(5 * TEST_POLL_MS);
+
+  //nothing changes, only e3, which reads an input, is evaluated each pass
+  uint32_t evals = test_evals();
+  mgos_host_advance(10 * TEST_POLL_MS);
+  test_engine_check("idle evaluations", test_evals() - evals == 10);
+
+  //d2 changes e1, which stays false, so e2 is not evaluated
+  s_inputs[1] = true;
+  evals = test_evals();
+  mgos_host_advance(TEST_POLL_MS);
+  test_engine_check("d2 evaluations", test_evals() - evals == 2 && test_active(d[1]) && !test_active(e1));
+
+  //d1 makes e1 true, and e2 follows it within the same pass
+  s_inputs[0] = true;
+  evals = test_evals();
+  mgos_host_advance(TEST_POLL_MS);
+  test_engine_check("d1 evaluations", test_evals() - evals == 3 && test_active(e1) && test_active(e2));
+
+  //d3 only affects e2 and e3
+  s_inputs[2] = true;
+  evals = test_evals();
+  mgos_host_advance(TEST_POLL_MS);
+  test_engine_check("d3 evaluations", test_evals() - evals == 2 && test_active(e3));
+  s_inputs[0] = false;
+  mgos_host_advance(TEST_POLL_MS);
+  test_engine_check("e2 held by d3", !test_active(e1) && test_active(e2));
+  s_inputs[2] = false;
+  mgos_host_advance(TEST_POLL_MS);
+  test_engine_check("e2 released", !test_active(e2) && !test_active(e3));
+
+  //a removed reference reads false
+  s_inputs[0] = true;
+  mgos_host_advance(TEST_POLL_MS);
+  test_engine_check("before remove", test_active(e2));
+  mgos_alarm_remove_h(d[1]);
+  mgos_host_advance(TEST_POLL_MS);
+  test_engine_check("removed reference", !test_active(e1) && !test_active(e2));
+}
+
+int main(void){
+  test_operators();
+  test_references();
+  test_limits();
+  test_positions();
+  test_engine();
+  printf("expressions %s\n", s_failed ? "FAIL" : "ok");
+  return s_failed != 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Transition queue stress test
+ *
+ * A producer thread pushes numbered transitions into a four entry ring
+ * while a consumer thread pops them, under each overflow policy. The
+ * consumer checks that every alarm's transitions come out in the order
+ * they were pushed, which a pop claiming an entry the producer dropped
+ * and reused would break, and that without coalescing every push is
+ * accounted for as popped or dropped. Both threads yield at random so
+ * that they interleave on a single core. A consumer that spins on a lost
+ * entry trips the watchdog.
+ *
+ * usage: test_queue [pushes]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "mgos_alarm.h"
+#include "mgos_alarm_queue.h"
+
+#define TEST_QUEUE_SIZE 4
+#define TEST_ALARMS 6
+#define TEST_WATCHDOG_S 60
+
+static struct mgos_alarm_queue s_queue;
+static uint32_t s_pushes;
+static volatile bool s_done;
+static uint32_t s_popped, s_out_of_order;
+
+static void *test_producer(void *arg){
+  enum mgos_alarm_overflow_policy policy = *(enum mgos_alarm_overflow_policy *) arg;
+  unsigned seed = 1;
+  struct alarm_transition t;
+  memset(&t, 0, sizeof(t));
+  t.info.type = DIGITAL;
+  for(uint32_t n = 1; n <= s_pushes; n++){
+    uint32_t r = (uint32_t) rand_r(&seed);
+    t.handle = r % TEST_ALARMS + 1;
+    t.old_state.d_state = (r >> 8) & 1;
+    t.info.state.d_state = (r >> 9) & 1;
+    t.time_ms = n;
+    mgos_alarm_queue_push(&s_queue, &t, n, policy);
+    if((r >> 10) % 64 == 0) sched_yield();
+  }
+  __atomic_store_n(&s_done, true, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void *test_consumer(void *arg){
+  int64_t last[TEST_ALARMS + 1];
+  memset(last, 0, sizeof(last));
+  struct alarm_transition t;
+  int64_t queued_us;
+  unsigned seed = 2;
+  (void) arg;
+  for(;;){
+    if(rand_r(&seed) % 64 == 0) sched_yield();
+    bool done = __atomic_load_n(&s_done, __ATOMIC_ACQUIRE);
+    if(!mgos_alarm_queue_pop(&s_queue, &t, &queued_us)){
+      if(done) break;
+      continue;
+    }
+    s_popped++;
+    //the queue time is that of the first push into the entry
+    if(t.time_ms <= last[t.handle] || queued_us > t.time_ms) s_out_of_order++;
+    last[t.handle] = t.time_ms;
+  }
+  return NULL;
+}
+
+static int test_run(enum mgos_alarm_overflow_policy policy, const char *label){
+  pthread_t producer, consumer;
+  if(!mgos_alarm_queue_init(&s_queue, TEST_QUEUE_SIZE)) return 1;
+  s_done = false;
+  s_popped = s_out_of_order = 0;
+  pthread_create(&consumer, NULL, test_consumer, NULL);
+  pthread_create(&producer, NULL, test_producer, &policy);
+  pthread_join(producer, NULL);
+  pthread_join(consumer, NULL);
+  //a coalesced entry may be cancelled and never popped
+  bool ok = s_out_of_order == 0 && mgos_alarm_queue_depth(&s_queue) == 0 &&
+            (policy == MGOS_ALARM_OVERFLOW_COALESCE || s_popped + s_queue.dropped == s_pushes);
+  printf("%-12s pushed %u popped %u dropped %u coalesced %u out of order %u %s\n", label,
+         s_pushes, s_popped, s_queue.dropped, s_queue.coalesced, s_out_of_order, ok ? "ok" : "FAIL");
+  free(s_queue.entries);
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv){
+  s_pushes = (argc > 1) ? (uint32_t) atoi(argv[1]) : 2000000;
+  alarm(TEST_WATCHDOG_S);
+  int res = test_run(MGOS_ALARM_OVERFLOW_DROP_OLDEST, "drop oldest");
+  res |= test_run(MGOS_ALARM_OVERFLOW_DROP_NEWEST, "drop newest");
+  res |= test_run(MGOS_ALARM_OVERFLOW_COALESCE, "coalesce");
+  return res;
+}
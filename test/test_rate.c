@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Rate of change and deviation alarm test
+ *
+ * Feeds ramps and steps to a rate alarm and a deviation alarm, one sample
+ * per 10 ms pass, and checks the value of mgos_alarm_get_value_h after
+ * every pass against the exponential moving average computed here, and
+ * the pass each SET and RESET is raised on. Covers the two samples a rate
+ * needs, an unfiltered rate, the average converging on a step, the bands
+ * being taken on the averaged value rather than the raw one, a NAN PV
+ * or setpoint restarting the history, and a disabled or masked alarm not
+ * sampling its PV.
+ *
+ * usage: test_rate
+ */
+
+#include <math.h>
+
+#include "mgos_alarm.h"
+
+#define TEST_POLL_MS 10
+#define TEST_FILTER_MS 90
+
+static float s_pv, s_sp;
+static char s_rate_name[] = "rate", s_fast_name[] = "fast", s_dev_name[] = "deviation", s_trip_name[] = "trip";
+static bool s_trip;
+static int s_pass;
+static int s_set_pass, s_reset_pass, s_events;
+static const char *s_watch;
+static int s_failed;
+
+static void test_handler(int ev, void *ev_data, void *arg){
+  (void) arg;
+  struct alarm_info *info = (struct alarm_info *) ev_data;
+  if((ev != MGOS_ALARM_EV_SET && ev != MGOS_ALARM_EV_RESET) || info->name != s_watch) return;
+  s_events++;
+  if(ev == MGOS_ALARM_EV_SET) s_set_pass = s_pass;
+  else s_reset_pass = s_pass;
+}
+
+/*
+ * Run one pass
+ */
+static void test_pass(void){
+  s_pass++;
+  mgos_host_advance(TEST_POLL_MS);
+}
+
+/*
+ * Check the value of an alarm, NAN expects NAN
+ */
+static void test_value(const char *label, mgos_alarm_handle_t handle, float expected){
+  float value;
+  bool ok = mgos_alarm_get_value_h(handle, &value);
+  if(ok && isnan(expected)) ok = isnan(value);
+  else if(ok) ok = fabsf(value - expected) <= 1e-3f * (1.0f + fabsf(expected));
+  if(!ok){
+    fprintf(stderr, "%s: pass %d value %g expected %g\n", label, s_pass, (double) value, (double) expected);
+    s_failed++;
+  }
+}
+
+/*
+ * Check the pass the last SET or RESET was raised on and the events since
+ * the alarm was watched
+ */
+static void test_events(const char *label, int set_pass, int reset_pass, int events){
+  if(s_set_pass != set_pass || s_reset_pass != reset_pass || s_events != events){
+    fprintf(stderr, "%s: SET at pass %d expected %d, RESET at %d expected %d, %d events expected %d\n",
+            label, s_set_pass, set_pass, s_reset_pass, reset_pass, s_events, events);
+    s_failed++;
+  }
+}
+
+static void test_watch(const char *name){
+  s_watch = name;
+  s_set_pass = s_reset_pass = -1;
+  s_events = 0;
+}
+
+/*
+ * Unfiltered rate, the first sample primes it and the second gives the
+ * rate between them
+ */
+static void test_unfiltered(void){
+  s_pv = 0;
+  mgos_alarm_handle_t handle = mgos_add_rate_alarm_h(true, &s_pv, 1000, 0, NAN, NAN, NAN, 1000, 0, s_fast_name);
+  test_value("unfiltered before sampling", handle, NAN);
+  test_pass();
+  test_value("unfiltered first sample", handle, NAN);
+  s_pv += 2;
+  test_pass();
+  test_value("unfiltered ramp", handle, 200);
+  s_pv -= 5;
+  test_pass();
+  test_value("unfiltered step down", handle, -500);
+  mgos_alarm_remove_h(handle);
+}
+
+/*
+ * Filtered rate of a ramp of 100 per s, each pass moving the average
+ * 10 / (90 + 10) of the way, SET once the average reaches h_sv 50 rather
+ * than on the first raw rate above it, and RESET when the PV stops
+ */
+static void test_filtered(void){
+  s_pv = 0;
+  mgos_alarm_handle_t handle = mgos_add_rate_alarm_h(true, &s_pv, 1000, TEST_FILTER_MS, NAN, NAN, 50, NAN, 0,
+                                                     s_rate_name);
+  test_watch(s_rate_name);
+  test_pass();
+  test_value("filtered first sample", handle, NAN);
+  test_pass();
+  test_value("filtered flat", handle, 0);
+  float expected = 0, alpha = (float) TEST_POLL_MS / (TEST_FILTER_MS + TEST_POLL_MS);
+  int ramp = s_pass;
+  for(int k = 0; k < 60; k++){
+    s_pv += 1;
+    test_pass();
+    expected += (100 - expected) * alpha;
+    test_value("filtered ramp", handle, expected);
+  }
+  //100 * (1 - 0.9^n) first reaches 50 at n = 7
+  test_events("filtered ramp", ramp + 7, -1, 1);
+  int stop = s_pass;
+  for(int k = 0; k < 20; k++){
+    test_pass();
+    expected -= expected * alpha;
+    test_value("filtered stop", handle, expected);
+  }
+  //99.82 * 0.9^n first falls below 50 at n = 7
+  test_events("filtered stop", ramp + 7, stop + 7, 2);
+
+  //a NAN PV restarts the history, so the jump back to 0 is not a rate
+  s_pv = NAN;
+  test_pass();
+  test_value("NAN PV", handle, NAN);
+  s_pv = 0;
+  test_pass();
+  test_value("after NAN first sample", handle, NAN);
+  test_pass();
+  test_value("after NAN flat", handle, 0);
+  test_events("after NAN", ramp + 7, stop + 7, 2);
+  mgos_alarm_remove_h(handle);
+}
+
+/*
+ * Filtered deviation from a moving setpoint, the first sample gives the
+ * deviation without priming, a step of the PV converges as the rate does
+ * and a NAN setpoint restarts the history
+ */
+static void test_deviation(void){
+  s_pv = 20;
+  s_sp = 20;
+  mgos_alarm_handle_t handle = mgos_add_deviation_alarm_h(true, &s_pv, &s_sp, TEST_FILTER_MS, NAN, -5, 5, NAN, 0,
+                                                          s_dev_name);
+  test_watch(s_dev_name);
+  s_sp = 23;
+  test_pass();
+  test_value("deviation first sample", handle, -3);
+  s_pv = 33;
+  float expected = -3, alpha = (float) TEST_POLL_MS / (TEST_FILTER_MS + TEST_POLL_MS);
+  int start = s_pass;
+  for(int k = 0; k < 10; k++){
+    test_pass();
+    expected += (10 - expected) * alpha;
+    test_value("deviation step", handle, expected);
+  }
+  //10 - 13 * 0.9^n first reaches 5 at n = 10
+  test_events("deviation step", start + 10, -1, 1);
+  s_sp = NAN;
+  test_pass();
+  test_value("NAN setpoint", handle, NAN);
+  s_sp = 40;
+  test_pass();
+  test_value("after NAN setpoint", handle, -7);
+  //NAN is in no band, so the alarm resets until the setpoint is back
+  test_events("after NAN setpoint", s_pass, s_pass - 1, 3);
+  mgos_alarm_remove_h(handle);
+}
+
+/*
+ * A disabled alarm samples nothing, so enabling it primes the rate again,
+ * and a masked one holds its value until unmasked, when the rate is taken
+ * over the passes it was masked for. The parent sets and resets within
+ * the pass its input changes on, after the PVs were classified.
+ */
+static void test_skipped(void){
+  s_pv = 0;
+  mgos_alarm_handle_t handle = mgos_add_rate_alarm_h(false, &s_pv, 1000, 0, NAN, NAN, NAN, 1000, 0, s_fast_name);
+  for(int k = 0; k < 3; k++){
+    s_pv += 2;
+    test_pass();
+  }
+  test_value("disabled", handle, NAN);
+  mgos_alarm_enable_h(handle);
+  s_pv += 2;
+  test_pass();
+  test_value("enabled first sample", handle, NAN);
+  s_pv += 2;
+  test_pass();
+  test_value("enabled ramp", handle, 200);
+
+  s_trip = true;
+  mgos_alarm_handle_t parent = mgos_add_d_alarm_h(true, &s_trip, ACTIVE_HIGH, 0, 0, s_trip_name);
+  mgos_alarm_set_parent_h(handle, parent);
+  //the PV is sampled before the parent masks the alarm
+  s_pv += 5;
+  test_pass();
+  test_value("tripped", handle, 500);
+  for(int k = 0; k < 5; k++){
+    s_pv += 2;
+    test_pass();
+    test_value("masked", handle, 500);
+  }
+  s_trip = false;
+  s_pv += 2;
+  test_pass();
+  test_value("unmasked", handle, 200);
+  mgos_alarm_remove_h(parent);
+  mgos_alarm_remove_h(handle);
+}
+
+int main(void){
+  if(!mgos_alarm_init(TEST_POLL_MS)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_handler, NULL);
+  if(mgos_add_a_alarm_h(false, NULL, NAN, NAN, 1, NAN, 0, s_rate_name) != MGOS_ALARM_INVALID_HANDLE ||
+     mgos_add_rate_alarm_h(true, &s_pv, 0, 0, NAN, NAN, NAN, NAN, 0, s_rate_name) != MGOS_ALARM_INVALID_HANDLE ||
+     mgos_add_deviation_alarm_h(true, &s_pv, NULL, 0, NAN, NAN, NAN, NAN, 0, s_dev_name) !=
+     MGOS_ALARM_INVALID_HANDLE){
+    fprintf(stderr, "invalid rate or deviation alarm added\n");
+    s_failed++;
+  }
+  test_unfiltered();
+  test_filtered();
+  test_deviation();
+  test_skipped();
+  printf("rate and deviation %s\n", s_failed ? "FAIL" : "ok");
+  return s_failed != 0;
+}
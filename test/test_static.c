@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Static alarm table test
+ *
+ * Checks mgos_alarm_init_static rejects an empty table, counts that do
+ * not match the descriptors, a table without seeds and an alarm without
+ * an input, leaving the library uninitialised with mgos_alarm_get_stats
+ * still safe to call. Then initialises with a table of one digital and
+ * one analog alarm and checks both are found by name, raise their events
+ * and are reported in the arena statistics.
+ *
+ * usage: test_static
+ */
+
+#include "mgos_alarm.h"
+
+#define TEST_POLL_MS 10
+
+static bool s_input;
+static float s_pv;
+static int s_set;
+static int s_failed;
+
+//descriptors and seeds as generated by tools/mgos_alarm_gen.py
+static const struct mgos_alarm_def s_defs[] = {
+  MGOS_ALARM_D_DEF("door", 0x21f5b729u, true, &s_input, ACTIVE_HIGH, 0, 0),
+  MGOS_ALARM_A_DEF("level", 0x9b99e7ddu, true, &s_pv, NAN, NAN, 1.0f, NAN, 0),
+};
+
+static const struct mgos_alarm_def s_no_input[] = {
+  MGOS_ALARM_D_DEF("door", 0x21f5b729u, true, NULL, ACTIVE_HIGH, 0, 0),
+};
+
+static const uint16_t s_seeds[] = {0};
+
+static void test_handler(int ev, void *ev_data, void *arg){
+  (void) ev_data;
+  (void) arg;
+  if(ev == MGOS_ALARM_EV_SET) s_set++;
+}
+
+static void test_check(const char *label, bool ok){
+  if(ok) return;
+  fprintf(stderr, "%s\n", label);
+  s_failed++;
+}
+
+int main(void){
+  const struct mgos_alarm_static_table invalid[] = {
+    {s_defs, 0, 0, 0, s_seeds, 1},
+    {NULL, 2, 1, 1, s_seeds, 1},
+    {s_defs, 2, 0, 2, s_seeds, 1},
+    {s_defs, 2, 2, 0, s_seeds, 1},
+    {s_defs, 2, 1, 1, NULL, 1},
+    {s_defs, 2, 1, 1, s_seeds, 0},
+    {s_no_input, 1, 1, 0, s_seeds, 1},
+  };
+  for(size_t k = 0; k < sizeof(invalid) / sizeof(invalid[0]); k++){
+    if(mgos_alarm_init_static(TEST_POLL_MS, &invalid[k])){
+      fprintf(stderr, "invalid table %u initialised\n", (unsigned) k);
+      return 1;
+    }
+  }
+  struct mgos_alarm_stats stats;
+  mgos_alarm_get_stats(&stats);
+  test_check("stats before init", stats.bytes_per_alarm == 0);
+
+  const struct mgos_alarm_static_table table = {s_defs, 2, 1, 1, s_seeds, 1};
+  if(!mgos_alarm_init_static(TEST_POLL_MS, &table)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_handler, NULL);
+  test_check("alarms found", mgos_alarm_find("door") == mgos_alarm_static_handle(0) &&
+             mgos_alarm_find("level") == mgos_alarm_static_handle(1) &&
+             mgos_alarm_static_handle(0) != MGOS_ALARM_INVALID_HANDLE);
+  s_input = true;
+  s_pv = 2;
+  mgos_host_advance(2 * TEST_POLL_MS);
+  test_check("alarms raised", s_set == 2);
+  mgos_alarm_get_stats(&stats);
+  test_check("stats", stats.arena_used > 0 && stats.bytes_per_alarm > 0);
+  printf("static tables %s\n", s_failed ? "FAIL" : "ok");
+  return s_failed != 0;
+}
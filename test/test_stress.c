@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Multi-threaded stress test of the alarm engine
+ *
+ * The main thread runs the service passes and toggles the inputs of 64
+ * base digital alarms. A writer thread adds and removes 2000 alarms of its
+ * own and updates the PVs of its analog alarms, which in 
+ * MGOS_ALARM_EVAL_IMMEDIATE raise and flush transitions from the writer
+ * thread. Two reader threads list the alarms and read the base alarms'
+ * state. Each phase runs with a different evaluation and dispatch mode.
+ * Checks that:
+ * - no API call fails and the readers only see valid names and states
+ * - every SET/RESET of a base alarm is delivered once and in order
+ * - transitions raised on the writer thread are delivered
+ * - MGOS_ALARM_DISPATCH_ASYNC drops nothing. The writer is paced to
+ *   TEST_PACED_OPS calls per pass in that phase, and the Makefile builds
+ *   this test with a 256 entry queue, so a pass's transitions always fit
+ *   and the counts above are exact.
+ *
+ * Build with SANITIZE=thread to check for data races.
+ *
+ * usage: test_stress [passes per phase]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "mgos_alarm.h"
+
+#ifndef MGOS_ALARM_DISPATCH_QUEUE_SIZE
+#error "build with test/Makefile, which sizes the dispatch queue for this test"
+#endif
+
+#define TEST_BASE 64
+#define TEST_CHURN 2000
+#define TEST_POLL_MS 10
+#define TEST_TOGGLE_PASSES 10
+#define TEST_PACED_OPS 16
+
+static bool s_inputs[TEST_BASE + TEST_CHURN];
+static float s_pvs[TEST_BASE + TEST_CHURN];
+static char s_names[TEST_BASE + TEST_CHURN][12];
+static mgos_alarm_handle_t s_base[TEST_BASE];
+static bool s_stop, s_paced;
+static uint32_t s_pass;
+static uint32_t s_errors, s_lists;
+static uint32_t s_base_events[TEST_BASE], s_base_order_errors, s_churn_events;
+
+static void test_error(const char *what){
+  fprintf(stderr, "%s\n", what);
+  __atomic_add_fetch(&s_errors, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Returns the index of the alarm an info name belongs to, -1 if not one
+ * of the test's names
+ */
+static int test_index(const char *name){
+  if(name < s_names[0] || name > s_names[TEST_BASE + TEST_CHURN - 1]) return -1;
+  size_t offset = (size_t) (name - s_names[0]);
+  if(offset % sizeof(s_names[0]) != 0) return -1;
+  return (int) (offset / sizeof(s_names[0]));
+}
+
+static void test_info(int ev, const struct alarm_info *info){
+  int i = test_index(info->name);
+  if(i < 0){
+    test_error("event of an unknown alarm");
+    return;
+  }
+  if(i >= TEST_BASE){
+    __atomic_add_fetch(&s_churn_events, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  //base alarms start inactive and alternate SET and RESET
+  uint32_t n = __atomic_fetch_add(&s_base_events[i], 1, __ATOMIC_RELAXED);
+  if((ev == MGOS_ALARM_EV_SET) != (n % 2 == 0)) __atomic_add_fetch(&s_base_order_errors, 1, __ATOMIC_RELAXED);
+}
+
+static void test_handler(int ev, void *ev_data, void *userdata){
+  (void) userdata;
+  if(ev == MGOS_ALARM_EV_SET || ev == MGOS_ALARM_EV_RESET) test_info(ev, ev_data);
+  else if(ev == MGOS_ALARM_EV_BATCH){
+    struct alarm_batch *batch = ev_data;
+    for(size_t k = 0; k < batch->length; k++){
+      test_info(batch->transitions[k].ev, &batch->transitions[k].info);
+    }
+  }
+}
+
+static void *test_writer(void *arg){
+  unsigned seed = 1;
+  mgos_alarm_handle_t handles[TEST_CHURN];
+  uint32_t ops = 0;
+  memset(handles, 0, sizeof(handles));
+  (void) arg;
+  while(!__atomic_load_n(&s_stop, __ATOMIC_ACQUIRE)){
+    //in the paced phase wait for the next pass every TEST_PACED_OPS calls
+    if(s_paced && ++ops > TEST_PACED_OPS){
+      uint32_t pass = __atomic_load_n(&s_pass, __ATOMIC_ACQUIRE);
+      while(__atomic_load_n(&s_pass, __ATOMIC_ACQUIRE) == pass && !__atomic_load_n(&s_stop, __ATOMIC_ACQUIRE)){
+        sched_yield();
+      }
+      ops = 1;
+    }
+    uint32_t r = (uint32_t) rand_r(&seed);
+    uint32_t i = r % TEST_CHURN;
+    uint32_t row = TEST_BASE + i;
+    if(handles[i] != MGOS_ALARM_INVALID_HANDLE && (r >> 16) % 4 == 0){
+      if(!mgos_alarm_remove_h(handles[i])) test_error("remove failed");
+      handles[i] = MGOS_ALARM_INVALID_HANDLE;
+    }
+    else if(handles[i] != MGOS_ALARM_INVALID_HANDLE){
+      //only analog PVs are written, under the alarm lock
+      if((i & 1) == 0 && !mgos_alarm_pv_update(handles[i], ((r >> 8) & 1) ? 6.0f : 0.0f)){
+        test_error("pv update failed");
+      }
+      if((i & 1) != 0 && !mgos_alarm_input_changed(handles[i])) test_error("input changed failed");
+    }
+    else{
+      if(i & 1) handles[i] = mgos_add_d_alarm_h(true, &s_inputs[row], ACTIVE_HIGH, 0, 0, s_names[row]);
+      else handles[i] = mgos_add_a_alarm_h(true, &s_pvs[row], NAN, 1, 5, NAN, 0, s_names[row]);
+      if(handles[i] == MGOS_ALARM_INVALID_HANDLE) test_error("add failed");
+    }
+  }
+  for(uint32_t i = 0; i < TEST_CHURN; i++){
+    if(handles[i] != MGOS_ALARM_INVALID_HANDLE) mgos_alarm_remove_h(handles[i]);
+  }
+  return NULL;
+}
+
+static void *test_reader(void *arg){
+  struct alarm_info buf[TEST_BASE];
+  (void) arg;
+  while(!__atomic_load_n(&s_stop, __ATOMIC_ACQUIRE)){
+    struct alarm_list *list = mgos_list_alarms();
+    if(list == NULL){
+      test_error("list failed");
+      continue;
+    }
+    if(list->length < TEST_BASE || list->length > TEST_BASE + TEST_CHURN) test_error("bad list length");
+    for(size_t k = 0; k < list->length; k++){
+      if(test_index(list->info[k].name) < 0) test_error("bad name");
+      if(list->info[k].type == ANALOG && (unsigned) list->info[k].state.a_state > HH) test_error("bad state");
+    }
+    free(list->info);
+    free(list);
+    if(mgos_list_alarms_buf(buf, TEST_BASE) < TEST_BASE) test_error("short buffered list");
+    for(int k = 0; k < TEST_BASE; k++){
+      struct alarm_info info;
+      if(!mgos_alarm_get_state_h(s_base[k], &info) || info.name != s_names[k]) test_error("bad base state");
+    }
+    __atomic_add_fetch(&s_lists, 1, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+/*
+ * Run passes service passes with the writer and readers running
+ * returns the number of failed checks
+ */
+static int test_phase(const char *label, enum mgos_alarm_eval_mode eval, bool batch,
+                      enum mgos_alarm_dispatch_mode dispatch, uint32_t passes){
+  pthread_t writer, readers[2];
+  uint32_t toggles = 0;
+  struct mgos_alarm_stats before, after;
+  mgos_alarm_set_eval_mode(eval);
+  mgos_alarm_set_batch_events(batch);
+  mgos_alarm_set_dispatch_mode(dispatch, MGOS_ALARM_OVERFLOW_DROP_OLDEST);
+  memset(s_base_events, 0, sizeof(s_base_events));
+  s_base_order_errors = s_churn_events = s_errors = s_lists = 0;
+  s_stop = false;
+  s_paced = dispatch == MGOS_ALARM_DISPATCH_ASYNC;
+  mgos_alarm_get_stats(&before);
+  pthread_create(&writer, NULL, test_writer, NULL);
+  for(int k = 0; k < 2; k++) pthread_create(&readers[k], NULL, test_reader, NULL);
+  for(uint32_t p = 1; p <= passes; p++){
+    if(p % TEST_TOGGLE_PASSES == 0){
+      for(int i = 0; i < TEST_BASE; i++){
+        s_inputs[i] = !s_inputs[i];
+        mgos_alarm_input_changed(s_base[i]);
+      }
+      toggles++;
+    }
+    mgos_host_advance(TEST_POLL_MS);
+    __atomic_store_n(&s_pass, p, __ATOMIC_RELEASE);
+    //let the other threads in on a single core
+    if(p % TEST_TOGGLE_PASSES == 5) sched_yield();
+  }
+  __atomic_store_n(&s_stop, true, __ATOMIC_RELEASE);
+  pthread_join(writer, NULL);
+  for(int k = 0; k < 2; k++) pthread_join(readers[k], NULL);
+  //settle, every base alarm ends up inactive
+  if(s_inputs[0]){
+    for(int i = 0; i < TEST_BASE; i++){
+      s_inputs[i] = false;
+      mgos_alarm_input_changed(s_base[i]);
+    }
+    toggles++;
+  }
+  mgos_host_advance(100);
+  mgos_alarm_get_stats(&after);
+  uint32_t dropped = after.queue_dropped - before.queue_dropped;
+  uint32_t base_events = 0;
+  for(int i = 0; i < TEST_BASE; i++) base_events += s_base_events[i];
+  int failed = 0;
+  if(s_errors > 0) failed++;
+  if(s_churn_events == 0) failed++;
+  if(dropped > 0) failed++;
+  for(int i = 0; i < TEST_BASE; i++) failed += s_base_events[i] != toggles;
+  failed += s_base_order_errors != 0;
+  printf("%-16s passes %u lists %u base events %u/%u order errors %u writer events %u dropped %u errors %u %s\n",
+         label, passes, s_lists, base_events, toggles * TEST_BASE, s_base_order_errors, s_churn_events,
+         dropped, s_errors, failed ? "FAIL" : "ok");
+  return failed;
+}
+
+int main(int argc, char **argv){
+  uint32_t passes = (argc > 1) ? (uint32_t) atoi(argv[1]) : 2000;
+  for(int i = 0; i < TEST_BASE + TEST_CHURN; i++) snprintf(s_names[i], sizeof(s_names[i]), "n%d", i);
+  if(!mgos_alarm_init(TEST_POLL_MS)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_handler, NULL);
+  for(int i = 0; i < TEST_BASE; i++){
+    s_base[i] = mgos_add_d_alarm_h(true, &s_inputs[i], ACTIVE_HIGH, 20, 20, s_names[i]);
+  }
+  int failed = test_phase("changed", MGOS_ALARM_EVAL_CHANGED, false, MGOS_ALARM_DISPATCH_SYNC, passes);
+  failed += test_phase("immediate", MGOS_ALARM_EVAL_IMMEDIATE, false, MGOS_ALARM_DISPATCH_SYNC, passes);
+  failed += test_phase("immediate batch", MGOS_ALARM_EVAL_IMMEDIATE, true, MGOS_ALARM_DISPATCH_SYNC, passes);
+  failed += test_phase("immediate async", MGOS_ALARM_EVAL_IMMEDIATE, false, MGOS_ALARM_DISPATCH_ASYNC, passes);
+  return failed != 0;
+}
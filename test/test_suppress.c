@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Suppression graph test
+ *
+ * Builds power -> breaker -> pump1, pump2 bottom up, so the rows are in
+ * the reverse of the depth order and the breaker's subtree moves deeper
+ * when it is attached, with filler alarms between them so the graph spans
+ * two bitset words. The events raised are counted per alarm while the
+ * inputs trip together, with an alarm already active, as the parent
+ * resets and as it is removed. Children must be masked before they raise
+ * anything, the first out of each cascade recorded, and masked alarms
+ * raise what their inputs still call for once unmasked. A parent that is
+ * the child itself or one of its descendants is rejected. The test runs
+ * with a serial pass and with the pass split into two shards.
+ *
+ * usage: test_suppress
+ */
+
+#include "mgos_alarm.h"
+
+#define TEST_POLL_MS 10
+#define TEST_FILLERS 40
+
+enum test_alarm{
+  TEST_PUMP1,
+  TEST_PUMP2,
+  TEST_BREAKER,
+  TEST_POWER,
+  TEST_ALARMS
+};
+
+static char s_names[TEST_ALARMS][8] = {"pump1", "pump2", "breaker", "power"};
+static char s_filler_names[TEST_FILLERS][8];
+static bool s_inputs[TEST_ALARMS], s_filler_input;
+static mgos_alarm_handle_t s_handles[TEST_ALARMS];
+static int s_set[TEST_ALARMS], s_reset[TEST_ALARMS];
+static int s_failed;
+static const char *s_phase;
+
+static void test_handler(int ev, void *ev_data, void *arg){
+  (void) arg;
+  struct alarm_info *info = (struct alarm_info *) ev_data;
+  if(ev != MGOS_ALARM_EV_SET && ev != MGOS_ALARM_EV_RESET) return;
+  for(int k = 0; k < TEST_ALARMS; k++){
+    if(info->name != s_names[k]) continue;
+    if(ev == MGOS_ALARM_EV_SET) s_set[k]++;
+    else s_reset[k]++;
+  }
+}
+
+/*
+ * Runs the shards one after another, last first
+ */
+static void test_runner(uint32_t shards, mgos_alarm_shard_fn fn, void *ctx, void *arg){
+  (void) arg;
+  for(uint32_t k = shards; k-- > 0;) fn(k, ctx);
+}
+
+static bool test_active(int k){
+  struct alarm_info info;
+  return mgos_alarm_get_state_h(s_handles[k], &info) && info.state.d_state;
+}
+
+/*
+ * Check the events each alarm raised since the last check, sets and
+ * resets as bits of each alarm, and the alarms active, as bits too
+ */
+static void test_check(const char *label, unsigned sets, unsigned resets, unsigned active){
+  for(int k = 0; k < TEST_ALARMS; k++){
+    if(s_set[k] == (int) ((sets >> k) & 1) && s_reset[k] == (int) ((resets >> k) & 1) &&
+       test_active(k) == ((active >> k) & 1)) continue;
+    fprintf(stderr, "%s %s: %s raised %d SET %d RESET and is %s\n", s_phase, label, s_names[k], s_set[k],
+            s_reset[k], test_active(k) ? "active" : "inactive");
+    s_failed++;
+  }
+  memset(s_set, 0, sizeof(s_set));
+  memset(s_reset, 0, sizeof(s_reset));
+}
+
+static void test_first_out(const char *label, int parent, int first_out, uint32_t masked, bool active){
+  struct alarm_first_out fo;
+  if(mgos_alarm_get_first_out(&fo) && fo.parent == s_handles[parent] && fo.first_out == s_handles[first_out] &&
+     fo.masked == masked && fo.active == active) return;
+  fprintf(stderr, "%s %s: first out of %u is %u masking %u%s\n", s_phase, label, (unsigned) fo.parent,
+          (unsigned) fo.first_out, (unsigned) fo.masked, fo.active ? "" : ", ended");
+  s_failed++;
+}
+
+#define BIT(k) (1u << (k))
+
+/*
+ * Add the graph bottom up and check the parents that would form a cycle
+ * are rejected
+ */
+static void test_build(void){
+  for(int k = 0; k < TEST_ALARMS; k++){
+    s_inputs[k] = false;
+    s_handles[k] = mgos_add_d_alarm_h(true, &s_inputs[k], ACTIVE_HIGH, 0, 0, s_names[k]);
+    if(k == TEST_PUMP2){
+      for(int f = 0; f < TEST_FILLERS; f++){
+        mgos_add_d_alarm_h(true, &s_filler_input, ACTIVE_HIGH, 0, 0, s_filler_names[f]);
+      }
+    }
+  }
+  bool ok = mgos_alarm_set_parent_h(s_handles[TEST_PUMP1], s_handles[TEST_BREAKER]) &&
+            mgos_alarm_set_parent_h(s_handles[TEST_PUMP2], s_handles[TEST_BREAKER]) &&
+            mgos_alarm_set_parent_h(s_handles[TEST_BREAKER], s_handles[TEST_POWER]);
+  if(!ok){
+    fprintf(stderr, "%s: graph not built\n", s_phase);
+    s_failed++;
+  }
+  if(mgos_alarm_set_parent_h(s_handles[TEST_POWER], s_handles[TEST_POWER]) ||
+     mgos_alarm_set_parent_h(s_handles[TEST_POWER], s_handles[TEST_PUMP2]) ||
+     mgos_alarm_set_parent_h(s_handles[TEST_BREAKER], s_handles[TEST_PUMP1]) ||
+     mgos_alarm_set_parent_h(s_handles[TEST_PUMP1], MGOS_ALARM_INVALID_HANDLE + 12345)){
+    fprintf(stderr, "%s: cycle or invalid parent accepted\n", s_phase);
+    s_failed++;
+  }
+}
+
+/*
+ * Run the phase with the pass split into shards
+ */
+static void test_phase(const char *label, uint32_t shards){
+  s_phase = label;
+  if(!mgos_alarm_set_shards(shards, shards > 1 ? test_runner : NULL, NULL)){
+    s_failed++;
+    return;
+  }
+  test_build();
+  mgos_host_advance(TEST_POLL_MS);
+  test_check("built", 0, 0, 0);
+
+  //every input trips in one pass, only power raises
+  for(int k = 0; k < TEST_ALARMS; k++) s_inputs[k] = true;
+  mgos_host_advance(TEST_POLL_MS);
+  test_check("trip together", BIT(TEST_POWER), 0, BIT(TEST_POWER));
+  test_first_out("trip together", TEST_POWER, TEST_POWER, 3, true);
+
+  //power resets and unmasks the breaker, which its input still trips and
+  //which masks the pumps before they raise. A serial pass evaluates it at
+  //its depth in the same pass, a sharded one on the next pass.
+  s_inputs[TEST_POWER] = false;
+  mgos_host_advance(2 * TEST_POLL_MS);
+  test_check("power reset", BIT(TEST_BREAKER), BIT(TEST_POWER), BIT(TEST_BREAKER));
+  test_first_out("power reset", TEST_BREAKER, TEST_BREAKER, 2, true);
+
+  //the breaker resets, ending its cascade, and the pumps raise what their
+  //inputs call for
+  s_inputs[TEST_BREAKER] = false;
+  mgos_host_advance(2 * TEST_POLL_MS);
+  test_check("pumps unmasked", BIT(TEST_PUMP1) | BIT(TEST_PUMP2), BIT(TEST_BREAKER),
+             BIT(TEST_PUMP1) | BIT(TEST_PUMP2));
+  test_first_out("pumps unmasked", TEST_BREAKER, TEST_BREAKER, 2, false);
+
+  //pump1 stays active while masked and is the first out
+  s_inputs[TEST_PUMP2] = false;
+  mgos_host_advance(TEST_POLL_MS);
+  test_check("pump2 reset", 0, BIT(TEST_PUMP2), BIT(TEST_PUMP1));
+  s_inputs[TEST_POWER] = true;
+  s_inputs[TEST_PUMP2] = true;
+  s_inputs[TEST_PUMP1] = false;
+  mgos_host_advance(TEST_POLL_MS);
+  test_check("cascade", BIT(TEST_POWER), 0, BIT(TEST_POWER) | BIT(TEST_PUMP1));
+  test_first_out("cascade", TEST_POWER, TEST_PUMP1, 3, true);
+
+  //removing power detaches and unmasks the breaker, which masks the pumps
+  //again, holding pump1 active
+  s_inputs[TEST_BREAKER] = true;
+  mgos_alarm_remove_h(s_handles[TEST_POWER]);
+  mgos_host_advance(2 * TEST_POLL_MS);
+  test_check("power removed", BIT(TEST_BREAKER), 0, BIT(TEST_BREAKER) | BIT(TEST_PUMP1));
+  test_first_out("power removed", TEST_BREAKER, TEST_PUMP1, 2, true);
+
+  //removing the breaker unmasks the pumps at depth 0
+  mgos_alarm_remove_h(s_handles[TEST_BREAKER]);
+  mgos_host_advance(2 * TEST_POLL_MS);
+  test_check("breaker removed", BIT(TEST_PUMP2), BIT(TEST_PUMP1), BIT(TEST_PUMP2));
+  test_first_out("breaker removed", TEST_BREAKER, TEST_PUMP1, 2, false);
+  if(mgos_alarm_set_parent_h(s_handles[TEST_PUMP1], s_handles[TEST_BREAKER]) ||
+     !mgos_alarm_set_parent_h(s_handles[TEST_PUMP1], s_handles[TEST_PUMP2])){
+    fprintf(stderr, "%s: stale parent accepted or pump parent rejected\n", s_phase);
+    s_failed++;
+  }
+  for(int k = TEST_PUMP1; k <= TEST_PUMP2; k++) mgos_alarm_remove_h(s_handles[k]);
+  for(int f = 0; f < TEST_FILLERS; f++) mgos_alarm_remove_h(mgos_alarm_find(s_filler_names[f]));
+  mgos_host_advance(TEST_POLL_MS);
+  memset(s_set, 0, sizeof(s_set));
+  memset(s_reset, 0, sizeof(s_reset));
+}
+
+int main(void){
+  for(int f = 0; f < TEST_FILLERS; f++) snprintf(s_filler_names[f], sizeof(s_filler_names[f]), "fill%d", f);
+  if(!mgos_alarm_init(TEST_POLL_MS) || !mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_handler, NULL);
+  test_phase("serial", 1);
+  test_phase("sharded", 2);
+  printf("suppression %s\n", s_failed ? "FAIL" : "ok");
+  return s_failed != 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2019 Neill Skelly
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Window alarm test
+ *
+ * Feeds a pseudo random PV, one sample per 10 ms pass, to minimum,
+ * maximum and mean window alarms and checks the value of
+ * mgos_alarm_get_value_h after every pass against the statistic computed
+ * here over the history of the PV. The windows are limited by samples
+ * alone and by window_ms within a larger ring, the PV runs for several
+ * laps of each ring, and a NAN PV empties them. Also checks the maximum
+ * alarm raises its SET and RESET on the passes the modelled statistic
+ * crosses h_sv, in MGOS_ALARM_DEBOUNCE_TIMESTAMP mode so that they are
+ * raised within the pass, and the arguments rejected.
+ *
+ * usage: test_window
+ */
+
+#include <math.h>
+
+#include "mgos_alarm.h"
+
+#define TEST_POLL_MS 10
+#define TEST_PASSES 400
+#define TEST_H_SV 80
+
+/*
+ * window alarm under test
+ *
+ * name, stat, samples, window_ms - arguments it is added with
+ * handle - its handle
+ * kept - samples the model keeps, the fewer of samples and the samples
+ *   younger than window_ms
+ */
+struct test_window{
+  char name[8];
+  enum mgos_alarm_window_stat stat;
+  int samples, window_ms;
+  mgos_alarm_handle_t handle;
+  int kept;
+};
+
+static struct test_window s_windows[] = {
+  {"min", MGOS_ALARM_WINDOW_MIN, 8, 0, MGOS_ALARM_INVALID_HANDLE, 8},
+  {"max", MGOS_ALARM_WINDOW_MAX, 32, 50, MGOS_ALARM_INVALID_HANDLE, 5},
+  {"mean", MGOS_ALARM_WINDOW_MEAN, 10, 0, MGOS_ALARM_INVALID_HANDLE, 10},
+  {"tmean", MGOS_ALARM_WINDOW_MEAN, 16, 70, MGOS_ALARM_INVALID_HANDLE, 7},
+};
+
+#define TEST_WINDOWS (int) (sizeof(s_windows) / sizeof(s_windows[0]))
+
+static float s_pv;
+static float s_history[TEST_PASSES];
+static int s_count;
+static int s_set, s_reset;
+static bool s_high;
+static int s_failed;
+static uint32_t s_seed = 12345;
+
+static void test_handler(int ev, void *ev_data, void *arg){
+  (void) arg;
+  struct alarm_info *info = (struct alarm_info *) ev_data;
+  if(info->name != s_windows[1].name) return;
+  if(ev == MGOS_ALARM_EV_SET) s_set++;
+  else if(ev == MGOS_ALARM_EV_RESET) s_reset++;
+}
+
+static float test_random(void){
+  s_seed = s_seed * 1103515245u + 12345u;
+  return (float) ((s_seed >> 16) % 10000) / 100.0f;
+}
+
+/*
+ * Returns the statistic of the last kept samples of the history
+ */
+static float test_model(const struct test_window *w){
+  int n = s_count < w->kept ? s_count : w->kept;
+  float value = s_history[s_count - 1], sum = 0;
+  for(int k = s_count - n; k < s_count; k++){
+    float v = s_history[k];
+    if(w->stat == MGOS_ALARM_WINDOW_MIN && v < value) value = v;
+    if(w->stat == MGOS_ALARM_WINDOW_MAX && v > value) value = v;
+    sum += v;
+  }
+  return w->stat == MGOS_ALARM_WINDOW_MEAN ? sum / (float) n : value;
+}
+
+/*
+ * Run one pass on pv and check every window against the model, a NAN PV
+ * empties the history
+ */
+static void test_pass(int pass, float pv){
+  s_pv = pv;
+  if(isnan(pv)) s_count = 0;
+  else s_history[s_count++] = pv;
+  mgos_host_advance(TEST_POLL_MS);
+  for(int k = 0; k < TEST_WINDOWS; k++){
+    float value, expected = s_count == 0 ? NAN : test_model(&s_windows[k]);
+    bool ok = mgos_alarm_get_value_h(s_windows[k].handle, &value);
+    if(ok && isnan(expected)) ok = isnan(value);
+    else if(ok) ok = fabsf(value - expected) <= 1e-4f * (1.0f + fabsf(expected));
+    if(!ok){
+      fprintf(stderr, "%s: pass %d value %g expected %g\n", s_windows[k].name, pass, (double) value,
+              (double) expected);
+      s_failed++;
+    }
+  }
+  //the maximum alarm is in H while its statistic is at or above h_sv
+  bool high = s_count > 0 && test_model(&s_windows[1]) >= TEST_H_SV;
+  if(s_set != (high && !s_high) || s_reset != (!high && s_high)){
+    fprintf(stderr, "max: pass %d raised %d SET %d RESET\n", pass, s_set, s_reset);
+    s_failed++;
+  }
+  s_set = s_reset = 0;
+  s_high = high;
+}
+
+int main(void){
+  if(!mgos_alarm_init(TEST_POLL_MS) || !mgos_alarm_set_debounce_mode(MGOS_ALARM_DEBOUNCE_TIMESTAMP)) return 1;
+  mgos_event_add_group_handler(MGOS_EVENT_GRP_ALARM, test_handler, NULL);
+  if(mgos_add_window_alarm_h(true, NULL, MGOS_ALARM_WINDOW_MIN, 4, 0, NAN, NAN, 1, NAN, 0, s_windows[0].name) !=
+     MGOS_ALARM_INVALID_HANDLE ||
+     mgos_add_window_alarm_h(true, &s_pv, MGOS_ALARM_WINDOW_MIN, 0, 0, NAN, NAN, 1, NAN, 0, s_windows[0].name) !=
+     MGOS_ALARM_INVALID_HANDLE ||
+     mgos_add_window_alarm_h(true, &s_pv, (enum mgos_alarm_window_stat) 7, 4, 0, NAN, NAN, 1, NAN, 0,
+                             s_windows[0].name) != MGOS_ALARM_INVALID_HANDLE){
+    fprintf(stderr, "invalid window alarm added\n");
+    s_failed++;
+  }
+  for(int k = 0; k < TEST_WINDOWS; k++){
+    struct test_window *w = &s_windows[k];
+    w->handle = mgos_add_window_alarm_h(true, &s_pv, w->stat, w->samples, w->window_ms, NAN, NAN, TEST_H_SV, NAN, 0,
+                                        w->name);
+  }
+  int pass = 0;
+  for(; pass < TEST_PASSES / 2; pass++) test_pass(pass, test_random());
+  test_pass(pass++, NAN);
+  for(; pass < TEST_PASSES; pass++) test_pass(pass, test_random());
+  printf("window %s\n", s_failed ? "FAIL" : "ok");
+  return s_failed != 0;
+}
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019 Neill Skelly
+# All rights reserved
+#
+# Licensed under the Apache License, Version 2.0 (the ""License"");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an ""AS IS"" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+"""Compile a JSON alarm configuration into the binary form mgos_alarm_load_config
+reads without parsing text.
+
+The JSON is the format mgos_alarm_load_config reads, input and pv being
+indexes into the arrays of struct mgos_alarm_config_io:
+
+    {
+      "alarms": [
+        {"name": "alarm1", "type": "digital", "input": 0,
+         "mode": "ACTIVE_HIGH", "set_interval": 1000, "reset_interval": 1000},
+        {"name": "alarm4", "type": "analog", "pv": 0,
+         "ll_sv": 0.2, "l_sv": 0.3, "h_sv": null, "hh_sv": 0.5,
+         "set_interval": 1000, "enabled": false}
+      ]
+    }
+
+The alarms are checked as the device checks them, so a blob this tool
+writes only fails to load on a device whose inputs or pvs are too few or
+whose alarms already use one of its names.
+
+usage: mgos_alarm_config.py alarms.json alarms.bin
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"ALMC"
+VERSION = 1
+ENABLED = 0x01
+ACTIVE_HIGH = 0x02
+SV_KEYS = ("ll_sv", "l_sv", "h_sv", "hh_sv")
+
+
+def interval(a, key):
+    value = a.get(key, 0)
+    if not isinstance(value, int) or not 0 <= value <= 0x7FFFFFFF:
+        sys.exit('alarm "%s" has an invalid %s' % (a["name"], key))
+    return value
+
+
+def index(a, key):
+    value = a.get(key)
+    if not isinstance(value, int) or not 0 <= value <= 0xFFFFFFFF:
+        sys.exit('alarm "%s" has an invalid %s' % (a["name"], key))
+    return value
+
+
+def record(a):
+    """Encode one alarm, see CONFIG_MAGIC in src/mgos_alarm_config.c."""
+    name = a.get("name", "")
+    if not isinstance(name, str) or not name or "\0" in name:
+        sys.exit("alarm without a valid name")
+    raw = name.encode()
+    if len(raw) > 0xFFFF:
+        sys.exit('alarm "%s" has too long a name' % name)
+    flags = ENABLED if a.get("enabled", True) else 0
+    if a.get("type") == "digital":
+        mode = a.get("mode", "ACTIVE_HIGH")
+        if mode not in ("ACTIVE_HIGH", "ACTIVE_LOW"):
+            sys.exit('digital alarm "%s" has an invalid mode' % name)
+        if mode == "ACTIVE_HIGH":
+            flags |= ACTIVE_HIGH
+        return struct.pack("<BBHIii", 0, flags, len(raw), index(a, "input"),
+                           interval(a, "set_interval"), interval(a, "reset_interval")) + raw
+    if a.get("type") == "analog":
+        svs = [a.get(k) for k in SV_KEYS]
+        used = [sv for sv in svs if sv is not None]
+        if not used:
+            sys.exit('analog alarm "%s" has all sv values unused' % name)
+        if used != sorted(used):
+            sys.exit('analog alarm "%s" has invalid sv values' % name)
+        svs = [float("nan") if sv is None else float(sv) for sv in svs]
+        return struct.pack("<BBHIffffi", 1, flags, len(raw), index(a, "pv"), *svs,
+                           interval(a, "set_interval")) + raw
+    sys.exit('alarm "%s" has an invalid type' % name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile a JSON alarm configuration")
+    parser.add_argument("config", help="JSON alarm configuration")
+    parser.add_argument("output", help="binary configuration to write")
+    args = parser.parse_args()
+
+    with open(args.config) as f:
+        alarms = json.load(f)["alarms"]
+    names = set()
+    for a in alarms:
+        if a.get("name") in names:
+            sys.exit('alarm "%s" is not unique' % a["name"])
+        names.add(a.get("name"))
+    blob = struct.pack("<4sB3xI", MAGIC, VERSION, len(alarms))
+    blob += b"".join(record(a) for a in alarms)
+    with open(args.output, "wb") as f:
+        f.write(blob)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019 Neill Skelly
+# All rights reserved
+#
+# Licensed under the Apache License, Version 2.0 (the ""License"");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an ""AS IS"" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+"""Generate a static alarm table for mgos_alarm_init_static.
+
+The alarm set is read from a JSON file:
+
+    {
+      "table": "main_alarms",
+      "includes": ["main_inputs.h"],
+      "alarms": [
+        {"name": "alarm1", "type": "digital", "input": "input_1",
+         "mode": "ACTIVE_HIGH", "set_interval": 1000, "reset_interval": 1000},
+        {"name": "alarm4", "type": "analog", "pv": "input_4",
+         "ll_sv": 0.2, "l_sv": 0.3, "h_sv": null, "hh_sv": 0.5,
+         "set_interval": 1000, "enabled": false}
+      ]
+    }
+
+input and pv name the bool and float variables the alarms read, plain
+identifiers are declared extern, anything else must be declared by the
+includes. null setpoints are unused (NAN). Names are checked for uniqueness and
+setpoint order here so that the device does neither at startup.
+
+<table>.c holds the const alarm descriptors, ordered by a minimal perfect
+hash of their names, and the hash seeds. <table>.h declares the table and
+the index of every alarm for mgos_alarm_static_handle.
+
+usage: mgos_alarm_gen.py alarms.json out_dir
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+MAX_SEED = 0xFFFF
+
+
+def fnv1a(name):
+    """FNV-1a hash of a name, as mgos_alarm_hash."""
+    h = 2166136261
+    for b in name.encode():
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def mix(h, seed):
+    """Seeded hash mix, as mgos_alarm_static_mix."""
+    x = h ^ ((seed * 0x9E3779B9) & 0xFFFFFFFF)
+    x ^= x >> 16
+    x = (x * 0x85EBCA6B) & 0xFFFFFFFF
+    x ^= x >> 13
+    x = (x * 0xC2B2AE35) & 0xFFFFFFFF
+    x ^= x >> 16
+    return x
+
+
+def perfect_hash(hashes):
+    """Hash and displace: bucket the names, then place the largest buckets
+    first, searching for a seed that maps the whole bucket to free slots.
+
+    Returns (seeds, order) where order[i] is the name placed in slot i.
+    """
+    n = len(hashes)
+    num_seeds = max(1, (n + 1) // 2)
+    buckets = [[] for _ in range(num_seeds)]
+    for i, h in enumerate(hashes):
+        buckets[h % num_seeds].append(i)
+    seeds = [0] * num_seeds
+    order = [None] * n
+    for b in sorted(range(num_seeds), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            break
+        for seed in range(MAX_SEED + 1):
+            slots = [mix(hashes[i], seed) % n for i in buckets[b]]
+            if len(set(slots)) == len(slots) and all(order[s] is None for s in slots):
+                break
+        else:
+            sys.exit("no perfect hash seed found, rename an alarm")
+        seeds[b] = seed
+        for i, s in zip(buckets[b], slots):
+            order[s] = i
+    return seeds, order
+
+
+def c_float(value):
+    if value is None:
+        return "NAN"
+    return repr(float(value)) + "f"
+
+
+def c_ident(name):
+    return re.sub(r"[^0-9A-Za-z]", "_", name).upper()
+
+
+def check(alarms):
+    names = set()
+    for a in alarms:
+        name = a.get("name", "")
+        if not name:
+            sys.exit("alarm without a name")
+        if name in names:
+            sys.exit('alarm "%s" is not unique' % name)
+        names.add(name)
+        if a.get("type") == "digital":
+            if "input" not in a:
+                sys.exit('digital alarm "%s" has no input' % name)
+            if a.get("mode", "ACTIVE_HIGH") not in ("ACTIVE_HIGH", "ACTIVE_LOW"):
+                sys.exit('digital alarm "%s" has an invalid mode' % name)
+        elif a.get("type") == "analog":
+            if "pv" not in a:
+                sys.exit('analog alarm "%s" has no pv' % name)
+            svs = [a.get(k) for k in ("ll_sv", "l_sv", "h_sv", "hh_sv")]
+            svs = [sv for sv in svs if sv is not None]
+            if not svs:
+                sys.exit('analog alarm "%s" has all sv values unused' % name)
+            if svs != sorted(svs):
+                sys.exit('analog alarm "%s" has invalid sv values' % name)
+        else:
+            sys.exit('alarm "%s" has an invalid type' % name)
+
+
+def alarm_def(a, h):
+    enabled = "true" if a.get("enabled", True) else "false"
+    if a["type"] == "digital":
+        return 'MGOS_ALARM_D_DEF("%s", 0x%08xu, %s, &%s, %s, %d, %d)' % (
+            a["name"], h, enabled, a["input"], a.get("mode", "ACTIVE_HIGH"),
+            max(0, a.get("set_interval", 0)), max(0, a.get("reset_interval", 0)))
+    return 'MGOS_ALARM_A_DEF("%s", 0x%08xu, %s, &%s, %s, %s, %s, %s, %d)' % (
+        a["name"], h, enabled, a["pv"], c_float(a.get("ll_sv")), c_float(a.get("l_sv")),
+        c_float(a.get("h_sv")), c_float(a.get("hh_sv")), max(0, a.get("set_interval", 0)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a static alarm table")
+    parser.add_argument("config", help="JSON alarm definitions")
+    parser.add_argument("out_dir", help="directory <table>.c and <table>.h are written to")
+    args = parser.parse_args()
+
+    with open(args.config) as f:
+        config = json.load(f)
+    table = config["table"]
+    alarms = config["alarms"]
+    check(alarms)
+    hashes = [fnv1a(a["name"]) for a in alarms]
+    seeds, order = perfect_hash(hashes) if alarms else ([0], [])
+    d_alarms = sum(1 for a in alarms if a["type"] == "digital")
+    a_alarms = len(alarms) - d_alarms
+    source = os.path.basename(args.config)
+    guard = "CS_FW_SRC_%s_H_" % c_ident(table)
+
+    with open(os.path.join(args.out_dir, table + ".h"), "w") as f:
+        f.write("/*\n * Generated by tools/mgos_alarm_gen.py from %s, do not edit\n *\n" % source)
+        f.write(" * Reserved on the heap unless the app sets the cdefs\n")
+        f.write(" *   MGOS_ALARM_STATIC_D_ALARMS: %d\n" % d_alarms)
+        f.write(" *   MGOS_ALARM_STATIC_A_ALARMS: %d\n */\n\n" % a_alarms)
+        f.write("#ifndef %s\n#define %s\n\n#include \"mgos_alarm.h\"\n\n" % (guard, guard))
+        f.write("extern const struct mgos_alarm_static_table %s;\n\n" % table)
+        if alarms:
+            f.write("/*\n * index of each alarm, see mgos_alarm_static_handle\n */\n")
+            f.write("enum %s_index{\n" % table)
+            for slot, i in enumerate(order):
+                f.write("  %s_%s = %d,\n" % (c_ident(table), c_ident(alarms[i]["name"]), slot))
+            f.write("};\n\n")
+        f.write("#endif /* %s */\n" % guard)
+
+    with open(os.path.join(args.out_dir, table + ".c"), "w") as f:
+        f.write("/*\n * Generated by tools/mgos_alarm_gen.py from %s, do not edit\n */\n\n" % source)
+        for inc in config.get("includes", []):
+            f.write("#include \"%s\"\n" % inc)
+        f.write("#include \"%s.h\"\n\n" % table)
+        externs = []
+        for a in alarms:
+            decl = ("bool", a["input"]) if a["type"] == "digital" else ("float", a["pv"])
+            if re.match(r"^[A-Za-z_][0-9A-Za-z_]*$", decl[1]) and decl not in externs:
+                externs.append(decl)
+        for decl in externs:
+            f.write("extern %s %s;\n" % decl)
+        if externs:
+            f.write("\n")
+        if alarms:
+            f.write("static const struct mgos_alarm_def s_defs[] = {\n")
+            for i in order:
+                f.write("  %s,\n" % alarm_def(alarms[i], hashes[i]))
+            f.write("};\n\n")
+        f.write("static const uint16_t s_seeds[] = {%s};\n\n" % ", ".join(str(s) for s in seeds))
+        f.write("const struct mgos_alarm_static_table %s = {\n" % table)
+        f.write("  %s, %d, %d, %d,\n" % ("s_defs" if alarms else "NULL", len(alarms), d_alarms, a_alarms))
+        f.write("  s_seeds, %d\n};\n" % len(seeds))
+
+
+if __name__ == "__main__":
+    main()